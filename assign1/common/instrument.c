@@ -0,0 +1,169 @@
+/**
+ *  \file instrument.c (implementation file)
+ *
+ *  \brief Opt-in counters and timers of the hot paths, shared by the text processing and the matrix determinant programs.
+ *
+ *  The slots of the threads are taken in turn from a static array, each on its own cache lines, so
+ *  the counters of a thread are only ever written by that thread. The dump runs at exit, once the
+ *  threads have been joined.
+ */
+
+#ifdef INSTRUMENT
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+
+#include "instrument.h"
+
+/** \brief most threads with their own slot, the others share the last one */
+#define INSTR_THREADS 256
+
+/** \brief counters of a thread */
+struct instrSlot
+{
+  uint64_t value[INSTR_COUNTERS];
+  const char *role;
+  int id;
+} __attribute__((aligned(64)));
+
+/** \brief names of the counters in the dump */
+static const char *counterNames[INSTR_COUNTERS] = {
+  "lockAcquires", "lockContended", "lockWaitNs", "condWaitNs", "fullWaitNs", "emptyWaitNs",
+  "queuePuts", "queueOccupancySum", "queueMax", "readCalls", "readBytes", "readNs",
+  "computeItems", "computeNs", "steals",
+};
+
+/** \brief slots of the threads */
+static struct instrSlot slots[INSTR_THREADS];
+
+/** \brief slots taken */
+static atomic_int nSlots = 0;
+
+/** \brief slot of the calling thread */
+static __thread struct instrSlot *self = NULL;
+
+/** \brief the dump is registered once */
+static pthread_once_t dumpOnce = PTHREAD_ONCE_INIT;
+
+/**
+ *  \brief Print the slots taken, one JSON line each.
+ */
+static void instrDump(void)
+{
+  int n = atomic_load(&nSlots);
+  if (n > INSTR_THREADS)
+    n = INSTR_THREADS;
+
+  for (int s = 0; s < n; s++)
+  {
+    fprintf(stderr, "{\"program\": \"%s\", \"role\": \"%s\", \"id\": %d", program_invocation_short_name,
+            slots[s].role, slots[s].id);
+    for (int c = 0; c < INSTR_COUNTERS; c++)
+      fprintf(stderr, ", \"%s\": %lu", counterNames[c], (unsigned long)slots[s].value[c]);
+    fprintf(stderr, "}\n");
+  }
+}
+
+/** \brief register the dump at exit */
+static void instrRegisterDump(void)
+{
+  atexit(instrDump);
+}
+
+/**
+ *  \brief Slot of the calling thread, taken on its first use.
+ *
+ *  \return slot
+ */
+static struct instrSlot *instrSelf(void)
+{
+  if (self == NULL)
+  {
+    pthread_once(&dumpOnce, instrRegisterDump);
+    int s = atomic_fetch_add(&nSlots, 1);
+    self = &slots[(s < INSTR_THREADS) ? s : INSTR_THREADS - 1];
+    if (self->role == NULL)
+    {
+      self->role = "main";
+      self->id = s;
+    }
+  }
+  return self;
+}
+
+/**
+ *  \brief Name the calling thread in the dump.
+ *
+ *  \param role role of the thread (worker, reader, pool...)
+ *  \param id index of the thread in its role
+ */
+void instrThread(const char *role, int id)
+{
+  struct instrSlot *slot = instrSelf();
+  slot->role = role;
+  slot->id = id;
+}
+
+/**
+ *  \brief Current time.
+ *
+ *  \return ns since an arbitrary point
+ */
+uint64_t instrNow(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+ *  \brief Add a value to a counter of the calling thread.
+ *
+ *  \param counter counter
+ *  \param value value added
+ */
+void instrAdd(enum instrCounter counter, uint64_t value)
+{
+  instrSelf()->value[counter] += value;
+}
+
+/**
+ *  \brief Keep the largest value of a counter of the calling thread.
+ *
+ *  \param counter counter
+ *  \param value value seen
+ */
+void instrMax(enum instrCounter counter, uint64_t value)
+{
+  struct instrSlot *slot = instrSelf();
+  if (value > slot->value[counter])
+    slot->value[counter] = value;
+}
+
+/**
+ *  \brief Lock a mutex, timing the wait if it is taken by another thread.
+ *
+ *  \param mutex mutex
+ *
+ *  \return status of pthread_mutex_lock
+ */
+int instrLock(pthread_mutex_t *mutex)
+{
+  struct instrSlot *slot = instrSelf();
+  slot->value[INSTR_LOCK_ACQUIRES]++;
+  if (pthread_mutex_trylock(mutex) == 0)
+    return 0;
+
+  uint64_t start = instrNow();
+  int status = pthread_mutex_lock(mutex);
+  slot->value[INSTR_LOCK_WAIT] += instrNow() - start;
+  slot->value[INSTR_LOCK_CONTENDED]++;
+  return status;
+}
+
+#endif /* INSTRUMENT */
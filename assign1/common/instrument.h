@@ -0,0 +1,83 @@
+/**
+ *  \file instrument.h (interface file)
+ *
+ *  \brief Opt-in counters and timers of the hot paths, shared by the text processing and the matrix determinant programs.
+ *
+ *  Built with -DINSTRUMENT, every thread adds to its own slot of counters, without locks nor atomics,
+ *  and at exit each slot is printed to stderr as a JSON line:
+ *
+ *     {"program": "prog2", "role": "worker", "id": 0, "lockWaitNs": 0, ...}
+ *
+ *  Without -DINSTRUMENT the macros below are empty and instrument.c is empty, so nothing is left of them.
+ *
+ *  Methods (all through the macros):
+ *     \li INSTR_THREAD - names the calling thread in the dump.
+ *     \li INSTR_NOW - start of a timed interval.
+ *     \li INSTR_TIME - adds the time elapsed since a start to a counter.
+ *     \li INSTR_ADD - adds a value to a counter.
+ *     \li INSTR_MAX - keeps the largest value of a counter.
+ *     \li INSTR_LOCK - locks a mutex, timing the wait when it is taken by another thread.
+ */
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/** \brief counters of a thread */
+enum instrCounter
+{
+  INSTR_LOCK_ACQUIRES,   /* mutex acquisitions */
+  INSTR_LOCK_CONTENDED,  /* acquisitions that found the mutex taken */
+  INSTR_LOCK_WAIT,       /* ns blocked on a taken mutex */
+  INSTR_COND_WAIT,       /* ns asleep on a condition variable */
+  INSTR_FULL_WAIT,       /* ns waiting for a slot of a full queue */
+  INSTR_EMPTY_WAIT,      /* ns waiting for an item of an empty queue */
+  INSTR_QUEUE_PUTS,      /* items inserted in the queue */
+  INSTR_QUEUE_OCCUPANCY, /* sum of the items in the queue after each insertion */
+  INSTR_QUEUE_MAX,       /* largest number of items in the queue */
+  INSTR_READ_CALLS,      /* reads of the files */
+  INSTR_READ_BYTES,      /* bytes read */
+  INSTR_READ_TIME,       /* ns reading */
+  INSTR_COMPUTE_ITEMS,   /* chunks or matrices processed */
+  INSTR_COMPUTE_TIME,    /* ns processing them */
+  INSTR_STEALS,          /* tasks stolen from another thread of the pool */
+  INSTR_COUNTERS
+};
+
+#ifdef INSTRUMENT
+
+/** \brief name the calling thread in the dump */
+extern void instrThread(const char *role, int id);
+
+/** \brief current time, in ns */
+extern uint64_t instrNow(void);
+
+/** \brief add a value to a counter of the calling thread */
+extern void instrAdd(enum instrCounter counter, uint64_t value);
+
+/** \brief keep the largest value of a counter of the calling thread */
+extern void instrMax(enum instrCounter counter, uint64_t value);
+
+/** \brief lock a mutex, timing the wait if it is taken */
+extern int instrLock(pthread_mutex_t *mutex);
+
+#define INSTR_THREAD(role, id) instrThread(role, id)
+#define INSTR_NOW() instrNow()
+#define INSTR_TIME(counter, start) instrAdd(counter, instrNow() - (start))
+#define INSTR_ADD(counter, value) instrAdd(counter, value)
+#define INSTR_MAX(counter, value) instrMax(counter, value)
+#define INSTR_LOCK(mutex) instrLock(mutex)
+
+#else
+
+#define INSTR_THREAD(role, id) ((void)0)
+#define INSTR_NOW() ((uint64_t)0)
+#define INSTR_TIME(counter, start) ((void)(start))
+#define INSTR_ADD(counter, value) ((void)0)
+#define INSTR_MAX(counter, value) ((void)0)
+#define INSTR_LOCK(mutex) pthread_mutex_lock(mutex)
+
+#endif /* INSTRUMENT */
+
+#endif /* INSTRUMENT_H */
@@ -0,0 +1,377 @@
+/**
+ *  \file workpool.c (implementation file)
+ *
+ *  \brief Work-stealing thread pool shared by the text processing and the matrix determinant programs.
+ *
+ *  Each deque is a circular array guarded by its own mutex: the owner works at the bottom and
+ *  the thieves at the top, so they only meet on the deque being stolen from, and there is no
+ *  central lock on the path of a task. The threads only share a lock to sleep when no task is
+ *  queued anywhere, and to wake up the threads waiting for a group from outside the pool.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "workpool.h"
+#include "instrument.h"
+
+/** \brief initial number of tasks of a deque, it grows when full */
+#define DEQUE_CAPACITY 64
+
+/** \brief task waiting in a deque */
+struct workItem
+{
+  workTask task;
+  void *arg;
+  struct workGroup *group;
+};
+
+/** \brief deque of a pool thread */
+struct workDeque
+{
+  pthread_mutex_t lock;   /* guards the deque, taken by the owner and the thieves */
+  struct workItem *items; /* circular array of capacity tasks */
+  unsigned int capacity;
+  unsigned int top;       /* oldest task, taken by the thieves */
+  unsigned int bottom;    /* one past the newest task, taken by the owner */
+};
+
+/** \brief structure of the pool */
+struct workPool
+{
+  int nThreads;
+  bool pin;                    /* threads are pinned to the cores */
+  pthread_t *threads;
+  struct workDeque *deques;    /* one per thread */
+  atomic_int queued;           /* tasks in the deques */
+  atomic_uint nextDeque;       /* deque of the next task submitted from outside the pool */
+  pthread_mutex_t idleLock;    /* guards the sleep of the threads */
+  pthread_cond_t idleCond;     /* threads sleeping while no task is queued */
+  pthread_cond_t doneCond;     /* threads outside the pool waiting for a group */
+  bool shutdown;               /* the threads exit once no task is queued */
+  pthread_barrier_t started;   /* every deque is allocated */
+};
+
+/** \brief arguments of a pool thread */
+struct workThreadArg
+{
+  struct workPool *pool;
+  int id;
+};
+
+/** \brief pool of the calling thread (NULL outside a pool) */
+static __thread struct workPool *selfPool = NULL;
+
+/** \brief index of the calling thread in its pool */
+static __thread int selfId = -1;
+
+/**
+ *  \brief Add a task at the bottom of a deque, growing it if it is full.
+ *
+ *  \param deque deque
+ *  \param item task
+ */
+static void pushBottom(struct workDeque *deque, struct workItem item)
+{
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom - deque->top == deque->capacity) /* full, copy the tasks in order to a larger array */
+  {
+    struct workItem *items = (struct workItem *)malloc(2 * deque->capacity * sizeof(struct workItem));
+    for (unsigned int i = 0; i < deque->capacity; i++)
+      items[i] = deque->items[(deque->top + i) % deque->capacity];
+    free(deque->items);
+    deque->items = items;
+    deque->bottom -= deque->top;
+    deque->top = 0;
+    deque->capacity *= 2;
+  }
+  deque->items[deque->bottom % deque->capacity] = item;
+  deque->bottom++;
+  pthread_mutex_unlock(&deque->lock);
+}
+
+/**
+ *  \brief Take the newest (owner) or the oldest (thief) task of a deque.
+ *
+ *  \param deque deque
+ *  \param owner the caller owns the deque
+ *  \param item task taken
+ *
+ *  \return a task was taken
+ */
+static bool takeFrom(struct workDeque *deque, bool owner, struct workItem *item)
+{
+  bool taken = false;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom != deque->top)
+  {
+    if (owner)
+      *item = deque->items[--deque->bottom % deque->capacity];
+    else
+      *item = deque->items[deque->top++ % deque->capacity];
+    taken = true;
+  }
+  pthread_mutex_unlock(&deque->lock);
+
+  return taken;
+}
+
+/**
+ *  \brief Take a task from the own deque, or steal one from the others.
+ *
+ *  \param pool pool
+ *  \param id index of the caller in the pool
+ *  \param item task taken
+ *
+ *  \return a task was taken
+ */
+static bool takeTask(struct workPool *pool, int id, struct workItem *item)
+{
+  if (atomic_load_explicit(&pool->queued, memory_order_relaxed) <= 0)
+    return false;
+
+  if (takeFrom(&pool->deques[id], true, item))
+  {
+    atomic_fetch_sub(&pool->queued, 1);
+    return true;
+  }
+  for (int k = 1; k < pool->nThreads; k++) /* victims in turn, starting at the next thread */
+    if (takeFrom(&pool->deques[(id + k) % pool->nThreads], false, item))
+    {
+      atomic_fetch_sub(&pool->queued, 1);
+      INSTR_ADD(INSTR_STEALS, 1);
+      return true;
+    }
+
+  return false;
+}
+
+/**
+ *  \brief Run a task and let the waiters of its group know when it was the last one.
+ *
+ *  \param pool pool
+ *  \param id index of the caller in the pool
+ *  \param item task
+ */
+static void runTask(struct workPool *pool, int id, struct workItem *item)
+{
+  item->task(item->arg, id);
+
+  if (atomic_fetch_sub(&item->group->pending, 1) == 1) /* last task of the group */
+  {
+    pthread_mutex_lock(&pool->idleLock);
+    pthread_cond_broadcast(&pool->doneCond);
+    pthread_mutex_unlock(&pool->idleLock);
+  }
+}
+
+/**
+ *  \brief Life cycle of a pool thread.
+ *
+ *  \param warg pointer to the workThreadArg of the thread
+ */
+static void *workThread(void *warg)
+{
+  struct workPool *pool = ((struct workThreadArg *)warg)->pool;
+  int id = ((struct workThreadArg *)warg)->id;
+  free(warg);
+
+  selfPool = pool;
+  selfId = id;
+  INSTR_THREAD("pool", id);
+
+  if (pool->pin)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); /* without the core, the thread just floats */
+  }
+
+  /* the deque is allocated by its own thread, after it is pinned */
+  struct workDeque *deque = &pool->deques[id];
+  pthread_mutex_init(&deque->lock, NULL);
+  deque->capacity = DEQUE_CAPACITY;
+  deque->items = (struct workItem *)malloc(DEQUE_CAPACITY * sizeof(struct workItem));
+  memset(deque->items, 0, DEQUE_CAPACITY * sizeof(struct workItem));
+  deque->top = deque->bottom = 0;
+  pthread_barrier_wait(&pool->started);
+
+  struct workItem item;
+  while (true)
+  {
+    if (takeTask(pool, id, &item))
+    {
+      runTask(pool, id, &item);
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->idleLock);
+    uint64_t idleStart = INSTR_NOW();
+    while (atomic_load(&pool->queued) <= 0 && !pool->shutdown) /* sleep until a task is submitted */
+      pthread_cond_wait(&pool->idleCond, &pool->idleLock);
+    INSTR_TIME(INSTR_COND_WAIT, idleStart);
+    bool stop = pool->shutdown && atomic_load(&pool->queued) <= 0;
+    pthread_mutex_unlock(&pool->idleLock);
+
+    if (stop)
+      break;
+  }
+
+  return NULL;
+}
+
+/**
+ *  \brief Create a pool of threads.
+ *
+ *  \param nThreads number of threads of the pool
+ *  \param pin pin thread i to core i (modulo the number of cores)
+ *
+ *  \return pool, the program exits on failure
+ */
+struct workPool *workPoolCreate(int nThreads, bool pin)
+{
+  struct workPool *pool = (struct workPool *)malloc(sizeof(struct workPool));
+
+  pool->nThreads = nThreads;
+  pool->pin = pin;
+  pool->threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+  pool->deques = (struct workDeque *)malloc(nThreads * sizeof(struct workDeque));
+  atomic_init(&pool->queued, 0);
+  atomic_init(&pool->nextDeque, 0);
+  pthread_mutex_init(&pool->idleLock, NULL);
+  pthread_cond_init(&pool->idleCond, NULL);
+  pthread_cond_init(&pool->doneCond, NULL);
+  pool->shutdown = false;
+  pthread_barrier_init(&pool->started, NULL, nThreads + 1);
+
+  for (int i = 0; i < nThreads; i++)
+  {
+    struct workThreadArg *warg = (struct workThreadArg *)malloc(sizeof(struct workThreadArg));
+    warg->pool = pool;
+    warg->id = i;
+    if (pthread_create(&pool->threads[i], NULL, workThread, warg) != 0)
+    {
+      perror("error on creating thread of the pool");
+      exit(EXIT_FAILURE);
+    }
+  }
+  pthread_barrier_wait(&pool->started); /* tasks can be submitted once every deque exists */
+
+  return pool;
+}
+
+/**
+ *  \brief Add a task to the pool.
+ *
+ *  \param pool pool
+ *  \param group group of the task
+ *  \param task function of the task
+ *  \param arg argument of the task
+ */
+void workPoolSubmit(struct workPool *pool, struct workGroup *group, workTask task, void *arg)
+{
+  struct workItem item = {task, arg, group};
+  int id = (selfPool == pool) ? selfId : (int)(atomic_fetch_add(&pool->nextDeque, 1) % pool->nThreads);
+
+  atomic_fetch_add(&group->pending, 1);
+  atomic_fetch_add(&pool->queued, 1); /* counted before it can be taken, so queued never goes below 0 for long */
+  pushBottom(&pool->deques[id], item);
+
+  pthread_mutex_lock(&pool->idleLock); /* wake up a sleeping thread, if any */
+  pthread_cond_signal(&pool->idleCond);
+  pthread_mutex_unlock(&pool->idleLock);
+}
+
+/**
+ *  \brief Wait for every task of a group.
+ *
+ *  \param pool pool
+ *  \param group group to wait for
+ */
+void workPoolWait(struct workPool *pool, struct workGroup *group)
+{
+  if (selfPool == pool) /* run tasks, maybe of the group itself, until it is done */
+  {
+    struct workItem item;
+    while (atomic_load(&group->pending) > 0)
+    {
+      if (takeTask(pool, selfId, &item))
+        runTask(pool, selfId, &item);
+      else
+        sched_yield(); /* the tasks left are running on other threads */
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->idleLock);
+  uint64_t waitStart = INSTR_NOW();
+  while (atomic_load(&group->pending) > 0)
+    pthread_cond_wait(&pool->doneCond, &pool->idleLock);
+  INSTR_TIME(INSTR_COND_WAIT, waitStart);
+  pthread_mutex_unlock(&pool->idleLock);
+}
+
+/**
+ *  \brief Index of the calling thread in the pool.
+ *
+ *  \param pool pool
+ *
+ *  \return index of the thread (0 to nThreads-1), or -1 if the caller is not a thread of the pool
+ */
+int workPoolSelf(struct workPool *pool)
+{
+  return (selfPool == pool) ? selfId : -1;
+}
+
+/**
+ *  \brief Number of threads of the pool.
+ *
+ *  \param pool pool
+ *
+ *  \return number of threads
+ */
+int workPoolSize(struct workPool *pool)
+{
+  return pool->nThreads;
+}
+
+/**
+ *  \brief Wait for the tasks left, join the threads and free the pool.
+ *
+ *  \param pool pool
+ */
+void workPoolDestroy(struct workPool *pool)
+{
+  pthread_mutex_lock(&pool->idleLock);
+  pool->shutdown = true;
+  pthread_cond_broadcast(&pool->idleCond);
+  pthread_mutex_unlock(&pool->idleLock);
+
+  for (int i = 0; i < pool->nThreads; i++)
+    if (pthread_join(pool->threads[i], NULL) != 0)
+    {
+      perror("error on waiting for thread of the pool");
+      exit(EXIT_FAILURE);
+    }
+
+  for (int i = 0; i < pool->nThreads; i++)
+  {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i].items);
+  }
+  pthread_mutex_destroy(&pool->idleLock);
+  pthread_cond_destroy(&pool->idleCond);
+  pthread_cond_destroy(&pool->doneCond);
+  pthread_barrier_destroy(&pool->started);
+  free(pool->deques);
+  free(pool->threads);
+  free(pool);
+}
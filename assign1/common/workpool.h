@@ -0,0 +1,109 @@
+/**
+ *  \file workpool.h (interface file)
+ *
+ *  \brief Work-stealing thread pool shared by the text processing and the matrix determinant programs.
+ *
+ *  Every thread of the pool owns a deque of tasks: it pushes and pops its own tasks at the bottom,
+ *  and, when its deque is empty, steals the oldest task from the top of another deque.
+ *  Tasks can submit more tasks (e.g. the blocks of a single large matrix) and wait for them,
+ *  running other tasks of the pool in the meantime, so a pool thread never blocks on a group.
+ *
+ *  Optionally, the threads are pinned to the cores in order, and each thread allocates its own
+ *  deque after being pinned, so on NUMA machines it lives on the node of the thread (first touch).
+ *
+ *  Methods:
+ *     \li workPoolCreate - creates the threads of the pool.
+ *     \li workPoolSubmit - adds a task of a group to the pool.
+ *     \li workPoolWait - waits for every task of a group.
+ *     \li workPoolSelf - index of the calling thread of the pool.
+ *     \li workPoolDestroy - waits for the tasks left and joins the threads of the pool.
+ */
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ *  \brief Task of the pool.
+ *
+ *  \param arg argument given on submission
+ *  \param threadId index of the pool thread running the task (0 to nThreads-1)
+ */
+typedef void (*workTask)(void *arg, int threadId);
+
+/**
+ *  \brief Group of tasks that can be waited for together.
+ *
+ *  Must be initialized with WORK_GROUP_INIT (or pending set to 0) before its first task is submitted.
+ */
+struct workGroup
+{
+  atomic_int pending; /* tasks submitted and not finished yet */
+};
+
+/** \brief initializer of an empty group */
+#define WORK_GROUP_INIT {0}
+
+/** \brief opaque structure of the pool */
+struct workPool;
+
+/**
+ *  \brief Create a pool of threads.
+ *
+ *  \param nThreads number of threads of the pool
+ *  \param pin pin thread i to core i (modulo the number of cores)
+ *
+ *  \return pool, the program exits on failure
+ */
+extern struct workPool *workPoolCreate(int nThreads, bool pin);
+
+/**
+ *  \brief Add a task to the pool.
+ *
+ *  From a pool thread, the task goes to the deque of the thread, from any other thread
+ *  the deques are filled in turn.
+ *
+ *  \param pool pool
+ *  \param group group of the task
+ *  \param task function of the task
+ *  \param arg argument of the task
+ */
+extern void workPoolSubmit(struct workPool *pool, struct workGroup *group, workTask task, void *arg);
+
+/**
+ *  \brief Wait for every task of a group.
+ *
+ *  A pool thread runs other tasks while it waits, any other thread sleeps.
+ *
+ *  \param pool pool
+ *  \param group group to wait for
+ */
+extern void workPoolWait(struct workPool *pool, struct workGroup *group);
+
+/**
+ *  \brief Index of the calling thread in the pool.
+ *
+ *  \param pool pool
+ *
+ *  \return index of the thread (0 to nThreads-1), or -1 if the caller is not a thread of the pool
+ */
+extern int workPoolSelf(struct workPool *pool);
+
+/**
+ *  \brief Number of threads of the pool.
+ *
+ *  \param pool pool
+ *
+ *  \return number of threads
+ */
+extern int workPoolSize(struct workPool *pool);
+
+/**
+ *  \brief Wait for the tasks left, join the threads and free the pool.
+ *
+ *  \param pool pool
+ */
+extern void workPoolDestroy(struct workPool *pool);
+
+#endif /* WORKPOOL_H */
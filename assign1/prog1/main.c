@@ -26,25 +26,58 @@
 #include <stdbool.h>
 #include <string.h>
 #include <libgen.h>
+#include <stdint.h>
 
 #include "sharedRegion.h"
 #include "textProcUtils.h"
 #include "probConst.h"
+#include "../common/workpool.h"
+#include "../../common/filelist.h"
+#include "../common/instrument.h"
+#include "../../common/resultsink.h"
+#include "../../common/resultcache.h"
 
 /** \brief worker threads return status array */
 int *statusWorker;
 
-/** \brief number of files to process */
+/** \brief number of files of the window being processed */
 int numFiles;
 
 /** \brief maximum number of bytes per chunk */
 int maxBytesPerChunk;
 
+/** \brief how the chunks are handed to the workers */
+int dispatchMode;
+
+/** \brief how the files are read */
+int inputBackend;
+
+/** \brief chunks shrink as the files run out (adaptive chunk sizing) */
+bool adaptiveChunks;
+
+/** \brief number of threads that process chunks */
+int numWorkers;
+
+/** \brief output of the results, written as the files are done */
+struct resultSink *sink;
+
+/** \brief position in the list of the first file of the window */
+unsigned long firstFile;
+
+/** \brief word counts of the files already processed, keyed by the hash of their contents (NULL without -C) */
+struct resultCache *cache;
+
 static void printUsage(char *cmdName);
 
 /** \brief worker life cycle routine */
 static void *worker(void *id);
 
+/** \brief chunk of each pool thread (pool dispatch mode) */
+static struct filePartialData *poolData;
+
+/** \brief task of a chunk (pool dispatch mode) */
+static void chunkTask(void *chunkIndex, int threadId);
+
 /**
  *  \brief Main thread.
  *
@@ -52,13 +85,18 @@ static void *worker(void *id);
  *
  *  1 - Process the arguments from the command line.
  *
- *  2 - Initialize the shared region with the necessary structures (by passing the filenames).
+ *  2 - Take the next window of files from the list (-f names, then the manifest).
+ *
+ *  3 - Initialize the shared region with the necessary structures (by passing the filenames),
+ *      the files found in the cache are handed to the sink at once and not processed.
  *
- *  3 - Create the worker threads.
+ *  4 - Create the worker threads.
  *
- *  4 - Wait for the worker threads to terminate.
+ *  5 - Wait for the worker threads to terminate.
  *
- *  5 - Print final results.
+ *  6 - Hand the results of the files of the window not written yet to the sink (the others were
+ *      handed over by the worker that finished them) and free the shared region, then go back to 2
+ *      until the list is exhausted.
  *
  *  \param argc number of words of the command line
  *  \param argv list of words of the command line
@@ -74,15 +112,24 @@ int main(int argc, char *argv[])
 
   /* process command line arguments and set up variables */
 
-  int i;                 /* counting variable */
-  maxBytesPerChunk = DB; /* maximum number of bytes each worker will process at a time */
-  int N = DN;            /* number of worker threads */
-  char *fileNames[M];    /* files to be processed (maximum of M) */
-  numFiles = 0;          /* number of files to process */
-  int opt;               /* selected option */
+  int i;                           /* counting variable */
+  maxBytesPerChunk = DB;           /* maximum number of bytes each worker will process at a time */
+  int N = DN;                      /* number of worker threads */
+  dispatchMode = DISPATCH_MONITOR; /* chunks are read inside the monitor by default */
+  inputBackend = INPUT_READ;       /* chunks are copied to a buffer by default */
+  bool pinThreads = false;         /* threads of the pool are pinned to the cores */
+  bool maxBytesSet = false;        /* the maximum number of bytes per chunk was given */
+  adaptiveChunks = false;          /* chunks have a fixed size by default */
+  struct fileList files;           /* files to be processed */
+  int W = DW;                      /* files of a window */
+  int outputFormat = SINK_TEXT;    /* format of the results */
+  char *outputPath = NULL;         /* file of the results, NULL for the standard output */
+  char *cacheDir = NULL;           /* directory of the cache, NULL for none */
+  int opt;                         /* selected option */
+  fileListInit(&files);
   do
   {
-    switch ((opt = getopt(argc, argv, "f:n:m:")))
+    switch ((opt = getopt(argc, argv, "f:F:w:n:m:d:i:cao:O:C:")))
     {
     case 'f': /* file name */
       if (optarg[0] == '-')
@@ -91,12 +138,23 @@ int main(int argc, char *argv[])
         printUsage(basename(argv[0]));
         return EXIT_FAILURE;
       }
-      if (numFiles == M)
+      fileListAdd(&files, optarg);
+      break;
+    case 'F': /* manifest */
+      if (fileListManifest(&files, optarg) != 0)
+      {
+        fprintf(stderr, "%s: could not open manifest %s\n", basename(argv[0]), optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'w': /* numeric argument */
+      if (atoi(optarg) < 1)
       {
-        fprintf(stderr, "%s: can only process %d files at a time\n", basename(argv[0]), M);
+        fprintf(stderr, "%s: number of files per window must be greater or equal than 1\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
         return EXIT_FAILURE;
       }
-      fileNames[numFiles++] = optarg;
+      W = (int)atoi(optarg);
       break;
     case 'n': /* numeric argument */
       if (atoi(optarg) < 1)
@@ -115,6 +173,55 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
       }
       maxBytesPerChunk = (int)atoi(optarg);
+      maxBytesSet = true;
+      break;
+    case 'd': /* dispatch mode */
+      if (strcmp(optarg, "monitor") == 0)
+        dispatchMode = DISPATCH_MONITOR;
+      else if (strcmp(optarg, "atomic") == 0)
+        dispatchMode = DISPATCH_ATOMIC;
+      else if (strcmp(optarg, "summary") == 0)
+        dispatchMode = DISPATCH_SUMMARY;
+      else if (strcmp(optarg, "pool") == 0)
+        dispatchMode = DISPATCH_POOL;
+      else
+      {
+        fprintf(stderr, "%s: dispatch mode must be monitor, atomic, summary or pool\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'i': /* input backend */
+      if (strcmp(optarg, "read") == 0)
+        inputBackend = INPUT_READ;
+      else if (strcmp(optarg, "mmap") == 0)
+        inputBackend = INPUT_MMAP;
+      else
+      {
+        fprintf(stderr, "%s: input backend must be read or mmap\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'c': /* pin the threads of the pool */
+      pinThreads = true;
+      break;
+    case 'a': /* adaptive chunk sizing */
+      adaptiveChunks = true;
+      break;
+    case 'o': /* output format */
+      if ((outputFormat = sinkFormat(optarg)) < 0)
+      {
+        fprintf(stderr, "%s: output format must be text, csv or binary\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'O': /* output file */
+      outputPath = optarg;
+      break;
+    case 'C': /* cache directory */
+      cacheDir = optarg;
       break;
     case 'h': /* help mode */
       printUsage(basename(argv[0]));
@@ -135,47 +242,114 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
+  if (adaptiveChunks && !maxBytesSet) /* the first chunks are larger than the fixed ones */
+    maxBytesPerChunk = DA;
+  numWorkers = N;
+
+  if ((sink = sinkOpen(outputPath, outputFormat)) == NULL)
+  {
+    fprintf(stderr, "%s: could not open output file %s\n", basename(argv[0]), outputPath);
+    return EXIT_FAILURE;
+  }
+  FILE *info = sinkInfo(sink); /* stream of the elapsed time, apart from csv or binary results */
+
+  cache = NULL;
+  if (cacheDir != NULL && (cache = cacheOpen(cacheDir, "words", 3 * sizeof(int))) == NULL)
+  {
+    fprintf(stderr, "%s: could not create cache directory %s\n", basename(argv[0]), cacheDir);
+    return EXIT_FAILURE;
+  }
+
   statusWorker = malloc(sizeof(int) * N); /* workers status */
   pthread_t tIdWorker[N];                 /* workers internal thread id array */
   unsigned int workerId[N];               /* workers application defined thread id array */
   int *status_p;                          /* pointer to execution status */
 
-  /* set up structures to be used on the monitor and shared regions */
+  /* pool dispatch mode: a task per chunk in the work-stealing pool, created once for all the windows */
 
-  putInitialData(fileNames);
+  struct workPool *pool = NULL;
+  if (dispatchMode == DISPATCH_POOL)
+  {
+    poolData = (struct filePartialData *)calloc(N, sizeof(struct filePartialData)); /* buffers allocated by their thread */
+    pool = workPoolCreate(N, pinThreads);
+  }
 
-  /* generation of worker threads */
+  char **fileNames = (char **)malloc(W * sizeof(char *)); /* files of the window */
 
-  for (i = 0; i < N; i++)
+  firstFile = 0;
+  while ((numFiles = fileListWindow(&files, fileNames, W)) > 0)
   {
-    workerId[i] = i;
+    /* set up structures to be used on the monitor and shared regions */
+
+    putInitialData(fileNames);
 
-    if (pthread_create(&tIdWorker[i], NULL, worker, &workerId[i]) != 0) /* thread worker */
+    if (dispatchMode == DISPATCH_POOL)
     {
-      perror("error on creating thread worker");
-      exit(EXIT_FAILURE);
+      struct workGroup chunks = WORK_GROUP_INIT;
+      unsigned int nChunks = getNumChunks();
+
+      for (unsigned int c = 0; c < nChunks; c++)
+        workPoolSubmit(pool, &chunks, chunkTask, (void *)(uintptr_t)c);
+      workPoolWait(pool, &chunks); /* every chunk is done, no worker threads are created */
     }
-  }
+    else
+    {
+      /* generation of worker threads */
 
-  /* waiting for the termination of the worker threads */
+      for (i = 0; i < N; i++)
+      {
+        workerId[i] = i;
 
-  for (i = 0; i < N; i++)
-  {
-    if (pthread_join(tIdWorker[i], (void *)&status_p) != 0)
-    {
-      perror("error on waiting for worker thread");
-      exit(EXIT_FAILURE);
+        if (pthread_create(&tIdWorker[i], NULL, worker, &workerId[i]) != 0) /* thread worker */
+        {
+          perror("error on creating thread worker");
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      /* waiting for the termination of the worker threads */
+
+      for (i = 0; i < N; i++)
+      {
+        if (pthread_join(tIdWorker[i], (void *)&status_p) != 0)
+        {
+          perror("error on waiting for worker thread");
+          exit(EXIT_FAILURE);
+        }
+      }
     }
+
+    /* join the summaries of the chunks of each file */
+    if (dispatchMode == DISPATCH_SUMMARY)
+      reconcileResults();
+
+    /* hand the results of the files left to the sink, then forget the files of the window */
+    emitResults();
+    freeData();
+    for (i = 0; i < numFiles; i++)
+      free(fileNames[i]);
+    firstFile += numFiles;
   }
+  free(fileNames);
+  fileListClose(&files);
+
+  if (dispatchMode == DISPATCH_POOL)
+  {
+    workPoolDestroy(pool);
+    for (i = 0; i < N; i++)
+      free(poolData[i].buffer);
+    free(poolData);
+  }
+
+  if (cache != NULL)
+    cacheClose(cache); /* the counts of the new files are kept for the next runs */
+  sinkClose(sink); /* every result was written */
 
   /* timer ends */
   clock_gettime(CLOCK_MONOTONIC_RAW, &finish); /* end of measurement */
 
-  /* print the results of the text processing */
-  printResults();
-
   /* calculate the elapsed time */
-  printf("\nElapsed time = %.6f s\n", (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+  fprintf(info, "\nElapsed time = %.6f s\n", (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
 
   exit(EXIT_SUCCESS);
 }
@@ -191,37 +365,90 @@ int main(int argc, char *argv[])
 static void *worker(void *wid)
 {
   unsigned int id = *((unsigned int *)wid); /* worker id */
+  INSTR_THREAD("worker", id);
 
   /* structure that has file's chunk to process and the results of that processing */
   struct filePartialData *partialData = (struct filePartialData *)malloc(sizeof(struct filePartialData));
-  partialData->chunk = (unsigned char *)malloc(maxBytesPerChunk * sizeof(unsigned char));
+  partialData->buffer = NULL; /* chunks of mapped files are views, no buffer is needed */
+  if (inputBackend == INPUT_READ)
+    partialData->buffer = (unsigned char *)malloc(maxBytesPerChunk * sizeof(unsigned char));
+  partialData->chunk = partialData->buffer;
+  partialData->finished = true; /* stays set if there is no data left on the first request */
 
   while (true) /* work until no more data is available */
   {
-    getData(id, partialData); /* retrieve data from the shared region to process */
+    if (dispatchMode == DISPATCH_MONITOR)
+      getData(id, partialData); /* retrieve data from the shared region to process */
+    else
+      getChunk(id, partialData); /* claim a chunk and read it without entering the monitor */
 
     if (partialData->finished) /* no more data available */
       break;
 
-    processChunk(partialData); /* perform text processing on the chunk */
+    uint64_t computeStart = INSTR_NOW();
+    if (dispatchMode == DISPATCH_SUMMARY)
+    {
+      summarizeChunk(partialData);       /* perform text processing without the previous character */
+      INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+      saveChunkSummary(id, partialData); /* store the summary in the slot of the chunk */
+    }
+    else
+    {
+      processChunk(partialData); /* perform text processing on the chunk */
+      INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
 
-    savePartialResults(id, partialData); /* save results on the shared region */
+      if (dispatchMode == DISPATCH_ATOMIC)
+        saveChunkResults(id, partialData); /* add results to the shared region with atomic operations */
+      else
+        savePartialResults(id, partialData); /* save results on the shared region */
+    }
+    INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
 
     /* reset structures */
     partialData->finished = true;
     partialData->nWords = 0;
     partialData->nWordsBV = 0;
     partialData->nWordsEC = 0;
-    memset(partialData->chunk, 0, maxBytesPerChunk * sizeof(unsigned char));
+    if (dispatchMode == DISPATCH_MONITOR && inputBackend == INPUT_READ)
+      memset(partialData->buffer, 0, maxBytesPerChunk * sizeof(unsigned char));
   }
 
-  free(partialData); /* deallocate the structure memory */
+  free(partialData->buffer); /* deallocate the chunk buffer */
+  free(partialData);         /* deallocate the structure memory */
 
   statusWorker[id] = EXIT_SUCCESS;
   pthread_exit(&statusWorker[id]);
   return 0;
 }
 
+/**
+ *  \brief Task of a chunk.
+ *
+ *  Its role is to read the chunk, in the structure of the pool thread running it,
+ *  perform text processing on it and add the results to the shared region with atomic operations.
+ *
+ *  \param chunkIndex global index of the chunk
+ *  \param threadId index of the pool thread
+ */
+static void chunkTask(void *chunkIndex, int threadId)
+{
+  struct filePartialData *partialData = &poolData[threadId];
+
+  if (inputBackend == INPUT_READ && partialData->buffer == NULL) /* first chunk of the thread */
+    partialData->buffer = (unsigned char *)malloc(maxBytesPerChunk * sizeof(unsigned char));
+
+  readChunk(threadId, (unsigned int)(uintptr_t)chunkIndex, partialData);
+  uint64_t computeStart = INSTR_NOW();
+  processChunk(partialData);
+  INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+  INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
+  saveChunkResults(threadId, partialData);
+
+  partialData->nWords = 0;
+  partialData->nWordsBV = 0;
+  partialData->nWordsEC = 0;
+}
+
 /**
  *  \brief Print command usage.
  *
@@ -231,11 +458,20 @@ static void *worker(void *wid)
  */
 static void printUsage(char *cmdName)
 {
-  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / number of threads / maximum number of bytes per chunk]\n"
+  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / manifest / files per window / number of threads / maximum number of bytes per chunk / dispatch mode / input backend / pinning / adaptive chunks / output format / output file / cache directory]\n"
                   "  OPTIONS:\n"
                   "  -h      --- print this help\n"
                   "  -f      --- filename to process\n"
+                  "  -F      --- manifest with a filename per line, - for the standard input\n"
+                  "  -w      --- number of files processed at a time (default %d)\n"
                   "  -n      --- number of threads\n"
-                  "  -m      --- maximum number of bytes per chunk\n",
-          cmdName);
+                  "  -m      --- maximum number of bytes per chunk\n"
+                  "  -d      --- dispatch mode: monitor (default), atomic, summary or pool\n"
+                  "  -i      --- input backend: read (default) or mmap\n"
+                  "  -c      --- pin the threads of the pool to the cores\n"
+                  "  -a      --- adaptive chunk sizing: chunks shrink as the files run out, -m is the largest (default %d)\n"
+                  "  -o      --- output format: text (default), csv or binary\n"
+                  "  -O      --- file of the results (default the standard output)\n"
+                  "  -C      --- directory of the cache of the results, files already processed are not processed again\n",
+          cmdName, DW, DA);
 }
\ No newline at end of file
@@ -13,9 +13,6 @@
 
 /* Generic parameters */
 
-/** \brief maximum number of files */
-#define M 10
-
 /** \brief minimum number of bytes each chunk must have */
 #define MIN 11
 
@@ -25,4 +22,31 @@
 /** \brief default number of worker threads */
 #define DN 2
 
+/** \brief default maximum number of bytes each chunk has in the adaptive chunk sizing mode */
+#define DA 1048576
+
+/** \brief minimum number of bytes of a chunk in the adaptive chunk sizing mode, before alignment */
+#define AMIN 4096
+
+/** \brief in the adaptive chunk sizing mode, a chunk has 1/(AF * number of workers) of the bytes left */
+#define AF 2
+
+/** \brief chunks are read by the workers inside the monitor */
+#define DISPATCH_MONITOR 0
+
+/** \brief chunks are claimed with an atomic counter and read with pread() */
+#define DISPATCH_ATOMIC 1
+
+/** \brief as DISPATCH_ATOMIC, but chunks are summarized and joined after all of them are processed */
+#define DISPATCH_SUMMARY 2
+
+/** \brief chunks are tasks of a work-stealing pool, results are added with atomic operations */
+#define DISPATCH_POOL 3
+
+/** \brief chunks are copied from the files to a buffer */
+#define INPUT_READ 0
+
+/** \brief chunks are views of the files mapped in memory */
+#define INPUT_MMAP 1
+
 #endif /* PROBCONST_H_ */
\ No newline at end of file
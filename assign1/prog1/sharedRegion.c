@@ -16,16 +16,26 @@
  *  array of structures. They can also store the partial results of the
  *  processing done.
  * 
- *  There is also a function to print out the final results, that should be
- *  used after there is no more data to be processed.
+ *  The results of a file are handed to the result sink by the worker that finishes its last chunk,
+ *  and a function hands over the files left (empty ones, or all of them in the summary dispatch mode),
+ *  that should be used after there is no more data to be processed.
  * 
  *  Monitored Methods:
  *     \li getData - operation carried out by worker threads.
  *     \li savePartialResults - operation carried out by worker threads.
  *
+ *  Lock-free Methods (atomic, summary and pool dispatch modes):
+ *     \li getChunk - operation carried out by worker threads.
+ *     \li readChunk - operation carried out by worker threads and pool tasks.
+ *     \li saveChunkResults - operation carried out by worker threads.
+ *     \li saveChunkSummary - operation carried out by worker threads.
+ *
  *  Unmonitored Methods:
  *     \li putInitialData - operation carried out by the main thread.
- *     \li printResults - operation carried out by the main thread.
+ *     \li getNumChunks - operation carried out by the main thread.
+ *     \li reconcileResults - operation carried out by the main thread.
+ *     \li emitResults - operation carried out by the main thread.
+ *     \li freeData - operation carried out by the main thread.
  *
  *  \author Mário Silva - April 2022
  */
@@ -34,9 +44,17 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "sharedRegion.h"
 #include "textProcUtils.h"
+#include "probConst.h"
+#include "../common/instrument.h"
+#include "../../common/resultsink.h"
+#include "../../common/resultcache.h"
 
 /** \brief worker threads return status array */
 extern int *statusWorker;
@@ -47,6 +65,27 @@ extern int numFiles;
 /** \brief maximum number of bytes per chunk */
 extern int maxBytesPerChunk;
 
+/** \brief how the chunks are handed to the workers */
+extern int dispatchMode;
+
+/** \brief how the files are read */
+extern int inputBackend;
+
+/** \brief chunks shrink as the files run out (adaptive chunk sizing) */
+extern bool adaptiveChunks;
+
+/** \brief number of threads that process chunks */
+extern int numWorkers;
+
+/** \brief output of the results, written as the files are done */
+extern struct resultSink *sink;
+
+/** \brief position in the list of the first file of the window */
+extern unsigned long firstFile;
+
+/** \brief word counts of the files already processed (NULL without a cache) */
+extern struct resultCache *cache;
+
 /** \brief locking flag which warrants mutual exclusion inside the monitor */
 static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
 
@@ -56,12 +95,116 @@ struct fileData *filesData;
 /** \brief current file index being processed */
 static int currFileIndex = 0;
 
+/** \brief total number of chunks of all files (atomic dispatch mode) */
+static unsigned int totalChunks = 0;
+
+/** \brief index of the next chunk to be claimed by a worker (atomic dispatch mode) */
+static atomic_uint nextChunk = 0;
+
+/** \brief summary of every chunk, by global chunk index (summary dispatch mode) */
+static struct chunkSummary *summaries = NULL;
+
+/** \brief bytes of the files not handed out yet (adaptive chunk sizing in the monitor dispatch mode) */
+static off_t remainingBytes = 0;
+
+/**
+ *  \brief Number of bytes of the next chunk handed out by the monitor, before alignment.
+ *
+ *  \return {maxBytesPerChunk-7}, or a share of the bytes left with adaptive chunk sizing
+ */
+static int nextChunkBytes(void)
+{
+  if (adaptiveChunks)
+    return guidedChunkSize(remainingBytes, numWorkers, maxBytesPerChunk);
+  return maxBytesPerChunk - 7;
+}
+
+/**
+ *  \brief Hand the results of a file to the result sink, unless another thread already did.
+ *
+ *  \param fileIndex index of the file in the window
+ */
+static void emitFile(int fileIndex)
+{
+  struct fileData *file = (filesData + fileIndex);
+
+  if (atomic_exchange(&file->emitted, true))
+    return;
+  int counts[3] = {atomic_load(&file->nWords), atomic_load(&file->nWordsBV), atomic_load(&file->nWordsEC)};
+  if (cache != NULL && file->hashed)
+    cachePut(cache, file->hash, counts); /* nothing is stored again for a file found in the cache */
+  sinkWords(sink, firstFile + fileIndex, file->fileName, counts[0], counts[1], counts[2]);
+}
+
+/**
+ *  \brief Look up the word counts of a file in the cache, by the hash of its contents.
+ *
+ *  On a hit the counts are stored, the file is handed to the sink and marked as cached,
+ *  so it has no chunks and the workers skip it.
+ *
+ *  \param fileIndex index of the file in the window
+ */
+static void lookupFile(int fileIndex)
+{
+  struct fileData *file = (filesData + fileIndex);
+  int counts[3];
+
+  if (cacheHashFile(file->fileName, &file->hash) != 0) /* the error is reported when the file is processed */
+    return;
+  file->hashed = true;
+  if (!cacheGet(cache, file->hash, counts))
+    return;
+  atomic_store(&file->nWords, counts[0]);
+  atomic_store(&file->nWordsBV, counts[1]);
+  atomic_store(&file->nWordsEC, counts[2]);
+  file->cached = true;
+  emitFile(fileIndex);
+}
+
+/**
+ *  \brief Split a file in advance in chunks that shrink as the files run out.
+ *
+ *  Used by the atomic, summary and pool dispatch modes with adaptive chunk sizing: the sizes
+ *  are those the monitor would hand out, computed from the sizes of the files.
+ *
+ *  \param file file to split
+ *  \param remaining bytes of this file and the next ones, updated with the bytes of the chunks
+ */
+static void splitFile(struct fileData *file, off_t *remaining)
+{
+  unsigned int capacity = 16;
+
+  file->chunkStarts = (off_t *)malloc(capacity * sizeof(off_t));
+  file->nChunks = 0;
+  for (off_t start = 0; start < file->fileSize;)
+  {
+    if (file->nChunks == capacity)
+    {
+      capacity *= 2;
+      file->chunkStarts = (off_t *)realloc(file->chunkStarts, capacity * sizeof(off_t));
+    }
+    file->chunkStarts[file->nChunks++] = start;
+
+    off_t size = guidedChunkSize(*remaining, numWorkers, maxBytesPerChunk);
+    if (size > file->fileSize - start)
+      size = file->fileSize - start;
+    start += size;
+    *remaining -= size;
+  }
+}
+
 /**
  *  \brief Initialization of the data transfer region.
  *
  *  Allocates the memory for an array of structures with the files passed
  *  as argument and initializes it with their names.
  *
+ *  In the atomic and summary dispatch modes, the files are also opened and split in advance
+ *  into chunks of {maxBytesPerChunk-7} bytes, or of the sizes of splitFile with adaptive chunk sizing.
+ *  In the mmap input backend, the files are also mapped in memory.
+ *  With adaptive chunk sizing, the sizes of the files are added up in advance.
+ *  With a cache, the files found in it are handed to the sink here, and count as empty files.
+ *
  *  \param fileNames contains the names of the files to be stored
  */
 void putInitialData(char *fileNames[])
@@ -73,7 +216,115 @@ void putInitialData(char *fileNames[])
   {
     (filesData + i)->fileName = fileNames[i];
     (filesData + i)->fp = NULL;
+    (filesData + i)->fd = -1;
+    (filesData + i)->map = NULL;
+    (filesData + i)->offset = 0;
+    (filesData + i)->chunkStarts = NULL;
+    (filesData + i)->previousCh = 32;
+    (filesData + i)->nChunks = 0;
+    (filesData + i)->chunksOut = 0;
+    (filesData + i)->handedOut = false;
+    atomic_init(&(filesData + i)->chunksDone, 0);
+    atomic_init(&(filesData + i)->emitted, false);
+    atomic_init(&(filesData + i)->nWords, 0);
+    atomic_init(&(filesData + i)->nWordsBV, 0);
+    atomic_init(&(filesData + i)->nWordsEC, 0);
+    (filesData + i)->hashed = false;
+    (filesData + i)->cached = false;
+    if (cache != NULL)
+      lookupFile(i);
+  }
+
+  if (dispatchMode == DISPATCH_MONITOR && inputBackend != INPUT_MMAP && !adaptiveChunks)
+    return;
+
+  for (int i = 0; i < numFiles; i++)
+  {
+    struct fileData *file = (filesData + i);
+    struct stat st;
+
+    if ((file->fd = open(file->fileName, O_RDONLY)) == -1 || fstat(file->fd, &st) == -1)
+    {
+      printf("Error: could not open file %s\n", file->fileName);
+      exit(EXIT_FAILURE);
+    }
+
+    file->fileSize = file->cached ? 0 : st.st_size; /* a cached file has no chunks */
+    remainingBytes += file->fileSize;
+
+    if (dispatchMode == DISPATCH_MONITOR && inputBackend != INPUT_MMAP) /* only the size was needed */
+    {
+      close(file->fd);
+      file->fd = -1;
+      continue;
+    }
+
+    /* an empty file can not be mapped, but it has no chunks either */
+    if (inputBackend == INPUT_MMAP && file->fileSize > 0)
+    {
+      if ((file->map = mmap(NULL, file->fileSize, PROT_READ, MAP_PRIVATE, file->fd, 0)) == MAP_FAILED)
+      {
+        printf("Error: could not map file %s\n", file->fileName);
+        exit(EXIT_FAILURE);
+      }
+      madvise(file->map, file->fileSize, MADV_SEQUENTIAL);
+    }
   }
+
+  off_t remaining = remainingBytes; /* bytes of the file being split and the next ones */
+  for (int i = 0; i < numFiles; i++)
+  {
+    struct fileData *file = (filesData + i);
+
+    file->firstChunk = totalChunks;
+    if (adaptiveChunks)
+      splitFile(file, &remaining);
+    else /* every chunk, except the last one of the file, has {maxBytesPerChunk-7} bytes before alignment */
+      file->nChunks = (file->fileSize + (maxBytesPerChunk - 7) - 1) / (maxBytesPerChunk - 7);
+    totalChunks += file->nChunks;
+  }
+
+  if (dispatchMode == DISPATCH_SUMMARY)
+    summaries = (struct chunkSummary *)malloc(totalChunks * sizeof(struct chunkSummary));
+}
+
+/**
+ *  \brief Get a view of the next chunk of a mapped file.
+ *
+ *  Internal operation of the monitor, used by the mmap input backend.
+ *  The chunk ends at the start of the UTF8 encoded character found by scanning
+ *  backwards from the split point, so nothing has to be copied.
+ *
+ *  \param partialData structure that will point at the chunk of chars to process
+ */
+static void getMappedChunk(struct filePartialData *partialData)
+{
+  /* skip the files that were already handed out completely */
+  while (currFileIndex < numFiles && (filesData + currFileIndex)->offset == (filesData + currFileIndex)->fileSize)
+    currFileIndex++;
+
+  if (currFileIndex == numFiles) /* all files have been processed */
+    return;
+
+  struct fileData *fileToProcess = (filesData + currFileIndex);
+  off_t start = fileToProcess->offset;
+  off_t end = start + nextChunkBytes();
+
+  if (end >= fileToProcess->fileSize)
+    end = fileToProcess->fileSize;
+  else
+    end = findCharStart(fileToProcess->map, end, start + 1);
+
+  partialData->finished = false;
+  partialData->fileIndex = currFileIndex;
+  partialData->previousCh = getCharBefore(fileToProcess->map, start, (start < 4) ? 0 : start - 4);
+  partialData->chunk = fileToProcess->map + start;
+  partialData->chunkSize = end - start;
+
+  fileToProcess->offset = end; /* the next chunk starts where this one ends */
+  fileToProcess->chunksOut++;
+  fileToProcess->handedOut = (end == fileToProcess->fileSize);
+  remainingBytes -= partialData->chunkSize;
 }
 
 /**
@@ -86,7 +337,7 @@ void putInitialData(char *fileNames[])
  */
 void getData(unsigned int workerId, struct filePartialData *partialData)
 {
-  if ((statusWorker[workerId] = pthread_mutex_lock(&accessCR)) != 0) /* enter monitor */
+  if ((statusWorker[workerId] = INSTR_LOCK(&accessCR)) != 0) /* enter monitor */
   {
     errno = statusWorker[workerId]; /* save error in errno */
     perror("error on entering monitor(CF)");
@@ -94,7 +345,12 @@ void getData(unsigned int workerId, struct filePartialData *partialData)
     pthread_exit(&statusWorker[workerId]);
   }
 
-  if (numFiles != currFileIndex) /* if files have not all been processed yet */
+  while (currFileIndex < numFiles && (filesData + currFileIndex)->cached) /* the results came from the cache */
+    currFileIndex++;
+
+  if (inputBackend == INPUT_MMAP) /* no reading, only the limits of the chunk are computed */
+    getMappedChunk(partialData);
+  else if (numFiles != currFileIndex) /* if files have not all been processed yet */
   {
 
     /* obtain the current file to process */
@@ -118,19 +374,27 @@ void getData(unsigned int workerId, struct filePartialData *partialData)
     partialData->previousCh = fileToProcess->previousCh; /* last character of the previous chunk */
 
     /*
-      stores in a buffer the a chunk with {maxBytesPerChunk-7} bytes
+      stores in a buffer the a chunk with {maxBytesPerChunk-7} bytes (or fewer with adaptive chunk sizing)
       also obtains the size of the chunk that was read from the file
     */
-    partialData->chunkSize = fread(partialData->chunk, 1, maxBytesPerChunk - 7, fileToProcess->fp);
+    int chunkBytes = nextChunkBytes();
+    uint64_t readStart = INSTR_NOW();
+    partialData->chunkSize = fread(partialData->chunk, 1, chunkBytes, fileToProcess->fp);
+    INSTR_TIME(INSTR_READ_TIME, readStart);
+    INSTR_ADD(INSTR_READ_CALLS, 1);
+    INSTR_ADD(INSTR_READ_BYTES, partialData->chunkSize);
+    fileToProcess->chunksOut++;
 
     /*
       if the chunk read is smaller than the value expected
       it means the current file has reached the end
     */
-    if (partialData->chunkSize < maxBytesPerChunk - 7)
+    if (partialData->chunkSize < chunkBytes)
     {
       currFileIndex++;           /* update the current file being processed index */
       fclose(fileToProcess->fp); /* close the file pointer */
+      fileToProcess->fp = NULL;
+      fileToProcess->handedOut = true;
     }
     else
     {
@@ -148,8 +412,11 @@ void getData(unsigned int workerId, struct filePartialData *partialData)
       {
         currFileIndex++;           /* update the current file being processed index */
         fclose(fileToProcess->fp); /* close the file pointer */
+        fileToProcess->fp = NULL;
+        fileToProcess->handedOut = true;
       }
     }
+    remainingBytes -= partialData->chunkSize;
   }
 
   if ((statusWorker[workerId] = pthread_mutex_unlock(&accessCR)) != 0) /* exit monitor */
@@ -171,7 +438,7 @@ void getData(unsigned int workerId, struct filePartialData *partialData)
  */
 void savePartialResults(unsigned int workerId, struct filePartialData *partialData)
 {
-  if ((statusWorker[workerId] = pthread_mutex_lock(&accessCR)) != 0) /* enter monitor */
+  if ((statusWorker[workerId] = INSTR_LOCK(&accessCR)) != 0) /* enter monitor */
   {
     errno = statusWorker[workerId]; /* save error in errno */
     perror("error on entering monitor(CF)");
@@ -187,6 +454,11 @@ void savePartialResults(unsigned int workerId, struct filePartialData *partialDa
   (filesData + partialData->fileIndex)->nWordsBV += partialData->nWordsBV;
   (filesData + partialData->fileIndex)->nWordsEC += partialData->nWordsEC;
 
+  /* the results of the last chunk of the file were stored, they can be written */
+  struct fileData *file = (filesData + partialData->fileIndex);
+  if (atomic_fetch_add(&file->chunksDone, 1) + 1 == file->chunksOut && file->handedOut)
+    emitFile(partialData->fileIndex);
+
   if ((statusWorker[workerId] = pthread_mutex_unlock(&accessCR)) != 0) /* exit monitor */
   {
     errno = statusWorker[workerId]; /* save error in errno */
@@ -197,17 +469,223 @@ void savePartialResults(unsigned int workerId, struct filePartialData *partialDa
 }
 
 /**
- *  \brief Print results of the text processing.
+ *  \brief Get a chunk to process without entering the monitor.
+ *
+ *  Operation carried out by the workers in the atomic and summary dispatch modes.
+ *
+ *  The files were split in advance into chunks of {maxBytesPerChunk-7} bytes (or of shrinking sizes).
+ *  The worker claims the next chunk index with an atomic counter and reads it
+ *  with pread(), moving both ends of the chunk to the start of an UTF8 encoded character.
+ *  A few bytes before the chunk are read as well, to obtain the previous character.
+ *  With the mmap input backend, the chunk is a view of the mapped file instead.
+ *
+ *  \param workerId worker identification
+ *  \param partialData structure that will store the chunk of chars to process
+ */
+void getChunk(unsigned int workerId, struct filePartialData *partialData)
+{
+  unsigned int chunkIndex = atomic_fetch_add(&nextChunk, 1); /* claim the next chunk */
+
+  if (chunkIndex >= totalChunks) /* no more chunks to claim */
+  {
+    partialData->finished = true;
+    return;
+  }
+
+  readChunk(workerId, chunkIndex, partialData);
+}
+
+/**
+ *  \brief Read a chunk, given its global index, without entering the monitor.
+ *
+ *  Operation carried out by the workers in the atomic and summary dispatch modes (through getChunk),
+ *  and by the tasks of the pool dispatch mode.
+ *
+ *  \param workerId worker identification
+ *  \param chunkIndex global index of the chunk
+ *  \param partialData structure that will store the chunk of chars to process
+ */
+void readChunk(unsigned int workerId, unsigned int chunkIndex, struct filePartialData *partialData)
+{
+  /* find the file of the chunk, files are ordered by their first chunk */
+  int low = 0, high = numFiles - 1;
+  while (low < high)
+  {
+    int mid = (low + high + 1) / 2;
+    if ((filesData + mid)->firstChunk <= chunkIndex)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+  struct fileData *file = (filesData + low);
+
+  /* nominal limits of the chunk and the window of the file that is read */
+  unsigned int c = chunkIndex - file->firstChunk;
+  off_t start, end;
+  if (file->chunkStarts != NULL) /* adaptive chunk sizing */
+  {
+    start = file->chunkStarts[c];
+    end = (c + 1 < file->nChunks) ? file->chunkStarts[c + 1] : file->fileSize;
+  }
+  else
+  {
+    start = (off_t)c * (maxBytesPerChunk - 7);
+    end = start + (maxBytesPerChunk - 7);
+  }
+  if (end > file->fileSize)
+    end = file->fileSize;
+
+  if (inputBackend == INPUT_MMAP) /* both limits are scanned backwards, nothing is read */
+  {
+    off_t begin = (start == 0) ? 0 : findCharStart(file->map, start, start - 3);
+    off_t finish = (end == file->fileSize) ? end : findCharStart(file->map, end, end - 3);
+
+    partialData->finished = false;
+    partialData->fileIndex = low;
+    partialData->chunkIndex = chunkIndex;
+    partialData->previousCh = getCharBefore(file->map, begin, (begin < 4) ? 0 : begin - 4);
+    partialData->chunk = file->map + begin;
+    partialData->chunkSize = finish - begin;
+    return;
+  }
+
+  off_t windowStart = (start < 4) ? 0 : start - 4;
+  off_t windowEnd = (end + 3 > file->fileSize) ? file->fileSize : end + 3;
+
+  uint64_t readStart = INSTR_NOW();
+  ssize_t nRead = pread(file->fd, partialData->buffer, windowEnd - windowStart, windowStart);
+  INSTR_TIME(INSTR_READ_TIME, readStart);
+  INSTR_ADD(INSTR_READ_CALLS, 1);
+  INSTR_ADD(INSTR_READ_BYTES, nRead);
+  if (nRead != windowEnd - windowStart)
+  {
+    printf("Error: could not read file %s\n", file->fileName);
+    statusWorker[workerId] = EXIT_FAILURE;
+    pthread_exit(&statusWorker[workerId]);
+  }
+
+  /* both neighbour chunks move their shared limit forward the same way */
+  int begin = alignToCharStart(partialData->buffer, start - windowStart, nRead);
+  int finish = alignToCharStart(partialData->buffer, end - windowStart, nRead);
+
+  partialData->finished = false;
+  partialData->fileIndex = low;
+  partialData->chunkIndex = chunkIndex;
+  partialData->previousCh = getCharBefore(partialData->buffer, begin, 0);
+  partialData->chunk = partialData->buffer + begin;
+  partialData->chunkSize = finish - begin;
+}
+
+/**
+ *  \brief Number of chunks the files were split into.
  *
- *  Operation carried out by the main thread.
+ *  \return total number of chunks of all files (atomic, summary and pool dispatch modes)
  */
-void printResults()
+unsigned int getNumChunks()
+{
+  return totalChunks;
+}
+
+/**
+ *  \brief Store the results of text processing without entering the monitor.
+ *
+ *  Operation carried out by the workers in the atomic dispatch mode.
+ *
+ *  \param workerId worker identification
+ *  \param partialData structure with the results to be stored
+ */
+void saveChunkResults(unsigned int workerId, struct filePartialData *partialData)
+{
+  atomic_fetch_add_explicit(&(filesData + partialData->fileIndex)->nWords, partialData->nWords, memory_order_relaxed);
+  atomic_fetch_add_explicit(&(filesData + partialData->fileIndex)->nWordsBV, partialData->nWordsBV, memory_order_relaxed);
+  atomic_fetch_add_explicit(&(filesData + partialData->fileIndex)->nWordsEC, partialData->nWordsEC, memory_order_relaxed);
+
+  /* the worker of the last chunk of the file sees the results of the others and hands them to the sink */
+  struct fileData *file = (filesData + partialData->fileIndex);
+  if (atomic_fetch_add_explicit(&file->chunksDone, 1, memory_order_acq_rel) + 1 == file->nChunks)
+    emitFile(partialData->fileIndex);
+}
+
+/**
+ *  \brief Store the summary of a chunk without entering the monitor.
+ *
+ *  Operation carried out by the workers in the summary dispatch mode.
+ *  Each chunk has its own slot, so there is a single writer per slot.
+ *
+ *  \param workerId worker identification
+ *  \param partialData structure with the summary to be stored
+ */
+void saveChunkSummary(unsigned int workerId, struct filePartialData *partialData)
+{
+  summaries[partialData->chunkIndex] = partialData->summary;
+}
+
+/**
+ *  \brief Join the summaries of the chunks of each file, in order, into its final results.
+ *
+ *  Operation carried out by the main thread in the summary dispatch mode,
+ *  after the workers have terminated.
+ */
+void reconcileResults()
 {
   for (int i = 0; i < numFiles; i++)
   {
-    printf("\nFile name: %s\n", (filesData + i)->fileName);
-    printf("Total number of words = %d\n", (filesData + i)->nWords);
-    printf("N. of words beginning with a vowel = %d\n", (filesData + i)->nWordsBV);
-    printf("N. of words ending with a consonant = %d\n", (filesData + i)->nWordsEC);
+    struct fileData *file = (filesData + i);
+
+    if (file->nChunks == 0) /* empty file */
+      continue;
+
+    /* a file starts outside a word, so the joined summary has the final counts */
+    struct chunkSummary total = summaries[file->firstChunk];
+    for (unsigned int c = 1; c < file->nChunks; c++)
+      mergeSummaries(&total, &summaries[file->firstChunk + c]);
+
+    file->nWords = total.nWords;
+    file->nWordsBV = total.nWordsBV;
+    file->nWordsEC = total.nWordsEC;
   }
-}
\ No newline at end of file
+}
+
+/**
+ *  \brief Hand the results of the files not handed over yet to the result sink.
+ *
+ *  Operation carried out by the main thread, after the workers have terminated:
+ *  the empty files of the atomic and pool dispatch modes have no last chunk, and the files
+ *  of the summary dispatch mode are only done once their summaries are joined.
+ */
+void emitResults()
+{
+  for (int i = 0; i < numFiles; i++)
+    emitFile(i);
+}
+
+/**
+ *  \brief Free the data transfer region, so it can be initialized again with the next files.
+ *
+ *  Operation carried out by the main thread, after the results of the files were printed.
+ *  The files still open are closed and the mapped ones unmapped.
+ */
+void freeData()
+{
+  for (int i = 0; i < numFiles; i++)
+  {
+    struct fileData *file = (filesData + i);
+
+    if (file->fp != NULL)
+      fclose(file->fp);
+    if (file->fd != -1)
+      close(file->fd);
+    if (file->map != NULL)
+      munmap(file->map, file->fileSize);
+    free(file->chunkStarts);
+  }
+  free(filesData);
+  free(summaries);
+
+  filesData = NULL;
+  summaries = NULL;
+  currFileIndex = 0;
+  totalChunks = 0;
+  atomic_store(&nextChunk, 0);
+  remainingBytes = 0;
+}
@@ -16,16 +16,26 @@
  *  array of structures. They can also store the partial results of the
  *  processing done.
  * 
- *  There is also a function to print out the final results, that should be
- *  used after there is no more data to be processed.
+ *  The results of a file are handed to the result sink by the worker that finishes its last chunk,
+ *  and a function hands over the files left (empty ones, or all of them in the summary dispatch mode),
+ *  that should be used after there is no more data to be processed.
  * 
  *  Monitored Methods:
  *     \li getData - operation carried out by worker threads.
  *     \li savePartialResults - operation carried out by worker threads.
  *
+ *  Lock-free Methods (atomic, summary and pool dispatch modes):
+ *     \li getChunk - operation carried out by worker threads.
+ *     \li readChunk - operation carried out by worker threads and pool tasks.
+ *     \li saveChunkResults - operation carried out by worker threads.
+ *     \li saveChunkSummary - operation carried out by worker threads.
+ *
  *  Unmonitored Methods:
  *     \li putInitialData - operation carried out by the main thread.
- *     \li printResults - operation carried out by the main thread.
+ *     \li getNumChunks - operation carried out by the main thread.
+ *     \li reconcileResults - operation carried out by the main thread.
+ *     \li emitResults - operation carried out by the main thread.
+ *     \li freeData - operation carried out by the main thread.
  *
  *  \author Mário Silva - April 2022
  */
@@ -37,6 +47,9 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 /**
  *  \brief Structure with the filename and file pointer to process.
@@ -47,10 +60,40 @@ struct fileData
 {
   char *fileName;
   FILE *fp;
+  int fd;                  /* file descriptor used by the atomic dispatch mode */
+  off_t fileSize;          /* size of the file in bytes */
+  unsigned char *map;      /* contents of the file mapped in memory (mmap input backend) */
+  off_t offset;            /* start of the next chunk to hand out (mmap input backend) */
+  unsigned int firstChunk; /* global index of the first chunk of the file */
+  unsigned int nChunks;    /* number of chunks the file was split into */
+  off_t *chunkStarts;      /* start of each chunk, before alignment (adaptive chunk sizing) */
+  atomic_int nWords;
+  atomic_int nWordsBV;
+  atomic_int nWordsEC;
+  int previousCh;
+  unsigned int chunksOut;  /* chunks handed out by the monitor */
+  bool handedOut;          /* the monitor handed out the last chunk of the file */
+  atomic_uint chunksDone;  /* chunks whose results were stored */
+  atomic_bool emitted;     /* the results were handed to the result sink */
+  uint64_t hash;           /* hash of the contents of the file (with a cache) */
+  bool hashed;             /* the hash is known */
+  bool cached;             /* the results came from the cache, the file is not processed */
+};
+
+/**
+ *  \brief Summary of the text processing of a chunk that did not know its previous character.
+ *
+ *   The counts assume the chunk starts outside a word.
+ */
+struct chunkSummary
+{
   int nWords;
   int nWordsBV;
   int nWordsEC;
-  int previousCh;
+  int firstClass;        /* class of the first start or end character (0 if there is none) */
+  bool mergeBeforeFirst; /* a merge character comes before that character */
+  bool endsInWord;       /* the chunk ends inside a word */
+  bool lastConsonant;    /* last character of that word is a consonant */
 };
 
 /**
@@ -61,13 +104,16 @@ struct fileData
 struct filePartialData
 {
   int fileIndex;
+  unsigned int chunkIndex; /* global index of the chunk (atomic and summary dispatch modes) */
   bool finished;
   int previousCh;
-  unsigned char *chunk;
+  unsigned char *buffer; /* memory owned by the worker */
+  unsigned char *chunk;  /* first byte of the chunk to process (inside buffer or a mapped file) */
   int chunkSize;
   int nWords;
   int nWordsBV;
   int nWordsEC;
+  struct chunkSummary summary; /* results of the summary dispatch mode */
 };
 
 /**
@@ -102,10 +148,81 @@ extern void savePartialResults(unsigned int workerId, struct filePartialData *da
 extern void getData(unsigned int workerId, struct filePartialData *partialData);
 
 /**
- *  \brief Print results of the text processing.
+ *  \brief Get a chunk to process without entering the monitor.
+ *
+ *  Operation carried out by the workers in the atomic dispatch mode.
+ *
+ *  The files were split in advance into chunks of {maxBytesPerChunk-7} bytes.
+ *  The worker claims the next chunk index with an atomic counter and reads it
+ *  with pread(), moving both ends of the chunk to the start of an UTF8 encoded character.
+ *
+ *  \param workerId worker identification
+ *  \param partialData structure that will store the chunk of chars to process
+ */
+extern void getChunk(unsigned int workerId, struct filePartialData *partialData);
+
+/**
+ *  \brief Read a chunk, given its global index, without entering the monitor.
+ *
+ *  Operation carried out by the workers in the atomic and summary dispatch modes (through getChunk),
+ *  and by the tasks of the pool dispatch mode.
+ *
+ *  \param workerId worker identification
+ *  \param chunkIndex global index of the chunk
+ *  \param partialData structure that will store the chunk of chars to process
+ */
+extern void readChunk(unsigned int workerId, unsigned int chunkIndex, struct filePartialData *partialData);
+
+/**
+ *  \brief Number of chunks the files were split into.
+ *
+ *  Operation carried out by the main thread, after putInitialData.
+ *
+ *  \return total number of chunks of all files (atomic, summary and pool dispatch modes)
+ */
+extern unsigned int getNumChunks();
+
+/**
+ *  \brief Store the results of text processing without entering the monitor.
+ *
+ *  Operation carried out by the workers in the atomic dispatch mode.
+ *
+ *  \param workerId worker identification
+ *  \param partialData structure with the results to be stored
+ */
+extern void saveChunkResults(unsigned int workerId, struct filePartialData *partialData);
+
+/**
+ *  \brief Store the summary of a chunk without entering the monitor.
+ *
+ *  Operation carried out by the workers in the summary dispatch mode.
+ *  Each chunk has its own slot, so there is a single writer per slot.
+ *
+ *  \param workerId worker identification
+ *  \param partialData structure with the summary to be stored
+ */
+extern void saveChunkSummary(unsigned int workerId, struct filePartialData *partialData);
+
+/**
+ *  \brief Join the summaries of the chunks of each file, in order, into its final results.
+ *
+ *  Operation carried out by the main thread in the summary dispatch mode,
+ *  after the workers have terminated.
+ */
+extern void reconcileResults();
+
+/**
+ *  \brief Hand the results of the files not handed over yet to the result sink.
+ *
+ *  Operation carried out by the main thread, after the workers have terminated.
+ */
+extern void emitResults();
+
+/**
+ *  \brief Free the data transfer region, so it can be initialized again with the next files.
  *
  *  Operation carried out by the main thread.
  */
-extern void printResults();
+extern void freeData();
 
 #endif /* MONITOR_H */
@@ -11,8 +11,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "sharedRegion.h"
+#include "textProcUtils.h"
+#include "probConst.h"
 
 /**
  *  \brief Checks if the given character is a alpha character.
@@ -157,10 +160,12 @@ int handleSpecialChars(int ch)
  *   It also counts the number of bytes read to obtain the character.
  *
  *  \param buffer buffer to read bytes from
+ *  \param index position of the character in the buffer
+ *  \param size number of bytes of the buffer, a character cut by its end is not decoded past it
  *  \param charUTF8Bytes array that will be filled with the first element
  *  the UTF8 character obtained and the second element the number of bytes read
  */
-void extractAChar(unsigned char *buffer, int index, int charUTF8Bytes[2])
+void extractAChar(unsigned char *buffer, int index, int size, int charUTF8Bytes[2])
 {
   int ch = buffer[index++];
 
@@ -178,6 +183,13 @@ void extractAChar(unsigned char *buffer, int index, int charUTF8Bytes[2])
   /* find out the number of bytes to read */
   while (ch & (0x80 >> seq_len))
   {
+    /* the character is cut by the end of the buffer (end of the file), it is taken as a white space */
+    if (index >= size)
+    {
+      charUTF8Bytes[0] = 32;
+      charUTF8Bytes[1] = seq_len;
+      return;
+    }
     /*
       shift to add 6 zeros on the right of the final char
       and use the 6 most representative bits of the read char
@@ -193,100 +205,454 @@ void extractAChar(unsigned char *buffer, int index, int charUTF8Bytes[2])
   charUTF8Bytes[1] = seq_len;
 }
 
+/** \brief character starts or continues a word (alpha, numeric or underscore) */
+#define CLS_START 0x01
+
+/** \brief character only continues a word (merge character) */
+#define CLS_MERGE 0x02
+
+/** \brief character ends a word (white space, separation or punctuation) */
+#define CLS_END 0x04
+
+/** \brief character is a vowel */
+#define CLS_VOWEL 0x08
+
+/** \brief character is a consonant */
+#define CLS_CONSONANT 0x10
+
+/** \brief number of bytes classified at a time by the ASCII fast path */
+#define BLOCK_BYTES 32
+
 /**
- *  \brief Performs text processing of a chunk.
+ *  \brief Class of the characters up to 255, after handleSpecialChars().
  *
- *  Counts the number of words, words starting with a vowel and words ending with a consonant.
+ *  Built from the isXxx() predicates: the accented vowels and the cedilla of
+ *  Latin-1 are classified as the general character they are transformed to.
+ */
+static const unsigned char latinClass[256] = {
+    ['\t'] = CLS_END, ['\n'] = CLS_END, ['\r'] = CLS_END, [' '] = CLS_END,
+    ['!'] = CLS_END, ['"'] = CLS_END, ['('] = CLS_END, [')'] = CLS_END,
+    [','] = CLS_END, ['-'] = CLS_END, ['.'] = CLS_END, [':'] = CLS_END,
+    [';'] = CLS_END, ['?'] = CLS_END, ['['] = CLS_END, [']'] = CLS_END,
+    [171] = CLS_END, [187] = CLS_END,
+    ['\''] = CLS_MERGE,
+    ['0' ... '9'] = CLS_START, ['_'] = CLS_START,
+    ['B' ... 'D'] = CLS_START | CLS_CONSONANT, ['F' ... 'H'] = CLS_START | CLS_CONSONANT,
+    ['J' ... 'N'] = CLS_START | CLS_CONSONANT, ['P' ... 'T'] = CLS_START | CLS_CONSONANT,
+    ['V' ... 'Z'] = CLS_START | CLS_CONSONANT,
+    ['b' ... 'd'] = CLS_START | CLS_CONSONANT, ['f' ... 'h'] = CLS_START | CLS_CONSONANT,
+    ['j' ... 'n'] = CLS_START | CLS_CONSONANT, ['p' ... 't'] = CLS_START | CLS_CONSONANT,
+    ['v' ... 'z'] = CLS_START | CLS_CONSONANT,
+    ['A'] = CLS_START | CLS_VOWEL, ['E'] = CLS_START | CLS_VOWEL, ['I'] = CLS_START | CLS_VOWEL,
+    ['O'] = CLS_START | CLS_VOWEL, ['U'] = CLS_START | CLS_VOWEL,
+    ['a'] = CLS_START | CLS_VOWEL, ['e'] = CLS_START | CLS_VOWEL, ['i'] = CLS_START | CLS_VOWEL,
+    ['o'] = CLS_START | CLS_VOWEL, ['u'] = CLS_START | CLS_VOWEL,
+    [192 ... 196] = CLS_START | CLS_VOWEL, [200 ... 207] = CLS_START | CLS_VOWEL,
+    [210 ... 214] = CLS_START | CLS_VOWEL, [217 ... 220] = CLS_START | CLS_VOWEL,
+    [224 ... 228] = CLS_START | CLS_VOWEL, [232 ... 239] = CLS_START | CLS_VOWEL,
+    [242 ... 246] = CLS_START | CLS_VOWEL, [249 ... 252] = CLS_START | CLS_VOWEL,
+    [199] = CLS_START | CLS_CONSONANT, [231] = CLS_START | CLS_CONSONANT};
+
+/** \brief first character of the General Punctuation table */
+#define PUNCT_BASE 0x2000
+
+/** \brief Class of the characters of the General Punctuation range (0x2000 - 0x206F). */
+static const unsigned char punctClass[0x70] = {
+    [8211 - PUNCT_BASE] = CLS_END, [8212 - PUNCT_BASE] = CLS_END,
+    [8216 - PUNCT_BASE] = CLS_MERGE, [8217 - PUNCT_BASE] = CLS_MERGE,
+    [8220 - PUNCT_BASE] = CLS_END, [8221 - PUNCT_BASE] = CLS_END,
+    [8230 - PUNCT_BASE] = CLS_END};
+
+/**
+ *  \brief Class of a character, the characters outside the tables belong to none.
  *
- *  Needs to know the previous character to see if the previous chunk was inside a word
- *  and also if it was and the word ends with the next character, to see if it was a consonant.
+ *  \param ch UTF8 encoded character
  *
- *  Operation executed by workers.
+ *  \return class bits of the character.
+ */
+static inline int classOf(int ch)
+{
+  if (0 <= ch && ch < 256)
+    return latinClass[ch];
+  if (PUNCT_BASE <= ch && ch < PUNCT_BASE + 0x70)
+    return punctClass[ch - PUNCT_BASE];
+  return (ch == EOF) ? CLS_END : 0;
+}
+
+/**
+ *  \brief Bit masks of the classes of a block of ASCII characters, one bit per byte.
+ */
+struct classMasks
+{
+  uint64_t start;     /* alpha, numeric or underscore */
+  uint64_t merge;     /* merge characters */
+  uint64_t end;       /* white space, separation or punctuation */
+  uint64_t vowel;     /* vowels */
+  uint64_t consonant; /* consonants */
+};
+
+/**
+ *  \brief Classifies up to BLOCK_BYTES ASCII characters with the lookup table.
  *
- *  \param partialData structure that contains the data needed to process
- *  and will be filled with the results obtained
+ *  \param chunk first character of the block
+ *  \param n number of characters of the block
+ *  \param masks structure filled with the masks of the block
  */
-void processChunk(struct filePartialData *partialData)
+static void classifyBlockTable(unsigned char *chunk, int n, struct classMasks *masks)
 {
-  // final results variables
-  int nWords = 0;
-  int nWordsBV = 0;
-  int nWordsEC = 0;
+  uint64_t start = 0, merge = 0, end = 0, vowel = 0, consonant = 0;
+  for (int i = 0; i < n; i++)
+  {
+    uint64_t cls = latinClass[chunk[i]];
+    start |= (cls & 1) << i;
+    merge |= ((cls >> 1) & 1) << i;
+    end |= ((cls >> 2) & 1) << i;
+    vowel |= ((cls >> 3) & 1) << i;
+    consonant |= ((cls >> 4) & 1) << i;
+  }
+  masks->start = start;
+  masks->merge = merge;
+  masks->end = end;
+  masks->vowel = vowel;
+  masks->consonant = consonant;
+}
 
-  int previousCh = partialData->previousCh;
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+#include <immintrin.h>
 
-  // current read character
-  int ch = 0;
-  // indicates when the chars read belong to a word
-  bool inWord;
-  // check if the previous char is a char that belongs to words
-  inWord = (isMergeChar(previousCh) || isAlpha(previousCh) ||
-            isNumeric(previousCh) || isUnderscore(previousCh));
+/**
+ *  \brief Classifies BLOCK_BYTES ASCII characters with AVX2.
+ *
+ *  Each byte is classified by two nibble lookups (vpshufb): the class bits selected by
+ *  the high nibble are intersected with the ones selected by the low nibble.
+ *  Table A holds the end groups (bits 0-3) and the start groups (bits 4-7),
+ *  table B holds the vowels (bits 0-1) and the merge character (bit 2).
+ *
+ *  \param chunk first character of the block
+ *  \param masks structure filled with the masks of the block
+ *
+ *  \return mask of the bytes that are not ASCII characters.
+ */
+__attribute__((target("avx2"))) static uint32_t classifyBlockAVX2(unsigned char *chunk, struct classMasks *masks)
+{
+  const __m256i hiA = _mm256_setr_epi8(0x01, 0, 0x02, 0x44, 0x10, 0xA8, 0x10, 0x20, 0, 0, 0, 0, 0, 0, 0, 0,
+                                       0x01, 0, 0x02, 0x44, 0x10, 0xA8, 0x10, 0x20, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i loA = _mm256_setr_epi8(0x62, 0x72, 0x72, 0x70, 0x70, 0x70, 0x70, 0x70,
+                                       0x72, 0x73, 0x35, 0x1C, 0x12, 0x1B, 0x12, 0x94,
+                                       0x62, 0x72, 0x72, 0x70, 0x70, 0x70, 0x70, 0x70,
+                                       0x72, 0x73, 0x35, 0x1C, 0x12, 0x1B, 0x12, 0x94);
+  const __m256i hiB = _mm256_setr_epi8(0, 0, 0x04, 0, 0x01, 0x02, 0x01, 0x02, 0, 0, 0, 0, 0, 0, 0, 0,
+                                       0, 0, 0x04, 0, 0x01, 0x02, 0x01, 0x02, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i loB = _mm256_setr_epi8(0, 0x01, 0, 0, 0, 0x03, 0, 0x04, 0, 0x01, 0, 0, 0, 0, 0, 0x01,
+                                       0, 0x01, 0, 0, 0, 0x03, 0, 0x04, 0, 0x01, 0, 0, 0, 0, 0, 0x01);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i zero = _mm256_setzero_si256();
+
+  __m256i bytes = _mm256_loadu_si256((const __m256i *)chunk);
+  __m256i lo = _mm256_and_si256(bytes, nibble);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble);
+
+  __m256i clsA = _mm256_and_si256(_mm256_shuffle_epi8(hiA, hi), _mm256_shuffle_epi8(loA, lo));
+  __m256i clsB = _mm256_and_si256(_mm256_shuffle_epi8(hiB, hi), _mm256_shuffle_epi8(loB, lo));
+
+#define ANY_BIT(v, bits) (~(uint64_t)(uint32_t)_mm256_movemask_epi8( \
+                             _mm256_cmpeq_epi8(_mm256_and_si256(v, _mm256_set1_epi8(bits)), zero)) & 0xFFFFFFFFu)
+  uint64_t letters = ANY_BIT(clsA, 0x30);
+  masks->start = ANY_BIT(clsA, (char)0xF0);
+  masks->end = ANY_BIT(clsA, 0x0F);
+  masks->vowel = ANY_BIT(clsB, 0x03);
+  masks->merge = ANY_BIT(clsB, 0x04);
+  masks->consonant = letters & ~masks->vowel;
+#undef ANY_BIT
+
+  return (uint32_t)_mm256_movemask_epi8(bytes);
+}
+#endif
 
+/**
+ *  \brief Propagates set bits towards the most significant bits while the pass bits allow it.
+ *
+ *  A bit of the result is set if there is a generate bit at or below it and only pass bits
+ *  in between (Kogge-Stone prefix).
+ *
+ *  \param generate bits that set the state
+ *  \param pass bits that keep the state
+ *
+ *  \return bits with the state after each position.
+ */
+static inline uint64_t fillForward(uint64_t generate, uint64_t pass)
+{
+  generate |= pass & (generate << 1);
+  pass &= pass << 1;
+  generate |= pass & (generate << 2);
+  pass &= pass << 2;
+  generate |= pass & (generate << 4);
+  pass &= pass << 4;
+  generate |= pass & (generate << 8);
+  pass &= pass << 8;
+  generate |= pass & (generate << 16);
+  pass &= pass << 16;
+  generate |= pass & (generate << 32);
+  return generate;
+}
+
+/**
+ *  \brief Counts the words of a block of classified ASCII characters.
+ *
+ *  Bit 0 of the state masks holds the state before the block and bit i+1 the state after
+ *  character i, so the state before each character is the mask itself.
+ *  A word starts on a start character when not in a word, and ends with a consonant on an end
+ *  character when in a word and the last start or merge character was a consonant.
+ *
+ *  \param masks masks of the block
+ *  \param n number of characters of the block
+ *  \param inWord in a word before the block, updated with the state after the block
+ *  \param lastConsonant last character of the word is a consonant, updated after the block
+ *  \param counts number of words, words beginning with a vowel and words ending with a consonant
+ */
+static inline void countBlock(struct classMasks *masks, int n, bool *inWord, bool *lastConsonant, int counts[3])
+{
+  uint64_t valid = (n == 64) ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+
+  /* in a word: set by start characters, reset by end characters */
+  uint64_t words = fillForward((masks->start << 1) | *inWord, ~((masks->start | masks->end) << 1) & (valid << 1));
+  /* last start or merge character is a consonant */
+  uint64_t cons = fillForward((masks->consonant << 1) | *lastConsonant, ~((masks->start | masks->merge) << 1) & (valid << 1));
+
+  uint64_t starts = masks->start & ~words & valid;
+  counts[0] += __builtin_popcountll(starts);
+  counts[1] += __builtin_popcountll(starts & masks->vowel);
+  counts[2] += __builtin_popcountll(masks->end & words & cons & valid);
+
+  *inWord = (words >> n) & 1;
+  *lastConsonant = (cons >> n) & 1;
+}
+
+/**
+ *  \brief Counts the words of a buffer of UTF8 encoded characters.
+ *
+ *  Runs of ASCII characters are classified BLOCK_BYTES at a time (with AVX2 when the
+ *  processor supports it, otherwise with the lookup table) and counted with bit masks and
+ *  popcount. Other characters are decoded one at a time and classified with the lookup tables.
+ *
+ *  \param chunk buffer with the characters
+ *  \param chunkSize number of bytes of the buffer
+ *  \param state state before the buffer, updated with the state at its end
+ *  \param counts filled with the number of words, words beginning with a vowel and
+ *  words ending with a consonant
+ */
+static void countWords(unsigned char *chunk, int chunkSize, struct wordState *state, int counts[3])
+{
+  struct classMasks masks;
   int charUTF8Bytes[2];
-  int numChars = 0;
+  int cls;
+  bool inWord = state->inWord;
+  bool lastConsonant = state->lastConsonant;
+  int index = 0;
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+  bool useAVX2 = __builtin_cpu_supports("avx2");
+#endif
+
+  counts[0] = counts[1] = counts[2] = 0;
 
-  while (numChars <= partialData->chunkSize)
+  while (index < chunkSize)
   {
-    /* extract a UTF8 encoded character from the buffer */
-    extractAChar(partialData->chunk, numChars, charUTF8Bytes);
+    int n = chunkSize - index;
+    if (n > BLOCK_BYTES)
+      n = BLOCK_BYTES;
+
+    /* number of ASCII characters at the start of the block */
+    int nAscii = 0;
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+    if (useAVX2 && n == BLOCK_BYTES)
+    {
+      /* the masks of the characters after the first non ASCII byte are ignored */
+      uint32_t nonAscii = classifyBlockAVX2(chunk + index, &masks);
+      nAscii = nonAscii ? __builtin_ctz(nonAscii) : BLOCK_BYTES;
+    }
+    else
+#endif
+    {
+      while (nAscii < n && chunk[index + nAscii] < 0x80)
+        nAscii++;
+      classifyBlockTable(chunk + index, nAscii, &masks);
+    }
 
-    ch = charUTF8Bytes[0];
+    if (nAscii > 0)
+    {
+      countBlock(&masks, nAscii, &inWord, &lastConsonant, counts);
+      index += nAscii;
+      continue;
+    }
 
-    numChars += charUTF8Bytes[1];
+    /* multi byte character */
+    extractAChar(chunk, index, chunkSize, charUTF8Bytes);
+    cls = classOf(charUTF8Bytes[0]);
+    index += charUTF8Bytes[1];
 
-    /*
-      if its not processing any word
-      and the char is alfa, numeric or a underscore
-    */
-    if (!inWord &&
-        (isAlpha(ch) || isNumeric(ch) || isUnderscore(ch)))
+    if (!inWord && (cls & CLS_START))
     {
-      /* check if the start of the word is a vowel */
-      if (isVowel(ch))
-        nWordsBV++;
-      /* processing a new word */
+      counts[0]++;
+      if (cls & CLS_VOWEL)
+        counts[1]++;
       inWord = true;
-      /* update previous read char */
-      previousCh = ch;
-      /* increase one word */
-      nWords++;
+      lastConsonant = (cls & CLS_CONSONANT) != 0;
     }
-    /* if its processing a word */
     else if (inWord)
     {
-      /*
-        if its a char that merges words
-        update the previous read char value
-        and continue reading next chars
-      */
-      if (isMergeChar(ch) || isAlpha(ch) ||
-          isNumeric(ch) || isUnderscore(ch))
-        previousCh = ch;
-      /*
-        else if its a white space, separation, punctuation char
-        or the end of the file
-        it means the current word has ended
-      */
-      else if (isWhiteSpace(ch) ||
-               isSeparation(ch) ||
-               isPunctuation(ch) ||
-               ch == EOF)
+      if (cls & (CLS_START | CLS_MERGE))
+        lastConsonant = (cls & CLS_CONSONANT) != 0;
+      else if (cls & CLS_END)
       {
-        /* checking if the last previous read char value is a consonant */
-        if (isConsonant(previousCh))
-          nWordsEC++;
-
-        /* end processing the word */
+        if (lastConsonant)
+          counts[2]++;
         inWord = false;
       }
     }
   }
+  state->inWord = inWord;
+  state->lastConsonant = lastConsonant;
+}
+
+/**
+ *  \brief Performs text processing of a chunk.
+ *
+ *  Counts the number of words, words starting with a vowel and words ending with a consonant.
+ *
+ *  Needs to know the previous character to see if the previous chunk was inside a word
+ *  and also if it was and the word ends with the next character, to see if it was a consonant.
+ *
+ *  The characters are classified with lookup tables, and runs of ASCII characters are
+ *  counted a block at a time (see countWords).
+ *
+ *  Operation executed by workers.
+ *
+ *  \param partialData structure that contains the data needed to process
+ *  and will be filled with the results obtained
+ */
+void processChunk(struct filePartialData *partialData)
+{
+  int counts[3];
+  struct wordState state;
+
+  startWordState(partialData->previousCh, &state);
+  countWords(partialData->chunk, partialData->chunkSize, &state, counts);
 
   /* update the structure with the results */
-  partialData->nWords = nWords;
-  partialData->nWordsBV = nWordsBV;
-  partialData->nWordsEC = nWordsEC;
+  partialData->nWords = counts[0];
+  partialData->nWordsBV = counts[1];
+  partialData->nWordsEC = counts[2];
+}
+
+/**
+ *  \brief Obtains the state of the text processing right after a character.
+ *
+ *  \param previousCh previous character of a chunk
+ *  \param state filled with the state the chunk starts from
+ */
+void startWordState(int previousCh, struct wordState *state)
+{
+  int cls = classOf(previousCh);
+
+  state->inWord = (cls & (CLS_START | CLS_MERGE)) != 0;
+  state->lastConsonant = (cls & CLS_CONSONANT) != 0;
+}
+
+/**
+ *  \brief Performs text processing of a chunk without knowing the previous character.
+ *
+ *  The chunk is counted as if it started outside a word, and the summary keeps what is
+ *  needed to correct the counts once the chunk before it is known (see mergeSummaries):
+ *  the class of its first start or end character, whether a merge character comes before
+ *  that one, and the state at the end of the chunk.
+ *
+ *  Operation executed by workers.
+ *
+ *  \param partialData structure that contains the chunk to process
+ *  and will be filled with its summary
+ */
+void summarizeChunk(struct filePartialData *partialData)
+{
+  struct chunkSummary *summary = &partialData->summary;
+  int counts[3];
+  int charUTF8Bytes[2];
+  int index = 0;
+  struct wordState state = {false, false};
+
+  /* the first start or end character decides how the chunk joins the previous one */
+  summary->firstClass = 0;
+  summary->mergeBeforeFirst = false;
+  while (index < partialData->chunkSize)
+  {
+    extractAChar(partialData->chunk, index, partialData->chunkSize, charUTF8Bytes);
+    int cls = classOf(charUTF8Bytes[0]);
+    index += charUTF8Bytes[1];
+
+    if (cls & (CLS_START | CLS_END))
+    {
+      summary->firstClass = cls;
+      break;
+    }
+    if (cls & CLS_MERGE)
+      summary->mergeBeforeFirst = true;
+  }
+
+  countWords(partialData->chunk, partialData->chunkSize, &state, counts);
+
+  summary->nWords = counts[0];
+  summary->nWordsBV = counts[1];
+  summary->nWordsEC = counts[2];
+  summary->endsInWord = state.inWord;
+  summary->lastConsonant = state.lastConsonant;
+}
+
+/**
+ *  \brief Joins the summary of a chunk with the summary of the chunk right after it.
+ *
+ *  If the left chunk ends inside a word, the first start character of the right chunk
+ *  continues that word instead of starting a new one, and its first end character
+ *  ends that word.
+ *  The operation is associative, so summaries can be joined in any grouping as long as
+ *  their order is kept.
+ *
+ *  \param left summary of the left chunk, updated with the joined summary
+ *  \param right summary of the right chunk
+ */
+void mergeSummaries(struct chunkSummary *left, struct chunkSummary *right)
+{
+  if (left->firstClass == 0) /* no start nor end character on the left, its counts are all zero */
+  {
+    bool mergeBeforeFirst = left->mergeBeforeFirst || right->mergeBeforeFirst;
+    *left = *right;
+    left->mergeBeforeFirst = mergeBeforeFirst;
+    return;
+  }
+
+  left->nWords += right->nWords;
+  left->nWordsBV += right->nWordsBV;
+  left->nWordsEC += right->nWordsEC;
+
+  if (right->firstClass == 0) /* the state goes through the right chunk, only merge characters change it */
+  {
+    left->lastConsonant = left->lastConsonant && !right->mergeBeforeFirst;
+    return;
+  }
+
+  if (left->endsInWord)
+  {
+    if (right->firstClass & CLS_START) /* not a new word */
+    {
+      left->nWords--;
+      if (right->firstClass & CLS_VOWEL)
+        left->nWordsBV--;
+    }
+    else if (left->lastConsonant && !right->mergeBeforeFirst) /* the word ends with a consonant */
+      left->nWordsEC++;
+  }
+
+  left->endsInWord = right->endsInWord;
+  left->lastConsonant = right->lastConsonant;
 }
 
 /**
@@ -322,7 +688,6 @@ void getChunkSizeAndLastChar(struct fileData *data, struct filePartialData *part
   if (ch == EOF || !(ch & 0x80))
   {
     data->previousCh = ch;
-    (partialData->chunk)[partialData->chunkSize++] = ch;
     return;
   }
 
@@ -340,7 +705,7 @@ void getChunkSizeAndLastChar(struct fileData *data, struct filePartialData *part
       shift to add 6 zeros on the right of the final char
       and use the 6 most representative bits of the read char
     */
-    fn = (fn << 6) | ((partialData->chunk)[partialData->chunkSize++] & 0x3F);
+    fn = (fn << 6) | (c & 0x3F);
     seq_len++;
   }
   /* add the initial bits after the sequence length identifier bits */
@@ -349,3 +714,82 @@ void getChunkSizeAndLastChar(struct fileData *data, struct filePartialData *part
   /* update the previous character of the file to process as the character found */
   data->previousCh = handleSpecialChars(ch);
 }
+
+/**
+ *  \brief Moves a position of a buffer forward to the start of an UTF8 encoded character.
+ *
+ *  Continuation bytes (10xxxxxx) are skipped until a leading byte or the limit is found.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position to align
+ *  \param limit first position that can not be read
+ *
+ *  \return position of the start of the character.
+ */
+int alignToCharStart(unsigned char *buffer, int index, int limit)
+{
+  while (index < limit && (buffer[index] & 0xC0) == 0x80)
+    index++;
+  return index;
+}
+
+/**
+ *  \brief Moves a position of a buffer backwards to the start of an UTF8 encoded character.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position to align
+ *  \param lowest first position that can be read
+ *
+ *  \return position of the start of the character.
+ */
+off_t findCharStart(unsigned char *buffer, off_t index, off_t lowest)
+{
+  while (index > lowest && (buffer[index] & 0xC0) == 0x80)
+    index--;
+  return index;
+}
+
+/**
+ *  \brief Decodes the UTF8 encoded character that ends right before a position of a buffer.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position right after the character
+ *  \param lowest first position that can be read
+ *
+ *  \return general representation of the character, or a white space if there is none.
+ */
+int getCharBefore(unsigned char *buffer, off_t index, off_t lowest)
+{
+  if (index <= lowest)
+    return 32;
+
+  /* walk back over the continuation bytes to the leading byte */
+  off_t start = findCharStart(buffer, index - 1, lowest);
+
+  int charUTF8Bytes[2];
+  extractAChar(buffer + start, 0, index - start, charUTF8Bytes);
+  return charUTF8Bytes[0];
+}
+
+/**
+ *  \brief Size of the next chunk in the adaptive chunk sizing mode (guided self-scheduling).
+ *
+ *  A chunk has a share of the bytes not handed out yet, so chunks start large and shrink as the
+ *  files run out, and the last ones are small enough to keep every worker busy until the end.
+ *
+ *  \param remaining bytes of all files not handed out yet
+ *  \param nWorkers number of workers
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *
+ *  \return number of bytes of the chunk before alignment, between AMIN and {maxBytesPerChunk-7}
+ */
+int guidedChunkSize(off_t remaining, int nWorkers, int maxBytesPerChunk)
+{
+  off_t size = remaining / ((off_t)AF * nWorkers);
+
+  if (size < AMIN)
+    size = AMIN;
+  if (size > maxBytesPerChunk - 7)
+    size = maxBytesPerChunk - 7;
+  return (int)size;
+}
@@ -111,10 +111,12 @@ int handleSpecialChars(int ch);
  *   It also counts the number of bytes read to obtain the character.
  *
  *  \param buffer buffer to read bytes from
+ *  \param index position of the character in the buffer
+ *  \param size number of bytes of the buffer, a character cut by its end is not decoded past it
  *  \param charUTF8Bytes array that will be filled with the first element
  *  the UTF8 character obtained and the second element the number of bytes read
  */
-void extractAChar(unsigned char *buffer, int index, int charUTF8Bytes[2]);
+void extractAChar(unsigned char *buffer, int index, int size, int charUTF8Bytes[2]);
 
 /**
  *  \brief Performs text processing of a chunk.
@@ -124,6 +126,9 @@ void extractAChar(unsigned char *buffer, int index, int charUTF8Bytes[2]);
  *  Needs to know the previous character to see if the previous chunk was inside a word
  *  and also if it was and the word ends with the next character, to see if it was a consonant.
  *
+ *  The characters are classified with lookup tables, and runs of ASCII characters are
+ *  counted a block at a time.
+ *
  *  Operation executed by workers.
  *
  *  \param partialData structure that contains the data needed to process
@@ -131,6 +136,47 @@ void extractAChar(unsigned char *buffer, int index, int charUTF8Bytes[2]);
  */
 void processChunk(struct filePartialData *partialData);
 
+/**
+ *  \brief State of the text processing at the end of a chunk.
+ */
+struct wordState
+{
+  bool inWord;        /* the last character is inside a word */
+  bool lastConsonant; /* the last letter of that word is a consonant */
+};
+
+/**
+ *  \brief Obtains the state of the text processing right after a character.
+ *
+ *  \param previousCh previous character of a chunk
+ *  \param state filled with the state the chunk starts from
+ */
+void startWordState(int previousCh, struct wordState *state);
+
+/**
+ *  \brief Performs text processing of a chunk without knowing the previous character.
+ *
+ *  The chunk is counted as if it started outside a word, and the summary keeps what is
+ *  needed to correct the counts once the chunk before it is known (see mergeSummaries).
+ *
+ *  Operation executed by workers.
+ *
+ *  \param partialData structure that contains the chunk to process
+ *  and will be filled with its summary
+ */
+void summarizeChunk(struct filePartialData *partialData);
+
+/**
+ *  \brief Joins the summary of a chunk with the summary of the chunk right after it.
+ *
+ *  The operation is associative, so summaries can be joined in any grouping as long as
+ *  their order is kept.
+ *
+ *  \param left summary of the left chunk, updated with the joined summary
+ *  \param right summary of the right chunk
+ */
+void mergeSummaries(struct chunkSummary *left, struct chunkSummary *right);
+
 /**
  *  \brief Reads bytes from the file until it reads a full UTF8 encoded character.
  *
@@ -145,4 +191,50 @@ void processChunk(struct filePartialData *partialData);
  */
 void getChunkSizeAndLastChar(struct fileData *data, struct filePartialData *partialData);
 
+/**
+ *  \brief Moves a position of a buffer forward to the start of an UTF8 encoded character.
+ *
+ *  Continuation bytes (10xxxxxx) are skipped until a leading byte or the limit is found.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position to align
+ *  \param limit first position that can not be read
+ *
+ *  \return position of the start of the character.
+ */
+int alignToCharStart(unsigned char *buffer, int index, int limit);
+
+/**
+ *  \brief Moves a position of a buffer backwards to the start of an UTF8 encoded character.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position to align
+ *  \param lowest first position that can be read
+ *
+ *  \return position of the start of the character.
+ */
+off_t findCharStart(unsigned char *buffer, off_t index, off_t lowest);
+
+/**
+ *  \brief Decodes the UTF8 encoded character that ends right before a position of a buffer.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position right after the character
+ *  \param lowest first position that can be read
+ *
+ *  \return general representation of the character, or a white space if there is none.
+ */
+int getCharBefore(unsigned char *buffer, off_t index, off_t lowest);
+
+/**
+ *  \brief Size of the next chunk in the adaptive chunk sizing mode (guided self-scheduling).
+ *
+ *  \param remaining bytes of all files not handed out yet
+ *  \param nWorkers number of workers
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *
+ *  \return number of bytes of the chunk before alignment, between AMIN and {maxBytesPerChunk-7}
+ */
+int guidedChunkSize(off_t remaining, int nWorkers, int maxBytesPerChunk);
+
 #endif /* TEXT_PROC_Funct_H */
\ No newline at end of file
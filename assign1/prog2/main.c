@@ -7,12 +7,12 @@
  *
  *  The main thread is responsible for reading the matrices from files and providing them to
  *  the shared region. Aferwards, worker threads should retrieve them and calculate the determinant.
- *  Then, these results are saved in the shared region where the main thread can retrieve them and 
- *  present them. 
+ *  Then, these results are saved in the shared region, and the worker of the last matrix of a file
+ *  hands the file to the result sink, which writes it while the next matrices are processed.
  *
- *  Synchronization based on monitors.
- *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
- *  monitor of the Lampson / Redell type.
+ *  The matrices travel in batches through a bounded lock-free ring (multi-producer / multi-consumer),
+ *  and each worker writes its results straight into the file's arrays, one slot per matrix.
+ *  The threads are implemented using the pthread library.
  *
  *  Generator thread of the intervening entities.
  *
@@ -31,14 +31,21 @@
 #include "probConst.h"
 #include "matrixutils.h"
 #include "sharedregion.h"
+#include "../common/workpool.h"
+#include "../../common/filelist.h"
+#include "../common/instrument.h"
+#include "../../common/resultsink.h"
+#include "../../common/resultcache.h"
 #include <stdbool.h>
 #include <libgen.h>
 #include <libgen.h>
 #include <string.h>
+#include <fcntl.h>
+#include <stdatomic.h>
 
 
 /** \brief shared region initialization */
-extern void initialization(int _totalFileCount, int _K);
+extern void initialization(int _totalFileCount, int _K, int _nHolders);
 
 /** \brief prints explanation of how to run code */
 static void printUsage(char *cmdName);
@@ -46,9 +53,72 @@ static void printUsage(char *cmdName);
 /** \brief worker threads return status array */
 int *statusWorker;
 
+/** \brief log|det| is also calculated for every matrix */
+static bool logResults = false;
+
+/** \brief precision of the elimination: PRECISION_DOUBLE, PRECISION_FLOAT or PRECISION_MIXED */
+static int precision = PRECISION_DOUBLE;
+
+/** \brief output of the results, written as the files are done */
+struct resultSink *sink;
+
+/** \brief position in the list of the first file of the window */
+unsigned long firstFile;
+
+/** \brief determinants of the matrices already processed, keyed by the hash of their terms (NULL without -C) */
+static struct resultCache *cache = NULL;
+
 /** \brief worker life cycle routine */
 static void *worker(void *id);
 
+/** \brief structure with the layout of a file, as seen by the readers */
+struct inputFile
+{
+  char *filename;                                                                             /** name of the file */
+  int fd;                                                            /** descriptor of the file, shared by the readers */
+  unsigned int order;                                                                      /** order of the matrices */
+  unsigned int nMatrix;                                                         /** total number of matrices in file */
+  unsigned int perBatch;                                                                    /** matrices per batch */
+  unsigned int firstBatch;                                         /** index of the first batch of the file among all */
+  bool split;                       /** each matrix is factorized by several pool threads (few large matrices) */
+};
+
+/** \brief files to be read */
+static struct inputFile *inputs;
+
+/** \brief number of files to be read in the window */
+static int nInputs;
+
+/** \brief number of batches of all files */
+static unsigned int totalBatches;
+
+/** \brief index of the next batch to be read by a reader thread */
+static atomic_uint nextBatch = 0;
+
+/** \brief reader threads return status array */
+static int *statusReader;
+
+/** \brief reader life cycle routine */
+static void *reader(void *id);
+
+/** \brief how the batches are handed to the workers */
+static int dispatchMode = DISPATCH_RING;
+
+/** \brief work-stealing pool running the batches (pool dispatch mode) */
+static struct workPool *pool;
+
+/** \brief batches submitted to the pool (pool dispatch mode) */
+static struct workGroup poolBatches = WORK_GROUP_INIT;
+
+/** \brief calculate the determinants of a batch and release it */
+static void processBatch(unsigned int id, struct matrixBatch *batch);
+
+/** \brief task of a batch (pool dispatch mode) */
+static void batchTask(void *batch, int threadId);
+
+/** \brief runs the ranges of rows of a factorization as tasks of the pool */
+static void poolFor(void *ctx, int nTasks, void (*body)(void *arg, int task), void *arg);
+
 
 /**
  *  \brief Main thread.
@@ -57,15 +127,19 @@ static void *worker(void *id);
  *
  *  1 - Process the arguments from the command line.
  *
- *  2 - Initialize the shared region with the necessary structures.
+ *  2 - Initialize the shared region with the necessary structures (and the work-stealing pool).
+ *
+ *  3 - Take the next window of files from the list (-f names, then the manifest).
  *
- *  3 - Create the worker threads.
+ *  4 - Create the worker threads (unless the pool replaces them).
  * 
- *  4 - Continuously provide matrices to the shared region, for the worker to process
+ *  5 - Read the header of each file and create the reader threads, which provide the matrices
+ *      to the shared region, for the worker to process
  *
- *  5 - Wait for the worker threads to terminate.
+ *  6 - Wait for the reader threads, close the ring and wait for the worker threads to terminate.
  *
- *  6 - Print final results.
+ *  7 - Hand the files of the window without matrices to the sink (the others were handed over by the
+ *      worker of their last matrix) and free its files, then go back to 3 until the list is exhausted.
  *
  *  \param argc number of words of the command line
  *  \param argv list of words of the command line
@@ -76,18 +150,25 @@ static void *worker(void *id);
 int main(int argc, char *argv[])
 {
   int N = DN;                                                                             /* number of worker threads */
-  int K = M;                                                                  /*Size of FIFO Queue in Shared Region */
+  int R = DR;                                                                             /* number of reader threads */
+  int K = M;                                                          /* number of slots of the ring in Shared Region */
+  bool pinThreads = false;                                              /* threads of the pool are pinned to the cores */
 
  
-  char *filenames[10];                                                                     /* array of file's names  */
-  int fnip = 0;                                                                        /* filename insertion pointer */
+  struct fileList list;                                                                     /* files to be processed */
+  int W = DW;                                                                                  /* files of a window */
+  int fnip = 0;                                                                           /* files of the window */
+  int outputFormat = SINK_TEXT;                                                            /* format of the results */
+  char *outputPath = NULL;                                  /* file of the results, NULL for the standard output */
+  char *cacheDir = NULL;                                                  /* directory of the cache, NULL for none */
   int opt;                                                                                        /* selected option */
+  fileListInit(&list);
 
 
   // argument handling
   do  
   {
-    switch ((opt = getopt(argc, argv, "f:n:k:")))
+    switch ((opt = getopt(argc, argv, "f:F:w:n:k:r:ld:p:co:O:C:")))
     {
     case 'f': /* file name */
       if (optarg[0] == '-')
@@ -96,14 +177,23 @@ int main(int argc, char *argv[])
         printUsage(basename(argv[0]));
         return EXIT_FAILURE;
       }
-      if (fnip>=10) /* at most 10 files */                                    
+      fileListAdd(&list, optarg);
+      break;
+    case 'F': /* manifest */
+      if (fileListManifest(&list, optarg) != 0)
       {
-        fprintf(stderr, "%s: Too many files to unpack. At Most 10\n", basename(argv[0]));
+        fprintf(stderr, "%s: could not open manifest %s\n", basename(argv[0]), optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'w': /* numeric argument */
+      if (atoi(optarg) < 1)
+      {
+        fprintf(stderr, "%s: number of files per window must be greater or equal than 1\n", basename(argv[0]));
         printUsage(basename(argv[0]));
         return EXIT_FAILURE;
       }
-
-      filenames[fnip++] = optarg;
+      W = (int)atoi(optarg);
       break;
     case 'n': /* numeric argument */
       if (atoi(optarg) < 1)
@@ -123,6 +213,61 @@ int main(int argc, char *argv[])
       }
       K = (int)atoi(optarg);
       break;
+    case 'r': /* numeric argument */
+      if (atoi(optarg) < 1)
+      {
+        fprintf(stderr, "%s: number of reader threads must be greater or equal than 1\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      R = (int)atoi(optarg);
+      break;
+    case 'l': /* log-domain results */
+      logResults = true;
+      break;
+    case 'd': /* dispatch mode */
+      if (strcmp(optarg, "ring") == 0)
+        dispatchMode = DISPATCH_RING;
+      else if (strcmp(optarg, "pool") == 0)
+        dispatchMode = DISPATCH_POOL;
+      else
+      {
+        fprintf(stderr, "%s: dispatch mode must be ring or pool\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'p': /* precision of the elimination */
+      if (strcmp(optarg, "double") == 0)
+        precision = PRECISION_DOUBLE;
+      else if (strcmp(optarg, "float") == 0)
+        precision = PRECISION_FLOAT;
+      else if (strcmp(optarg, "mixed") == 0)
+        precision = PRECISION_MIXED;
+      else
+      {
+        fprintf(stderr, "%s: precision must be double, float or mixed\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'c': /* pin the threads of the pool */
+      pinThreads = true;
+      break;
+    case 'o': /* output format */
+      if ((outputFormat = sinkFormat(optarg)) < 0)
+      {
+        fprintf(stderr, "%s: output format must be text, csv or binary\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'O': /* output file */
+      outputPath = optarg;
+      break;
+    case 'C': /* cache directory */
+      cacheDir = optarg;
+      break;
     case 'h': /* help mode */
       printUsage(basename(argv[0]));
       return EXIT_SUCCESS;
@@ -142,6 +287,19 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
+  if ((sink = sinkOpen(outputPath, outputFormat)) == NULL)
+  {
+    fprintf(stderr, "%s: could not open output file %s\n", basename(argv[0]), outputPath);
+    return EXIT_FAILURE;
+  }
+  FILE *info = sinkInfo(sink);                               /* stream of the other lines, apart from csv or binary */
+
+  if (cacheDir != NULL && (cache = cacheOpen(cacheDir, "determinants", 2 * sizeof(double))) == NULL)
+  {
+    fprintf(stderr, "%s: could not create cache directory %s\n", basename(argv[0]), cacheDir);
+    return EXIT_FAILURE;
+  }
+
   pthread_t tIdCons[N];                                                        /* consumers internal thread id array */
   unsigned int cons[N];                                             /* consumers application defined thread id array */
   int *status_p;                                                                      /* pointer to execution status */                            
@@ -155,91 +313,131 @@ int main(int argc, char *argv[])
   for (int i = 0; i < N; i++)                                                          /* incremental id attribution */
     cons[i] = i;
 
+  pthread_t tIdRead[R];                                                          /* readers internal thread id array */
+  unsigned int readers[R];                                            /* readers application defined thread id array */
+  statusReader = malloc(sizeof(int) * R);                       /* memory allocation of reader's return status array */
+  for (int i = 0; i < R; i++)
+    readers[i] = i;
 
-  initialization(fnip,K);                                                     /* initialization of the shared region */
 
-  for (int i = 0; i < N; i++)                                                             /* worker htreads creation */
-    if (pthread_create (&tIdCons[i], NULL, worker, &cons[i]) != 0)                                  /* thread worker */
-       { perror ("error on creating thread consumer");
-         exit (EXIT_FAILURE);
-       }
+  initialization(W,K,N+R);             /* initialization of the shared region, workers and readers hold a batch each */
 
-  
-  for (int fCk = 0;fCk<fnip;fCk++){                                          /* process each file in filenames array */
+  if (dispatchMode == DISPATCH_POOL)                /* the threads of the pool replace the workers, in every window */
+    pool = workPoolCreate(N, pinThreads);
 
-    FILE *fp = fopen(filenames[fCk], "r");
+  inputs = (struct inputFile *)malloc(W * sizeof(struct inputFile));
+  char **filenames = (char **)malloc(W * sizeof(char *));                                /* names of the window */
 
-    if (fp == NULL)
-    {
-        printf("Error: could not open file %s", filenames[fCk]);
-        return 1;
-    }
-
-    int numMatrix;
-    fread(&numMatrix, 4, 1, fp);                                               /* get number of matrices in the file */
-    
-    int order;
-    fread(&order, 4, 1, fp);                                                /* get order of the matrices in the file */
-    
-    
-    struct matrixFile curFile;                                         /* initialize structure with file information */
-    curFile.filename = filenames[fCk];
-    curFile.processedMatrixCounter = 0;
-    curFile.order = order;
-    curFile.nMatrix = numMatrix;
+  firstFile = 0;
+  while ((fnip = fileListWindow(&list, filenames, W)) > 0){
+    totalBatches = 0;
+    atomic_store(&nextBatch, 0);
+    for (int fCk = 0;fCk<fnip;fCk++){                              /* read the header of each file in filenames array */
 
+      int fd = open(filenames[fCk], O_RDONLY);
 
-    putFileData (curFile);                    /* insert the current file's info into the shared region's files array */
-
-
-    int incMCount = 0;                                                                 /* incremental matrix counter */
-    while(incMCount!=numMatrix){                                     /* iterate over each matrix in the current file */
-   
-      struct matrixData  curMatrix;                               /* initialize structure with current matrix's info */
-      curMatrix.fileIndex = fCk;
-      curMatrix.matrixNumber = incMCount;
-      curMatrix.order = order;
-      curMatrix.determinant = 0;
-
-      curMatrix.matrix = (double *)malloc(order * order * sizeof(double));        /* memory allocation of the matrix */
-  
-      fread(curMatrix.matrix, 8, order*order, fp);                                     /* read full matrix from file */
-     
-      putMatrixInFifo (curMatrix);                        /* add matrix to the shared region's FIFO processing queue */
+      if (fd == -1)
+      {
+          printf("Error: could not open file %s", filenames[fCk]);
+          return 1;
+      }
 
-      incMCount++;
-    }
+      int header[2] = {0, 0};
+      if (pread(fd, header, sizeof(header), 0) != sizeof(header))          /* get number and order of the matrices */
+      {
+          printf("Error: could not read the header of file %s", filenames[fCk]);
+          return 1;
+      }
+      int numMatrix = header[0];
+      int order = header[1];
     
+    
+      struct matrixFile curFile;                                         /* initialize structure with file information */
+      curFile.filename = filenames[fCk];
+      curFile.processedMatrixCounter = 0;
+      curFile.order = order;
+      curFile.nMatrix = numMatrix;
+      curFile.matrixLogDeterminants = logResults ? (double *)malloc(numMatrix * sizeof(double)) : NULL;
+
+
+      putFileData (curFile);                    /* insert the current file's info into the shared region's files array */
+
+
+      unsigned int terms = order * order;                                                   /* terms of each matrix */
+      unsigned int perBatch = (BT + terms - 1) / terms;           /* matrices per batch, until it holds BT terms */
+      if (perBatch > MB)
+        perBatch = MB;
+
+      inputs[fCk].filename = filenames[fCk];
+      inputs[fCk].fd = fd;
+      inputs[fCk].order = order;
+      inputs[fCk].nMatrix = numMatrix;
+      inputs[fCk].perBatch = perBatch;
+      inputs[fCk].firstBatch = totalBatches;
+      inputs[fCk].split = (dispatchMode == DISPATCH_POOL) && (order >= INTRA_ORDER) && (numMatrix < (unsigned int)N);
+      totalBatches += (numMatrix + perBatch - 1) / perBatch;
+    }
+    nInputs = fnip;
+
+    if (dispatchMode != DISPATCH_POOL)
+      for (int i = 0; i < N; i++)                                                           /* worker htreads creation */
+        if (pthread_create (&tIdCons[i], NULL, worker, &cons[i]) != 0)                                /* thread worker */
+           { perror ("error on creating thread consumer");
+             exit (EXIT_FAILURE);
+           }
+
+    for (int i = 0; i < R; i++)                                                            /* reader threads creation */
+      if (pthread_create (&tIdRead[i], NULL, reader, &readers[i]) != 0)                               /* thread reader */
+         { perror ("error on creating thread reader");
+           exit (EXIT_FAILURE);
+         }
+
+    /* waiting for the termination of the reader threads, every batch is in the ring afterwards */
+    for (int i = 0; i < R; i++)
+      if (pthread_join (tIdRead[i], NULL) != 0)
+         { perror ("error on waiting for thread reader");
+           exit (EXIT_FAILURE);
+         }
+    for (int fCk = 0; fCk<fnip; fCk++)
+      close(inputs[fCk].fd);
+
+    if (dispatchMode == DISPATCH_POOL)
+      workPoolWait(pool, &poolBatches);                                         /* every batch has been submitted */
+    else {
+      closeFifo();                                                       /* the workers stop once the ring is empty */
   
-  }
+      /* waiting for the termination of the intervening worker threads */
+      for (int i = 0; i < N; i++)
+      { if (pthread_join (tIdCons[i], (void *) &status_p) != 0)                                       
+           { perror ("error on waiting for thread customer");
+             exit (EXIT_FAILURE);
+           }
+        fprintf (stderr, "thread consumer, with id %u, has terminated: ", i);
+        fprintf (stderr, "its status was %d\n", *status_p);
+      }
+    }
+
   
-  /* waiting for the termination of the intervening worker threads */
-  for (int i = 0; i < N; i++)
-  { if (pthread_join (tIdCons[i], (void *) &status_p) != 0)                                       
-       { perror ("error on waiting for thread customer");
-         exit (EXIT_FAILURE);
-       }
-    printf ("thread consumer, with id %u, has terminated: ", i);
-    printf ("its status was %d\n", *status_p);
+    emitFileData();                                             /* the files without matrices, the others are out */
+
+    freeFileData();                                        /* the results of the window were handed to the sink */
+    for (int fCk = 0; fCk<fnip; fCk++)
+      free(filenames[fCk]);
+    firstFile += fnip;
   }
+  free(filenames);
+  free(inputs);
+  fileListClose(&list);
 
+  if (dispatchMode == DISPATCH_POOL)
+    workPoolDestroy(pool);
 
-  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);   
-  
-  for (int g=0; g<fnip; g++) {                                                     /* printing results for each file */
-    struct matrixFile *file = getFileData();                                     /* retrieve file from shared region */
-    
-    printf("\nMatrix File  %s\n", file->filename);
-    printf("Number of Matrices  %d\n", file->nMatrix);
-    printf("Order of the matrices  %d\n", file->order);
+  if (cache != NULL)
+    cacheClose(cache);                               /* the determinants of the new matrices are kept for the next runs */
+  sinkClose(sink);                                                                   /* every result was written */
 
-    for (int o =0;o<file->nMatrix; o++){
-      printf("\tMatrix %d Result: Determinant = %.3e \n", o+1,file->matrixDeterminants[o]);
-    }
-        
-  }
-                                             /* end of measurement */
-  printf ("\nElapsed time = %.6f s\n",  (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);                                             /* end of measurement */
+  fprintf (info, "\nElapsed time = %.6f s\n",  (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
 
   exit (EXIT_SUCCESS);
 
@@ -256,25 +454,196 @@ int main(int argc, char *argv[])
 static void *worker(void *wid)
 {
   unsigned int id = *((unsigned int *)wid); /* worker id */
+  INSTR_THREAD("worker", id);
 
   while(true){
-      struct matrixData  *curMatrix = (struct matrixData *)malloc(sizeof(struct matrixData));   /* matrix to be processed
-                                                                                                  memory alocation   */
-      int contin = getSingleMatrixData(id, curMatrix);                          /* retrive matrix from shared region */
-      if (contin == -1) {                                        /* if all files have been processed, end life cycle */
+      struct matrixBatch *batch = getMatrixBatch(id);                            /* retrive batch from shared region */
+      if (batch == NULL) {                                       /* if all files have been processed, end life cycle */
         break;
       }
-      double det = getDeterminant(curMatrix->order,curMatrix->matrix);                     /* calculate determinant  */
-
-      putResults(id,det, curMatrix->fileIndex, curMatrix->matrixNumber);      /* insert results in the shared region */
-    
-      free(curMatrix);                                                                      /* free allocated memory */
+      processBatch(id, batch);
   }
  
   statusWorker[id] = EXIT_SUCCESS;
   pthread_exit (&statusWorker[id]);
 }
 
+/**
+ *  \brief Calculate the determinants of a batch and release it.
+ *
+ *  \param id worker (or pool thread) identification
+ *  \param batch batch retrieved from the shared region
+ */
+static void processBatch(unsigned int id, struct matrixBatch *batch)
+{
+  for (unsigned int b = 0; b < batch->count; b++){
+    struct matrixData *curMatrix = &batch->matrices[b];                                      /* matrix to be processed */
+    uint64_t key = 0;                                                          /* hash of the terms, before the elimination */
+    double cached[2];                                                                       /* determinant and log|det| */
+    if (cache != NULL){                                    /* the precision is in the seed, each one has its own results */
+      key = cacheHash(curMatrix->matrix, (size_t)curMatrix->order * curMatrix->order * sizeof(double), curMatrix->order + ((uint64_t)precision << 32));
+      if (cacheGet(cache, key, cached) && (!logResults || !isnan(cached[1]))){   /* a log|det| that was not computed is a miss */
+        putResults(id, cached[0], logResults ? cached[1] : 0, curMatrix->fileIndex, curMatrix->matrixNumber);
+        continue;
+      }
+    }
+
+    uint64_t computeStart = INSTR_NOW();
+    double det, logDet;
+    if (precision == PRECISION_DOUBLE){
+      det = inputs[curMatrix->fileIndex].split                                             /* calculate determinant  */
+            ? getDeterminantParallel(curMatrix->order, curMatrix->matrix, 2 * workPoolSize(pool), poolFor, pool)
+            : getDeterminant(curMatrix->order,curMatrix->matrix);
+      logDet = logResults ? getLogDeterminant(curMatrix->order,curMatrix->matrix) : 0;            /* from the pivots */
+    }
+    else{                                                              /* converted on load, eliminated in float */
+      bool wide = (precision == PRECISION_MIXED);                      /* pivots accumulated in double */
+      float *matrix = (float *)malloc((size_t)curMatrix->order * curMatrix->order * sizeof(float));
+      convertMatrix(curMatrix->order, curMatrix->matrix, matrix);
+      det = inputs[curMatrix->fileIndex].split
+            ? getDeterminantFloatParallel(curMatrix->order, matrix, wide, 2 * workPoolSize(pool), poolFor, pool)
+            : getDeterminantFloat(curMatrix->order, matrix, wide);
+      logDet = logResults ? getLogDeterminantFloat(curMatrix->order, matrix, wide) : 0;
+      free(matrix);
+    }
+
+    INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+    INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
+
+    if (cache != NULL){
+      cached[0] = det;
+      cached[1] = logResults ? logDet : NAN;
+      cachePut(cache, key, cached);
+    }
+
+    putResults(id,det,logDet, curMatrix->fileIndex, curMatrix->matrixNumber);   /* insert results in the shared region */
+  }
+  releaseBatch(id, batch);                                                /* the batch and its buffer can be reused */
+}
+
+/**
+ *  \brief Task of a batch.
+ *
+ *  Submitted by the readers in the pool dispatch mode, instead of inserting the batch in the ring.
+ *
+ *  \param batch batch read
+ *  \param threadId index of the pool thread
+ */
+static void batchTask(void *batch, int threadId)
+{
+  processBatch(threadId, (struct matrixBatch *)batch);
+}
+
+/** \brief range of rows of a factorization, as a task of the pool */
+struct rangeTask
+{
+  void (*body)(void *arg, int task);
+  void *arg;
+  int task;
+};
+
+/**
+ *  \brief Task of a range of rows of a factorization.
+ *
+ *  \param range the rangeTask
+ *  \param threadId index of the pool thread
+ */
+static void rangeTaskRun(void *range, int threadId)
+{
+  struct rangeTask *r = (struct rangeTask *)range;
+  r->body(r->arg, r->task);
+}
+
+/**
+ *  \brief Run the ranges of rows of a trailing update as tasks of the pool, and wait for them.
+ *
+ *  The calling pool thread runs tasks while it waits, so it takes its share of the ranges
+ *  (or of the batches) instead of blocking.
+ *
+ *  \param ctx the pool
+ *  \param nTasks number of ranges
+ *  \param body update of a range
+ *  \param arg argument of body
+ */
+static void poolFor(void *ctx, int nTasks, void (*body)(void *arg, int task), void *arg)
+{
+  struct workPool *p = (struct workPool *)ctx;
+  struct workGroup ranges = WORK_GROUP_INIT;
+  struct rangeTask *tasks = (struct rangeTask *)malloc(nTasks * sizeof(struct rangeTask));
+
+  for (int t = 0; t < nTasks; t++){
+    tasks[t] = (struct rangeTask){body, arg, t};
+    workPoolSubmit(p, &ranges, rangeTaskRun, &tasks[t]);
+  }
+  workPoolWait(p, &ranges);
+  free(tasks);
+}
+
+/**
+ *  \brief Function reader.
+ *  Reader's life cycle
+ *
+ *  Its role is to read batches of matrices and insert them in the shared region.
+ *  The batches of all files are numbered, and each reader claims the next one with an atomic counter,
+ *  so the readers share the files, or the ranges of a single file, with a single pread() per batch.
+ *  Batches of the same file reach the ring in any order, the results are kept in order by matrixNumber.
+ *
+ *  \param rid pointer to application defined reader identification
+ */
+
+static void *reader(void *rid)
+{
+  unsigned int id = *((unsigned int *)rid); /* reader id */
+  unsigned int b;                           /* batch being read */
+  INSTR_THREAD("reader", id);
+
+  while ((b = atomic_fetch_add(&nextBatch, 1)) < totalBatches){
+      int fCk = 0;                                                                           /* file of the batch */
+      while (fCk + 1 < nInputs && inputs[fCk+1].firstBatch <= b)
+        fCk++;
+      struct inputFile *in = &inputs[fCk];
+
+      unsigned int terms = in->order * in->order;                                         /* terms of each matrix */
+      unsigned int first = (b - in->firstBatch) * in->perBatch;                   /* first matrix of the batch */
+      unsigned int count = (in->nMatrix - first < in->perBatch) ? in->nMatrix - first : in->perBatch;
+
+      struct matrixBatch *batch = getFreeBatch(in->perBatch * terms);   /* recycled batch, with a buffer for its matrices */
+      size_t bytes = (size_t)count * terms * sizeof(double);                                /* read the whole batch */
+      off_t offset = 2 * sizeof(int) + (off_t)first * terms * sizeof(double);
+      uint64_t readStart = INSTR_NOW();
+      for (size_t done = 0; done < bytes; ){
+        INSTR_ADD(INSTR_READ_CALLS, 1);
+        ssize_t c = pread(in->fd, (char *)batch->terms + done, bytes - done, offset + done);
+        if (c <= 0)
+           { fprintf (stderr, "error on reading file %s\n", in->filename);
+             statusReader[id] = EXIT_FAILURE;
+             exit (EXIT_FAILURE);
+           }
+        done += c;
+      }
+      INSTR_TIME(INSTR_READ_TIME, readStart);
+      INSTR_ADD(INSTR_READ_BYTES, bytes);
+
+      for (unsigned int k = 0; k < count; k++){
+        struct matrixData *curMatrix = &batch->matrices[k];          /* structure with current matrix's info */
+        curMatrix->fileIndex = fCk;
+        curMatrix->matrixNumber = first + k;
+        curMatrix->order = in->order;
+        curMatrix->determinant = 0;
+        curMatrix->matrix = batch->terms + (size_t)k * terms;                 /* matrix stored in the batch buffer */
+      }
+      batch->count = count;
+
+      if (dispatchMode == DISPATCH_POOL)
+        workPoolSubmit(pool, &poolBatches, batchTask, batch);            /* or run it as a task of the pool */
+      else
+        putBatchInFifo (batch);                             /* add batch to the shared region's processing ring */
+  }
+
+  statusReader[id] = EXIT_SUCCESS;
+  pthread_exit (&statusReader[id]);
+}
+
 /**
  *  \brief Print command usage.
  *
@@ -284,12 +653,22 @@ static void *worker(void *wid)
  */
 static void printUsage(char *cmdName)
 {
-  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / number of threads / size of the FIFO queue]\n"
+  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / manifest / files per window / number of threads / number of slots of the ring / number of reader threads / dispatch mode / precision / pinning / log-domain results / output format / output file / cache directory]\n"
                   "  OPTIONS:\n"
                   "  -h      --- print this help\n"
                   "  -f      --- filename to process\n"
+                  "  -F      --- manifest with a filename per line, - for the standard input\n"
+                  "  -w      --- number of files processed at a time (default %d)\n"
                   "  -n      --- number of threads\n"
-                  "  -k      --- size of the FIFO queue in the monitor\n",
-          cmdName);
+                  "  -k      --- number of slots of the ring of batches\n"
+                  "  -r      --- number of reader threads\n"
+                  "  -d      --- dispatch mode: ring (default) or pool\n"
+                  "  -p      --- precision of the elimination: double (default), float or mixed (float, pivots multiplied in double)\n"
+                  "  -c      --- pin the threads of the pool to the cores\n"
+                  "  -l      --- also calculate log|det|, the determinants are printed from it\n"
+                  "  -o      --- output format: text (default), csv or binary\n"
+                  "  -O      --- file of the results (default the standard output)\n"
+                  "  -C      --- directory of the cache of the results, matrices already processed are not processed again\n",
+          cmdName, DW);
 }
 
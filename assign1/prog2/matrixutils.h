@@ -9,6 +9,31 @@
 #ifndef MATRIXUTILS_H
 # define MATRIXUTILS_H
 
+#include <stdbool.h>
+
 /** \brief get the determinant of given matrix */
 extern double getDeterminant(int order, double *matrix);                    
+
+/**
+ *  \brief runs body(arg, task) for every task in [0, nTasks), in parallel, and waits for all of them
+ */
+typedef void (*parallelFor)(void *ctx, int nTasks, void (*body)(void *arg, int task), void *arg);
+
+/** \brief get the determinant of given matrix, with the factorization split in tasks run by pfor */
+extern double getDeterminantParallel(int order, double *matrix, int nTasks, parallelFor pfor, void *ctx);
+
+/** \brief get the logarithm of the absolute value of the determinant of a matrix factorized by getDeterminant */
+extern double getLogDeterminant(int order, double *matrix);
+
+/** \brief converts a matrix to single precision, for the float and mixed precision modes */
+extern void convertMatrix(int order, const double *matrix, float *converted);
+
+/** \brief get the determinant of a matrix in single precision, the pivots multiplied in double when wide */
+extern double getDeterminantFloat(int order, float *matrix, bool wide);
+
+/** \brief get the determinant of a matrix in single precision, with the factorization split in tasks run by pfor */
+extern double getDeterminantFloatParallel(int order, float *matrix, bool wide, int nTasks, parallelFor pfor, void *ctx);
+
+/** \brief get log|det| of a matrix factorized by getDeterminantFloat, summed in double when wide */
+extern double getLogDeterminantFloat(int order, float *matrix, bool wide);
 #endif
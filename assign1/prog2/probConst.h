@@ -19,4 +19,32 @@
 /** \brief default number of worker threads */
 #define  DN          4
 
+/** \brief default number of reader threads */
+#define  DR          1
+
+/** \brief batches are retrieved from the ring by the worker threads */
+#define  DISPATCH_RING  0
+
+/** \brief batches are tasks of the work-stealing pool */
+#define  DISPATCH_POOL  1
+
+/** \brief in the pool dispatch mode, files with fewer matrices than threads and at least this order
+    have each matrix factorized by several threads */
+#define  INTRA_ORDER 512
+
+/** \brief the matrices are eliminated in double precision */
+#define  PRECISION_DOUBLE  0
+
+/** \brief the matrices are converted to float on load and eliminated in float, the pivots multiplied in float */
+#define  PRECISION_FLOAT   1
+
+/** \brief as PRECISION_FLOAT, but the pivots (or their logarithms) are accumulated in double */
+#define  PRECISION_MIXED   2
+
+/** \brief maximum number of matrices per batch of the ring */
+#define  MB          16
+
+/** \brief a batch is sent once it holds this many terms, so large matrices travel alone */
+#define  BT          32768
+
 #endif /* PROBCONST_H_ */
\ No newline at end of file
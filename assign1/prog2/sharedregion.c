@@ -1,27 +1,39 @@
-
 /**
  *  \file sharedregion.c (implementation file)
  *
  *  \brief Problem name: Matrix Determinant Calculation With Multithreading.
  *
- *  Synchronization based on monitors.
- *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
- *  monitor of the Lampson / Redell type.
- *
- *  Data transfer region implemented as a monitor.
- *  Includes 2 main data regions:
+ *  Lock-free data transfer region.
+ *  Includes 3 main data regions:
  *     \li files is an array of matrixFile structures, containing information about a processed file
- *     \li matrices is the FIFO Queue of matrices to be processed by the workers
- * 
- *  
+ *     \li fifo is a bounded multi-producer / multi-consumer ring of batches of matrices to be processed
+ *         by the workers
+ *     \li pool is a ring of the free batches, each one owning the buffer of its matrices, so the memory
+ *         in use is bounded by the number of batches (K + N + R), not by the number of matrices
+ *
+ *  Each slot of a ring has a sequence number (Vyukov's bounded queue): a producer may fill the slot
+ *  at position pos when its sequence is pos, and publishes it by setting the sequence to pos + 1,
+ *  a consumer may empty it when its sequence is pos + 1, and frees it for the next round by setting
+ *  the sequence to pos + size. Producers and consumers only compete on the CAS of their own position.
+ *  A thread that finds a ring full (or empty) yields the processor and tries again.
+ *
+ *  The results need no synchronization, each determinant slot of a file is written by a single worker.
+ *  The worker that stores the last determinant of a file (its processedMatrixCounter reaches the number
+ *  of matrices) sees the others, and hands the arrays of the file to the result sink, which writes them
+ *  while the next files are processed.
+ *
  *  Definition of the operations carried out by the workers and main thread:
  *  Executed by the main thread:
- *     \li putFileData - Inserts a file info in the shared region
- *     \li putMatrixInFifo - Inserts a Matrix in the FIFO Queue for processing
- *     \li getFileData  - Returns a file's information from the files array
+ *     \li putFileData - Inserts a file info in the shared region, before any of its matrices
+ *     \li getFreeBatch - Retrieves a free batch from the pool, with room for the matrices of a file
+ *     \li putBatchInFifo - Inserts a batch of matrices in the ring for processing
+ *     \li closeFifo - Lets the workers know that no more batches will be inserted
+ *     \li emitFileData  - Hands the files not handed over yet to the result sink
  * Executed by the worker threads:
- *     \li getSingleMatrixData - Retrieved a single matrix from the FIFO Queue
- *     \li putResults - Inserts results of the processed matrix into the correct file in the files array
+ *     \li getMatrixBatch - Retrieves a batch of matrices from the ring
+ *     \li putResults - Inserts results of the processed matrix into the correct file in the files array,
+ *         and hands the file to the result sink after its last matrix
+ *     \li releaseBatch - Returns a processed batch to the pool
  *
  *  \author Pedro Marques - April 2022
  */
@@ -31,304 +43,427 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
-#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
 #include "sharedregion.h"
 #include <math.h>
 #include "matrixutils.h"
+#include "../common/instrument.h"
+#include "../../common/resultsink.h"
 #include <stdbool.h>
  #include  <time.h>
 
 
-/** \brief main thread's return status */
-int statusProd;
+/** \brief failed attempts on a full (or empty) ring before the thread starts to sleep */
+#define SPINS 1024
+
+/** \brief sleep between attempts after SPINS failed attempts (ns) */
+#define PAUSE 50000
+
+/** \brief slot of a ring */
+struct ringSlot
+{
+  atomic_size_t sequence;                                       /** round of the slot, see the description above */
+  struct matrixBatch *batch;                                                         /** batch stored in the slot */
+};
+
+/** \brief bounded multi-producer / multi-consumer ring of batches */
+struct ring
+{
+  struct ringSlot *slots;                                                                   /** slots of the ring */
+  unsigned int size;                                                                    /** number of slots, >= 2 */
+  _Alignas(64) atomic_size_t enqueuePos;    /** insertion position, only increases (kept apart from the retrieval one) */
+  _Alignas(64) atomic_size_t dequeuePos;                                    /** retrieval position, only increases */
+  _Alignas(64) atomic_bool closed;                                   /** set when no more batches will be inserted */
+};
 
-/** \brief worker threads return status array */
-extern int *statusWorker;
+/** \brief batches to process storage region - bounded MPMC ring */
+static struct ring fifo;
 
-/** \brief matrix to process storage region - FIFO Queue */
-static struct matrixData *matrices;
+/** \brief free batches, with their buffers */
+static struct ring pool;
 
 
 /** \brief storage region of all files */
 static struct matrixFile * files;
 
-/** \brief insertion pointer in FIFO Queue*/
-static unsigned int ii;
-
-/** \brief retrieval pointer */
-static unsigned int ri;
-
 /** \brief file insertion pointer */
 static unsigned int fip;
 
-/** \brief file retrieval pointer */
-static unsigned int frp;
-
-/** \brief counter of processed files */
-static unsigned int fCounter;
-
 /** \brief total number of files */
 static unsigned int totalFileCount;
 
+/** \brief output of the results, written as the files are done */
+extern struct resultSink *sink;
 
-/** \brief dimension of matrices array */
-static unsigned int K;
+/** \brief position in the list of the first file of the window */
+extern unsigned long firstFile;
 
 
-/** \brief flag signaling the data transfer region is full */
-static bool full;
+/**
+ *  \brief
+ *
+ *  Memory allocation of a ring with every slot free for the first round
+ *
+ *  \param r ring to initialize
+ *  \param size number of slots
+ *
+ */
+static void ringInit(struct ring *r, unsigned int size)
+{
+  r->size = (size < 2) ? 2 : size;            /* with a single slot, free (pos + size) and full (pos + 1) would be equal */
+  r->slots = malloc(sizeof(struct ringSlot) * r->size);
+
+  for (unsigned int i = 0; i < r->size; i++)
+    atomic_init(&r->slots[i].sequence, i);
+
+  atomic_init(&r->enqueuePos, 0);                      /* insertion and retrieval positions set to the same value */
+  atomic_init(&r->dequeuePos, 0);
+  atomic_init(&r->closed, false);
+}
+
+
+/**
+ *  \brief
+ *
+ *  Wait a little before another attempt on a full or empty ring
+ *
+ *  \param spins number of failed attempts so far
+ *
+ */
+static void backoff(unsigned int *spins)
+{
+  if (++(*spins) < SPINS)
+    sched_yield();                                                       /* let the other side run on this core */
+  else
+  {
+    struct timespec pause = {0, PAUSE};                               /* the other side is slow, e.g. reading a file */
+    nanosleep(&pause, NULL);
+  }
+}
 
-/** \brief locking flag which warrants mutual exclusion inside the monitor */
-static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
 
-/** \brief main process file insertion producers synchronization point when the data transfer region is full */
-static pthread_cond_t fifoFull;
+/**
+ *  \brief
+ *
+ *  Insert a batch into a ring
+ *  If the ring is full, wait until a slot is freed by a consumer.
+ *  \param r ring
+ *  \param batch batch to be added
+ *
+ */
+static void ringPut(struct ring *r, struct matrixBatch *batch)
+{
+  unsigned int spins = 0;                                                          /* failed attempts on a full ring */
+  uint64_t waitStart = 0;                                                              /* first failed attempt */
+  struct ringSlot *slot;
+  size_t pos = atomic_load_explicit(&r->enqueuePos, memory_order_relaxed);
+
+  while (true)
+  {
+    slot = &r->slots[pos % r->size];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0)                                          /* the slot is free, claim the position for this producer */
+    {
+      if (atomic_compare_exchange_weak_explicit(&r->enqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)                                /* the slot of the previous round was not retrieved, ring full */
+    {
+      if (spins == 0) waitStart = INSTR_NOW();
+      backoff(&spins);
+      pos = atomic_load_explicit(&r->enqueuePos, memory_order_relaxed);
+    }
+    else                                                              /* another producer took the position, retry */
+      pos = atomic_load_explicit(&r->enqueuePos, memory_order_relaxed);
+  }
 
-/** \brief workers synchronization point when the data transfer region is empty */
-static pthread_cond_t fifoEmpty;
+  slot->batch = batch;                                                                    /* store batch in the slot */
+  atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);           /* and publish it to the consumers */
+  if (spins > 0) INSTR_TIME(INSTR_FULL_WAIT, waitStart);
+}
 
 
 /**
- *  \brief 
+ *  \brief
+ *
+ *  Retrieve a batch from a ring
+ *  If the ring is empty, wait until a batch is inserted, or the ring is closed.
+ *  \param r ring
+ *  \param waitCounter counter of the time waiting on the empty ring (instrumentation)
+ *  \return the batch, or NULL once the ring is closed and empty
+ *
+ */
+static struct matrixBatch *ringGet(struct ring *r, enum instrCounter waitCounter)
+{
+  unsigned int spins = 0;                                                         /* failed attempts on an empty ring */
+  uint64_t waitStart = 0;                                                              /* first failed attempt */
+  bool finished = false;                                          /* the ring was already closed on the last attempt */
+  struct ringSlot *slot;
+  size_t pos = atomic_load_explicit(&r->dequeuePos, memory_order_relaxed);
+
+  while (true)
+  {
+    slot = &r->slots[pos % r->size];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    if (diff == 0)                                                /* the slot is full, claim it for this consumer */
+    {
+      if (atomic_compare_exchange_weak_explicit(&r->dequeuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)                                                                           /* the ring is empty */
+    {
+      if (finished)                                 /* and it was closed before this attempt, so no batch is left */
+      {
+        if (spins > 0) INSTR_TIME(waitCounter, waitStart);
+        return NULL;
+      }
+      finished = atomic_load_explicit(&r->closed, memory_order_acquire);       /* one last look at a closed ring */
+      if (!finished)
+      {
+        if (spins == 0) waitStart = INSTR_NOW();
+        backoff(&spins);
+      }
+      pos = atomic_load_explicit(&r->dequeuePos, memory_order_relaxed);
+    }
+    else                                                              /* another consumer took the position, retry */
+      pos = atomic_load_explicit(&r->dequeuePos, memory_order_relaxed);
+  }
+
+  struct matrixBatch *batch = slot->batch;                                         /* retrieve batch from the slot */
+  atomic_store_explicit(&slot->sequence, pos + r->size, memory_order_release);          /* free it for the next round */
+  if (spins > 0) INSTR_TIME(waitCounter, waitStart);
+
+  return batch;
+}
+
+
+/**
+ *  \brief
  *
  *  Initialization of the shared region variables
- *  Memory allocation for the FIFO Queue and files array
- *  
- *  \param _totalFileCount total number of files to be processed
- *  \param _K size of the FIFO Queue
+ *  Memory allocation for the rings, the batches of the pool and files array
+ *
+ *  \param _totalFileCount most files processed at a time (the files of a window)
+ *  \param _K number of slots of the ring of batches to process
+ *  \param _nHolders number of threads holding a batch outside the rings (workers and readers)
  *
  */
-void initialization(int _totalFileCount, int _K)
+void initialization(int _totalFileCount, int _K, int _nHolders)
 {
-  K = _K;
-  totalFileCount = _totalFileCount;                                               
+  totalFileCount = _totalFileCount;
 
-  matrices = malloc(sizeof(struct matrixData) * _K);                              /* initialize FIFO/matrices Queue  */
   files = (struct matrixFile *)malloc(_totalFileCount * sizeof(struct matrixFile));       /* initialize files array  */
 
-  
+  unsigned int nBatches = _K + _nHolders;              /* full ring, a batch per worker and one per reader */
+  ringInit(&fifo, _K);
+  ringInit(&pool, nBatches);
+  for (unsigned int i = 0; i < nBatches; i++)                          /* the buffers are allocated on the first use */
+  {
+    struct matrixBatch *batch = (struct matrixBatch *)malloc(sizeof(struct matrixBatch));
+    batch->count = 0;
+    batch->capacity = 0;
+    batch->terms = NULL;
+    ringPut(&pool, batch);
+  }
 
-                                                                                 
-  ii = ri = 0;                                       /* FIFO insertion and retrieval pointers  set to the same value */
   fip = 0;                                                                     /* File insertion pointer initialized */
-  fCounter = 0;                                                             /* initialize number of processed files  */
-
-  full = false;                                                                                  /* FIFO is not full */
-
-  pthread_cond_init (&fifoFull, NULL);                                 /* initialize producers synchronization point */
-  pthread_cond_init (&fifoEmpty, NULL);                                /* initialize consumers synchronization point */
 }
 
 
 /**
- *  \brief 
+ *  \brief
  *
  *  Insert a file's data info in the files array
- *  Executed by the main thread
+ *  Executed by the main thread, before any batch of the file is inserted in the ring,
+ *  which makes the info visible to the workers that retrieve those batches
  *  \param file file's data matrixFile structure
  *
  */
 void putFileData (struct matrixFile file)
 {
-
-  if ((statusProd = pthread_mutex_lock (&accessCR)) != 0)                                           /* enter monitor */
-     { errno = statusProd;                                                                    /* save error in errno */
-       perror ("error on entering monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
-     }
-  
   /* saving the file's data into the files array */
   (files+fip)->filename = file.filename;
-  (files+fip)->processedMatrixCounter = file.processedMatrixCounter;
+  atomic_init(&(files+fip)->processedMatrixCounter, 0);
+  atomic_init(&(files+fip)->emitted, false);
   (files+fip)->order = file.order;
   (files+fip)->nMatrix = file.nMatrix;
   (files+fip)->matrixDeterminants = (double *)malloc(file.nMatrix * sizeof(double));
+  (files+fip)->matrixLogDeterminants = file.matrixLogDeterminants;                 /* allocated by the main thread */
 
   fip++;                                                                         /* increment file insertion pointer */
-
-  if ((statusProd = pthread_mutex_unlock (&accessCR)) != 0)                                          /* exit monitor */
-     { errno = statusProd;                                                                    /* save error in errno */
-       perror ("error on exiting monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
-     }
 }
 
 /**
- *  \brief 
+ *  \brief
  *
- *  Retrieve file's data info from the shared region
- *  Executed by the main thread
- *  \return file's data info, matrixFile structure
+ *  Hand the determinants of a file to the result sink, unless another thread already did
+ *  The arrays now belong to the sink
+ *  \param fileIndex index of the file in the files array
  *
  */
-struct matrixFile * getFileData ()
+static void emitFile (unsigned int fileIndex)
 {
-  struct matrixFile * toRetrieve;
-
-  toRetrieve = (files+frp);                                                /* retrieve file at frp position in files */
+  struct matrixFile *file = files+fileIndex;
+
+  if (atomic_exchange(&file->emitted, true))
+    return;
+  sinkDeterminants(sink, firstFile + fileIndex, file->filename, file->nMatrix, file->order,
+                   file->matrixDeterminants, file->matrixLogDeterminants);
+  file->matrixDeterminants = NULL;
+  file->matrixLogDeterminants = NULL;
+}
 
-  frp = (frp + 1) % totalFileCount;                                         /* increase file retrieval pointer value */
- 
-  return toRetrieve;
+/**
+ *  \brief
+ *
+ *  Hand the files not handed over yet to the result sink (those without matrices)
+ *  Executed by the main thread, after every batch of the window was processed
+ *
+ */
+void emitFileData (void)
+{
+  for (unsigned int i = 0; i < fip; i++)
+    emitFile(i);
 }
 
 /**
- *  \brief 
- *  
- *  Insert matrix into the FIFO Queue matrices to be processed
- *  If the Queue is full, wait until space is available to insert.
- *  Afterwards, signal a consumer about the existance of a new matrix in the queue
+ *  \brief
+ *
+ *  Retrieve a free batch from the pool
+ *  If every batch is in use, wait until a worker releases one.
+ *  The buffer of the batch only grows, when a file has larger matrices than the batch has held so far.
  *  Executed by the main thread
- *  \param matrix to be added, matrixData structure
+ *  \param terms number of terms the buffer of the batch must hold
+ *  \return empty batch
  *
  */
-void putMatrixInFifo (struct matrixData matrix)
+struct matrixBatch * getFreeBatch (unsigned int terms)
 {
-  if ((statusProd = pthread_mutex_lock (&accessCR)) != 0)                                           /* enter monitor */
-     { errno = statusProd;                                                                    /* save error in errno */
-       perror ("error on entering monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
-     }                                         
-
-  while (full)                                                    /* wait if the data transfer region (FIFO) is full */
-  { if ((statusProd = pthread_cond_wait (&fifoFull, &accessCR)) != 0)
-       { errno = statusProd;                                                                  /* save error in errno */
-         perror ("error on waiting in fifoFull");
-         statusProd = EXIT_FAILURE;
-         pthread_exit (&statusProd);
-       }
+  struct matrixBatch *batch = ringGet(&pool, INSTR_FULL_WAIT);     /* the pool is never closed, empty while all batches are in use */
+
+  if (batch->capacity < terms)
+  {
+    free(batch->terms);
+    batch->terms = (double *)malloc(terms * sizeof(double));
+    batch->capacity = terms;
   }
+  batch->count = 0;
 
-  matrices[ii] = matrix;                                                             /* insert matrix at ii position */
-  ii = (ii + 1) % K; 
-  full = (ii == ri);
-
-  if ((statusProd = pthread_cond_signal (&fifoEmpty)) != 0)        /* let a worker know that a value has been stored */
-     { errno = statusProd;                                                                    /* save error in errno */
-       perror ("error on signaling in fifoEmpty");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
-     }
-
-  if ((statusProd = pthread_mutex_unlock (&accessCR)) != 0)                                          /* exit monitor */
-     { errno = statusProd;                                                                    /* save error in errno */
-       perror ("error on exiting monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
-     }
+  return batch;
 }
 
+/**
+ *  \brief
+ *
+ *  Insert a batch of matrices into the ring to be processed
+ *  If the ring is full, wait until a slot is freed by a worker.
+ *  Executed by the main thread
+ *  \param batch batch to be added, owned by the workers from now on
+ *
+ */
+void putBatchInFifo (struct matrixBatch *batch)
+{
+  ringPut(&fifo, batch);
+#ifdef INSTRUMENT
+  size_t inRing = atomic_load_explicit(&fifo.enqueuePos, memory_order_relaxed) - atomic_load_explicit(&fifo.dequeuePos, memory_order_relaxed);
+  INSTR_ADD(INSTR_QUEUE_PUTS, 1);
+  INSTR_ADD(INSTR_QUEUE_OCCUPANCY, inRing);                                   /* batches waiting for a worker */
+  INSTR_MAX(INSTR_QUEUE_MAX, inRing);
+#endif
+}
 
 /**
- *  \brief 
+ *  \brief
  *
- *  Retrieve matrix info from the FIFO Queue matrices to be processed
- *  If the Queue is empty, wait until a matrix is inserted.
- *  Afterwards, signal the main  about the existance of a new matrix in the queue
- *  
- *  \param val matrixData structure to be filled with the retrieved matrix's info
- *  \param consId worker thread's id
- *  \return if there are still files to be processed returns 0, otherwise returns -1
+ *  Let the workers know that no more batches will be inserted
+ *  Executed by the main thread, after its last batch has been inserted
  *
  */
-int getSingleMatrixData(unsigned int consId, struct matrixData *val)
+void closeFifo (void)
 {
-  int toReturn = -1;                                                                         /* value to be returned */
-  if ((statusWorker[consId] = pthread_mutex_lock (&accessCR)) != 0)                                 /* enter monitor */
-     { errno = statusWorker[consId];                                                          /* save error in errno */
-       perror ("error on entering monitor(CF)");
-       statusWorker[consId] = EXIT_FAILURE;
-       pthread_exit (&statusWorker[consId]);
-     }                                         
-
-  while ((ii == ri) && !full && (fCounter!=totalFileCount))         /* wait if the data transfer region is empty and not 
-                                                                                       all files have been processed */
-    { 
-      if ((statusWorker[consId] = pthread_cond_wait (&fifoEmpty, &accessCR)) != 0)
-        { errno = statusWorker[consId];                                                       /* save error in errno */
-          perror ("error on waiting in fifoEmpty");
-          statusWorker[consId] = EXIT_FAILURE;
-          pthread_exit (&statusWorker[consId]);
-        }
-    }
+  atomic_store_explicit(&fifo.closed, true, memory_order_release);
+}
 
 
-  if (fCounter != totalFileCount){                       /* retrieve matrix if not all files have been processed yet */
-      val->fileIndex = matrices[ri].fileIndex;
-      val->matrixNumber = matrices[ri].matrixNumber;
-      val->order = matrices[ri].order;
-      val->determinant = matrices[ri].determinant;
-      val->matrix = matrices[ri].matrix;
-      
-    
-      ri = (ri + 1) % K;
+/**
+ *  \brief
+ *
+ *  Free the files of a window and reopen the ring for the files of the next one
+ *  Executed by the main thread, after the results of the files were handed to the sink and every worker
+ *  has seen the ring closed and empty, so the batches are all back in the pool
+ *
+ */
+void freeFileData (void)
+{
+  for (unsigned int i = 0; i < fip; i++)
+  {
+    free((files+i)->matrixDeterminants);
+    free((files+i)->matrixLogDeterminants);
+  }
 
-      /* if all matrixes have been processed, increment processed file counter */
-      if (((struct matrixFile *)(files+val->fileIndex))->processedMatrixCounter == ((struct matrixFile *)(files+val->fileIndex))->nMatrix-1){
-        fCounter++;
-      }
+  fip = 0;                                                            /* file pointer back to the first slot */
+  atomic_store_explicit(&fifo.closed, false, memory_order_release);
+}
 
-      ((struct matrixFile *)(files+val->fileIndex))->processedMatrixCounter++;                  /* increment counter of 
-                                                                                                  processed matrices */
-      full = false;                                                                       /* queue is no longer full */
-      
-      if ((statusWorker[consId] = pthread_cond_signal (&fifoFull)) != 0)             /* let the main thread know that a
-                                                                                            value has been retrieved */
-        { errno = statusWorker[consId];                                                       /* save error in errno */
-          perror ("error on signaling in fifoFull");
-          statusWorker[consId] = EXIT_FAILURE;
-          pthread_exit (&statusWorker[consId]);
-        }
-      toReturn = 0;                                                                   
-  }
 
-  if ((statusWorker[consId] = pthread_mutex_unlock (&accessCR)) != 0)                                /* exit monitor */
-     { errno = statusWorker[consId];                                                          /* save error in errno */
-       perror ("error on exiting monitor(CF)");
-       statusWorker[consId] = EXIT_FAILURE;
-       pthread_exit (&statusWorker[consId]);
-     }
+/**
+ *  \brief
+ *
+ *  Retrieve a batch of matrices from the ring to be processed
+ *  If the ring is empty, wait until a batch is inserted, or the ring is closed.
+ *
+ *  \param consId worker thread's id
+ *  \return the batch, owned by the worker until it is released, or NULL if all batches have been retrieved
+ *
+ */
+struct matrixBatch * getMatrixBatch(unsigned int consId)
+{
+  return ringGet(&fifo, INSTR_EMPTY_WAIT);
+}
 
-  return toReturn;
+/**
+ *  \brief
+ *
+ *  Return a processed batch, and the buffer of its matrices, to the pool
+ *  Executed by the worker threads, after the results of every matrix of the batch were inserted
+ *
+ *  \param consId worker thread's id
+ *  \param batch processed batch
+ *
+ */
+void releaseBatch(unsigned int consId, struct matrixBatch *batch)
+{
+  ringPut(&pool, batch);                                     /* never waits, the pool has a slot for every batch */
 }
 
 /**
- *  \brief 
+ *  \brief
  *
  *  Insert processed matrix's results into the file's determinants array
- *  If all files have been processed and no matrices are left to be processed, signal all waiting workers 
- *  to end lifecycle.
+ *  No lock is taken, the matrix is owned by a single worker, so its slot has a single writer.
+ *  The worker of the last matrix of the file hands the file to the result sink.
 
  *  \param consId worker thread's id
  *  \param determinant determinant of the processed matrix
+ *  \param logDeterminant log|det| of the processed matrix, stored if the file keeps them
  *  \param fileIndex index of processed matrix's file in the files array
  *  \param matrixNumber index of the matrix in its file
  *
  */
-void putResults(unsigned int consId,double determinant,int fileIndex,int matrixNumber)
+void putResults(unsigned int consId,double determinant,double logDeterminant,int fileIndex,int matrixNumber)
 {
-  if ((statusWorker[consId] = pthread_mutex_lock (&accessCR)) != 0)                                 /* enter monitor */
-     { errno = statusWorker[consId];                                                          /* save error in errno */
-       perror ("error on entering monitor(CF)");
-       statusWorker[consId] = EXIT_FAILURE;
-       pthread_exit (&statusWorker[consId]);
-     }     
   (*((((struct matrixFile *)(files+fileIndex))
     ->matrixDeterminants) + matrixNumber)) = determinant;        /* add determinant in the file's determinants array */
-  
-  if (fCounter == totalFileCount){ 
-    pthread_cond_broadcast(&fifoEmpty);                                               /* signal all  waiting workers */
-  }
+  if ((files+fileIndex)->matrixLogDeterminants != NULL)
+    (files+fileIndex)->matrixLogDeterminants[matrixNumber] = logDeterminant;                     /* and its log|det| */
 
-  if ((statusWorker[consId] = pthread_mutex_unlock (&accessCR)) != 0)                                /* exit monitor */
-  { errno = statusWorker[consId];                                                             /* save error in errno */
-    perror ("error on exiting monitor(CF)");
-    statusWorker[consId] = EXIT_FAILURE;
-    pthread_exit (&statusWorker[consId]);
-  }
+  if (atomic_fetch_add_explicit(&(files+fileIndex)->processedMatrixCounter, 1, memory_order_acq_rel) + 1
+      == (files+fileIndex)->nMatrix)
+    emitFile(fileIndex);                                          /* the last matrix of the file, the others are seen */
 }
-
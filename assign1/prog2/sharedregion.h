@@ -9,6 +9,11 @@
 #ifndef SHAREDREGION_H
 # define SHAREDREGION_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "probConst.h"
+
 /** \brief structure with matrix information */
 struct matrixData
 {
@@ -19,30 +24,53 @@ struct matrixData
   double *matrix;                                                                         /** array of matrix values */
 };
 
+/** \brief structure with a batch of matrices of the same file */
+struct matrixBatch
+{
+  unsigned int count;                                                                /** number of matrices in batch */
+  unsigned int capacity;                                                          /** number of terms of the buffer */
+  double *terms;                                                 /** buffer of the matrices, owned by the batch */
+  struct matrixData matrices[MB];                                  /** matrices of the batch, views of its buffer */
+};
+
 /** \brief structure with file information */
 struct matrixFile
 {
   char *filename;                                                                       /** name of the current file */
   double *matrixDeterminants;                                               /** array of determinants of each matrix */
-  unsigned int processedMatrixCounter;                                      /** number of matrices already processed */
+  double *matrixLogDeterminants;                                 /** array of log|det| of each matrix (or NULL) */
+  atomic_uint processedMatrixCounter;                                       /** number of matrices already processed */
+  atomic_bool emitted;                                             /** the results were handed to the result sink */
   unsigned int order;                                                                      /** order of the matrices */
   unsigned int nMatrix;                                                         /** total number of matrices in file */
 };
 
 
-/** \brief retrive single matrix structure from queue */
-extern int getSingleMatrixData(unsigned int consId, struct matrixData *val);
+/** \brief retrive a batch of matrices from the ring */
+extern struct matrixBatch * getMatrixBatch(unsigned int consId);
+
+/** \brief return a processed batch to the pool */
+extern void releaseBatch(unsigned int consId, struct matrixBatch *batch);
+
+/** \brief retrive a free batch from the pool */
+extern struct matrixBatch * getFreeBatch (unsigned int terms);
 
 /** \brief insert file information */
 extern void putFileData (struct matrixFile matrix);
 
-/** \brief retrive one matrixFile object from files array */
-extern struct matrixFile * getFileData ();
+/** \brief hand the files not handed over yet to the result sink */
+extern void emitFileData (void);
+
+/** \brief insert a batch of matrices in the ring */
+extern void putBatchInFifo (struct matrixBatch *batch);
+
+/** \brief no more batches will be inserted in the ring */
+extern void closeFifo (void);
 
-/** \brief insert matrix in FIFO Queue */
-extern void putMatrixInFifo (struct matrixData matrix);
+/** \brief free the files of a window and reopen the ring */
+extern void freeFileData (void);
 
 /** \brief insert results in file's determinant array */
-extern void putResults(unsigned int consId,double determinant,int fileIndex,int matrixNumber);
+extern void putResults(unsigned int consId,double determinant,double logDeterminant,int fileIndex,int matrixNumber);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+/**
+ *  \file checkpoint.c (implementation file)
+ *
+ *  \brief Checkpoint of the work done on each file, shared by the MPI text processing and matrix determinant programs.
+ *
+ *  The file is a header (magic, kind of the records) followed by a record per file, each a fixed
+ *  part (length of the name, size of the values, position), the name and the values. In memory
+ *  the records are kept in an open addressing hash table keyed by the hash of the name. The file is
+ *  read whole when the checkpoint is opened, and written whole to "<path>.tmp", synced and renamed
+ *  over the checkpoint whenever it is flushed, so it never holds a record cut by a run that was
+ *  stopped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "../../common/resultcache.h"
+
+/** \brief first bytes of a checkpoint file */
+#define CHECKPOINT_MAGIC "CKPOINT2"
+
+/** \brief header of a checkpoint file */
+struct checkpointHeader
+{
+  char magic[8];
+  uint32_t kind;
+  uint32_t reserved;
+};
+
+/** \brief fixed part of a record of the file, followed by the name and the values */
+struct recordHeader
+{
+  uint32_t nameLength;
+  uint32_t size;
+  uint64_t position;
+};
+
+/** \brief entry of the hash table, free when its name is NULL */
+struct checkpointEntry
+{
+  uint64_t hash; /* hash of the name */
+  char *name;
+  struct checkpointRecord record; /* its values are owned by the entry */
+};
+
+/** \brief structure of the checkpoint */
+struct checkpoint
+{
+  char *path;                      /* file of the checkpoint */
+  uint32_t kind;                   /* kind of the records */
+  double interval;                 /* seconds between two writes */
+  struct timespec lastWrite;       /* time of the last write */
+  struct checkpointEntry *entries; /* hash table of the records */
+  size_t capacity;                 /* entries of the table, a power of two */
+  size_t nRecords;
+  bool changed;                    /* a record was set since the last write */
+};
+
+/**
+ *  \brief Entry of a name in the hash table: its entry, or the free entry where it goes.
+ *
+ *  \param cp checkpoint
+ *  \param name name of the file
+ *  \param hash hash of the name
+ *
+ *  \return entry of the name
+ */
+static struct checkpointEntry *findEntry(struct checkpoint *cp, const char *name, uint64_t hash)
+{
+  size_t e = hash & (cp->capacity - 1);
+
+  while (cp->entries[e].name != NULL && (cp->entries[e].hash != hash || strcmp(cp->entries[e].name, name) != 0))
+    e = (e + 1) & (cp->capacity - 1);
+  return cp->entries + e;
+}
+
+/**
+ *  \brief Doubles the hash table once it is half full.
+ *
+ *  \param cp checkpoint
+ */
+static void growTable(struct checkpoint *cp)
+{
+  struct checkpointEntry *old = cp->entries;
+  size_t oldCapacity = cp->capacity;
+
+  if (2 * (cp->nRecords + 1) <= cp->capacity)
+    return;
+  cp->capacity = (cp->capacity == 0) ? 1024 : 2 * cp->capacity;
+  cp->entries = (struct checkpointEntry *)calloc(cp->capacity, sizeof(struct checkpointEntry));
+  for (size_t e = 0; e < oldCapacity; e++)
+    if (old[e].name != NULL)
+      *findEntry(cp, old[e].name, old[e].hash) = old[e];
+  free(old);
+}
+
+/**
+ *  \brief Load the records of a previous run.
+ *
+ *  \param path file of the checkpoint, created when it is first written
+ *  \param kind kind of the records, a checkpoint of another kind is not used
+ *  \param interval seconds between two writes of the checkpoint
+ *
+ *  \return checkpoint, or NULL if the file can not be read or is of another kind
+ */
+struct checkpoint *checkpointOpen(const char *path, uint32_t kind, double interval)
+{
+  struct checkpoint *cp = (struct checkpoint *)calloc(1, sizeof(struct checkpoint));
+  cp->path = strdup(path);
+  cp->kind = kind;
+  cp->interval = interval;
+  clock_gettime(CLOCK_MONOTONIC, &cp->lastWrite);
+  growTable(cp);
+
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) /* no checkpoint yet */
+    return cp;
+
+  struct checkpointHeader header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0 || header.kind != kind)
+  {
+    fprintf(stderr, "checkpoint %s does not match, it is not used\n", path);
+    fclose(fp);
+    checkpointClose(cp, false);
+    return NULL;
+  }
+
+  struct recordHeader rh;
+  while (fread(&rh, sizeof(rh), 1, fp) == 1)
+  {
+    char *name = (char *)malloc(rh.nameLength + 1);
+    void *values = malloc(rh.size > 0 ? rh.size : 1);
+    if (fread(name, 1, rh.nameLength, fp) != rh.nameLength || fread(values, 1, rh.size, fp) != rh.size)
+    {
+      fprintf(stderr, "checkpoint %s is cut, its last record is not used\n", path);
+      free(name);
+      free(values);
+      break;
+    }
+    name[rh.nameLength] = '\0';
+    checkpointSet(cp, name, rh.position, values, rh.size);
+    free(name);
+    free(values);
+  }
+  fclose(fp);
+  cp->changed = false;
+  return cp;
+}
+
+/**
+ *  \brief Record of a file.
+ *
+ *  \param cp checkpoint
+ *  \param name name of the file
+ *
+ *  \return record of the file, valid until the next checkpointSet, or NULL if it has none
+ */
+const struct checkpointRecord *checkpointFind(struct checkpoint *cp, const char *name)
+{
+  struct checkpointEntry *entry = findEntry(cp, name, cacheHash(name, strlen(name), 0));
+
+  return (entry->name != NULL) ? &entry->record : NULL;
+}
+
+/**
+ *  \brief Replace the record of a file, written with the others at the next checkpointFlush.
+ *
+ *  \param cp checkpoint
+ *  \param name name of the file
+ *  \param position end of the part of the file done: bytes or matrices
+ *  \param values values of the part, copied
+ *  \param size bytes of the values
+ */
+void checkpointSet(struct checkpoint *cp, const char *name, uint64_t position, const void *values, uint32_t size)
+{
+  uint64_t hash = cacheHash(name, strlen(name), 0);
+  struct checkpointEntry *entry = findEntry(cp, name, hash);
+
+  if (entry->name == NULL)
+  {
+    growTable(cp);
+    entry = findEntry(cp, name, hash); /* the table may have moved */
+    entry->hash = hash;
+    entry->name = strdup(name);
+    cp->nRecords++;
+  }
+  if (entry->record.values == NULL || entry->record.size != size)
+  {
+    free((void *)entry->record.values);
+    entry->record.values = malloc(size > 0 ? size : 1);
+  }
+  memcpy((void *)entry->record.values, values, size);
+  entry->record.position = position;
+  entry->record.size = size;
+  cp->changed = true;
+}
+
+/**
+ *  \brief Tells whether the interval passed since the checkpoint was last written.
+ *
+ *  \param cp checkpoint
+ *
+ *  \return true if the checkpoint should be written
+ */
+bool checkpointDue(struct checkpoint *cp)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - cp->lastWrite.tv_sec) + (now.tv_nsec - cp->lastWrite.tv_nsec) / 1000000000.0 >= cp->interval;
+}
+
+/**
+ *  \brief Write every record to a temporary file, wait until it is on disk and rename it over the checkpoint.
+ *
+ *  \param cp checkpoint
+ */
+void checkpointFlush(struct checkpoint *cp)
+{
+  clock_gettime(CLOCK_MONOTONIC, &cp->lastWrite);
+  if (!cp->changed)
+    return;
+
+  size_t pathLength = strlen(cp->path);
+  char *tmpPath = (char *)malloc(pathLength + 5);
+  memcpy(tmpPath, cp->path, pathLength);
+  memcpy(tmpPath + pathLength, ".tmp", 5);
+
+  FILE *fp = fopen(tmpPath, "wb");
+  bool ok = (fp != NULL);
+  if (ok)
+  {
+    struct checkpointHeader header;
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.kind = cp->kind;
+    header.reserved = 0;
+    ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+    for (size_t e = 0; e < cp->capacity && ok; e++)
+    {
+      struct checkpointEntry *entry = cp->entries + e;
+      if (entry->name == NULL)
+        continue;
+      struct recordHeader rh;
+      rh.nameLength = strlen(entry->name);
+      rh.size = entry->record.size;
+      rh.position = entry->record.position;
+      ok = fwrite(&rh, sizeof(rh), 1, fp) == 1 && fwrite(entry->name, 1, rh.nameLength, fp) == rh.nameLength &&
+           fwrite(entry->record.values, 1, rh.size, fp) == rh.size;
+    }
+    ok = (fflush(fp) == 0) && ok;
+    ok = (fsync(fileno(fp)) == 0) && ok;
+    ok = (fclose(fp) == 0) && ok;
+  }
+  if (ok && rename(tmpPath, cp->path) == 0) /* the previous checkpoint is replaced at once */
+    cp->changed = false;
+  else
+  {
+    fprintf(stderr, "checkpoint %s could not be written\n", cp->path);
+    remove(tmpPath);
+  }
+  free(tmpPath);
+}
+
+/**
+ *  \brief Write the checkpoint, or remove it, and free it.
+ *
+ *  \param cp checkpoint
+ *  \param finished every file was done, the file of the checkpoint is removed
+ */
+void checkpointClose(struct checkpoint *cp, bool finished)
+{
+  if (finished)
+    remove(cp->path);
+  else
+    checkpointFlush(cp);
+  for (size_t e = 0; e < cp->capacity; e++)
+  {
+    free(cp->entries[e].name);
+    free((void *)cp->entries[e].record.values);
+  }
+  free(cp->entries);
+  free(cp->path);
+  free(cp);
+}
@@ -0,0 +1,98 @@
+/**
+ *  \file checkpoint.h (interface file)
+ *
+ *  \brief Checkpoint of the work done on each file, shared by the MPI text processing and matrix determinant programs.
+ *
+ *  A checkpoint keeps a single record per file, with the results of the part of the file done
+ *  from its start: its end (in bytes of text or in matrices) and its values (the counts of the
+ *  words, or the determinants). The dispatcher replaces the record of a file as that part grows,
+ *  and the whole checkpoint is written again every few seconds, to a temporary file renamed over
+ *  the previous one, so a job that is stopped loses at most the work of those seconds and the
+ *  file on disk is always complete. A job restarted with the same checkpoint finds the record of
+ *  each file and only processes the rest of the file.
+ *
+ *  The files are identified by their name, so they must not change between the runs. The file of
+ *  the checkpoint is removed once a run finished every file.
+ *
+ *  Methods:
+ *     \li checkpointOpen - loads the records of a previous run.
+ *     \li checkpointFind - record of a file.
+ *     \li checkpointSet - replaces the record of a file.
+ *     \li checkpointDue - tells whether the checkpoint should be written.
+ *     \li checkpointFlush - writes the checkpoint.
+ *     \li checkpointClose - writes the checkpoint, or removes it, and frees it.
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** \brief opaque structure of the checkpoint */
+struct checkpoint;
+
+/** \brief results of the part of a file done from its start */
+struct checkpointRecord
+{
+  uint64_t position;  /* end of the part: bytes or matrices */
+  uint32_t size;      /* bytes of the values */
+  const void *values; /* values of the part, not aligned (copy them) */
+};
+
+/**
+ *  \brief Load the records of a previous run.
+ *
+ *  \param path file of the checkpoint, created when it is first written
+ *  \param kind kind of the records, a checkpoint of another kind is not used
+ *  \param interval seconds between two writes of the checkpoint
+ *
+ *  \return checkpoint, or NULL if the file can not be read or is of another kind
+ */
+extern struct checkpoint *checkpointOpen(const char *path, uint32_t kind, double interval);
+
+/**
+ *  \brief Record of a file.
+ *
+ *  \param cp checkpoint
+ *  \param name name of the file
+ *
+ *  \return record of the file, valid until the next checkpointSet, or NULL if it has none
+ */
+extern const struct checkpointRecord *checkpointFind(struct checkpoint *cp, const char *name);
+
+/**
+ *  \brief Replace the record of a file, written with the others at the next checkpointFlush.
+ *
+ *  \param cp checkpoint
+ *  \param name name of the file
+ *  \param position end of the part of the file done: bytes or matrices
+ *  \param values values of the part, copied
+ *  \param size bytes of the values
+ */
+extern void checkpointSet(struct checkpoint *cp, const char *name, uint64_t position, const void *values, uint32_t size);
+
+/**
+ *  \brief Tells whether the interval passed since the checkpoint was last written.
+ *
+ *  \param cp checkpoint
+ *
+ *  \return true if the checkpoint should be written
+ */
+extern bool checkpointDue(struct checkpoint *cp);
+
+/**
+ *  \brief Write every record to a temporary file, wait until it is on disk and rename it over the checkpoint.
+ *
+ *  \param cp checkpoint
+ */
+extern void checkpointFlush(struct checkpoint *cp);
+
+/**
+ *  \brief Write the checkpoint, or remove it, and free it.
+ *
+ *  \param cp checkpoint
+ *  \param finished every file was done, the file of the checkpoint is removed
+ */
+extern void checkpointClose(struct checkpoint *cp, bool finished);
+
+#endif /* CHECKPOINT_H */
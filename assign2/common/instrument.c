@@ -0,0 +1,199 @@
+/**
+ *  \file instrument.c (implementation file)
+ *
+ *  \brief Opt-in counters and timers of the hot paths, shared by the MPI text processing and matrix determinant programs.
+ *
+ *  The MPI calls of the programs are defined here and forwarded to their PMPI versions, counting
+ *  them on the way, so the programs call MPI as usual. The processes are single threaded, so the
+ *  counters are plain integers.
+ */
+
+#ifdef INSTRUMENT
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <mpi.h>
+
+#include "instrument.h"
+
+/** \brief counters of the process */
+uint64_t instrCounters[INSTR_COUNTERS];
+
+/** \brief names of the counters in the dump */
+static const char *counterNames[INSTR_COUNTERS] = {
+  "msgSent", "bytesSent", "msgRecv", "bytesRecv", "recvWaitNs", "sendWaitNs",
+  "collectives", "collectiveBytes", "collectiveNs", "readCalls", "readBytes", "readNs",
+  "computeItems", "computeNs",
+};
+
+/**
+ *  \brief Current time.
+ *
+ *  \return ns since an arbitrary point
+ */
+uint64_t instrNow(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/**
+ *  \brief Bytes of a buffer of an MPI call.
+ *
+ *  \param count number of elements
+ *  \param datatype type of the elements
+ *
+ *  \return bytes
+ */
+static uint64_t bytesOf(int count, MPI_Datatype datatype)
+{
+  int size;
+  PMPI_Type_size(datatype, &size);
+  return (uint64_t)count * size;
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+  uint64_t start = instrNow();
+  int status = PMPI_Send(buf, count, datatype, dest, tag, comm);
+  INSTR_TIME(INSTR_SEND_WAIT, start);
+  INSTR_ADD(INSTR_MSG_SENT, 1);
+  INSTR_ADD(INSTR_BYTES_SENT, bytesOf(count, datatype));
+  return status;
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm, MPI_Request *request)
+{
+  INSTR_ADD(INSTR_MSG_SENT, 1);
+  INSTR_ADD(INSTR_BYTES_SENT, bytesOf(count, datatype));
+  return PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+  MPI_Status own;                                   /* the size of the message is needed even if status is ignored */
+  uint64_t start = instrNow();
+  int result = PMPI_Recv(buf, count, datatype, source, tag, comm, (status == MPI_STATUS_IGNORE) ? &own : status);
+  INSTR_TIME(INSTR_RECV_WAIT, start);
+
+  int received;
+  PMPI_Get_count((status == MPI_STATUS_IGNORE) ? &own : status, datatype, &received);
+  INSTR_ADD(INSTR_MSG_RECV, 1);
+  if (received != MPI_UNDEFINED)
+    INSTR_ADD(INSTR_BYTES_RECV, bytesOf(received, datatype));
+  return result;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request *request)
+{
+  INSTR_ADD(INSTR_MSG_RECV, 1);
+  INSTR_ADD(INSTR_BYTES_RECV, bytesOf(count, datatype));
+  return PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Probe(source, tag, comm, status);
+  INSTR_TIME(INSTR_RECV_WAIT, start);
+  return result;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Wait(request, status);
+  INSTR_TIME(INSTR_RECV_WAIT, start);
+  return result;
+}
+
+int MPI_Waitany(int count, MPI_Request requests[], int *index, MPI_Status *status)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Waitany(count, requests, index, status);
+  INSTR_TIME(INSTR_RECV_WAIT, start);
+  return result;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[])
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Waitall(count, requests, statuses);
+  INSTR_TIME(INSTR_RECV_WAIT, start);
+  return result;
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Bcast(buffer, count, datatype, root, comm);
+  INSTR_TIME(INSTR_COLLECTIVE_TIME, start);
+  INSTR_ADD(INSTR_COLLECTIVES, 1);
+  INSTR_ADD(INSTR_COLLECTIVE_BYTES, bytesOf(count, datatype));
+  return result;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+  INSTR_TIME(INSTR_COLLECTIVE_TIME, start);
+  INSTR_ADD(INSTR_COLLECTIVES, 1);
+  INSTR_ADD(INSTR_COLLECTIVE_BYTES, bytesOf(count, datatype));
+  return result;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+  INSTR_TIME(INSTR_COLLECTIVE_TIME, start);
+  INSTR_ADD(INSTR_COLLECTIVES, 1);
+  INSTR_ADD(INSTR_COLLECTIVE_BYTES, bytesOf(sendcount, sendtype));
+  return result;
+}
+
+int MPI_File_read_all(MPI_File fh, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_File_read_all(fh, buf, count, datatype, status);
+  INSTR_TIME(INSTR_READ_TIME, start);
+  INSTR_ADD(INSTR_READ_CALLS, 1);
+  INSTR_ADD(INSTR_READ_BYTES, bytesOf(count, datatype));
+  return result;
+}
+
+int MPI_File_read_at_all(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  uint64_t start = instrNow();
+  int result = PMPI_File_read_at_all(fh, offset, buf, count, datatype, status);
+  INSTR_TIME(INSTR_READ_TIME, start);
+  INSTR_ADD(INSTR_READ_CALLS, 1);
+  INSTR_ADD(INSTR_READ_BYTES, bytesOf(count, datatype));
+  return result;
+}
+
+/**
+ *  \brief Print the counters of the process, then finalize.
+ *
+ *  \return status of PMPI_Finalize
+ */
+int MPI_Finalize(void)
+{
+  int rank;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  fprintf(stderr, "{\"program\": \"%s\", \"rank\": %d", program_invocation_short_name, rank);
+  for (int c = 0; c < INSTR_COUNTERS; c++)
+    fprintf(stderr, ", \"%s\": %lu", counterNames[c], (unsigned long)instrCounters[c]);
+  fprintf(stderr, "}\n");
+
+  return PMPI_Finalize();
+}
+
+#endif /* INSTRUMENT */
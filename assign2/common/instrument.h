@@ -0,0 +1,65 @@
+/**
+ *  \file instrument.h (interface file)
+ *
+ *  \brief Opt-in counters and timers of the hot paths, shared by the MPI text processing and matrix determinant programs.
+ *
+ *  Built with -DINSTRUMENT, every process keeps its own counters: the programs time their reads of the
+ *  files and their processing with the macros below, and instrument.c intercepts the MPI calls through
+ *  the profiling interface (PMPI) to count the messages, their bytes and the time blocked in them.
+ *  MPI_Finalize prints the counters of the process to stderr as a JSON line:
+ *
+ *     {"program": "prog2", "rank": 0, "msgSent": 12, "bytesSent": 4096, ...}
+ *
+ *  Without -DINSTRUMENT the macros below are empty and instrument.c is empty, so nothing is left of them.
+ *
+ *  Methods (all through the macros):
+ *     \li INSTR_NOW - start of a timed interval.
+ *     \li INSTR_TIME - adds the time elapsed since a start to a counter.
+ *     \li INSTR_ADD - adds a value to a counter.
+ */
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+
+/** \brief counters of a process */
+enum instrCounter
+{
+  INSTR_MSG_SENT,        /* point-to-point messages sent */
+  INSTR_BYTES_SENT,      /* their bytes */
+  INSTR_MSG_RECV,        /* point-to-point messages received (or receives posted) */
+  INSTR_BYTES_RECV,      /* their bytes (the size of the buffer of a posted receive) */
+  INSTR_RECV_WAIT,       /* ns blocked in receives, probes and waits */
+  INSTR_SEND_WAIT,       /* ns blocked in sends */
+  INSTR_COLLECTIVES,     /* collective operations */
+  INSTR_COLLECTIVE_BYTES,/* bytes of the local buffers of the collectives */
+  INSTR_COLLECTIVE_TIME, /* ns in collectives */
+  INSTR_READ_CALLS,      /* reads of the files */
+  INSTR_READ_BYTES,      /* bytes read */
+  INSTR_READ_TIME,       /* ns reading */
+  INSTR_COMPUTE_ITEMS,   /* chunks or matrices processed */
+  INSTR_COMPUTE_TIME,    /* ns processing them */
+  INSTR_COUNTERS
+};
+
+#ifdef INSTRUMENT
+
+/** \brief current time, in ns */
+extern uint64_t instrNow(void);
+
+/** \brief counters of the process */
+extern uint64_t instrCounters[INSTR_COUNTERS];
+
+#define INSTR_NOW() instrNow()
+#define INSTR_TIME(counter, start) (instrCounters[counter] += instrNow() - (start))
+#define INSTR_ADD(counter, value) (instrCounters[counter] += (value))
+
+#else
+
+#define INSTR_NOW() ((uint64_t)0)
+#define INSTR_TIME(counter, start) ((void)(start))
+#define INSTR_ADD(counter, value) ((void)0)
+
+#endif /* INSTRUMENT */
+
+#endif /* INSTRUMENT_H */
@@ -14,14 +14,15 @@
  * 
  *  1 - Read and process the command line.
  *  2 - Broadcast a message with the maximum number of bytes each chunk will have.
- *  3 - For every file:
- *    3.1 - Obtain chunks and split them to each worker process until there are no
- *    more chunks or no more workers available.
- *    3.2 - Wait for a response with the processing results from each worker that it sent a chunk.
- *    3.3 - Store the processing results obtained from the workers response.
+ *  3 - For every window of files of the list (-f names, then the manifest):
+ *    3.1 - For every file of the window:
+ *      3.1.1 - Obtain chunks and split them to each worker process until there are no
+ *      more chunks or no more workers available.
+ *      3.1.2 - Wait for a response with the processing results from each worker that it sent a chunk.
+ *      3.1.3 - Store the processing results obtained from the workers response.
+ *    3.2 - Hand the processing results of each file to the result sink as soon as its last chunk is done.
  *  4 - Send a message to the workers alerting there isn't more work to be done.
- *  5 - Print final processing results.
- *  6 - Finalize.
+ *  5 - Finalize.
  * 
  *  Design and flow of the worker process:
  *  
@@ -32,6 +33,28 @@
  *    2.2 - Send to the dispatcher the processing results.
  *  3 - Finalize.
  *
+ *  In the pipelined mode (-p) each chunk travels in a single message with its header, the
+ *  dispatcher keeps a number of chunks in flight per worker and reads the next chunk while
+ *  the workers compute.
+ *
+ *  With adaptive chunk sizing (-a) the sizes of the files are added up first, and every chunk
+ *  has a share of the bytes left, so the chunks shrink as the files run out.
+ *
+ *  With a cache directory (-C) the dispatcher hashes the contents of each file of the window
+ *  first: a file found in the cache is handed to the result sink with the counts of a previous
+ *  run and never sent to the workers.
+ *
+ *  In the pipelined mode a worker that has chunks in flight and does not answer for the worker
+ *  timeout (-T) is lost: its chunks are sent to the other workers and it gets no more chunks. With
+ *  a checkpoint (-R) the counts of the chunks of each file done from its start, and where they end,
+ *  are kept and written every few seconds, and a job restarted with the same checkpoint reads each
+ *  file from there; the files done are not read at all.
+ *
+ *  With scatter scheduling (-s scatter) there are no chunks: every process, the dispatcher
+ *  included, reads its own contiguous range of bytes of each file of the window with MPI-IO, a
+ *  window of -m bytes at a time, and counts its words, and the counts of every file are added up
+ *  on the dispatcher with a single reduction.
+ *
  *  \author Mário Silva - May 2022
  */
 
@@ -42,10 +65,18 @@
 #include <stdbool.h>
 #include <string.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <mpi.h>
 
 #include "textProcUtils.h"
 #include "probConst.h"
+#include "../common/instrument.h"
+#include "../../common/filelist.h"
+#include "../../common/resultsink.h"
+#include "../../common/resultcache.h"
+#include "../common/checkpoint.h"
 
 /**
  *  \brief Print command usage.
@@ -56,12 +87,160 @@
  */
 static void printUsage(char *cmdName);
 
+/** \brief output of the results, written as the files are done (dispatcher only) */
+static struct resultSink *sink;
+
+/** \brief position in the list of the first file of the window */
+static unsigned long firstFile = 0;
+
+/** \brief word counts of the files already processed, keyed by the hash of their contents (dispatcher only, NULL without -C) */
+static struct resultCache *cache = NULL;
+
+/** \brief counts of the part of each file done, kept across runs (dispatcher only, NULL without -R) */
+static struct checkpoint *checkpoint = NULL;
+
+/** \brief seconds a worker with chunks in flight may go without answering before it is lost (0 waits forever) */
+static double workerTimeout = 0;
+
+/** \brief workers lost, that get no more chunks (dispatcher only, indexed by rank) */
+static bool *lostWorkers = NULL;
+
+/** \brief number of workers lost */
+static int nLost = 0;
+
+/** \brief position of a chunk in its file, kept by the dispatcher until its results arrive */
+struct chunkPosition
+{
+  off_t start; /* first byte of the chunk */
+  int size;    /* bytes of the chunk */
+  int lastCh;  /* last character of the chunk, the previous character of the next one */
+  bool last;   /* the last chunk of the file */
+};
+
+/** \brief counts of a file, added up over the processes with scatter scheduling */
+struct wordCounts
+{
+  int nWords;
+  int nWordsBV;
+  int nWordsEC;
+};
+
+/** \brief record of a file in the checkpoint: counts of its chunks done from its start */
+struct prefixCounts
+{
+  int nWords;
+  int nWordsBV;
+  int nWordsEC;
+  int lastCh; /* last character of the last of those chunks */
+  int last;   /* the last chunk of the file is one of them */
+};
+
+/** \brief chunk done while a chunk before it in its file is still in flight (dispatcher only) */
+struct doneChunk
+{
+  int nFile;                     /* file of the chunk */
+  struct chunkPosition position; /* position of the chunk */
+  int counts[3];                 /* processing results of the chunk */
+};
+
+/**
+ *  \brief Looks up the processing results of a file of the window in the cache.
+ *
+ *  On a hit the file is handed to the result sink and marked as cached and finished, so it is
+ *  never opened nor sent.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
+ */
+static void lookupFile(struct fileData *filesData, int nFile);
+
+/**
+ *  \brief Restores the counts of the part of a file of the window found in the checkpoint.
+ *
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
+ */
+static void resumeFile(struct fileData *filesData, int nFile);
+
+/**
+ *  \brief Hands the processing results of a file of the window to the result sink, once.
+ *
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
+ */
+static void emitFile(struct fileData *filesData, int nFile);
+
+/**
+ *  \brief Opens a file with the given input backend.
+ *
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param data fileData structure of the file
+ *  \param inputBackend how the file is read
+ */
+static void openFile(struct fileData *data, int inputBackend);
+
+/**
+ *  \brief Sends the chunks of the files of a window keeping several chunks in flight per worker.
+ *
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window, updated with the processing results
+ *  \param numFiles number of files of the window
+ *  \param size number of processes
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *  \param inputBackend how the files are read
+ *  \param depth number of chunks in flight per worker
+ */
+static void dispatchPipelined(struct fileData *filesData, int numFiles, int size, int maxBytesPerChunk, int inputBackend, int depth);
+
 /**
- *  \brief Print results of the text processing.
+ *  \brief Processes chunk messages until the dispatcher says there is no more work to be done.
+ *
+ *  The next message is received while the current chunk is processed.
+ *  Operation carried out by the worker processes in the pipelined mode.
+ *
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ */
+static void workPipelined(int maxBytesPerChunk);
+
+/**
+ *  \brief Counts the words of a window of files with a static partition of their bytes.
+ *
+ *  Operation carried out by every process.
+ *
+ *  \param rank rank of the process
+ *  \param size number of processes
+ *  \param filesData files of the window, updated with the counts (dispatcher only)
+ *  \param numFiles number of files of the window (dispatcher only)
+ *  \param windowBytes maximum number of bytes read at a time
+ *
+ *  \return number of files of the window
+ */
+static int scatterStatic(int rank, int size, struct fileData *filesData, int numFiles, int windowBytes);
+
+/** \brief chunks shrink as the files run out (adaptive chunk sizing) */
+static bool adaptiveChunks = false;
+
+/** \brief bytes of the files of the window not read yet (adaptive chunk sizing) */
+static off_t remainingBytes = 0;
+
+/**
+ *  \brief Number of bytes of the next chunk, before alignment.
  *
  *  Operation carried out by the dispatcher process.
+ *
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *  \param nWorkers number of worker processes
+ *
+ *  \return {maxBytesPerChunk-7}, or a share of the bytes left with adaptive chunk sizing
  */
-void printResults(struct fileData *filesData, int numFiles);
+static int nextChunkBytes(int maxBytesPerChunk, int nWorkers);
 
 /**
  *  \brief
@@ -70,14 +249,15 @@ void printResults(struct fileData *filesData, int numFiles);
  * 
  *  1 - Read and process the command line.
  *  2 - Broadcast a message with the maximum number of bytes each chunk will have.
- *  3 - For every file:
- *    3.1 - Obtain chunks and split them to each worker process until there are no
- *    more chunks or no more workers available.
- *    3.2 - Wait for a response with the processing results from each worker that it sent a chunk.
- *    3.3 - Store the processing results obtained from the workers response.
+ *  3 - For every window of files of the list (-f names, then the manifest):
+ *    3.1 - For every file of the window:
+ *      3.1.1 - Obtain chunks and split them to each worker process until there are no
+ *      more chunks or no more workers available.
+ *      3.1.2 - Wait for a response with the processing results from each worker that it sent a chunk.
+ *      3.1.3 - Store the processing results obtained from the workers response.
+ *    3.2 - Hand the processing results of each file to the result sink as soon as its last chunk is done.
  *  4 - Send a message to the workers alerting there isn't more work to be done.
- *  5 - Print final processing results.
- *  6 - Finalize.
+ *  5 - Finalize.
  * 
  *  Design and flow of the worker process:
  *  
@@ -88,6 +268,10 @@ void printResults(struct fileData *filesData, int numFiles);
  *    2.2 - Send to the dispatcher the processing results.
  *  3 - Finalize.
  *
+ *  In the pipelined mode (-p) each chunk travels in a single message with its header, the
+ *  dispatcher keeps a number of chunks in flight per worker and reads the next chunk while
+ *  the workers compute.
+ *
  *  \param argc number of words of the command line
  *  \param argv list of words of the command line
  *
@@ -99,6 +283,11 @@ int main(int argc, char *argv[])
   int workStatus; /* indicates if there is more work to be done or not */
   /** \brief maximum number of bytes per chunk */
   int maxBytesPerChunk = DB; /* default value is used if not in args */
+  int inputBackend = INPUT_READ; /* how the dispatcher reads the files */
+  int pipelineDepth = DP; /* number of chunks in flight per worker (0 for the lock-step dispatcher) */
+  int scheduling = SCHED_DISPATCH; /* who reads the files */
+  bool maxBytesSet = false; /* the maximum number of bytes per chunk was given */
+  bool inputBackendSet = false; /* the input backend was given */
   int i; /* counting variable */
 
   // MPI
@@ -106,14 +295,6 @@ int main(int argc, char *argv[])
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-  /* This program requires at least 2 processes */
-  if (size < 2)
-  {
-    fprintf(stderr, "Requires at least two processes.\n");
-    MPI_Finalize();
-    return EXIT_FAILURE;
-  }
-
   if (rank == 0)
   {
     struct timespec start, finish; /* time limits */
@@ -123,12 +304,18 @@ int main(int argc, char *argv[])
 
     /* process command line arguments and set up variables */
     int nFile;          /* counting variable */
-    char *fileNames[M]; /* files to be processed (maximum of M) */
-    int numFiles = 0;   /* number of files to process */
-    int opt;            /* selected option */
+    struct fileList files; /* files to be processed */
+    int W = DW;            /* files of a window */
+    int numFiles = 0;      /* number of files of the window */
+    int outputFormat = SINK_TEXT; /* format of the results */
+    char *outputPath = NULL;      /* file of the results, NULL for the standard output */
+    char *cacheDir = NULL;        /* directory of the cache, NULL for none */
+    char *checkpointPath = NULL;  /* file of the checkpoint, NULL for none */
+    int opt;               /* selected option */
+    fileListInit(&files);
     do
     {
-      switch ((opt = getopt(argc, argv, "f:n:m:")))
+      switch ((opt = getopt(argc, argv, "f:F:w:n:m:i:p:s:ao:O:C:T:R:")))
       {
       case 'f': /* file name */
         if (optarg[0] == '-')
@@ -137,12 +324,23 @@ int main(int argc, char *argv[])
           printUsage(basename(argv[0]));
           return EXIT_FAILURE;
         }
-        if (numFiles == M)
+        fileListAdd(&files, optarg);
+        break;
+      case 'F': /* manifest */
+        if (fileListManifest(&files, optarg) != 0)
+        {
+          fprintf(stderr, "%s: could not open manifest %s\n", basename(argv[0]), optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'w': /* numeric argument */
+        if (atoi(optarg) < 1)
         {
-          fprintf(stderr, "%s: can only process %d files at a time\n", basename(argv[0]), M);
+          fprintf(stderr, "%s: number of files per window must be greater or equal than 1\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
           return EXIT_FAILURE;
         }
-        fileNames[numFiles++] = optarg;
+        W = (int)atoi(optarg);
         break;
       case 'm': /* numeric argument */
         if (atoi(optarg) < MIN)
@@ -152,6 +350,70 @@ int main(int argc, char *argv[])
           return EXIT_FAILURE;
         }
         maxBytesPerChunk = (int)atoi(optarg);
+        maxBytesSet = true;
+        break;
+      case 'i': /* input backend */
+        if (strcmp(optarg, "read") == 0)
+          inputBackend = INPUT_READ;
+        else if (strcmp(optarg, "mmap") == 0)
+          inputBackend = INPUT_MMAP;
+        else
+        {
+          fprintf(stderr, "%s: input backend must be read or mmap\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        inputBackendSet = true;
+        break;
+      case 'p': /* numeric argument */
+        if (atoi(optarg) < 0)
+        {
+          fprintf(stderr, "%s: number of chunks in flight must be greater or equal than 0\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        pipelineDepth = (int)atoi(optarg);
+        break;
+      case 's': /* scheduling */
+        if (strcmp(optarg, "dispatch") == 0)
+          scheduling = SCHED_DISPATCH;
+        else if (strcmp(optarg, "scatter") == 0)
+          scheduling = SCHED_SCATTER;
+        else
+        {
+          fprintf(stderr, "%s: scheduling must be dispatch or scatter\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'a': /* adaptive chunk sizing */
+        adaptiveChunks = true;
+        break;
+      case 'o': /* output format */
+        if ((outputFormat = sinkFormat(optarg)) < 0)
+        {
+          fprintf(stderr, "%s: output format must be text, csv or binary\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'O': /* output file */
+        outputPath = optarg;
+        break;
+      case 'C': /* cache directory */
+        cacheDir = optarg;
+        break;
+      case 'T': /* numeric argument */
+        if (atof(optarg) < 0)
+        {
+          fprintf(stderr, "%s: worker timeout must be greater or equal than 0\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        workerTimeout = atof(optarg);
+        break;
+      case 'R': /* checkpoint */
+        checkpointPath = optarg;
         break;
       case 'h': /* help mode */
         printUsage(basename(argv[0]));
@@ -172,11 +434,72 @@ int main(int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
+    if (adaptiveChunks && !maxBytesSet) /* the first chunks are larger than the fixed ones */
+      maxBytesPerChunk = DA;
+    if (scheduling == SCHED_SCATTER && !maxBytesSet) /* the windows are read without messages */
+      maxBytesPerChunk = DS;
+
+    /* This program requires at least 2 processes, but with scatter scheduling the dispatcher also counts */
+    if (size < 2 && scheduling != SCHED_SCATTER)
+    {
+      fprintf(stderr, "Requires at least two processes.\n");
+      MPI_Finalize();
+      return EXIT_FAILURE;
+    }
+
+    if (scheduling == SCHED_SCATTER && (inputBackendSet || adaptiveChunks || workerTimeout > 0 || checkpointPath != NULL))
+    {
+      fprintf(stderr, "%s: scatter scheduling has no input backend (-i), adaptive chunks (-a), worker timeout (-T) nor checkpoint (-R)\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+    if ((workerTimeout > 0 || checkpointPath != NULL) && pipelineDepth == 0)
+    {
+      fprintf(stderr, "%s: worker timeout and checkpoint need the pipelined mode (-p)\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+    if (scheduling == SCHED_SCATTER && pipelineDepth > 0)
+    {
+      fprintf(stderr, "%s: scatter scheduling has no chunks in flight (-p)\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+    if ((sink = sinkOpen(outputPath, outputFormat)) == NULL)
+    {
+      fprintf(stderr, "%s: could not open output file %s\n", basename(argv[0]), outputPath);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    FILE *info = sinkInfo(sink); /* stream of the elapsed time, apart from csv or binary results */
+
+    if (cacheDir != NULL && (cache = cacheOpen(cacheDir, "words", 3 * sizeof(int))) == NULL)
+    {
+      fprintf(stderr, "%s: could not create cache directory %s\n", basename(argv[0]), cacheDir);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    if (checkpointPath != NULL && (checkpoint = checkpointOpen(checkpointPath, CHECKPOINT_KIND, CI)) == NULL)
+    {
+      fprintf(stderr, "%s: could not open checkpoint %s\n", basename(argv[0]), checkpointPath);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    lostWorkers = (bool *)calloc(size, sizeof(bool));
+    if (workerTimeout > 0) /* a worker that fails must not abort the job */
+      MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
 
     /* Tell each worker the maximum number of bytes each chunk will have so they can initialize the buffer */
     MPI_Bcast(&maxBytesPerChunk, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    /* and how the chunks will be sent */
+    MPI_Bcast(&pipelineDepth, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    /* or if every process reads its own part of the files */
+    MPI_Bcast(&scheduling, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-    struct fileData *filesData = (struct fileData *)malloc(numFiles * sizeof(struct fileData)); /* allocating memory for numFiles of fileData structs */
+    struct fileData *filesData = (struct fileData *)malloc(W * sizeof(struct fileData));        /* allocating memory for the fileData structs of a window */
+    char **fileNames = (char **)malloc(W * sizeof(char *));                                     /* names of the files of a window */
     int nWorkers = 0;                                                                           /* number of worker processes that got chunks */
     int previousCh = 0;                                                                         /* last character read of the previous chunk */
     int nWords = 0, nWordsBV = 0, nWordsEC = 0;                                                 /* results of the processing received from the workers */
@@ -184,88 +507,188 @@ int main(int argc, char *argv[])
     unsigned char * chunk = (unsigned char *)malloc(maxBytesPerChunk * sizeof(unsigned char));  /* allocating memory for the chunk buffer */
     memset(chunk, 0, maxBytesPerChunk * sizeof(unsigned char));
 
-    for (nFile = 0; nFile < numFiles; nFile++)
+    while ((numFiles = fileListWindow(&files, fileNames, W)) > 0)
     {
-      /* initialize struct data */
-      (filesData + nFile)->fileName = fileNames[nFile];
-      (filesData + nFile)->finished = false;
-      (filesData + nFile)->nWords = 0;
-      (filesData + nFile)->nWordsBV = 0;
-      (filesData + nFile)->nWordsEC = 0;
-      (filesData + nFile)->previousCh = 32;
-      /* get the file pointer */
-      if (((filesData + nFile)->fp = fopen(fileNames[nFile], "rb")) == NULL)
+      for (nFile = 0; nFile < numFiles; nFile++)
+      {
+        /* initialize struct data */
+        (filesData + nFile)->fileName = fileNames[nFile];
+        (filesData + nFile)->finished = false;
+        (filesData + nFile)->nWords = 0;
+        (filesData + nFile)->nWordsBV = 0;
+        (filesData + nFile)->nWordsEC = 0;
+        (filesData + nFile)->previousCh = 32;
+        (filesData + nFile)->chunksRead = 0;
+        (filesData + nFile)->chunksDone = 0;
+        (filesData + nFile)->emitted = false;
+        (filesData + nFile)->hashed = false;
+        (filesData + nFile)->cached = false;
+        (filesData + nFile)->resumeOffset = 0;
+        (filesData + nFile)->restored = false;
+        if (cache != NULL)
+          lookupFile(filesData, nFile);
+        if (checkpoint != NULL && !(filesData + nFile)->cached)
+          resumeFile(filesData, nFile);
+      }
+
+      if (adaptiveChunks) /* the sizes of the files of the window are known up front */
       {
-        printf("Error: could not open file %s\n", fileNames[nFile]);
-        exit(EXIT_FAILURE);
+        struct stat st;
+        remainingBytes = 0;
+        for (nFile = 0; nFile < numFiles; nFile++)
+          if (!(filesData + nFile)->cached && !(filesData + nFile)->restored && stat(fileNames[nFile], &st) == 0)
+            remainingBytes += st.st_size - (filesData + nFile)->resumeOffset;
       }
 
-      /* while file is processing */
-      while (!((filesData + nFile)->finished))
+      if (scheduling == SCHED_SCATTER)
+        scatterStatic(rank, size, filesData, numFiles, maxBytesPerChunk);
+      else if (pipelineDepth > 0)
+        dispatchPipelined(filesData, numFiles, size, maxBytesPerChunk, inputBackend, pipelineDepth);
+
+      /* lock-step rounds, one file at a time */
+      for (nFile = 0; nFile < numFiles && pipelineDepth == 0 && scheduling == SCHED_DISPATCH; nFile++)
       {
-        /* Send a chunk of data to each worker process for processing */
-        for (nWorkers = 1; nWorkers < size; nWorkers++)
+        if ((filesData + nFile)->cached) /* already written */
+          continue;
+        openFile(filesData + nFile, inputBackend);
+
+        /* while file is processing */
+        while (!((filesData + nFile)->finished))
         {
-          if ((filesData + nFile)->finished)
+          /* Send a chunk of data to each worker process for processing */
+          for (nWorkers = 1; nWorkers < size; nWorkers++)
           {
-            fclose((filesData + nFile)->fp); /* close the file pointer */
-            break;
-          }
+            if ((filesData + nFile)->finished)
+            {
+              if (inputBackend == INPUT_READ)
+                fclose((filesData + nFile)->fp); /* close the file pointer */
+              break;
+            }
+
+            int chunkBytes = nextChunkBytes(maxBytesPerChunk, size - 1);
+
+            if (inputBackend == INPUT_MMAP)
+            {
+              /* view of the next chunk in the mapping, nothing is copied */
+              getMappedChunk(filesData + nFile, chunkBytes + 7);
+              remainingBytes -= (filesData + nFile)->chunkSize;
 
-          previousCh = (filesData + nFile)->previousCh;
-          (filesData + nFile)->chunkSize = fread(chunk, 1, maxBytesPerChunk - 7, (filesData + nFile)->fp);
+              MPI_Send(&workStatus, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);
+              MPI_Send((filesData + nFile)->chunk, (filesData + nFile)->chunkSize, MPI_UNSIGNED_CHAR, nWorkers, 0, MPI_COMM_WORLD);
+              MPI_Send(&(filesData + nFile)->chunkSize, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);
+              MPI_Send(&(filesData + nFile)->previousCh, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);
+              continue;
+            }
+
+            previousCh = (filesData + nFile)->previousCh;
+            uint64_t readStart = INSTR_NOW();
+            (filesData + nFile)->chunkSize = fread(chunk, 1, chunkBytes, (filesData + nFile)->fp);
+            INSTR_TIME(INSTR_READ_TIME, readStart);
+            INSTR_ADD(INSTR_READ_CALLS, 1);
+            INSTR_ADD(INSTR_READ_BYTES, (filesData + nFile)->chunkSize);
           
-          /* if the chunk read is smaller than the value expected it means the current file has reached the end */
-          if ((filesData + nFile)->chunkSize < (maxBytesPerChunk - 7)) 
-            (filesData + nFile)->finished = true;
-          else
-            getChunkSizeAndLastChar(chunk, filesData + nFile);
-
-          if ((filesData + nFile)->previousCh == EOF) /* checks the last character was the EOF */
-            (filesData + nFile)->finished = true;
-
-          /* send to the worker: */
-          MPI_Send(&workStatus, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD); /* a flag saying if there is work to do */
-          MPI_Send(chunk, maxBytesPerChunk, MPI_UNSIGNED_CHAR, nWorkers, 0, MPI_COMM_WORLD);/* the chunk buffer */
-          MPI_Send(&(filesData + nFile)->chunkSize, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);/* the size of the chunk */
-          MPI_Send(&previousCh, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);/* the character of the previous chunk */
-
-          memset(chunk, 0, maxBytesPerChunk * sizeof(unsigned char));
-        }
+            /* if the chunk read is smaller than the value expected it means the current file has reached the end */
+            if ((filesData + nFile)->chunkSize < chunkBytes) 
+              (filesData + nFile)->finished = true;
+            else
+              getChunkSizeAndLastChar(chunk, filesData + nFile);
+            remainingBytes -= (filesData + nFile)->chunkSize;
 
-        for (i = 1; i < nWorkers; i++)
-        {
-          /* Receive the processing results from each worker process */
-          MPI_Recv(&nWords, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-          MPI_Recv(&nWordsBV, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-          MPI_Recv(&nWordsEC, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-          /* update struct with new results */
-          (filesData + nFile)->nWords += nWords;
-          (filesData + nFile)->nWordsBV += nWordsBV;
-          (filesData + nFile)->nWordsEC += nWordsEC;
+            if ((filesData + nFile)->previousCh == EOF) /* checks the last character was the EOF */
+              (filesData + nFile)->finished = true;
+
+            /* send to the worker: */
+            MPI_Send(&workStatus, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD); /* a flag saying if there is work to do */
+            MPI_Send(chunk, (filesData + nFile)->chunkSize, MPI_UNSIGNED_CHAR, nWorkers, 0, MPI_COMM_WORLD);/* the bytes of the chunk */
+            MPI_Send(&(filesData + nFile)->chunkSize, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);/* the size of the chunk */
+            MPI_Send(&previousCh, 1, MPI_INT, nWorkers, 0, MPI_COMM_WORLD);/* the character of the previous chunk */
+
+            memset(chunk, 0, (filesData + nFile)->chunkSize * sizeof(unsigned char)); /* only the bytes of the chunk were written */
+          }
+
+          for (i = 1; i < nWorkers; i++)
+          {
+            /* Receive the processing results from each worker process */
+            MPI_Recv(&nWords, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(&nWordsBV, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(&nWordsEC, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+            /* update struct with new results */
+            (filesData + nFile)->nWords += nWords;
+            (filesData + nFile)->nWordsBV += nWordsBV;
+            (filesData + nFile)->nWordsEC += nWordsEC;
+          }
         }
+
+        if (inputBackend == INPUT_MMAP && (filesData + nFile)->map != NULL)
+          munmap((filesData + nFile)->map, (filesData + nFile)->fileSize); /* all chunks were processed */
+        emitFile(filesData, nFile); /* written while the next file is processed */
       }
+
+      /* hand the files left (empty ones of the pipelined mode) to the sink, then forget the files of the window */
+      for (nFile = 0; nFile < numFiles; nFile++)
+      {
+        emitFile(filesData, nFile);
+        free(fileNames[nFile]);
+      }
+      firstFile += numFiles;
     }
+    fileListClose(&files);
 
     /* no more work to be done */
     workStatus = ALL_FILES_PROCESSED;
     /* inform workers that all files are process and they can exit */
-    for (i = 1; i < size; i++)
-      MPI_Send(&workStatus, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+    if (scheduling == SCHED_SCATTER)
+      scatterStatic(rank, size, NULL, 0, maxBytesPerChunk); /* an empty window */
+    else if (pipelineDepth > 0)
+    {
+      int header[MSG_HEADER] = {ALL_FILES_PROCESSED}; /* chunk size and previous character are 0 */
+      for (i = 1; i < size; i++)
+        MPI_Send(header, sizeof(header), MPI_UNSIGNED_CHAR, i, 0, MPI_COMM_WORLD); /* the error of a lost worker is ignored */
+    }
+    else
+      for (i = 1; i < size; i++)
+        MPI_Send(&workStatus, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+
+    if (cache != NULL)
+      cacheClose(cache); /* the counts of the new files are kept for the next runs */
+    if (checkpoint != NULL)
+      checkpointClose(checkpoint, true); /* every file is done, there is nothing to resume */
+    free(lostWorkers);
+    sinkClose(sink); /* every result was written */
 
     /* timer ends */
     clock_gettime(CLOCK_MONOTONIC_RAW, &finish); /* end of measurement */
 
-    /* print the results of the text processing */
-    printResults(filesData, numFiles);
-
     /* calculate the elapsed time */
-    printf("\nElapsed time = %.6f s\n", (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+    fprintf(info, "\nElapsed time = %.6f s\n", (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+
+    if (nLost > 0) /* every result was written, but the lost workers would never finalize */
+    {
+      fflush(info);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_SUCCESS);
+    }
   }
   else
   {
     MPI_Bcast(&maxBytesPerChunk, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&pipelineDepth, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&scheduling, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (scheduling == SCHED_SCATTER)
+    {
+      while (scatterStatic(rank, size, NULL, 0, maxBytesPerChunk) > 0)
+        ; /* a window at a time */
+      MPI_Finalize();
+      exit(EXIT_SUCCESS);
+    }
+
+    if (pipelineDepth > 0)
+    {
+      workPipelined(maxBytesPerChunk);
+      MPI_Finalize();
+      exit(EXIT_SUCCESS);
+    }
 
     /* allocating memory for the file data structure */
     struct fileData *data = (struct fileData *)malloc(sizeof(struct fileData));
@@ -286,7 +709,10 @@ int main(int argc, char *argv[])
       MPI_Recv(&data->previousCh, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
       /* perform text processing on the chunk */
+      uint64_t computeStart = INSTR_NOW();
       processChunk(data);
+      INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+      INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
       /* Send the processing results to the dispatcher */
       MPI_Send(&data->nWords, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
       MPI_Send(&data->nWordsBV, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
@@ -302,6 +728,566 @@ int main(int argc, char *argv[])
   exit(EXIT_SUCCESS);
 }
 
+/**
+ *  \brief Opens a file with the given input backend.
+ *
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param data fileData structure of the file
+ *  \param inputBackend how the file is read
+ */
+static void openFile(struct fileData *data, int inputBackend)
+{
+  if (inputBackend == INPUT_MMAP)
+  {
+    /* map the file, chunks are sent straight from the mapping */
+    int fd;
+    struct stat st;
+    if ((fd = open(data->fileName, O_RDONLY)) == -1 || fstat(fd, &st) == -1)
+    {
+      printf("Error: could not open file %s\n", data->fileName);
+      exit(EXIT_FAILURE);
+    }
+    data->fp = NULL;
+    data->map = NULL;
+    data->fileSize = st.st_size;
+    data->offset = 0;
+    data->finished = (st.st_size == 0); /* an empty file can not be mapped */
+    if (st.st_size > 0 &&
+        (data->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+      printf("Error: could not map file %s\n", data->fileName);
+      exit(EXIT_FAILURE);
+    }
+    if (st.st_size > 0)
+      madvise(data->map, st.st_size, MADV_SEQUENTIAL);
+    close(fd); /* the mapping stays valid */
+    data->offset = data->resumeOffset; /* the chunks before are in the checkpoint */
+  }
+  /* get the file pointer */
+  else if ((data->fp = fopen(data->fileName, "rb")) == NULL)
+  {
+    printf("Error: could not open file %s\n", data->fileName);
+    exit(EXIT_FAILURE);
+  }
+  else if (data->resumeOffset > 0)
+    fseeko(data->fp, data->resumeOffset, SEEK_SET); /* the chunks before are in the checkpoint */
+}
+
+/**
+ *  \brief Closes a file opened with the given input backend.
+ *
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param data fileData structure of the file
+ *  \param inputBackend how the file is read
+ */
+static void closeFile(struct fileData *data, int inputBackend)
+{
+  if (inputBackend == INPUT_MMAP)
+  {
+    if (data->map != NULL)
+      munmap(data->map, data->fileSize);
+  }
+  else
+    fclose(data->fp);
+}
+
+/**
+ *  \brief Reads the next chunk of the files into a chunk message.
+ *
+ *  The message starts with a header of MSG_HEADER ints (status, chunk size and previous
+ *  character) followed by the bytes of the chunk.
+ *  Files are opened when their first chunk is read and closed after their last one.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files to process
+ *  \param numFiles number of files to process
+ *  \param nFile index of the file being read, advanced when it ends
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *  \param nWorkers number of worker processes
+ *  \param inputBackend how the files are read
+ *  \param message buffer that will store the message
+ *  \param position position of the chunk in its file
+ *
+ *  \return index of the file of the chunk, or -1 if all files have been read.
+ */
+static int readChunkMessage(struct fileData *filesData, int numFiles, int *nFile, int maxBytesPerChunk, int nWorkers, int inputBackend, unsigned char *message,
+                            struct chunkPosition *position)
+{
+  int header[MSG_HEADER];                          /* status, chunk size and previous character */
+  unsigned char *chunk = message + sizeof(header); /* the bytes of the chunk follow the header */
+  struct fileData *data;
+
+  /* move on to the next file with chunks left, the cached and restored files are never opened */
+  while (*nFile < numFiles && (filesData + *nFile)->finished)
+  {
+    if (!(filesData + *nFile)->cached && !(filesData + *nFile)->restored)
+      closeFile(filesData + *nFile, inputBackend);
+    if (++(*nFile) < numFiles && !(filesData + *nFile)->cached && !(filesData + *nFile)->restored)
+      openFile(filesData + *nFile, inputBackend);
+  }
+  if (*nFile == numFiles)
+    return -1;
+
+  data = filesData + *nFile;
+  int chunkBytes = nextChunkBytes(maxBytesPerChunk, nWorkers);
+  if (inputBackend == INPUT_MMAP)
+  {
+    position->start = data->offset;
+    getMappedChunk(data, chunkBytes + 7);
+    memcpy(chunk, data->chunk, data->chunkSize);
+    header[2] = data->previousCh;
+    position->lastCh = getCharBefore(data->map, data->offset, (data->offset - 4 < position->start) ? position->start : data->offset - 4);
+  }
+  else
+  {
+    position->start = ftello(data->fp);
+    header[2] = data->previousCh;
+    uint64_t readStart = INSTR_NOW();
+    data->chunkSize = fread(chunk, 1, chunkBytes, data->fp);
+    INSTR_TIME(INSTR_READ_TIME, readStart);
+    INSTR_ADD(INSTR_READ_CALLS, 1);
+    INSTR_ADD(INSTR_READ_BYTES, data->chunkSize);
+
+    /* if the chunk read is smaller than the value expected it means the current file has reached the end */
+    if (data->chunkSize < chunkBytes)
+      data->finished = true;
+    else
+    {
+      /* the buffers are reused, clear the tail the chunk is completed on as the lock-step dispatcher does */
+      memset(chunk + data->chunkSize, 0, 7);
+      getChunkSizeAndLastChar(chunk, data);
+    }
+
+    if (data->previousCh == EOF) /* checks the last character was the EOF */
+      data->finished = true;
+    position->lastCh = data->previousCh;
+  }
+  position->size = data->chunkSize;
+  position->last = data->finished;
+  remainingBytes -= data->chunkSize;
+  data->chunksRead++;
+  header[0] = FILES_IN_PROCESSING;
+  header[1] = data->chunkSize;
+  memcpy(message, header, sizeof(header));
+
+  return *nFile;
+}
+
+/**
+ *  \brief Number of bytes of the next chunk, before alignment.
+ *
+ *  With adaptive chunk sizing, chunks shrink as the bytes left run low (guided self-scheduling).
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *  \param nWorkers number of worker processes
+ *
+ *  \return {maxBytesPerChunk-7}, or a share of the bytes left with adaptive chunk sizing
+ */
+static int nextChunkBytes(int maxBytesPerChunk, int nWorkers)
+{
+  if (adaptiveChunks)
+    return guidedChunkSize(remainingBytes, nWorkers, maxBytesPerChunk);
+  return maxBytesPerChunk - 7;
+}
+
+/**
+ *  \brief Starts sending a chunk message to a worker and receiving its processing results.
+ *
+ *  Only the header and the bytes of the chunk are sent.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param worker rank of the worker process
+ *  \param message chunk message
+ *  \param sendRequest request of the message sent
+ *  \param results buffer that will store the processing results
+ *  \param recvRequest request of the results received
+ */
+static void sendChunkMessage(int worker, unsigned char *message, MPI_Request *sendRequest, int *results, MPI_Request *recvRequest)
+{
+  int header[MSG_HEADER]; /* status, chunk size and previous character */
+
+  memcpy(header, message, sizeof(header));
+  MPI_Isend(message, sizeof(header) + header[1], MPI_UNSIGNED_CHAR, worker, 0, MPI_COMM_WORLD, sendRequest);
+  MPI_Irecv(results, 3, MPI_INT, worker, 0, MPI_COMM_WORLD, recvRequest);
+}
+
+/**
+ *  \brief Waits for the results of a slot, or for a worker to be lost.
+ *
+ *  Without a worker timeout it blocks until results arrive. With one, the receives are polled,
+ *  and a worker with chunks in flight that did not answer for the timeout is lost, as is the
+ *  worker of a receive that completes with an error.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param nSlots number of slots
+ *  \param recvRequests request of the results of each slot
+ *  \param depth number of chunks in flight per worker
+ *  \param size number of processes
+ *  \param pending number of chunks in flight of each worker
+ *  \param lastHeard time each worker last answered, or was sent a chunk while it had none
+ *
+ *  \return slot whose results arrived, or minus the rank of the worker lost
+ */
+static int waitSlot(int nSlots, MPI_Request *recvRequests, int depth, int size, int *pending, double *lastHeard)
+{
+  int slot = MPI_UNDEFINED, done = 1, rc;
+  int worker;
+
+  while (true)
+  {
+    if (workerTimeout > 0)
+      rc = MPI_Testany(nSlots, recvRequests, &slot, &done, MPI_STATUS_IGNORE);
+    else
+      rc = MPI_Waitany(nSlots, recvRequests, &slot, MPI_STATUS_IGNORE);
+    if (rc != MPI_SUCCESS && slot != MPI_UNDEFINED)
+      return -(slot / depth + 1);
+    if (done && slot != MPI_UNDEFINED)
+      return slot;
+
+    double now = MPI_Wtime();
+    for (worker = 1; worker < size; worker++)
+      if (pending[worker] > 0 && now - lastHeard[worker] > workerTimeout)
+        return -worker;
+  }
+}
+
+/**
+ *  \brief Gives up on a worker: its chunks in flight will be sent to the other workers.
+ *
+ *  The receives of its results are cancelled, so results that arrive late are never counted.
+ *  The job is aborted when no worker is left, after the checkpoint is written.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param worker rank of the worker
+ *  \param size number of processes
+ *  \param depth number of chunks in flight per worker
+ *  \param recvRequests request of the results of each slot
+ *  \param pending number of chunks in flight of each worker
+ *  \param orphans slots whose chunks must be sent again
+ *  \param nOrphans number of those slots
+ *  \param inFlight number of chunks sent whose results did not arrive yet
+ */
+static void loseWorker(int worker, int size, int depth, MPI_Request *recvRequests, int *pending, int *orphans, int *nOrphans, int *inFlight)
+{
+  int slot;
+
+  lostWorkers[worker] = true;
+  fprintf(stderr, "worker %d does not answer, its chunks are sent to the other workers\n", worker);
+  if (++nLost == size - 1)
+  {
+    fprintf(stderr, "every worker was lost\n");
+    if (checkpoint != NULL)
+      checkpointFlush(checkpoint);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  for (slot = (worker - 1) * depth; slot < worker * depth; slot++)
+    if (recvRequests[slot] != MPI_REQUEST_NULL)
+    {
+      MPI_Cancel(&recvRequests[slot]);
+      MPI_Wait(&recvRequests[slot], MPI_STATUS_IGNORE);
+      orphans[(*nOrphans)++] = slot;
+    }
+  *inFlight -= pending[worker];
+  pending[worker] = 0;
+}
+
+/**
+ *  \brief Adds the chunks done that continue the part of a file done from its start to that part.
+ *
+ *  Chunks of a file are done out of order, so a chunk is kept until every chunk before it is
+ *  done. When the part grows, its counts and where it ends replace the record of the file in the
+ *  checkpoint.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
+ *  \param prefixEnds end of the part done of each file of the window
+ *  \param prefixes counts of the part done of each file of the window
+ *  \param doneChunks chunks done that do not continue the part of their file yet
+ *  \param nDone number of those chunks
+ */
+static void advancePrefix(struct fileData *filesData, int nFile, off_t *prefixEnds, struct prefixCounts *prefixes, struct doneChunk *doneChunks, int *nDone)
+{
+  bool advanced = false;
+  int c = 0;
+
+  while (c < *nDone)
+    if (doneChunks[c].nFile == nFile && doneChunks[c].position.start == prefixEnds[nFile])
+    {
+      prefixes[nFile].nWords += doneChunks[c].counts[0];
+      prefixes[nFile].nWordsBV += doneChunks[c].counts[1];
+      prefixes[nFile].nWordsEC += doneChunks[c].counts[2];
+      prefixes[nFile].lastCh = doneChunks[c].position.lastCh;
+      prefixes[nFile].last = doneChunks[c].position.last;
+      prefixEnds[nFile] += doneChunks[c].position.size;
+      doneChunks[c] = doneChunks[--(*nDone)];
+      advanced = true;
+      c = 0; /* the chunk that follows may have been skipped */
+    }
+    else
+      c++;
+
+  if (advanced)
+    checkpointSet(checkpoint, (filesData + nFile)->fileName, prefixEnds[nFile], prefixes + nFile, sizeof(struct prefixCounts));
+}
+
+/**
+ *  \brief Sends the chunks of all files keeping several chunks in flight per worker.
+ *
+ *  Every worker has {depth} slots, each with a message buffer and the requests of the chunk
+ *  sent and of its results. When the results of a slot arrive, the slot is refilled with the
+ *  chunk read ahead and the next chunk is read while the workers compute.
+ *  Results of a worker arrive in the order its chunks were sent, so each one matches the
+ *  receive posted with its chunk.
+ *  The chunks of a lost worker are copied to the free slots of the other workers before any
+ *  new chunk, and its slots are not used again. With a checkpoint the counts of every chunk
+ *  are added to the part of its file done from its start, and the checkpoint is written when
+ *  its interval has passed.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window, updated with the processing results
+ *  \param numFiles number of files of the window
+ *  \param size number of processes
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *  \param inputBackend how the files are read
+ *  \param depth number of chunks in flight per worker
+ */
+static void dispatchPipelined(struct fileData *filesData, int numFiles, int size, int maxBytesPerChunk, int inputBackend, int depth)
+{
+  int nSlots = (size - 1) * depth;                                /* chunks in flight at most */
+  int messageSize = MSG_HEADER * sizeof(int) + maxBytesPerChunk; /* size of the largest chunk message */
+  unsigned char **messages = (unsigned char **)malloc(nSlots * sizeof(unsigned char *));
+  unsigned char *readAhead = (unsigned char *)malloc(messageSize); /* message of the next chunk */
+  unsigned char *message;                                         /* used to swap buffers */
+  MPI_Request *sendRequests = (MPI_Request *)malloc(nSlots * sizeof(MPI_Request));
+  MPI_Request *recvRequests = (MPI_Request *)malloc(nSlots * sizeof(MPI_Request));
+  int(*results)[3] = malloc(nSlots * sizeof(*results)); /* processing results of each slot */
+  int *slotFile = (int *)malloc(nSlots * sizeof(int));  /* file of the chunk of each slot */
+  struct chunkPosition *positions = (struct chunkPosition *)malloc(nSlots * sizeof(struct chunkPosition)); /* position of the chunk of each slot */
+  struct chunkPosition readAheadPosition;               /* position of the chunk read ahead */
+  int *orphans = (int *)malloc(nSlots * sizeof(int));   /* slots of lost workers whose chunks must be sent again */
+  int nOrphans = 0;
+  int *pending = (int *)calloc(size, sizeof(int));      /* number of chunks in flight of each worker */
+  double *lastHeard = (double *)malloc(size * sizeof(double)); /* time each worker last answered, or was sent a chunk while it had none */
+  off_t *prefixEnds = NULL;             /* end of the part of each file done from its start (with a checkpoint) */
+  struct prefixCounts *prefixes = NULL; /* counts of that part */
+  struct doneChunk *doneChunks = NULL;  /* chunks done after a chunk of their file still in flight */
+  int nDone = 0, doneCapacity = 0;
+  int nFile = 0;    /* file being read */
+  int nextFile;     /* file of the chunk read ahead */
+  int inFlight = 0; /* number of chunks sent whose results did not arrive yet */
+  int slot, worker, d;
+
+  for (slot = 0; slot < nSlots; slot++)
+  {
+    messages[slot] = (unsigned char *)malloc(messageSize);
+    sendRequests[slot] = MPI_REQUEST_NULL;
+    recvRequests[slot] = MPI_REQUEST_NULL;
+  }
+  if (checkpoint != NULL)
+  {
+    prefixEnds = (off_t *)malloc(numFiles * sizeof(off_t));
+    prefixes = (struct prefixCounts *)malloc(numFiles * sizeof(struct prefixCounts));
+    for (nFile = 0; nFile < numFiles; nFile++) /* the part restored from the checkpoint */
+    {
+      struct fileData *data = filesData + nFile;
+      struct prefixCounts restored = {data->nWords, data->nWordsBV, data->nWordsEC, data->previousCh, data->restored};
+      prefixEnds[nFile] = data->resumeOffset;
+      prefixes[nFile] = restored;
+    }
+    nFile = 0;
+  }
+
+  if (numFiles > 0 && !filesData->cached && !filesData->restored)
+    openFile(filesData, inputBackend);
+  nextFile = readChunkMessage(filesData, numFiles, &nFile, maxBytesPerChunk, size - 1 - nLost, inputBackend, readAhead, &readAheadPosition);
+
+  /* give each worker up to depth chunks, a round at a time so the work is spread evenly */
+  for (d = 0; d < depth && nextFile != -1; d++)
+    for (worker = 1; worker < size && nextFile != -1; worker++)
+    {
+      if (lostWorkers[worker])
+        continue;
+      slot = (worker - 1) * depth + d;
+
+      /* the slot was never used, so its buffer is free */
+      message = messages[slot];
+      messages[slot] = readAhead;
+      readAhead = message;
+      slotFile[slot] = nextFile;
+      positions[slot] = readAheadPosition;
+      sendChunkMessage(worker, messages[slot], &sendRequests[slot], results[slot], &recvRequests[slot]);
+      if (pending[worker]++ == 0)
+        lastHeard[worker] = MPI_Wtime();
+      inFlight++;
+
+      nextFile = readChunkMessage(filesData, numFiles, &nFile, maxBytesPerChunk, size - 1 - nLost, inputBackend, readAhead, &readAheadPosition);
+    }
+
+  while (inFlight > 0 || nOrphans > 0)
+  {
+    int first = 0, last = nSlots; /* slots to refill: every free one after a worker was lost */
+
+    if (inFlight > 0 && (slot = waitSlot(nSlots, recvRequests, depth, size, pending, lastHeard)) < 0)
+      loseWorker(-slot, size, depth, recvRequests, pending, orphans, &nOrphans, &inFlight);
+    else if (inFlight > 0)
+    {
+      worker = slot / depth + 1;
+      pending[worker]--;
+      lastHeard[worker] = MPI_Wtime();
+      inFlight--;
+
+      /* update struct with new results */
+      (filesData + slotFile[slot])->nWords += results[slot][0];
+      (filesData + slotFile[slot])->nWordsBV += results[slot][1];
+      (filesData + slotFile[slot])->nWordsEC += results[slot][2];
+
+      /* the last chunk of a file that was read completely, its results can be written */
+      struct fileData *data = filesData + slotFile[slot];
+      if (checkpoint != NULL)
+      {
+        if (nDone == doneCapacity)
+        {
+          doneCapacity = (doneCapacity == 0) ? nSlots : 2 * doneCapacity;
+          doneChunks = (struct doneChunk *)realloc(doneChunks, doneCapacity * sizeof(struct doneChunk));
+        }
+        struct doneChunk chunk = {slotFile[slot], positions[slot], {results[slot][0], results[slot][1], results[slot][2]}};
+        doneChunks[nDone++] = chunk;
+        advancePrefix(filesData, slotFile[slot], prefixEnds, prefixes, doneChunks, &nDone);
+        if (checkpointDue(checkpoint))
+          checkpointFlush(checkpoint);
+      }
+      if (++data->chunksDone == data->chunksRead && data->finished)
+        emitFile(filesData, slotFile[slot]);
+      first = slot; /* the only free slot */
+      last = slot + 1;
+    }
+
+    for (slot = first; slot < last && (nOrphans > 0 || nextFile != -1); slot++)
+    {
+      worker = slot / depth + 1;
+      if (lostWorkers[worker] || recvRequests[slot] != MPI_REQUEST_NULL)
+        continue;
+
+      /* the worker of the slot finished its chunk, so the buffer can be reused */
+      MPI_Wait(&sendRequests[slot], MPI_STATUS_IGNORE);
+      bool resend = (nOrphans > 0); /* a chunk of a lost worker, sent before the new ones */
+      if (resend)
+      {
+        int orphan = orphans[--nOrphans];
+        int header[MSG_HEADER];
+
+        /* copied, the buffer of the lost slot may still be read by its send */
+        memcpy(header, messages[orphan], sizeof(header));
+        memcpy(messages[slot], messages[orphan], sizeof(header) + header[1]);
+        slotFile[slot] = slotFile[orphan];
+        positions[slot] = positions[orphan];
+      }
+      else
+      {
+        message = messages[slot];
+        messages[slot] = readAhead;
+        readAhead = message;
+        slotFile[slot] = nextFile;
+        positions[slot] = readAheadPosition;
+      }
+      sendChunkMessage(worker, messages[slot], &sendRequests[slot], results[slot], &recvRequests[slot]);
+      if (pending[worker]++ == 0)
+        lastHeard[worker] = MPI_Wtime();
+      inFlight++;
+
+      /* read the next chunk while the workers compute */
+      if (!resend)
+        nextFile = readChunkMessage(filesData, numFiles, &nFile, maxBytesPerChunk, size - 1 - nLost, inputBackend, readAhead, &readAheadPosition);
+    }
+  }
+
+  for (slot = 0; slot < nSlots; slot++)
+  {
+    if (lostWorkers[slot / depth + 1] && sendRequests[slot] != MPI_REQUEST_NULL)
+      continue; /* the send to a lost worker may never complete, its buffer is left allocated */
+    MPI_Wait(&sendRequests[slot], MPI_STATUS_IGNORE);
+    free(messages[slot]);
+  }
+  free(messages);
+  free(readAhead);
+  free(sendRequests);
+  free(recvRequests);
+  free(results);
+  free(slotFile);
+  free(positions);
+  free(orphans);
+  free(pending);
+  free(lastHeard);
+  free(prefixEnds);
+  free(prefixes);
+  free(doneChunks);
+}
+
+/**
+ *  \brief Processes chunk messages until the dispatcher says there is no more work to be done.
+ *
+ *  The next message is received while the current chunk is processed.
+ *  Operation carried out by the worker processes in the pipelined mode.
+ *
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ */
+static void workPipelined(int maxBytesPerChunk)
+{
+  int header[MSG_HEADER];                                         /* status, chunk size and previous character */
+  int messageSize = MSG_HEADER * sizeof(int) + maxBytesPerChunk; /* size of the largest chunk message */
+  unsigned char *messages[2];                                     /* chunk being processed and the next one */
+  int current = 0;                                                /* message being processed */
+  int results[3];                                                 /* processing results sent to the dispatcher */
+  MPI_Request recvRequest, sendRequest = MPI_REQUEST_NULL;
+  struct fileData data;
+
+  messages[0] = (unsigned char *)malloc(messageSize);
+  messages[1] = (unsigned char *)malloc(messageSize);
+  MPI_Irecv(messages[current], messageSize, MPI_UNSIGNED_CHAR, 0, 0, MPI_COMM_WORLD, &recvRequest);
+
+  while (true)
+  {
+    MPI_Wait(&recvRequest, MPI_STATUS_IGNORE);
+    memcpy(header, messages[current], sizeof(header));
+    if (header[0] == ALL_FILES_PROCESSED)
+      break;
+
+    /* receive the next chunk while this one is processed */
+    MPI_Irecv(messages[1 - current], messageSize, MPI_UNSIGNED_CHAR, 0, 0, MPI_COMM_WORLD, &recvRequest);
+
+    data.chunk = messages[current] + sizeof(header);
+    data.chunkSize = header[1];
+    data.previousCh = header[2];
+    data.nWords = 0;
+    data.nWordsBV = 0;
+    data.nWordsEC = 0;
+
+    /* perform text processing on the chunk */
+    uint64_t computeStart = INSTR_NOW();
+    processChunk(&data);
+    INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+    INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
+
+    /* Send the processing results to the dispatcher, once the previous ones left */
+    MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+    results[0] = data.nWords;
+    results[1] = data.nWordsBV;
+    results[2] = data.nWordsEC;
+    MPI_Isend(results, 3, MPI_INT, 0, 0, MPI_COMM_WORLD, &sendRequest);
+
+    current = 1 - current;
+  }
+  MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+
+  free(messages[0]);
+  free(messages[1]);
+}
+
 /**
  *  \brief Print command usage.
  *
@@ -311,26 +1297,248 @@ int main(int argc, char *argv[])
  */
 static void printUsage(char *cmdName)
 {
-  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / maximum number of bytes per chunk]\n"
+  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / manifest / files per window / maximum number of bytes per chunk / input backend / chunks in flight / scheduling / adaptive chunks / output format / output file / cache directory / worker timeout / checkpoint]\n"
                   "  OPTIONS:\n"
                   "  -h      --- print this help\n"
                   "  -f      --- filename to process\n"
-                  "  -m      --- maximum number of bytes per chunk\n",
-          cmdName);
+                  "  -F      --- manifest with a filename per line, - for the standard input\n"
+                  "  -w      --- number of files processed at a time (default %d)\n"
+                  "  -m      --- maximum number of bytes per chunk, or read at a time by each process with scatter scheduling\n"
+                  "  -i      --- input backend: read (default) or mmap\n"
+                  "  -p      --- number of chunks in flight per worker, 0 (default) sends them in lock-step rounds\n"
+                  "  -s      --- scheduling: dispatch (default) or scatter, every process counts its own part of each file\n"
+                  "  -a      --- adaptive chunk sizing: chunks shrink as the files run out, -m is the largest (default %d)\n"
+                  "  -o      --- output format: text (default), csv or binary\n"
+                  "  -O      --- file of the results (default the standard output)\n"
+                  "  -C      --- directory of the cache of the results, files already processed are not processed again\n"
+                  "  -T      --- seconds a worker may not answer before its chunks go to the others, 0 (default) waits forever (with -p)\n"
+                  "  -R      --- file of the checkpoint, a job stopped resumes from it when run again (with -p)\n",
+          cmdName, DW, DA);
 }
 
 /**
- *  \brief Print results of the text processing.
+ *  \brief Hands the processing results of a file of the window to the result sink, once.
  *
  *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
  */
-void printResults(struct fileData *filesData, int numFiles)
+static void emitFile(struct fileData *filesData, int nFile)
 {
-  for (int i = 0; i < numFiles; i++)
+  struct fileData *data = filesData + nFile;
+
+  if (data->emitted)
+    return;
+  data->emitted = true;
+  if (cache != NULL && data->hashed && !data->cached)
   {
-    printf("\nFile name: %s\n", (filesData + i)->fileName);
-    printf("Total number of words = %d\n", (filesData + i)->nWords);
-    printf("N. of words beginning with a vowel = %d\n", (filesData + i)->nWordsBV);
-    printf("N. of words ending with a consonant = %d\n", (filesData + i)->nWordsEC);
+    int counts[3] = {data->nWords, data->nWordsBV, data->nWordsEC};
+    cachePut(cache, data->hash, counts);
   }
-}
\ No newline at end of file
+  sinkWords(sink, firstFile + nFile, data->fileName, data->nWords, data->nWordsBV, data->nWordsEC);
+}
+
+/**
+ *  \brief Looks up the processing results of a file of the window in the cache.
+ *
+ *  On a hit the file is handed to the result sink and marked as cached and finished, so it is
+ *  never opened nor sent.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
+ */
+static void lookupFile(struct fileData *filesData, int nFile)
+{
+  struct fileData *data = filesData + nFile;
+  int counts[3];
+
+  if (cacheHashFile(data->fileName, &data->hash) != 0) /* the error is reported when the file is opened */
+    return;
+  data->hashed = true;
+  if (!cacheGet(cache, data->hash, counts))
+    return;
+  data->nWords = counts[0];
+  data->nWordsBV = counts[1];
+  data->nWordsEC = counts[2];
+  data->cached = true;
+  data->finished = true;
+  emitFile(filesData, nFile);
+}
+
+/**
+ *  \brief Restores the counts of the part of a file of the window found in the checkpoint.
+ *
+ *  The counts of the chunks done from the start of the file are taken from its record, and the
+ *  file will be read from where they end, with their last character as the previous character.
+ *  A file whose last chunk was done is handed to the result sink and marked as restored and
+ *  finished, so it is never opened nor sent.
+ *  Operation carried out by the dispatcher process.
+ *
+ *  \param filesData files of the window
+ *  \param nFile index of the file in the window
+ */
+static void resumeFile(struct fileData *filesData, int nFile)
+{
+  struct fileData *data = filesData + nFile;
+  const struct checkpointRecord *record = checkpointFind(checkpoint, data->fileName);
+  struct prefixCounts counts;
+
+  if (record == NULL || record->size != sizeof(counts))
+    return; /* nothing done, or a record of another program */
+  memcpy(&counts, record->values, sizeof(counts));
+  data->nWords = counts.nWords;
+  data->nWordsBV = counts.nWordsBV;
+  data->nWordsEC = counts.nWordsEC;
+  data->resumeOffset = record->position;
+  data->previousCh = counts.lastCh;
+  if (counts.last)
+  {
+    data->restored = true;
+    data->finished = true;
+    emitFile(filesData, nFile);
+  }
+}
+
+/**
+ *  \brief Moves a boundary between the ranges of two processes back to the start of a character.
+ *
+ *  The bytes around the boundary are read, so both processes find the same position.
+ *
+ *  \param fh file
+ *  \param fileSize size of the file
+ *  \param boundary nominal boundary
+ *  \param buffer buffer of at least 9 bytes
+ *  \param previousCh filled with the character before the position found
+ *
+ *  \return position of the start of the character
+ */
+static MPI_Offset alignBoundary(MPI_File fh, MPI_Offset fileSize, MPI_Offset boundary, unsigned char *buffer, int *previousCh)
+{
+  /* the bytes before hold the previous character and the byte after tells where the character starts */
+  MPI_Offset low = (boundary < 8) ? 0 : boundary - 8;
+  MPI_Offset high = (boundary < fileSize) ? boundary + 1 : fileSize;
+  MPI_Offset aligned = boundary;
+
+  MPI_File_read_at(fh, low, buffer, high - low, MPI_UNSIGNED_CHAR, MPI_STATUS_IGNORE);
+  if (boundary < fileSize)
+    aligned = low + findCharStart(buffer, boundary - low, ((boundary < 3) ? 0 : boundary - 3) - low);
+  *previousCh = getCharBefore(buffer, aligned - low, ((aligned < 4) ? 0 : aligned - 4) - low);
+  return aligned;
+}
+
+/**
+ *  \brief Counts the words of a window of files with a static partition of their bytes.
+ *
+ *  Every process, the dispatcher included, counts its own contiguous range of bytes of each file.
+ *  Both ends of the range are moved back to the start of a character, as the neighbour processes
+ *  do, so every character is counted once. The range is read with MPI-IO a window of at most
+ *  {windowBytes} bytes at a time, each window ending at the start of a character and counted from
+ *  the state the window before left, so the memory of a process does not grow with the size of the
+ *  files and the counts do not depend on the size of the windows. The counts of all the files are added up on the
+ *  dispatcher with a single reduction of a structure per file, and the files are handed to the
+ *  result sink.
+ *  The number and names of the files are broadcasted by the dispatcher, an empty window stops the
+ *  workers. The files found in the cache are not read by any process.
+ *  Operation carried out by every process.
+ *
+ *  \param rank rank of the process
+ *  \param size number of processes
+ *  \param filesData files of the window, updated with the counts (dispatcher only)
+ *  \param numFiles number of files of the window (dispatcher only)
+ *  \param windowBytes maximum number of bytes read at a time
+ *
+ *  \return number of files of the window
+ */
+static int scatterStatic(int rank, int size, struct fileData *filesData, int numFiles, int windowBytes)
+{
+  MPI_Bcast(&numFiles, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (numFiles == 0)
+    return 0;
+
+  struct wordCounts *counts = (struct wordCounts *)calloc(numFiles, sizeof(struct wordCounts)); /* counts of the range of each file */
+  int *skipped = (int *)malloc(numFiles * sizeof(int));                                          /* files not read */
+  unsigned char *buffer = (unsigned char *)malloc(windowBytes + 1);                               /* bytes of a window, and the byte after */
+  int nFile;
+
+  for (nFile = 0; nFile < numFiles && rank == 0; nFile++)
+    skipped[nFile] = (filesData + nFile)->cached || (filesData + nFile)->restored;
+  MPI_Bcast(skipped, numFiles, MPI_INT, 0, MPI_COMM_WORLD);
+
+  for (nFile = 0; nFile < numFiles; nFile++)
+  {
+    char fileName[4096]; /* name of the current file */
+    MPI_File fh;
+    MPI_Offset fileSize;
+
+    if (skipped[nFile])
+      continue;
+    if (rank == 0)
+      strncpy(fileName, (filesData + nFile)->fileName, sizeof(fileName) - 1);
+    fileName[sizeof(fileName) - 1] = '\0';
+    MPI_Bcast(fileName, sizeof(fileName), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    if (MPI_File_open(MPI_COMM_WORLD, fileName, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    {
+      printf("Error: could not open file %s\n", fileName);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    MPI_File_get_size(fh, &fileSize);
+
+    /* the range of the process, from the start of a character to the start of another one */
+    int previousCh, ignored;
+    struct wordState state; /* state of the counting at the end of the last window */
+    MPI_Offset start = alignBoundary(fh, fileSize, fileSize * rank / size, buffer, &previousCh);
+    MPI_Offset end = alignBoundary(fh, fileSize, fileSize * (rank + 1) / size, buffer, &ignored);
+    startWordState(previousCh, &state);
+
+    /* count the range a window at a time */
+    while (start < end)
+    {
+      MPI_Offset nBytes = end - start;
+      bool more = (nBytes > windowBytes); /* the range goes on after the window */
+      if (more)
+        nBytes = windowBytes + 1; /* with the byte after, to end the window at the start of a character */
+
+      uint64_t readStart = INSTR_NOW();
+      MPI_File_read_at(fh, start, buffer, nBytes, MPI_UNSIGNED_CHAR, MPI_STATUS_IGNORE);
+      INSTR_TIME(INSTR_READ_TIME, readStart);
+      INSTR_ADD(INSTR_READ_CALLS, 1);
+      INSTR_ADD(INSTR_READ_BYTES, nBytes);
+
+      struct fileData data;
+      data.chunk = buffer;
+      data.chunkSize = more ? findCharStart(buffer, windowBytes, 1) : nBytes;
+
+      /* perform text processing on the window, from where the window before left it */
+      uint64_t computeStart = INSTR_NOW();
+      processChunkFrom(&data, &state);
+      INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+      INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
+      counts[nFile].nWords += data.nWords;
+      counts[nFile].nWordsBV += data.nWordsBV;
+      counts[nFile].nWordsEC += data.nWordsEC;
+      start += data.chunkSize;
+    }
+    MPI_File_close(&fh);
+  }
+
+  /* the counts of every file, added up on the dispatcher at once */
+  MPI_Reduce((rank == 0) ? MPI_IN_PLACE : counts, counts, numFiles * 3, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  for (nFile = 0; nFile < numFiles && rank == 0; nFile++)
+  {
+    if (skipped[nFile])
+      continue;
+    (filesData + nFile)->nWords = counts[nFile].nWords;
+    (filesData + nFile)->nWordsBV = counts[nFile].nWordsBV;
+    (filesData + nFile)->nWordsEC = counts[nFile].nWordsEC;
+    emitFile(filesData, nFile);
+  }
+
+  free(buffer);
+  free(skipped);
+  free(counts);
+  return numFiles;
+}
@@ -13,19 +13,52 @@
 
 /* Generic parameters */
 
-/** \brief maximum number of files */
-#define M 10
-
 /** \brief minimum number of bytes each chunk must have */
 #define MIN 11
 
 /** \brief default maximum number of bytes each chunk has */
 #define DB 4060
 
+/** \brief default maximum number of bytes each chunk has in the adaptive chunk sizing mode */
+#define DA 1048576
+
+/** \brief default number of bytes each process reads at a time with scatter scheduling */
+#define DS 4194304
+
+/** \brief minimum number of bytes of a chunk in the adaptive chunk sizing mode, before alignment */
+#define AMIN 4096
+
+/** \brief in the adaptive chunk sizing mode, a chunk has 1/(AF * number of workers) of the bytes left */
+#define AF 2
+
 /** \brief indicates if all files have been processed */
 # define ALL_FILES_PROCESSED 0
 
 /** \brief indicates there are still files to be processed */
 # define FILES_IN_PROCESSING 1
 
+/** \brief chunks are copied from the files to a buffer */
+#define INPUT_READ 0
+
+/** \brief chunks are views of the files mapped in memory */
+#define INPUT_MMAP 1
+
+/** \brief number of ints in the header of a chunk message (status, chunk size and previous character) */
+#define MSG_HEADER 3
+
+/** \brief default number of chunks in flight per worker (0 keeps the lock-step dispatcher) */
+#define DP 0
+
+/** \brief the dispatcher reads the files and sends the chunks to the workers */
+#define SCHED_DISPATCH 0
+
+/** \brief every process, the dispatcher included, counts its own range of bytes of each file */
+#define SCHED_SCATTER 1
+
+/** \brief kind of the records of a checkpoint (counts of the text of each file done from its start) */
+#define CHECKPOINT_KIND 1
+
+/** \brief seconds between two writes of the checkpoint */
+#define CI 10
+
 #endif /* PROBCONST_H_ */
\ No newline at end of file
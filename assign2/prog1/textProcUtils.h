@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #ifndef TEXT_PROC_Funct_H
 #define TEXT_PROC_Funct_H
@@ -22,6 +24,9 @@ struct fileData
 {
   char *fileName;
   FILE* fp;
+  unsigned char* map; /* contents of the file mapped in memory (mmap input backend) */
+  off_t fileSize;     /* size of the file in bytes (mmap input backend) */
+  off_t offset;       /* start of the next chunk (mmap input backend) */
   bool finished;
   int previousCh;
   unsigned char* chunk;
@@ -29,6 +34,14 @@ struct fileData
   int nWords;
   int nWordsBV;
   int nWordsEC;
+  int chunksRead;     /* chunks read by the dispatcher */
+  int chunksDone;     /* chunks whose results were received */
+  bool emitted;       /* the results were handed to the result sink */
+  uint64_t hash;      /* hash of the contents of the file (with a cache) */
+  bool hashed;        /* the hash is known */
+  bool cached;        /* the results came from the cache, the file is not read */
+  off_t resumeOffset; /* end of the part of the file done in the checkpoint (with a checkpoint) */
+  bool restored;      /* the results came from the checkpoint, the file is not read */
 };
 
 /**
@@ -127,10 +140,12 @@ int handleSpecialChars(int ch);
  *   It also counts the number of bytes read to obtain the character.
  *
  *  \param buffer buffer to read bytes from
+ *  \param index position of the character in the buffer
+ *  \param size number of bytes of the buffer, a character cut by its end is not decoded past it
  *  \param charUTF8Bytes array that will be filled with the first element
  *  the UTF8 character obtained and the second element the number of bytes read
  */
-void extractAChar(unsigned char *buffer, int index, int* charUTF8Bytes);
+void extractAChar(unsigned char *buffer, int index, int size, int* charUTF8Bytes);
 
 /**
  *  \brief Performs text processing of a chunk.
@@ -140,6 +155,9 @@ void extractAChar(unsigned char *buffer, int index, int* charUTF8Bytes);
  *  Needs to know the previous character to see if the previous chunk was inside a word
  *  and also if it was and the word ends with the next character, to see if it was a consonant.
  *
+ *  The characters are classified with lookup tables, and runs of ASCII characters are
+ *  counted a block at a time.
+ *
  *  Operation executed by workers.
  *
  *  \param partialData structure that contains the data needed to process
@@ -147,6 +165,34 @@ void extractAChar(unsigned char *buffer, int index, int* charUTF8Bytes);
  */
 void processChunk(struct fileData *partialData);
 
+/**
+ *  \brief State of the text processing at the end of a chunk.
+ */
+struct wordState
+{
+  bool inWord;        /* the last character is inside a word */
+  bool lastConsonant; /* the last letter of that word is a consonant */
+};
+
+/**
+ *  \brief Obtains the state of the text processing right after a character.
+ *
+ *  \param previousCh previous character of a chunk
+ *  \param state filled with the state the chunk starts from
+ */
+void startWordState(int previousCh, struct wordState *state);
+
+/**
+ *  \brief Performs text processing of a chunk that goes on from the chunk before it.
+ *
+ *  Same as processChunk, but the counting starts from the state left by the chunk before, so a
+ *  range of bytes counted a chunk at a time gets the same counts as counted at once.
+ *
+ *  \param partialData structure that contains the chunk and will be filled with the results obtained
+ *  \param state state the chunk starts from, updated with the state at its end
+ */
+void processChunkFrom(struct fileData *partialData, struct wordState *state);
+
 /**
  *  \brief Reads bytes from the file until it reads a full UTF8 encoded character.
  *
@@ -161,4 +207,51 @@ void processChunk(struct fileData *partialData);
  */
 void getChunkSizeAndLastChar(unsigned char* chunk, struct fileData* data);
 
+/**
+ *  \brief Moves a position of a buffer backwards to the start of an UTF8 encoded character.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position to align
+ *  \param lowest first position that can be read
+ *
+ *  \return position of the start of the character.
+ */
+off_t findCharStart(unsigned char *buffer, off_t index, off_t lowest);
+
+/**
+ *  \brief Decodes the UTF8 encoded character that ends right before a position of a buffer.
+ *
+ *  \param buffer buffer with the bytes
+ *  \param index position right after the character
+ *  \param lowest first position that can be read
+ *
+ *  \return general representation of the character, or a white space if there is none.
+ */
+int getCharBefore(unsigned char *buffer, off_t index, off_t lowest);
+
+/**
+ *  \brief Obtains a view of the next chunk of a mapped file.
+ *
+ *  The chunk has at most {maxBytesPerChunk-7} bytes and ends at the start of the UTF8
+ *  encoded character found by scanning backwards from the split point.
+ *  Updates the chunk, chunk size and previous character of the given structure,
+ *  and flags the file as finished after its last chunk.
+ *  Operation executed by the dispatcher.
+ *
+ *  \param data fileData structure of the mapped file
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ */
+void getMappedChunk(struct fileData *data, int maxBytesPerChunk);
+
+/**
+ *  \brief Size of the next chunk in the adaptive chunk sizing mode (guided self-scheduling).
+ *
+ *  \param remaining bytes of all files not read yet
+ *  \param nWorkers number of worker processes
+ *  \param maxBytesPerChunk maximum number of bytes per chunk
+ *
+ *  \return number of bytes of the chunk before alignment, between AMIN and {maxBytesPerChunk-7}
+ */
+int guidedChunkSize(off_t remaining, int nWorkers, int maxBytesPerChunk);
+
 #endif /* TEXT_PROC_Funct_H */
\ No newline at end of file
@@ -7,7 +7,28 @@
  *
  *  The dispatcher is responsible for reading the matrices from files and sending them to
  *  the worker processes. Aferwards, these workers should retrieve them and calculate the determinant.
- *  Then, these results are sent back to the dispatcher in order to display them
+ *  Then, these results are sent back to the dispatcher, which hands each file to the result sink
+ *  as soon as its last determinant arrives.
+ *
+ *  With dynamic scheduling the matrices are not handed out in rounds, whichever worker
+ *  returns a result gets the next matrix read, keeping a number of matrices in flight per worker.
+ *
+ *  With scatter scheduling every process, the dispatcher included, reads its own contiguous range
+ *  of matrices of each file with MPI-IO and the determinants are gathered on the dispatcher.
+ *
+ *  With a cache directory (-C) the terms of each matrix are hashed once read, and a matrix found in
+ *  the cache gets the determinant of a previous run instead of being sent to a worker (calculated,
+ *  with scatter scheduling).
+ *
+ *  With a reduced precision (-P float or mixed) every matrix is converted to single precision by the
+ *  process that calculates it; the matrices factorized by all the processes together (scatter
+ *  scheduling) stay in double precision.
+ *
+ *  With dynamic scheduling a worker that has blocks in flight and does not answer for the worker
+ *  timeout (-T) is lost: its blocks are sent to the other workers and it gets no more blocks. With a
+ *  checkpoint (-R) the determinants of the matrices of each file done from its start are written
+ *  every few seconds, and a job restarted with the same checkpoint fills them in and only reads the
+ *  matrices after them.
  *
  *
  *  \author Pedro Marques - May 2022
@@ -28,6 +49,11 @@
 #include <libgen.h>
 #include <string.h>
 #include <mpi.h>
+#include "../common/instrument.h"
+#include "../../common/filelist.h"
+#include "../../common/resultsink.h"
+#include "../../common/resultcache.h"
+#include "../common/checkpoint.h"
 
 
 
@@ -40,13 +66,99 @@ static void printUsage(char *cmdName);
 /** \brief indicates there are still files to be processed */
 # define PROCESSINGFILES 1
 
+/** \brief tag of the messages with a block of matrices (dynamic scheduling) */
+# define TAGMATRIX 1
+
+/** \brief tag of the messages with a determinant (dynamic scheduling) */
+# define TAGRESULT 2
+
+/** \brief tag of the message that finalizes a worker (dynamic scheduling) */
+# define TAGSTOP 3
+
+/** \brief tag of the messages with the order of the matrices of the next blocks (dynamic scheduling) */
+# define TAGORDER 4
+
+/** \brief log|det| is also calculated for every matrix, and sent after each determinant */
+static int logResults = 0;
+
+/** \brief precision of the elimination: PRECISION_DOUBLE, PRECISION_FLOAT or PRECISION_MIXED */
+static int precision = PRECISION_DOUBLE;
+
+/** \brief output of the results, written as the files are done (dispatcher only) */
+static struct resultSink *sink;
+
+/** \brief position in the list of the first file of the window */
+static unsigned long firstFile = 0;
+
+/** \brief determinants of the matrices already processed, keyed by the hash of their terms (NULL without -C) */
+static struct resultCache *cache = NULL;
+
+/** \brief determinants of the part of each file done, kept across runs (dispatcher only, NULL without -R) */
+static struct checkpoint *checkpoint = NULL;
+
+/** \brief seconds a worker with blocks in flight may go without answering before it is lost (0 waits forever) */
+static double workerTimeout = 0;
+
+/** \brief workers lost, that get no more blocks (dispatcher only, indexed by rank) */
+static bool *lostWorkers = NULL;
+
+/** \brief number of workers lost */
+static int nLost = 0;
+
+/** \brief structure with a block of matrices sent to a worker whose determinants did not arrive yet */
+struct matrixSlot
+{
+  double *matrix;                                                          /** array of values of the block's matrices */
+  int count;                                                                       /** number of matrices in the block */
+  int fileIndex;                                                                 /** file where the matrices are from */
+  int matrixNumber;                                                           /** index of first matrix of the block */
+  uint64_t *keys;                                                        /** hash of each matrix of the block (with -C) */
+  MPI_Request request;                                                                      /** request of the block */
+};
+
+/** \brief hands the determinants of a file of the window to the result sink, once */
+static void emitFile(struct matrixFile *files, int fileIndex);
+
+/** \brief looks up the determinant of a matrix in the cache */
+static bool lookupMatrix(const double *matrix, int order, uint64_t *key, double *determinant, double *logDeterminant);
+
+/** \brief stores the determinant of a matrix in the cache */
+static void storeMatrix(uint64_t key, double determinant, double logDeterminant);
+
+/** \brief calculates the determinant of a matrix in the precision of the run */
+static void calcDeterminant(int order, double *matrix, double *determinant, double *logDeterminant);
+
+/** \brief opens a file of matrices and reads its header */
+static FILE *openMatrixFile(char *filename, struct matrixFile *file);
+
+/** \brief fills in the determinants of the part of a file found in the checkpoint */
+static void resumeFile(struct matrixFile *file, FILE *fp);
+
+/** \brief marks the matrices of a block as done, and advances the part of the file done from its start */
+static void markDone(struct matrixFile *file, unsigned int first, unsigned int count);
+
+/** \brief replaces the record of a file in the checkpoint with the determinants of its part done */
+static void recordFile(struct matrixFile *file, unsigned int nDone);
+
+/** \brief hands out the matrices to the first worker that becomes free */
+static void dispatchDynamic(struct matrixFile *files, FILE **fps, int fnip, int size, int depth, int batch);
+
+/** \brief calculates the determinants of the matrices received with dynamic scheduling */
+static void workDynamic(void);
+
+/** \brief calculates the determinants of a static partition of the matrices of a window of files read with MPI-IO */
+static int scatterStatic(int rank, int size, char **filenames, int fnip, struct matrixFile *files);
+
+/** \brief factorization of a matrix whose rows are dealt to the processes in turn (scatter scheduling) */
+static void factorizeDistributed(int rank, int size, int order, double *rows, double *determinant, double *logDeterminant);
+
 /**
  *  \brief
  *
  *  Design and flow of the Dispatcher process:
  * 
  *  1 - Read and process the command line.
- *  2 - For every file:
+ *  2 - For every file of a window of files of the list (-f names, then the manifest):
  *    2.1 - Read the number of matrices in file
  *    2.2 - Read the order of the matrices in file
  *    2.3 - Initialize the file's fileStructure containg the array of determinants
@@ -54,9 +166,25 @@ static void printUsage(char *cmdName);
  *        2.4.1 - Send worker status, matrix order, matrix index in file and the matrix itself
  *        2.4.2 - Wait for a response  from each worker, including the index of the processed matrix and the determinant.
  *        2.4.3 - Store the results in the corresponding position in the current fileStructure's determinant array.
- *  3 - Send a message to the workers alerting there isn't more work to be done and to finalize.
- *  4 - Print final results.
+ *    2.5 - Hand the file's determinants to the result sink, which writes them while the next file is processed.
+ *  3 - Hand the files left to the result sink, free the fileStructures of the window and go back to 2 until
+ *      the list is exhausted.
+ *  4 - Send a message to the workers alerting there isn't more work to be done and to finalize.
  *  5 - Finalize.
+ *
+ *  With dynamic scheduling (-s dynamic) step 2 becomes:
+ *    2.1 - Read the header of every file and initialize its fileStructure.
+ *    2.2 - Send up to depth blocks of matrices to each worker, the order only when the worker's file changes.
+ *    2.3 - Wait for the determinants of a block from any worker, store them and send that worker the block read ahead.
+ *          The file is handed to the result sink once all its determinants arrived.
+ *    2.4 - Read the next block while the workers compute.
+ *
+ *  With scatter scheduling (-s scatter) every process runs step 2 as:
+ *    2.1 - Read the header of the file with MPI-IO.
+ *    2.2 - Read its own contiguous range of matrices and calculate their determinants.
+ *    2.3 - Gather the determinants of every process in the dispatcher's fileStructure, and hand it to the result sink.
+ *    When the file has fewer matrices than processes and they are large, every process instead reads
+ *    every order-th row of each matrix, and the processes factorize the matrix together.
  * 
  *  Design and flow of the worker processes:
  *  
@@ -77,9 +205,17 @@ static void printUsage(char *cmdName);
 int main(int argc, char *argv[])
 {
   
-  char *filenames[16];                                                                                          /* array of file's names  */
-  int fnip = 0;                                                                                                 /* filename insertion pointer */
+  struct fileList list;                                                                                         /* files to be processed */
+  int W = DW;                                                                                                   /* files of a window */
+  int fnip = 0;                                                                                                 /* files of the window */
   int opt;  
+  int scheduling = SCHED_ROUNDS;                                                                                /* how the matrices are handed out */
+  int depth = DP;                                                                                               /* blocks in flight per worker */
+  int batch = DB;                                                                                               /* matrices per block */
+  int outputFormat = SINK_TEXT;                                                                                 /* format of the results */
+  char *outputPath = NULL;                                                                                      /* file of the results, NULL for the standard output */
+  char cacheDir[4096] = "";                                                                                     /* directory of the cache, empty for none */
+  char *checkpointPath = NULL;                                                                                  /* file of the checkpoint, NULL for none */
   
                                                                                         
   int rank, size;
@@ -97,10 +233,11 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
   if (rank == 0){                       
+    fileListInit(&list);
     // argument handling
     do  
     {
-      switch ((opt = getopt(argc, argv, "f:")))
+      switch ((opt = getopt(argc, argv, "f:F:w:s:p:b:P:lo:O:C:T:R:")))
       {
       case 'f':                                                                                                 /* file name */
         if (optarg[0] == '-')
@@ -109,14 +246,103 @@ int main(int argc, char *argv[])
           printUsage(basename(argv[0]));
           return EXIT_FAILURE;
         }
-        if (fnip>=16)                                                                                           /* at most 16 files */                                    
+        fileListAdd(&list, optarg);
+        break;
+
+      case 'F':                                                                                                 /* manifest */
+        if (fileListManifest(&list, optarg) != 0)
+        {
+          fprintf(stderr, "%s: could not open manifest %s\n", basename(argv[0]), optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+
+      case 'w':                                                                                                 /* files per window */
+        if (atoi(optarg) < 1)
+        {
+          fprintf(stderr, "%s: number of files per window must be greater or equal than 1\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        W = atoi(optarg);
+        break;
+
+      case 's':                                                                                                 /* scheduling */
+        if (strcmp(optarg, "rounds") == 0)
+          scheduling = SCHED_ROUNDS;
+        else if (strcmp(optarg, "dynamic") == 0)
+          scheduling = SCHED_DYNAMIC;
+        else if (strcmp(optarg, "scatter") == 0)
+          scheduling = SCHED_SCATTER;
+        else
         {
-          fprintf(stderr, "%s: Too many files to unpack. At Most 16\n", basename(argv[0]));
+          fprintf(stderr, "%s: scheduling must be rounds, dynamic or scatter\n", basename(argv[0]));
           printUsage(basename(argv[0]));
           return EXIT_FAILURE;
         }
+        break;
 
-        filenames[fnip++] = optarg;
+      case 'p':                                                                                                 /* matrices in flight per worker */
+        if (atoi(optarg) < 1)
+        {
+          fprintf(stderr, "%s: number of matrices in flight must be greater or equal than 1\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        depth = atoi(optarg);
+        break;
+
+      case 'b':                                                                                                 /* matrices per message */
+        if (atoi(optarg) < 1)
+        {
+          fprintf(stderr, "%s: number of matrices per message must be greater or equal than 1\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        batch = atoi(optarg);
+        break;
+      case 'P':                                                                                                 /* precision of the elimination */
+        if (strcmp(optarg, "double") == 0)
+          precision = PRECISION_DOUBLE;
+        else if (strcmp(optarg, "float") == 0)
+          precision = PRECISION_FLOAT;
+        else if (strcmp(optarg, "mixed") == 0)
+          precision = PRECISION_MIXED;
+        else
+        {
+          fprintf(stderr, "%s: precision must be double, float or mixed\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'l':                                                                                                 /* log-domain results */
+        logResults = 1;
+        break;
+      case 'o':                                                                                                 /* output format */
+        if ((outputFormat = sinkFormat(optarg)) < 0)
+        {
+          fprintf(stderr, "%s: output format must be text, csv or binary\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'O':                                                                                                 /* output file */
+        outputPath = optarg;
+        break;
+      case 'C':                                                                                                 /* cache directory */
+        strncpy(cacheDir, optarg, sizeof(cacheDir)-1);
+        break;
+      case 'T':                                                                                                 /* worker timeout */
+        if (atof(optarg) < 0)
+        {
+          fprintf(stderr, "%s: worker timeout must be greater or equal than 0\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        workerTimeout = atof(optarg);
+        break;
+      case 'R':                                                                                                 /* checkpoint */
+        checkpointPath = optarg;
         break;
      
       case 'h': /* help mode */
@@ -137,111 +363,172 @@ int main(int argc, char *argv[])
       printUsage(basename(argv[0]));
       return EXIT_FAILURE;
     }   
+
+    if ((workerTimeout > 0 || checkpointPath != NULL) && scheduling != SCHED_DYNAMIC)
+    {
+      fprintf(stderr, "%s: worker timeout and checkpoint need dynamic scheduling\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
    
 
    
-      struct timespec start, finish;                                                                            /* time limits */
+    if ((sink = sinkOpen(outputPath, outputFormat)) == NULL)
+    {
+      fprintf(stderr, "%s: could not open output file %s\n", basename(argv[0]), outputPath);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    FILE *info = sinkInfo(sink);                                                                                /* stream of the elapsed time, apart from csv or binary results */
+
+    if (cacheDir[0] != '\0' && (cache = cacheOpen(cacheDir, "determinants", 2 * sizeof(double))) == NULL)
+    {
+      fprintf(stderr, "%s: could not create cache directory %s\n", basename(argv[0]), cacheDir);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    if (checkpointPath != NULL && (checkpoint = checkpointOpen(checkpointPath, CHECKPOINT_KIND, CI)) == NULL)
+    {
+      fprintf(stderr, "%s: could not open checkpoint %s\n", basename(argv[0]), checkpointPath);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    lostWorkers = (bool *)calloc(size, sizeof(bool));
+    if (workerTimeout > 0)                                                                                      /* a worker that fails must not abort the job */
+      MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+
+    struct timespec start, finish;                                                                              /* time limits */
 
     clock_gettime (CLOCK_MONOTONIC_RAW, &start);                                                                /* begin of time measurement */  
-    struct matrixFile * files = (struct matrixFile *)malloc(fnip * sizeof(struct matrixFile));                  /* initialize files array  */
+    struct matrixFile * files = (struct matrixFile *)malloc(W * sizeof(struct matrixFile));                     /* initialize files array of a window */
+    char **filenames = (char **)malloc(W * sizeof(char *));                                                     /* names of the files of a window */
+    FILE **fps = (FILE **)malloc(W * sizeof(FILE *));                                                           /* file pointers of the files (dynamic scheduling) */
                                               
+    MPI_Bcast(&scheduling, 1, MPI_INT, 0, MPI_COMM_WORLD);                                                      /* tell the workers how the matrices are handed out */
+    MPI_Bcast(&logResults, 1, MPI_INT, 0, MPI_COMM_WORLD);                                                      /* and if log|det| is needed */
+    MPI_Bcast(&precision, 1, MPI_INT, 0, MPI_COMM_WORLD);                                                       /* and in which precision */
+    if (scheduling == SCHED_SCATTER)
+      MPI_Bcast(cacheDir, sizeof(cacheDir), MPI_CHAR, 0, MPI_COMM_WORLD);                                       /* every process looks up its own matrices */
 
-    for (int fCk = 0;fCk<fnip;fCk++){                                                                           /* process each file in filenames array */
+    while ((fnip = fileListWindow(&list, filenames, W)) > 0){
+      if (scheduling == SCHED_DYNAMIC){
+        for (int fCk = 0;fCk<fnip;fCk++)
+          fps[fCk] = openMatrixFile(filenames[fCk], files+fCk);                                                  /* every header is needed before the first matrix */
+        dispatchDynamic(files, fps, fnip, size, depth, batch);
+      }
 
-      FILE *fp = fopen(filenames[fCk], "r");
+      if (scheduling == SCHED_SCATTER)
+        scatterStatic(rank, size, filenames, fnip, files);
 
-      if (fp == NULL)
-      {
-          printf("Error: could not open file %s", filenames[fCk]);
-          return 1;
-      }
-      
-      int numMatrix;
-      int c;
-      c = fread(&numMatrix, 4, 1, fp);                                                                              /* get number of matrices in the file */
-      if (!c) {
-        printf("Error: could not read file %s", filenames[fCk]);
-        return 1;
-        }
-      int order; 
-      c = fread(&order, 4, 1, fp);                                                                                  /* get order of the matrices in the file */
-      if (!c) {
-        printf("Error: could not read file %s", filenames[fCk]);
-        return 1;
-        }
-       
- 
-      (files+fCk)->filename = filenames[fCk];                                                                   /* save current file's data */
-      (files+fCk)->order = order;                                                                               /* save order of the matrices */
-      (files+fCk)->nMatrix = numMatrix;                                                                         /* save total number of matrices */
-      (files+fCk)->matrixDeterminants = (double *)malloc(numMatrix * sizeof(double));                           /* allocate memory for determinants */
+      for (int fCk = 0;fCk<fnip && scheduling == SCHED_ROUNDS;fCk++){                                             /* process each file in filenames array */
+
+        FILE *fp = openMatrixFile(filenames[fCk], files+fCk);
+        int numMatrix = (files+fCk)->nMatrix;
+        int order = (files+fCk)->order;
+        int c;
 
       
-      int rest = numMatrix%(size-1);
-      int iterations = floor((numMatrix-rest)/(size-1));                                                        /* deal with odd number of workers */
-      int incMCount = 0;  
-      if (rest>0) iterations+=1;
-
-      for (int iter=0; iter<iterations;iter++){                                                                 /* read and get determinant of each matrix in file */
-        int toRead = size;
-        if (iter == iterations-1 && rest != 0) toRead = rest+1;                                                 /* deal with odd number of workers */
-
-        for (int nProc = 1; nProc<toRead; nProc++){
-          double *matrix = (double *)malloc(order * order * sizeof(double));                                    /* memory allocation of the matrix */
-          c = fread(matrix, 8, order*order, fp);                                                                    /* read full matrix from file */
-          if (!c) {
-            printf("Error: could not read file %s", filenames[fCk]);
-            return 1;
+        int incMCount = 0;                                                                                        /* matrices read */
+        uint64_t keys[size];                                                                                      /* hash of the matrix of each worker (with -C) */
+
+        while (incMCount < numMatrix){                                                                            /* read and get determinant of each matrix in file */
+          int toRead = 1;                                                                                         /* a round gives a matrix to each worker */
+
+          while (toRead < size && incMCount < numMatrix){
+            double *matrix = (double *)malloc(order * order * sizeof(double));                                    /* memory allocation of the matrix */
+            uint64_t readStart = INSTR_NOW();
+            c = fread(matrix, 8, order*order, fp);                                                                    /* read full matrix from file */
+            INSTR_TIME(INSTR_READ_TIME, readStart);
+            INSTR_ADD(INSTR_READ_CALLS, 1);
+            INSTR_ADD(INSTR_READ_BYTES, (uint64_t)c * 8);
+            if (!c) {
+              printf("Error: could not read file %s", filenames[fCk]);
+              return 1;
+              }
+            double cached[2];
+            if (cache != NULL && lookupMatrix(matrix, order, &keys[toRead], &cached[0], &cached[1])){             /* no worker needed */
+              (files+fCk)->matrixDeterminants[incMCount] = cached[0];
+              if (logResults) (files+fCk)->matrixLogDeterminants[incMCount] = cached[1];
+              free(matrix);
+              incMCount++;
+              continue;
             }
-          int WORKSTATUS = PROCESSINGFILES;
-          MPI_Send(&WORKSTATUS, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD);                                          /* Send current worker status (PROCESSINGFILES) */
-          MPI_Send(&order, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD);                                               /* Send order*/
-          MPI_Send(&incMCount, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD);                                           /* Send matrix index*/
-          MPI_Send(matrix, order*order, MPI_DOUBLE, nProc, 0, MPI_COMM_WORLD);                                  /* send matrix */
-          incMCount++;
+            int nProc = toRead++;
+            int WORKSTATUS = PROCESSINGFILES;
+            MPI_Send(&WORKSTATUS, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD);                                          /* Send current worker status (PROCESSINGFILES) */
+            MPI_Send(&order, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD);                                               /* Send order*/
+            MPI_Send(&incMCount, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD);                                           /* Send matrix index*/
+            MPI_Send(matrix, order*order, MPI_DOUBLE, nProc, 0, MPI_COMM_WORLD);                                  /* send matrix */
+            free(matrix);                                                                                         /* already sent */
+            incMCount++;
          
-      }
+        }
 
-      for (int nProc = 1; nProc<toRead; nProc++){                                                               /* receive results form all workers */
-          int curMatrixNumber;
-          double determinant;
-          MPI_Recv(&curMatrixNumber, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);                  /* receive the matrix index from the nProc worker */
-          MPI_Recv(&determinant, 1, MPI_DOUBLE, nProc, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);                   /* receive the determinant from the nProc worker*/
+        for (int nProc = 1; nProc<toRead; nProc++){                                                               /* receive results form all workers */
+            int curMatrixNumber;
+            double determinant[2];
+            MPI_Recv(&curMatrixNumber, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);                  /* receive the matrix index from the nProc worker */
+            MPI_Recv(determinant, 1+logResults, MPI_DOUBLE, nProc, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);         /* receive the determinant (and log|det|) from the nProc worker*/
 
-          /* update struct with new results */
-          (*((((struct matrixFile *)(files+fCk))->matrixDeterminants) + curMatrixNumber)) = determinant;        /* save calculated determinant */
+            /* update struct with new results */
+            (*((((struct matrixFile *)(files+fCk))->matrixDeterminants) + curMatrixNumber)) = determinant[0];     /* save calculated determinant */
+            if (logResults) (files+fCk)->matrixLogDeterminants[curMatrixNumber] = determinant[1];
+            if (cache != NULL) storeMatrix(keys[nProc], determinant[0], determinant[1]);
 
-          }
+            }
+        }
+        fclose(fp);
+        emitFile(files, fCk);                                                                                     /* written while the next file is processed */
       }
-    }
 
+      for (int g=0; g<fnip; g++){                                                    /* the files left (without matrices) go to the sink */
+        emitFile(files, g);
+        free((files+g)->matrixDeterminants);                                          /* NULL once handed to the sink */
+        free((files+g)->matrixLogDeterminants);
+        free((files+g)->done);
+        free(filenames[g]);
+      }
+      firstFile += fnip;
+    }
+    fileListClose(&list);
 
-    for (int nProc = 1; nProc<size; nProc++){                                        /* End worker Processes */
+    if (scheduling == SCHED_SCATTER)
+      scatterStatic(rank, size, NULL, 0, NULL);                                      /* no files left, the workers stop */
+    for (int nProc = 1; nProc<size && scheduling == SCHED_DYNAMIC; nProc++)           /* End worker Processes */
+      MPI_Send(NULL, 0, MPI_INT, nProc, TAGSTOP, MPI_COMM_WORLD);                     /* the error of a lost worker is ignored */
+    for (int nProc = 1; nProc<size && scheduling == SCHED_ROUNDS; nProc++){          /* End worker Processes */
       int ws = ALLFILESPROCESSED;
       MPI_Send(&ws, 1, MPI_INT, nProc, 0, MPI_COMM_WORLD); 
     }
 
-  
+    if (cache != NULL)
+      cacheClose(cache);                                                           /* the determinants of the new matrices are kept for the next runs */
+    if (checkpoint != NULL)
+      checkpointClose(checkpoint, true);                                           /* every file is done, there is nothing to resume */
+    sinkClose(sink);                                                               /* every result was written */
 
-    clock_gettime (CLOCK_MONOTONIC_RAW, &finish);   
-    for (int g=0; g<fnip; g++) {                                                     /* printing results for each file */
-      struct matrixFile *file = ((struct matrixFile *)(files+g));                    
-      
-      printf("\nMatrix File  %s\n", file->filename);
-      printf("Number of Matrices  %d\n", file->nMatrix);
-      printf("Order of the matrices  %d\n", file->order);
+    clock_gettime (CLOCK_MONOTONIC_RAW, &finish);                                  /* end of measurement */
+    fprintf (info, "\nElapsed time = %.6f s\n",  (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
 
-      for (int o =0;o<file->nMatrix; o++){
-        printf("\tMatrix %d Result: Determinant = %.3e \n", o+1,file->matrixDeterminants[o]);
-      }
-        
+    if (nLost > 0){                                                                /* every result was written, but the lost workers would never finalize */
+      fflush(info);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_SUCCESS);
     }
-    printf ("\nElapsed time = %.6f s\n",  (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+    free(lostWorkers);
 
   
    }else{                                                                                 /* Worker Processes, rank!=0 */
+    int scheduling;
+    MPI_Bcast(&scheduling, 1, MPI_INT, 0, MPI_COMM_WORLD);                                /* receive how the matrices are handed out */
+    MPI_Bcast(&logResults, 1, MPI_INT, 0, MPI_COMM_WORLD);                                /* and if log|det| is needed */
+    MPI_Bcast(&precision, 1, MPI_INT, 0, MPI_COMM_WORLD);                                 /* and in which precision */
+    if (scheduling == SCHED_SCATTER){
+      char cacheDir[4096];                                                                /* directory of the cache, empty for none */
+      MPI_Bcast(cacheDir, sizeof(cacheDir), MPI_CHAR, 0, MPI_COMM_WORLD);
+      if (cacheDir[0] != '\0' && (cache = cacheOpen(cacheDir, "determinants", 2 * sizeof(double))) == NULL)
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
     
-    while(true){
+    while(scheduling == SCHED_ROUNDS){
       int curWorkStatus;
       MPI_Recv(&curWorkStatus, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);      /* receive current worker status  */
       if (curWorkStatus == ALLFILESPROCESSED) {                                           /* finalize if ALLFILESPROCESSED  */
@@ -256,12 +543,24 @@ int main(int argc, char *argv[])
       MPI_Recv(matrix, order*order, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE); /* receive matrix */
     
 
-      double det = getDeterminant(order,matrix);                                          /* calculate determinant  */
+      double det[2];
+      uint64_t computeStart = INSTR_NOW();
+      calcDeterminant(order, matrix, &det[0], &det[1]);                                   /* calculate determinant  */
+      INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+      INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
       free(matrix);                                                                       /* free memory used by malloc  */
       MPI_Send(&matrixIndex, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);                           /* send matrix index back to dispatcher  */
-      MPI_Send(&det, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);                                /* send matrix determinant to dispatcher  */
+      MPI_Send(det, 1+logResults, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);                      /* send matrix determinant to dispatcher  */
     }
 
+    if (scheduling == SCHED_DYNAMIC)
+      workDynamic();
+
+    while (scheduling == SCHED_SCATTER && scatterStatic(rank, size, NULL, 0, NULL) > 0)
+      ;                                                                                 /* a window at a time */
+    if (cache != NULL)
+      cacheClose(cache);                                                                /* only read, the dispatcher stores the determinants */
+
   }
   
 
@@ -281,10 +580,791 @@ int main(int argc, char *argv[])
  */
 static void printUsage(char *cmdName)
 {
-  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename]\n"
+  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / manifest / files per window / scheduling / messages in flight / matrices per message / precision / log-domain results / output format / output file / cache directory / worker timeout / checkpoint]\n"
                   "  OPTIONS:\n"
                   "  -h      --- print this help\n"
-                  "  -f      --- filename to process\n",
-          cmdName);
+                  "  -f      --- filename to process\n"
+                  "  -F      --- manifest with a filename per line, - for the standard input\n"
+                  "  -w      --- number of files processed at a time (default %d)\n"
+                  "  -s      --- scheduling: rounds (default), dynamic or scatter\n"
+                  "  -p      --- number of messages in flight per worker with dynamic scheduling (default 1)\n"
+                  "  -b      --- number of matrices per message with dynamic scheduling (default 1)\n"
+                  "  -P      --- precision of the elimination: double (default), float or mixed (float, pivots multiplied in double)\n"
+                  "  -l      --- also calculate log|det|, the determinants are printed from it\n"
+                  "  -o      --- output format: text (default), csv or binary\n"
+                  "  -O      --- file of the results (default the standard output)\n"
+                  "  -C      --- directory of the cache of the results, matrices already processed are not processed again\n"
+                  "  -T      --- seconds a worker may not answer before its blocks go to the others, 0 (default) waits forever (dynamic scheduling)\n"
+                  "  -R      --- file of the checkpoint, a job stopped resumes from it when run again (dynamic scheduling)\n",
+          cmdName, DW);
+}
+
+
+
+/**
+ *  \brief 
+ *  Opens a file of matrices and reads its header
+ *  Initializes the file's fileStructure with the number and order of its matrices
+ *  \param filename name of the file
+ *  \param file fileStructure of the file
+ *
+ *  \return the file pointer, positioned at the first matrix
+ */
+static FILE *openMatrixFile(char *filename, struct matrixFile *file)
+{
+  FILE *fp = fopen(filename, "r");
+
+  if (fp == NULL)
+  {
+      printf("Error: could not open file %s", filename);
+      exit(1);
+  }
+
+  int numMatrix;
+  int c;
+  c = fread(&numMatrix, 4, 1, fp);                                                      /* get number of matrices in the file */
+  if (!c) {
+    printf("Error: could not read file %s", filename);
+    exit(1);
+    }
+  int order; 
+  c = fread(&order, 4, 1, fp);                                                          /* get order of the matrices in the file */
+  if (!c) {
+    printf("Error: could not read file %s", filename);
+    exit(1);
+    }
+
+  file->filename = filename;                                                            /* save current file's data */
+  file->order = order;                                                                  /* save order of the matrices */
+  file->nMatrix = numMatrix;                                                            /* save total number of matrices */
+  file->matrixDeterminants = (double *)malloc(numMatrix * sizeof(double));              /* allocate memory for determinants */
+  file->matrixLogDeterminants = logResults ? (double *)malloc(numMatrix * sizeof(double)) : NULL;
+  file->processedMatrixCounter = 0;
+  file->emitted = false;
+  file->restoredMatrices = 0;
+  file->done = NULL;
+  file->donePrefix = 0;
+  if (checkpoint != NULL) resumeFile(file, fp);
+  return fp;
 }
 
+/**
+ *  \brief 
+ *  Fills in the determinants of the part of a file found in the checkpoint, and moves the file past
+ *  its matrices so they are not read. A record without log|det| is not used with log-domain results
+ *  \param file fileStructure of the file, with its header read
+ *  \param fp file pointer of the file, positioned at the first matrix
+ */
+static void resumeFile(struct matrixFile *file, FILE *fp)
+{
+  const struct checkpointRecord *record = checkpointFind(checkpoint, file->filename);
+
+  file->done = (bool *)calloc(file->nMatrix, sizeof(bool));
+  if (record == NULL || record->position > file->nMatrix) return;
+  size_t nDone = record->position;
+  bool withLog = (record->size == 2 * nDone * sizeof(double));                          /* the determinants, then their log|det| */
+  if ((record->size != nDone * sizeof(double) && !withLog) || (logResults && !withLog)) return;
+
+  memcpy(file->matrixDeterminants, record->values, nDone * sizeof(double));
+  if (logResults)
+    memcpy(file->matrixLogDeterminants, (const double *)record->values + nDone, nDone * sizeof(double));
+  memset(file->done, true, nDone);
+  file->restoredMatrices = nDone;
+  file->donePrefix = nDone;
+  file->processedMatrixCounter = nDone;
+  fseeko(fp, (off_t)nDone*file->order*file->order*8, SEEK_CUR);                         /* its determinants are in the checkpoint */
+}
+
+/**
+ *  \brief 
+ *  Marks the matrices of a block as done, and advances the part of the file done from its start
+ *  over them and the blocks done before that follow them
+ *  \param file fileStructure of the file
+ *  \param first first matrix of the block
+ *  \param count number of matrices of the block
+ */
+static void markDone(struct matrixFile *file, unsigned int first, unsigned int count)
+{
+  memset(file->done + first, true, count);
+  while (file->donePrefix < file->nMatrix && file->done[file->donePrefix])
+    file->donePrefix++;
+}
+
+/**
+ *  \brief 
+ *  Replaces the record of a file in the checkpoint with the determinants of the first matrices of the
+ *  file, followed by their log|det| with log-domain results
+ *  \param file fileStructure of the file, with its determinants
+ *  \param nDone number of matrices
+ */
+static void recordFile(struct matrixFile *file, unsigned int nDone)
+{
+  int stride = 1 + logResults;
+  double *values = (double *)malloc((nDone > 0 ? nDone : 1) * stride * sizeof(double));
+
+  memcpy(values, file->matrixDeterminants, nDone * sizeof(double));
+  if (logResults) memcpy(values + nDone, file->matrixLogDeterminants, nDone * sizeof(double));
+  checkpointSet(checkpoint, file->filename, nDone, values, nDone * stride * sizeof(double));
+  free(values);
+}
+
+/**
+ *  \brief 
+ *  Hands the determinants of a file of the window to the result sink, unless it was already done
+ *  The arrays now belong to the sink, the fileStructure no longer points to them
+ *  \param files fileStructures of the window
+ *  \param fileIndex index of the file in the window
+ */
+static void emitFile(struct matrixFile *files, int fileIndex)
+{
+  struct matrixFile *file = files+fileIndex;
+
+  if (file->emitted)
+    return;
+  file->emitted = true;
+  if (checkpoint != NULL && file->restoredMatrices < file->nMatrix)
+    recordFile(file, file->nMatrix);                                                    /* before the sink takes the arrays */
+  sinkDeterminants(sink, firstFile + fileIndex, file->filename, file->nMatrix, file->order,
+                   file->matrixDeterminants, file->matrixLogDeterminants);
+  file->matrixDeterminants = NULL;
+  file->matrixLogDeterminants = NULL;
+}
+
+/**
+ *  \brief 
+ *  Looks up the determinant of a matrix in the cache
+ *  With log-domain results a determinant stored without its log|det| is a miss
+ *  \param matrix terms of the matrix, before the elimination
+ *  \param order order of the matrix
+ *  \param key hash of the terms, the key to store the determinant with on a miss
+ *  \param determinant determinant of the matrix, on a hit
+ *  \param logDeterminant log|det| of the matrix, on a hit
+ *
+ *  \return true on a hit
+ */
+static bool lookupMatrix(const double *matrix, int order, uint64_t *key, double *determinant, double *logDeterminant)
+{
+  double value[2];                                                                      /* determinant and log|det| */
+
+  *key = cacheHash(matrix, (size_t)order * order * sizeof(double), order + ((uint64_t)precision << 32));   /* each precision has its own results */
+  if (!cacheGet(cache, *key, value) || (logResults && isnan(value[1])))
+    return false;
+  *determinant = value[0];
+  *logDeterminant = value[1];
+  return true;
+}
+
+/**
+ *  \brief 
+ *  Calculates the determinant of a matrix, and its log|det| with log-domain results
+ *  In the float and mixed precisions the matrix is converted to single precision first and
+ *  eliminated in float, with the pivots multiplied in double in the mixed precision
+ *  In double precision the matrix is overwritten by its factorization
+ *  \param order order of the matrix
+ *  \param matrix terms of the matrix
+ *  \param determinant determinant of the matrix
+ *  \param logDeterminant log|det| of the matrix, not written without log-domain results
+ */
+static void calcDeterminant(int order, double *matrix, double *determinant, double *logDeterminant)
+{
+  if (precision == PRECISION_DOUBLE){
+    *determinant = getDeterminant(order, matrix);
+    if (logResults) *logDeterminant = getLogDeterminant(order, matrix);                /* from the pivots left in the matrix */
+    return;
+  }
+  bool wide = (precision == PRECISION_MIXED);                                          /* pivots accumulated in double */
+  float *converted = (float *)malloc((size_t)order * order * sizeof(float));
+  convertMatrix(order, matrix, converted);
+  *determinant = getDeterminantFloat(order, converted, wide);
+  if (logResults) *logDeterminant = getLogDeterminantFloat(order, converted, wide);
+  free(converted);
+}
+
+/**
+ *  \brief 
+ *  Stores the determinant of a matrix in the cache, appended to its file at the end of the run
+ *  \param key hash of the terms of the matrix
+ *  \param determinant determinant of the matrix
+ *  \param logDeterminant log|det| of the matrix, ignored without log-domain results
+ */
+static void storeMatrix(uint64_t key, double determinant, double logDeterminant)
+{
+  double value[2] = {determinant, logResults ? logDeterminant : NAN};                  /* NAN: log|det| was not calculated */
+
+  cachePut(cache, key, value);
+}
+
+/**
+ *  \brief 
+ *  Reads the next block of matrices of the files into a slot
+ *  Files are read in order and closed after their last matrix, a block has matrices of a single file
+ *  With a cache the matrices are read one at a time: those found in the cache are stored at once
+ *  and end the block, so a block only has matrices to calculate. The matrices restored from the
+ *  checkpoint are not read
+ *  \param files fileStructures of the files
+ *  \param fps file pointers of the files
+ *  \param fnip number of files
+ *  \param fCk index of the file being read, advanced when it ends
+ *  \param mCk number of matrices already read from the file being read
+ *  \param batch maximum number of matrices of the block
+ *  \param slot slot that will store the block
+ *
+ *  \return true if a block was read, false if all matrices have been read
+ */
+static bool readNextBlock(struct matrixFile *files, FILE **fps, int fnip, int *fCk, int *mCk, int batch, struct matrixSlot *slot)
+{
+  while (*fCk < fnip && *mCk == (int)(files+*fCk)->nMatrix){                            /* move on to the next file with matrices left */
+    fclose(fps[*fCk]);
+    (*fCk)++;
+    *mCk = (*fCk < fnip) ? (int)(files+*fCk)->restoredMatrices : 0;
+  }
+  if (*fCk == fnip) return false;
+
+  int order = (files+*fCk)->order;
+  if (cache != NULL){
+    struct matrixFile *file = files+*fCk;
+    slot->count = 0;
+    slot->fileIndex = *fCk;
+    slot->matrixNumber = *mCk;
+    while (*mCk < (int)file->nMatrix && slot->count < batch){
+      double *matrix = slot->matrix + (size_t)slot->count*order*order;
+      double determinant, logDeterminant;
+      uint64_t readStart = INSTR_NOW();
+      int c = fread(matrix, 8, order*order, fps[*fCk]);                                 /* read the next matrix from file */
+      INSTR_TIME(INSTR_READ_TIME, readStart);
+      INSTR_ADD(INSTR_READ_CALLS, 1);
+      INSTR_ADD(INSTR_READ_BYTES, (uint64_t)c * 8);
+      if (!c) {
+        printf("Error: could not read file %s", file->filename);
+        exit(1);
+        }
+      if (cache == NULL || !lookupMatrix(matrix, order, &slot->keys[slot->count], &determinant, &logDeterminant)){
+        slot->count++;
+        (*mCk)++;
+        continue;
+      }
+      file->matrixDeterminants[*mCk] = determinant;                                     /* found in the cache */
+      if (logResults) file->matrixLogDeterminants[*mCk] = logDeterminant;
+      if (checkpoint != NULL) markDone(file, *mCk, 1);
+      (*mCk)++;
+      if (++file->processedMatrixCounter == file->nMatrix)
+        emitFile(files, *fCk);                                                          /* its other determinants already arrived */
+      if (slot->count > 0) break;                                                       /* the matrices of a block are contiguous */
+      slot->matrixNumber = *mCk;
+    }
+    if (slot->count == 0)                                                               /* every matrix left of the file was cached */
+      return readNextBlock(files, fps, fnip, fCk, mCk, batch, slot);
+    return true;
+  }
+
+  slot->count = (files+*fCk)->nMatrix - *mCk;
+  if (slot->count > batch) slot->count = batch;
+  slot->fileIndex = *fCk;
+  slot->matrixNumber = *mCk;
+  *mCk += slot->count;
+  uint64_t readStart = INSTR_NOW();
+  int c = fread(slot->matrix, 8, slot->count*order*order, fps[*fCk]);                   /* read the matrices of the block from file */
+  INSTR_TIME(INSTR_READ_TIME, readStart);
+  INSTR_ADD(INSTR_READ_CALLS, 1);
+  INSTR_ADD(INSTR_READ_BYTES, (uint64_t)c * 8);
+  if (!c) {
+    printf("Error: could not read file %s", (files+*fCk)->filename);
+    exit(1);
+    }
+  return true;
+}
+
+/**
+ *  \brief 
+ *  Starts sending the block of a slot to a worker
+ *  The order is sent first when the block is from another file than the last one sent to the worker
+ *  \param files fileStructures of the files
+ *  \param worker rank of the worker
+ *  \param workerFile file of the last block sent to each worker
+ *  \param slot slot with the block
+ */
+static void sendBlock(struct matrixFile *files, int worker, int *workerFile, struct matrixSlot *slot)
+{
+  int order = (files+slot->fileIndex)->order;
+
+  if (workerFile[worker] != slot->fileIndex){
+    MPI_Send(&order, 1, MPI_INT, worker, TAGORDER, MPI_COMM_WORLD);                     /* send order once per file */
+    workerFile[worker] = slot->fileIndex;
+  }
+  MPI_Isend(slot->matrix, slot->count*order*order, MPI_DOUBLE, worker, TAGMATRIX, MPI_COMM_WORLD, &slot->request);   /* send block */
+}
+
+/**
+ *  \brief
+ *  Waits for the determinants of a block from any worker, or for a worker to be lost
+ *  Without a worker timeout it blocks until a message arrives. With one, the messages are polled,
+ *  and a worker with blocks in flight that did not answer for the timeout is lost
+ *  \param size number of processes
+ *  \param pending number of blocks in flight of each worker
+ *  \param lastHeard time each worker last answered, or was sent a block while it had none
+ *  \param status status of the message that arrived
+ *
+ *  \return rank of the worker whose determinants arrived, or minus the rank of the worker lost
+ */
+static int waitResult(int size, int *pending, double *lastHeard, MPI_Status *status)
+{
+  int arrived = 0;
+
+  if (workerTimeout == 0){
+    MPI_Probe(MPI_ANY_SOURCE, TAGRESULT, MPI_COMM_WORLD, status);
+    return status->MPI_SOURCE;
+  }
+  while (true){
+    if (MPI_Iprobe(MPI_ANY_SOURCE, TAGRESULT, MPI_COMM_WORLD, &arrived, status) == MPI_SUCCESS && arrived)
+      return status->MPI_SOURCE;
+    double now = MPI_Wtime();
+    for (int nProc = 1; nProc<size; nProc++)
+      if (pending[nProc] > 0 && now - lastHeard[nProc] > workerTimeout)
+        return -nProc;
+  }
+}
+
+/**
+ *  \brief
+ *  Records the part done of every file of the window still in progress in the checkpoint, and writes it
+ *  The files already handed to the result sink were recorded whole
+ *  \param files fileStructures of the files
+ *  \param fnip number of files
+ */
+static void saveCheckpoint(struct matrixFile *files, int fnip)
+{
+  for (int fk = 0; fk<fnip; fk++)
+    if (!(files+fk)->emitted && (files+fk)->donePrefix > (files+fk)->restoredMatrices)
+      recordFile(files+fk, (files+fk)->donePrefix);
+  checkpointFlush(checkpoint);
+}
+
+/**
+ *  \brief
+ *  Gives up on a worker: its blocks in flight will be sent to the other workers
+ *  Its slots are not used again, and the determinants it sends late are received and dropped.
+ *  The job is aborted when no worker is left, after the checkpoint is written
+ *  \param files fileStructures of the files
+ *  \param fnip number of files
+ *  \param nProc rank of the worker
+ *  \param size number of processes
+ *  \param slots slots of every worker
+ *  \param depth number of blocks in flight per worker
+ *  \param oldest oldest slot of each worker
+ *  \param pending number of blocks in flight of each worker
+ *  \param orphans slots whose blocks must be sent again
+ *  \param nOrphans number of those slots
+ *  \param inFlight number of blocks sent whose determinants did not arrive yet
+ */
+static void loseWorker(struct matrixFile *files, int fnip, int nProc, int size, struct matrixSlot *slots, int depth, int *oldest, int *pending,
+                       struct matrixSlot **orphans, int *nOrphans, int *inFlight)
+{
+  lostWorkers[nProc] = true;
+  fprintf(stderr, "worker %d does not answer, its blocks are sent to the other workers\n", nProc);
+  if (++nLost == size-1){
+    fprintf(stderr, "every worker was lost\n");
+    if (checkpoint != NULL) saveCheckpoint(files, fnip);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  for (int k = 0; k<pending[nProc]; k++)
+    orphans[(*nOrphans)++] = slots + (nProc-1)*depth + (oldest[nProc]+k) % depth;
+  *inFlight -= pending[nProc];
+  pending[nProc] = 0;
+}
+
+/**
+ *  \brief
+ *  Hands out blocks of matrices of a window of files to the first worker that becomes free
+ *  Every worker has depth slots with the blocks it was sent. A worker answers its blocks
+ *  in the order they were sent, so the determinants received from it belong to its oldest slot,
+ *  which is then refilled with the block read ahead.
+ *  The order of the matrices is only sent when the file of the blocks of a worker changes.
+ *  The blocks of a lost worker are copied to the free slots of the other workers before any new
+ *  block. With a checkpoint the blocks that arrive advance the part of their file done from its start,
+ *  and the checkpoint is written when its interval has passed
+ *  \param files fileStructures of the files, updated with the determinants
+ *  \param fps file pointers of the files, positioned at the first matrix
+ *  \param fnip number of files
+ *  \param size number of processes
+ *  \param depth number of blocks in flight per worker
+ *  \param batch maximum number of matrices per block
+ */
+static void dispatchDynamic(struct matrixFile *files, FILE **fps, int fnip, int size, int depth, int batch)
+{
+  int nSlots = (size-1)*depth;                                                          /* blocks in flight at most */
+  struct matrixSlot *slots = (struct matrixSlot *)malloc(nSlots * sizeof(struct matrixSlot));
+  int *oldest = (int *)calloc(size, sizeof(int));                                       /* oldest slot of each worker */
+  int *pending = (int *)calloc(size, sizeof(int));                                      /* blocks in flight of each worker */
+  double *lastHeard = (double *)malloc(size * sizeof(double));                          /* time each worker last answered, or was sent a block while it had none */
+  struct matrixSlot **orphans = (struct matrixSlot **)malloc(nSlots * sizeof(struct matrixSlot *));   /* slots of lost workers whose blocks must be sent again */
+  int nOrphans = 0;
+  int *workerFile = (int *)malloc(size * sizeof(int));                                  /* file of the last block sent to each worker */
+  int stride = 1 + logResults;                                                          /* values per matrix of a result */
+  double *determinants = (double *)malloc(batch * stride * sizeof(double));             /* determinants of a block */
+  struct matrixSlot readAhead, swap;
+  int maxOrder = 0;
+  int fCk = 0;                                                                          /* file being read */
+  int mCk = (fnip > 0) ? (int)files->restoredMatrices : 0;                              /* matrices read from it */
+  int inFlight = 0;                                                                     /* blocks sent whose determinants did not arrive yet */
+  bool more;                                                                            /* a block was read ahead */
+
+  for (int fk = 0; fk<fnip; fk++)
+    if ((int)(files+fk)->order > maxOrder) maxOrder = (files+fk)->order;                /* every buffer can hold a block of any file */
+  for (int s = 0; s<nSlots; s++){
+    slots[s].matrix = (double *)malloc(batch * maxOrder * maxOrder * sizeof(double));
+    slots[s].keys = (uint64_t *)malloc(batch * sizeof(uint64_t));
+    slots[s].request = MPI_REQUEST_NULL;
+  }
+  readAhead.matrix = (double *)malloc(batch * maxOrder * maxOrder * sizeof(double));
+  readAhead.keys = (uint64_t *)malloc(batch * sizeof(uint64_t));
+  readAhead.request = MPI_REQUEST_NULL;
+  for (int nProc = 0; nProc<size; nProc++) workerFile[nProc] = -1;
+  for (int fk = 0; fk<fnip; fk++)
+    if ((files+fk)->nMatrix > 0 && (files+fk)->processedMatrixCounter == (files+fk)->nMatrix)
+      emitFile(files, fk);                                                              /* every determinant came from the checkpoint */
+
+  more = readNextBlock(files, fps, fnip, &fCk, &mCk, batch, &readAhead);
+  for (int d = 0; d<depth && more; d++)                                                 /* fill the slots a round at a time */
+    for (int nProc = 1; nProc<size && more; nProc++){
+      if (lostWorkers[nProc]) continue;
+      struct matrixSlot *slot = slots + (nProc-1)*depth + d;
+      swap = *slot; *slot = readAhead; readAhead = swap;
+      sendBlock(files, nProc, workerFile, slot);
+      if (pending[nProc]++ == 0) lastHeard[nProc] = MPI_Wtime();
+      inFlight++;
+      more = readNextBlock(files, fps, fnip, &fCk, &mCk, batch, &readAhead);
+    }
+
+  while (inFlight > 0 || nOrphans > 0){
+    int nProc = 0;                                                                      /* worker to refill, 0 for every worker after a loss */
+    if (inFlight > 0){
+      MPI_Status status;
+      nProc = waitResult(size, pending, lastHeard, &status);
+      if (nProc < 0){
+        loseWorker(files, fnip, -nProc, size, slots, depth, oldest, pending, orphans, &nOrphans, &inFlight);
+        nProc = 0;
+      }
+      else if (lostWorkers[nProc]){
+        MPI_Recv(determinants, batch*stride, MPI_DOUBLE, nProc, TAGRESULT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);   /* its block was sent again */
+        continue;
+      }
+      else{
+        MPI_Recv(determinants, batch*stride, MPI_DOUBLE, nProc, TAGRESULT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);   /* receive the determinants of a block from the worker */
+        inFlight--;
+        pending[nProc]--;
+        lastHeard[nProc] = MPI_Wtime();
+
+        struct matrixSlot *slot = slots + (nProc-1)*depth + oldest[nProc];
+        oldest[nProc] = (oldest[nProc]+1) % depth;
+        struct matrixFile *file = files+slot->fileIndex;
+        if (logResults)
+          for (int k = 0; k<slot->count; k++){                                          /* determinants and log|det| are interleaved */
+            file->matrixDeterminants[slot->matrixNumber+k] = determinants[2*k];
+            file->matrixLogDeterminants[slot->matrixNumber+k] = determinants[2*k+1];
+          }
+        else
+          memcpy(file->matrixDeterminants + slot->matrixNumber,
+                 determinants, slot->count * sizeof(double));                           /* save calculated determinants */
+        for (int k = 0; k<slot->count && cache != NULL; k++)
+          storeMatrix(slot->keys[k], determinants[k*stride], logResults ? determinants[2*k+1] : 0);
+        if (checkpoint != NULL) markDone(file, slot->matrixNumber, slot->count);
+        file->processedMatrixCounter += slot->count;
+        if (file->processedMatrixCounter == file->nMatrix)
+          emitFile(files, slot->fileIndex);                                             /* its last determinants, written while the workers compute */
+        if (checkpoint != NULL && checkpointDue(checkpoint))
+          saveCheckpoint(files, fnip);
+      }
+    }
+
+    for (int w = (nProc == 0) ? 1 : nProc; w<((nProc == 0) ? size : nProc+1); w++)
+      while (!lostWorkers[w] && pending[w] < depth && (more || nOrphans > 0)){
+        struct matrixSlot *slot = slots + (w-1)*depth + (oldest[w]+pending[w]) % depth;
+        MPI_Wait(&slot->request, MPI_STATUS_IGNORE);                                    /* the buffer of the slot can be reused */
+        if (nOrphans > 0){                                                              /* a block of a lost worker, sent before the new ones */
+          struct matrixSlot *orphan = orphans[--nOrphans];
+          int order = (files+orphan->fileIndex)->order;
+          memcpy(slot->matrix, orphan->matrix, (size_t)orphan->count*order*order * sizeof(double));   /* copied, the buffer of the lost slot may still be read by its send */
+          memcpy(slot->keys, orphan->keys, orphan->count * sizeof(uint64_t));
+          slot->count = orphan->count;
+          slot->fileIndex = orphan->fileIndex;
+          slot->matrixNumber = orphan->matrixNumber;
+          sendBlock(files, w, workerFile, slot);
+        }
+        else{
+          swap = *slot; *slot = readAhead; readAhead = swap;
+          sendBlock(files, w, workerFile, slot);                                        /* refill the worker that became free */
+          more = readNextBlock(files, fps, fnip, &fCk, &mCk, batch, &readAhead);        /* read the next block while the workers compute */
+        }
+        if (pending[w]++ == 0) lastHeard[w] = MPI_Wtime();
+        inFlight++;
+      }
+  }
+
+  for (int s = 0; s<nSlots; s++){
+    if (lostWorkers[s/depth+1] && slots[s].request != MPI_REQUEST_NULL)
+      continue;                                                                         /* the send to a lost worker may never complete, its buffers are left allocated */
+    MPI_Wait(&slots[s].request, MPI_STATUS_IGNORE);
+    free(slots[s].matrix);
+    free(slots[s].keys);
+  }
+  free(readAhead.matrix);
+  free(readAhead.keys);
+  free(determinants);
+  free(workerFile);
+  free(slots);
+  free(oldest);
+  free(pending);
+  free(lastHeard);
+  free(orphans);
+}
+
+/**
+ *  \brief 
+ *  Calculates the determinants of the blocks of matrices received with dynamic scheduling
+ *  until the dispatcher sends a message with the stop tag
+ *  The number of matrices of a block is given by the size of its message
+ *  With log-domain results log|det| follows each determinant in the message sent back
+ */
+static void workDynamic(void)
+{
+  double *matrix = NULL, *determinants = NULL;
+  int capacity = 0;                                                                     /* matrix values the buffer can hold */
+  int detCapacity = 0;                                                                  /* determinants the buffer can hold */
+  int order = 0;                                                                        /* order of the matrices of the blocks */
+
+  while(true){
+    MPI_Status status;
+    MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);                                 /* wait for the next message */
+    if (status.MPI_TAG == TAGSTOP){
+      MPI_Recv(NULL, 0, MPI_INT, 0, TAGSTOP, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      break;
+    }
+    if (status.MPI_TAG == TAGORDER){
+      MPI_Recv(&order, 1, MPI_INT, 0, TAGORDER, MPI_COMM_WORLD, MPI_STATUS_IGNORE);     /* receive the order of the next blocks */
+      continue;
+    }
+
+    int values, count;
+    MPI_Get_count(&status, MPI_DOUBLE, &values);
+    count = values / (order*order);                                                     /* number of matrices of the block */
+    if (values > capacity){
+      capacity = values;
+      matrix = (double *)realloc(matrix, capacity * sizeof(double));                    /* buffers grow with the block */
+    }
+    if (count*(1+logResults) > detCapacity){
+      detCapacity = count*(1+logResults);
+      determinants = (double *)realloc(determinants, detCapacity * sizeof(double));
+    }
+    MPI_Recv(matrix, values, MPI_DOUBLE, 0, TAGMATRIX, MPI_COMM_WORLD, MPI_STATUS_IGNORE);   /* receive block */
+
+    uint64_t computeStart = INSTR_NOW();
+    for (int k = 0; k<count; k++){
+      double *m = matrix + k*order*order;
+      calcDeterminant(order, m, &determinants[k*(1+logResults)], &determinants[k*(1+logResults)+logResults]);   /* calculate determinants */
+    }
+    INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+    INSTR_ADD(INSTR_COMPUTE_ITEMS, count);
+    MPI_Send(determinants, count*(1+logResults), MPI_DOUBLE, 0, TAGRESULT, MPI_COMM_WORLD);   /* send the determinants to dispatcher */
+  }
+  free(matrix);
+  free(determinants);
+}
+
+/**
+ *  \brief 
+ *  Calculates the determinants of a window of files with a static partition of the matrices
+ *  Every process opens the file with MPI-IO, reads its own contiguous range of matrices
+ *  and the determinants of all processes are gathered in the dispatcher's fileStructure.
+ *  The number and names of the files are broadcasted by the dispatcher, an empty window stops the workers.
+ *  With a cache every process looks up its own matrices, and the hashes of those it calculated are
+ *  gathered with the determinants so the dispatcher stores them. The matrices factorized by all the
+ *  processes together are not cached, no process has all their terms.
+ *  \param rank rank of the process
+ *  \param size number of processes
+ *  \param filenames names of the files of the window (dispatcher only)
+ *  \param fnip number of files of the window (dispatcher only)
+ *  \param files fileStructures of the files, filled on the dispatcher (dispatcher only)
+ *  \return number of files of the window
+ */
+static int scatterStatic(int rank, int size, char **filenames, int fnip, struct matrixFile *files)
+{
+  int *counts = (int *)malloc(size * sizeof(int));                                      /* matrices of each process */
+  int *displs = (int *)malloc(size * sizeof(int));                                      /* first matrix of each process */
+
+  MPI_Bcast(&fnip, 1, MPI_INT, 0, MPI_COMM_WORLD);                                      /* number of files */
+  for (int fCk = 0; fCk<fnip; fCk++){
+    char filename[4096];                                                                /* name of the current file */
+    int header[2];                                                                      /* number and order of the matrices */
+    MPI_File fh;
+
+    if (rank == 0) strncpy(filename, filenames[fCk], sizeof(filename)-1);
+    filename[sizeof(filename)-1] = '\0';
+    MPI_Bcast(filename, sizeof(filename), MPI_CHAR, 0, MPI_COMM_WORLD);
+
+    if (MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS){
+      printf("Error: could not open file %s", filename);
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_read_at_all(fh, 0, header, 2, MPI_INT, MPI_STATUS_IGNORE);                /* get number and order of the matrices in the file */
+    int numMatrix = header[0];
+    int order = header[1];
+
+    if (rank == 0){
+      (files+fCk)->filename = filenames[fCk];                                           /* save current file's data */
+      (files+fCk)->order = order;                                                       /* save order of the matrices */
+      (files+fCk)->nMatrix = numMatrix;                                                 /* save total number of matrices */
+      (files+fCk)->matrixDeterminants = (double *)malloc(numMatrix * sizeof(double));   /* allocate memory for determinants */
+      (files+fCk)->matrixLogDeterminants = logResults ? (double *)malloc(numMatrix * sizeof(double)) : NULL;
+      (files+fCk)->processedMatrixCounter = 0;
+      (files+fCk)->emitted = false;
+    }
+
+    if (order >= INTRA_ORDER && numMatrix < size && order >= size){                     /* too few matrices to keep every process busy */
+      int nLocal = order/size + (rank < order%size);                                    /* rows rank, rank+size, ... of each matrix */
+      double *rows = (double *)malloc(((size_t)nLocal * order + 1) * sizeof(double));
+      MPI_Datatype rowType;                                                             /* the rows of the process in a matrix */
+      MPI_Type_vector(nLocal, order, size*order, MPI_DOUBLE, &rowType);
+      MPI_Type_commit(&rowType);
+
+      for (int k = 0; k<numMatrix; k++){
+        MPI_Offset offset = 2 * sizeof(int) + ((MPI_Offset)k * order * order + (MPI_Offset)rank * order) * sizeof(double);
+        MPI_File_set_view(fh, offset, MPI_DOUBLE, rowType, "native", MPI_INFO_NULL);
+        MPI_File_read_all(fh, rows, nLocal*order, MPI_DOUBLE, MPI_STATUS_IGNORE);
+
+        double det, logDet;
+        uint64_t computeStart = INSTR_NOW();                                          /* communication included */
+        factorizeDistributed(rank, size, order, rows, &det, &logDet);
+        INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+        INSTR_ADD(INSTR_COMPUTE_ITEMS, 1);
+        if (rank == 0){
+          (files+fCk)->matrixDeterminants[k] = det;
+          if (logResults) (files+fCk)->matrixLogDeterminants[k] = logDet;
+        }
+      }
+
+      MPI_Type_free(&rowType);
+      MPI_File_close(&fh);
+      free(rows);
+      if (rank == 0) emitFile(files, fCk);
+      continue;
+    }
+
+    for (int r = 0; r<size; r++){                                                       /* contiguous ranges, the first ones get the rest */
+      counts[r] = numMatrix/size + (r < numMatrix%size);
+      displs[r] = (r == 0) ? 0 : displs[r-1] + counts[r-1];
+    }
+
+    double *matrix = (double *)malloc(((size_t)counts[rank] * order * order + 1) * sizeof(double));   /* matrices of the process */
+    double *determinants = (double *)malloc((counts[rank] + 1) * sizeof(double));       /* determinants of the process */
+    double *logDeterminants = (double *)malloc((counts[rank] + 1) * sizeof(double));    /* and their log|det| */
+    MPI_Offset offset = 2 * sizeof(int) + (MPI_Offset)displs[rank] * order * order * sizeof(double);
+    MPI_File_read_at_all(fh, offset, matrix, counts[rank]*order*order, MPI_DOUBLE, MPI_STATUS_IGNORE);   /* read the range of the process */
+    MPI_File_close(&fh);
+
+    uint64_t *keys = (uint64_t *)malloc((counts[rank] + 1) * sizeof(uint64_t));         /* hash of each matrix calculated, 0 if cached */
+    uint64_t computeStart = INSTR_NOW();
+    for (int k = 0; k<counts[rank]; k++){
+      if (cache != NULL && lookupMatrix(matrix + (size_t)k*order*order, order, &keys[k], &determinants[k], &logDeterminants[k])){
+        keys[k] = 0;                                                                    /* nothing to store (a hash of 0 is never stored) */
+        continue;
+      }
+      calcDeterminant(order, matrix + (size_t)k*order*order, &determinants[k], logResults ? &logDeterminants[k] : NULL);   /* calculate determinants */
+    }
+    INSTR_TIME(INSTR_COMPUTE_TIME, computeStart);
+    INSTR_ADD(INSTR_COMPUTE_ITEMS, counts[rank]);
+
+    MPI_Gatherv(determinants, counts[rank], MPI_DOUBLE,
+                (rank == 0) ? (files+fCk)->matrixDeterminants : NULL, counts, displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (logResults)
+      MPI_Gatherv(logDeterminants, counts[rank], MPI_DOUBLE,
+                  (rank == 0) ? (files+fCk)->matrixLogDeterminants : NULL, counts, displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (cache != NULL){
+      uint64_t *allKeys = (rank == 0) ? (uint64_t *)malloc((numMatrix + 1) * sizeof(uint64_t)) : NULL;
+      MPI_Gatherv(keys, counts[rank], MPI_UINT64_T, allKeys, counts, displs, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+      for (int k = 0; k<numMatrix && rank == 0; k++)
+        if (allKeys[k] != 0)
+          storeMatrix(allKeys[k], (files+fCk)->matrixDeterminants[k], logResults ? (files+fCk)->matrixLogDeterminants[k] : 0);
+      free(allKeys);
+    }
+    if (rank == 0) emitFile(files, fCk);                                                 /* written while the next file is processed */
+
+    free(matrix);
+    free(determinants);
+    free(logDeterminants);
+    free(keys);
+  }
+
+  free(counts);
+  free(displs);
+  return fnip;
+}
+
+/**
+ *  \brief Factorization of a matrix whose rows are dealt to the processes in turn.
+ *
+ *  Row g of the matrix is the local row g/size of process g%size, so the rows left to eliminate
+ *  stay spread over every process until the end. For each column:
+ *    1 - The pivot, the largest term of the column, is searched by all the processes together.
+ *    2 - Its owner broadcasts the pivot row, and the row it replaces moves to the place of the pivot row.
+ *    3 - Every process eliminates the column from its own rows.
+ *  Every process takes part and gets the determinant.
+ *  \param rank rank of the process
+ *  \param size number of processes
+ *  \param order order of the matrix
+ *  \param rows rows of the process, overwritten
+ *  \param determinant determinant of the matrix
+ *  \param logDeterminant log|det| of the matrix
+ */
+static void factorizeDistributed(int rank, int size, int order, double *rows, double *determinant, double *logDeterminant)
+{
+  double *pivotRow = (double *)malloc(order * sizeof(double));
+  double det = 1, logDet = 0;
+  struct { double value; int row; } local, pivot;                                      /* MPI_DOUBLE_INT */
+
+  for (int i = 0; i<order; i++){
+    int first = i/size + (rank < i%size);                                               /* first local row not eliminated yet */
+    local.value = -1;
+    local.row = order;
+    for (int l = first; l*size+rank < order; l++)
+      if (fabs(rows[(size_t)l*order + i]) > local.value){
+        local.value = fabs(rows[(size_t)l*order + i]);
+        local.row = l*size + rank;
+      }
+    MPI_Allreduce(&local, &pivot, 1, MPI_DOUBLE_INT, MPI_MAXLOC, MPI_COMM_WORLD);       /* ties go to the lowest row, as serially */
+    if (pivot.value == 0){
+      det = 0;
+      logDet = -INFINITY;
+      break;
+    }
+
+    int pOwner = pivot.row % size, iOwner = i % size;
+    double *pLocal = rows + (size_t)(pivot.row/size)*order;
+    double *iLocal = rows + (size_t)(i/size)*order;
+    if (rank == pOwner)
+      memcpy(pivotRow + i, pLocal + i, (order-i) * sizeof(double));
+    if (pivot.row != i){                                                                /* row i goes to the place of the pivot row */
+      if (rank == iOwner && rank == pOwner)
+        memcpy(pLocal + i, iLocal + i, (order-i) * sizeof(double));
+      else if (rank == iOwner)
+        MPI_Send(iLocal + i, order-i, MPI_DOUBLE, pOwner, 0, MPI_COMM_WORLD);
+      else if (rank == pOwner)
+        MPI_Recv(pLocal + i, order-i, MPI_DOUBLE, iOwner, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      det = -det;
+    }
+    MPI_Bcast(pivotRow + i, order-i, MPI_DOUBLE, pOwner, MPI_COMM_WORLD);
+
+    det *= pivotRow[i];
+    logDet += log(fabs(pivotRow[i]));
+    for (int l = (i+1)/size + (rank < (i+1)%size); l*size+rank < order; l++){          /* rows below the pivot */
+      double *row = rows + (size_t)l*order;
+      double term = row[i]/pivotRow[i];
+      for (int j = i+1; j<order; j++)
+        row[j] -= term*pivotRow[j];
+    }
+  }
+
+  free(pivotRow);
+  *determinant = det;
+  *logDeterminant = logDet;
+}
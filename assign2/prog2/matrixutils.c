@@ -5,6 +5,13 @@
 
  *  Utility functions to calculate the determinant of a matrix
  *
+ *  The determinant is the product of the pivots of an LU factorization with partial
+ *  pivoting (argmax of the column, a single row swap per column).
+ *  Small orders have kernels specialized at compile time, larger ones are factorized
+ *  by panels with the trailing matrix updated by vectorized row kernels.
+ *  The same factorizations exist in single precision, for matrices converted on load,
+ *  with the product of the pivots accumulated in float or in double (mixed precision).
+ *
  *  \author Pedro Marques - April 2022
  */
 
@@ -13,50 +20,655 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdbool.h>
+
+#include "matrixutils.h"
+
+/** \brief largest order with a specialized kernel */
+#define SMALL_ORDER 16
 
+/** \brief number of columns of a panel of the blocked factorization */
+#define PANEL 32
+
+/** \brief number of columns of the trailing matrix updated at a time */
+#define COLUMN_BLOCK 256
+
+/** \brief fewest rows of the trailing matrix per task of a parallel factorization */
+#define TASK_ROWS 32
 
 /**
- *  \brief 
+ *  \brief
+ *  Signature of the row update kernels
+ *  Subtracts from dst the combination of nb rows of u (ld values apart) with the factors l
+ *  dst[j] -= l[0]*u[j] + l[1]*u[ld+j] + ... for j < len
+ */
+typedef void (*rowUpdate)(double *restrict dst, const double *restrict l, const double *restrict u, int ld, int nb, int len);
+
+/**
+ *  \brief
+ *  Eliminates the matrix below the diagonal, column by column
+ *  Inlined in the kernels of each small order, so the loops have constant bounds
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *
+ *  \return the determinant of the matrix
+ */
+static inline __attribute__((always_inline)) double eliminate(int order, double *matrix){
+    double det = 1;
+    for(int i=0;i<order;i++){
+        double *pivotRow = matrix+i*order;
+        //Partial Pivoting, the largest term (absolute value) of the column
+        int p = i;
+        double largest = fabs(pivotRow[i]);
+        for(int k=i+1;k<order;k++){
+            if(fabs(*((matrix+k*order) + i))>largest){
+                largest = fabs(*((matrix+k*order) + i));
+                p = k;
+            }
+        }
+        if(largest == 0) return 0;
+        if(p != i){
+            //Swap the rows, the columns on the left are no longer needed
+            for(int j=i;j<order;j++){
+                double temp=pivotRow[j];
+                pivotRow[j]=*((matrix+p*order) + j);
+                *((matrix+p*order) + j)=temp;
+            }
+            det = -det;
+        }
+        det *= pivotRow[i];
+        //Gauss Elimination of the terms on the right of the pivot
+        for(int k=i+1;k<order;k++){
+            double *row = matrix+k*order;
+            double term=row[i]/pivotRow[i];
+            for(int j=i+1;j<order;j++){
+                row[j]-=term*pivotRow[j];
+            }
+        }
+    }
+    return det;
+}
+
+/** \brief defines the kernel of a small order */
+#define SMALL_KERNEL(N) \
+    static double determinant##N(double *matrix){ return eliminate(N, matrix); }
+
+SMALL_KERNEL(1) SMALL_KERNEL(2) SMALL_KERNEL(3) SMALL_KERNEL(4)
+SMALL_KERNEL(5) SMALL_KERNEL(6) SMALL_KERNEL(7) SMALL_KERNEL(8)
+SMALL_KERNEL(9) SMALL_KERNEL(10) SMALL_KERNEL(11) SMALL_KERNEL(12)
+SMALL_KERNEL(13) SMALL_KERNEL(14) SMALL_KERNEL(15) SMALL_KERNEL(16)
+
+/** \brief kernels of the small orders, indexed by order */
+static double (*const smallKernels[SMALL_ORDER+1])(double *matrix) = {
+    NULL, determinant1, determinant2, determinant3, determinant4,
+    determinant5, determinant6, determinant7, determinant8,
+    determinant9, determinant10, determinant11, determinant12,
+    determinant13, determinant14, determinant15, determinant16
+};
+
+/**
+ *  \brief
+ *  Row update kernel without vector instructions
+ */
+static void updateRowGeneric(double *restrict dst, const double *restrict l, const double *restrict u, int ld, int nb, int len){
+    for(int j=0;j<len;j++){
+        double acc = dst[j];
+        for(int i=0;i<nb;i++)
+            acc -= l[i]*u[i*ld+j];
+        dst[j] = acc;
+    }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+#include <immintrin.h>
+
+/**
+ *  \brief
+ *  Row update kernel with AVX2 and FMA
+ *  16 terms of dst are kept in registers while the nb rows are subtracted
+ */
+__attribute__((target("avx2,fma"))) static void updateRowAVX2(double *restrict dst, const double *restrict l, const double *restrict u, int ld, int nb, int len){
+    int j = 0;
+    for(;j+16<=len;j+=16){
+        __m256d a0 = _mm256_loadu_pd(dst+j), a1 = _mm256_loadu_pd(dst+j+4);
+        __m256d a2 = _mm256_loadu_pd(dst+j+8), a3 = _mm256_loadu_pd(dst+j+12);
+        for(int i=0;i<nb;i++){
+            const double *ui = u+i*ld+j;
+            __m256d f = _mm256_broadcast_sd(l+i);
+            a0 = _mm256_fnmadd_pd(f, _mm256_loadu_pd(ui), a0);
+            a1 = _mm256_fnmadd_pd(f, _mm256_loadu_pd(ui+4), a1);
+            a2 = _mm256_fnmadd_pd(f, _mm256_loadu_pd(ui+8), a2);
+            a3 = _mm256_fnmadd_pd(f, _mm256_loadu_pd(ui+12), a3);
+        }
+        _mm256_storeu_pd(dst+j, a0); _mm256_storeu_pd(dst+j+4, a1);
+        _mm256_storeu_pd(dst+j+8, a2); _mm256_storeu_pd(dst+j+12, a3);
+    }
+    for(;j+4<=len;j+=4){
+        __m256d a = _mm256_loadu_pd(dst+j);
+        for(int i=0;i<nb;i++)
+            a = _mm256_fnmadd_pd(_mm256_broadcast_sd(l+i), _mm256_loadu_pd(u+i*ld+j), a);
+        _mm256_storeu_pd(dst+j, a);
+    }
+    updateRowGeneric(dst+j, l, u+j, ld, nb, len-j);
+}
+
+/**
+ *  \brief
+ *  Row update kernel with AVX-512
+ *  32 terms of dst are kept in registers while the nb rows are subtracted
+ */
+__attribute__((target("avx512f"))) static void updateRowAVX512(double *restrict dst, const double *restrict l, const double *restrict u, int ld, int nb, int len){
+    int j = 0;
+    for(;j+32<=len;j+=32){
+        __m512d a0 = _mm512_loadu_pd(dst+j), a1 = _mm512_loadu_pd(dst+j+8);
+        __m512d a2 = _mm512_loadu_pd(dst+j+16), a3 = _mm512_loadu_pd(dst+j+24);
+        for(int i=0;i<nb;i++){
+            const double *ui = u+i*ld+j;
+            __m512d f = _mm512_set1_pd(l[i]);
+            a0 = _mm512_fnmadd_pd(f, _mm512_loadu_pd(ui), a0);
+            a1 = _mm512_fnmadd_pd(f, _mm512_loadu_pd(ui+8), a1);
+            a2 = _mm512_fnmadd_pd(f, _mm512_loadu_pd(ui+16), a2);
+            a3 = _mm512_fnmadd_pd(f, _mm512_loadu_pd(ui+24), a3);
+        }
+        _mm512_storeu_pd(dst+j, a0); _mm512_storeu_pd(dst+j+8, a1);
+        _mm512_storeu_pd(dst+j+16, a2); _mm512_storeu_pd(dst+j+24, a3);
+    }
+    for(;j+8<=len;j+=8){
+        __m512d a = _mm512_loadu_pd(dst+j);
+        for(int i=0;i<nb;i++)
+            a = _mm512_fnmadd_pd(_mm512_set1_pd(l[i]), _mm512_loadu_pd(u+i*ld+j), a);
+        _mm512_storeu_pd(dst+j, a);
+    }
+    updateRowGeneric(dst+j, l, u+j, ld, nb, len-j);
+}
+#endif
+
+/**
+ *  \brief
+ *  Chooses the widest row update kernel the processor supports
+ *
+ *  \return the row update kernel
+ */
+static rowUpdate selectRowUpdate(void){
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+    if(__builtin_cpu_supports("avx512f")) return updateRowAVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return updateRowAVX2;
+#endif
+    return updateRowGeneric;
+}
+
+/** \brief trailing matrix update of a panel, split in ranges of rows */
+struct trailingUpdate
+{
+    double *matrix;
+    int order;
+    int kb;             /* first column of the panel */
+    int je;             /* end of the panel, first row and column of the trailing matrix */
+    int nTasks;         /* number of ranges of rows */
+    rowUpdate update;
+};
+
+/**
+ *  \brief
+ *  Updates a range of rows of the trailing matrix with the panel, COLUMN_BLOCK columns at a time
+ *  The ranges of rows are independent, so they can be updated in parallel
+ *  \param arg the trailingUpdate of the panel
+ *  \param task index of the range of rows
+ */
+static void updateTrailingRows(void *arg, int task){
+    struct trailingUpdate *t = (struct trailingUpdate *)arg;
+    double *matrix = t->matrix;
+    int order = t->order, kb = t->kb, je = t->je;
+    int first = je + (int)((long)(order-je)*task/t->nTasks);
+    int last = je + (int)((long)(order-je)*(task+1)/t->nTasks);
+    for(int jb=je;jb<order;jb+=COLUMN_BLOCK){
+        int len = (jb+COLUMN_BLOCK<order) ? COLUMN_BLOCK : order-jb;
+        for(int r=first;r<last;r++)
+            t->update(matrix+r*order+jb, matrix+r*order+kb, matrix+kb*order+jb, order, je-kb, len);
+    }
+}
+
+/**
+ *  \brief
+ *  Right-looking blocked LU factorization with partial pivoting
+ *  For each panel of PANEL columns:
+ *  1. The panel is factorized column by column, the multipliers are stored below the diagonal.
+ *  2. The rows of U on the right of the panel are obtained by forward substitution.
+ *  3. The trailing matrix is updated with the panel, COLUMN_BLOCK columns at a time,
+ *     by up to nTasks ranges of rows run through pfor (inline when pfor is NULL).
+ *  Every term goes through the same operations whatever the number of tasks, so the result does not change.
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \param update row update kernel
+ *  \param nTasks largest number of ranges of rows of a trailing update
+ *  \param pfor runs the ranges of rows in parallel (or NULL)
+ *  \param ctx argument of pfor
+ *
+ *  \return the determinant of the matrix
+ */
+static double factorizeBlocked(int order, double *matrix, rowUpdate update, int nTasks, parallelFor pfor, void *ctx){
+    double det = 1;
+    for(int kb=0;kb<order;kb+=PANEL){
+        int je = (kb+PANEL<order) ? kb+PANEL : order;                             /* end of the panel */
+        for(int i=kb;i<je;i++){
+            double *pivotRow = matrix+i*order;
+            //Partial Pivoting, the largest term (absolute value) of the column
+            int p = i;
+            double largest = fabs(pivotRow[i]);
+            for(int k=i+1;k<order;k++){
+                if(fabs(*((matrix+k*order) + i))>largest){
+                    largest = fabs(*((matrix+k*order) + i));
+                    p = k;
+                }
+            }
+            if(largest == 0) return 0;
+            if(p != i){
+                //Swap the rows, the columns of the previous panels are no longer needed
+                for(int j=kb;j<order;j++){
+                    double temp=pivotRow[j];
+                    pivotRow[j]=*((matrix+p*order) + j);
+                    *((matrix+p*order) + j)=temp;
+                }
+                det = -det;
+            }
+            det *= pivotRow[i];
+            //Gauss Elimination inside the panel, the multipliers are kept for the updates
+            for(int k=i+1;k<order;k++){
+                double *row = matrix+k*order;
+                double term = row[i] /= pivotRow[i];
+                for(int j=i+1;j<je;j++){
+                    row[j]-=term*pivotRow[j];
+                }
+            }
+        }
+        //rows of U on the right of the panel
+        for(int r=kb+1;r<je;r++)
+            update(matrix+r*order+je, matrix+r*order+kb, matrix+kb*order+je, order, r-kb, order-je);
+        //trailing matrix
+        struct trailingUpdate t = {matrix, order, kb, je, 1, update};
+        if(pfor != NULL && (order-je)/TASK_ROWS > 1){
+            t.nTasks = ((order-je)/TASK_ROWS < nTasks) ? (order-je)/TASK_ROWS : nTasks;
+            pfor(ctx, t.nTasks, updateTrailingRows, &t);
+        }
+        else
+            updateTrailingRows(&t, 0);
+    }
+    return det;
+}
+
+/**
+ *  \brief
  *  Calculates the determinant of a given matrix
+ *  The matrix is overwritten by its factorization
  *  \param matrix the matrix to be processed
  *  \param argv order of the matrix
  *
  *  \return the determinant of the matrix
  */
 double getDeterminant(int order, double *matrix){
-    int i,j,k;
-    int swaps = 0;
-    for(i=0;i<order-1;i++){
-        //Partial Pivoting
-        for(k=i+1;k<order;k++){
-            //If diagonal element(absolute vallue) is smaller than any of the terms below it
-            if(fabs(*((matrix+i*order) + i))<fabs(*((matrix+k*order) + i))){
-                //Swap the rows
-                swaps++;
-                for(j=0;j<order;j++){                
-                    double temp;
-                    temp=*((matrix+i*order) + j);
-                    *((matrix+i*order) + j)=*((matrix+k*order) + j);
-                    *((matrix+k*order) + j)=temp;
-                }
+    if(order<1) return 1;
+    if(order<=SMALL_ORDER) return smallKernels[order](matrix);
+    return factorizeBlocked(order, matrix, selectRowUpdate(), 1, NULL, NULL);
+}
+
+/**
+ *  \brief
+ *  Calculates the determinant of a given matrix, with the trailing updates of its factorization
+ *  split in ranges of rows that run in parallel
+ *  The matrix is overwritten by its factorization, which is the same as the one of getDeterminant
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \param nTasks largest number of ranges of rows of a trailing update
+ *  \param pfor runs the ranges of rows in parallel
+ *  \param ctx argument of pfor
+ *
+ *  \return the determinant of the matrix
+ */
+double getDeterminantParallel(int order, double *matrix, int nTasks, parallelFor pfor, void *ctx){
+    if(order<=SMALL_ORDER) return getDeterminant(order, matrix);
+    return factorizeBlocked(order, matrix, selectRowUpdate(), nTasks, pfor, ctx);
+}
+
+/**
+ *  \brief 
+ *  Calculates the logarithm of the absolute value of the determinant of a matrix
+ *  already factorized by getDeterminant, as the sum of the logarithms of its pivots
+ *  It does not overflow or underflow for large orders
+ *  \param order order of the matrix
+ *  \param matrix the matrix factorized by getDeterminant
+ *
+ *  \return log|det|, or -inf if the matrix is singular
+ */
+double getLogDeterminant(int order, double *matrix){
+    double logDet = 0;
+    for(int i=0;i<order;i++)
+        logDet += log(fabs(*((matrix+i*order) + i)));
+    return logDet;
+}
+
+/**
+ *  \brief
+ *  Signature of the single precision row update kernels, as rowUpdate
+ */
+typedef void (*rowUpdateFloat)(float *restrict dst, const float *restrict l, const float *restrict u, int ld, int nb, int len);
+
+/**
+ *  \brief
+ *  Converts a matrix to single precision, on load of the reduced precision modes
+ *  \param order order of the matrix
+ *  \param matrix the matrix read from the file
+ *  \param converted its terms rounded to single precision
+ */
+void convertMatrix(int order, const double *matrix, float *converted){
+    for(long e=0;e<(long)order*order;e++)
+        converted[e] = (float)matrix[e];
+}
+
+/**
+ *  \brief
+ *  Eliminates the matrix below the diagonal in single precision, as eliminate
+ *  The pivots are multiplied in double when wide (mixed precision), in float otherwise
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \param wide the product of the pivots is accumulated in double
+ *
+ *  \return the determinant of the matrix
+ */
+static inline __attribute__((always_inline)) double eliminateFloat(int order, float *matrix, bool wide){
+    double det = 1;
+    float detFloat = 1;
+    for(int i=0;i<order;i++){
+        float *pivotRow = matrix+i*order;
+        //Partial Pivoting, the largest term (absolute value) of the column
+        int p = i;
+        float largest = fabsf(pivotRow[i]);
+        for(int k=i+1;k<order;k++){
+            if(fabsf(*((matrix+k*order) + i))>largest){
+                largest = fabsf(*((matrix+k*order) + i));
+                p = k;
+            }
+        }
+        if(largest == 0) return 0;
+        if(p != i){
+            //Swap the rows, the columns on the left are no longer needed
+            for(int j=i;j<order;j++){
+                float temp=pivotRow[j];
+                pivotRow[j]=*((matrix+p*order) + j);
+                *((matrix+p*order) + j)=temp;
             }
+            det = -det;
+            detFloat = -detFloat;
         }
-        //Begin Gauss Elimination
-        for(k=i+1;k<order;k++){
-            double  term=*((matrix+k*order) + i)/ *((matrix+i*order) + i);
-            for(j=0;j<order;j++){
-                *((matrix+k*order) + j)=*((matrix+k*order) + j)-term*(*((matrix+i*order) + j));
+        if(wide) det *= pivotRow[i];
+        else detFloat *= pivotRow[i];
+        //Gauss Elimination of the terms on the right of the pivot
+        for(int k=i+1;k<order;k++){
+            float *row = matrix+k*order;
+            float term=row[i]/pivotRow[i];
+            for(int j=i+1;j<order;j++){
+                row[j]-=term*pivotRow[j];
             }
         }
     }
-    
+    return wide ? det : detFloat;
+}
+
+/** \brief defines the single precision kernel of a small order */
+#define SMALL_KERNEL_FLOAT(N) \
+    static double determinantFloat##N(float *matrix, bool wide){ return eliminateFloat(N, matrix, wide); }
+
+SMALL_KERNEL_FLOAT(1) SMALL_KERNEL_FLOAT(2) SMALL_KERNEL_FLOAT(3) SMALL_KERNEL_FLOAT(4)
+SMALL_KERNEL_FLOAT(5) SMALL_KERNEL_FLOAT(6) SMALL_KERNEL_FLOAT(7) SMALL_KERNEL_FLOAT(8)
+SMALL_KERNEL_FLOAT(9) SMALL_KERNEL_FLOAT(10) SMALL_KERNEL_FLOAT(11) SMALL_KERNEL_FLOAT(12)
+SMALL_KERNEL_FLOAT(13) SMALL_KERNEL_FLOAT(14) SMALL_KERNEL_FLOAT(15) SMALL_KERNEL_FLOAT(16)
+
+/** \brief single precision kernels of the small orders, indexed by order */
+static double (*const smallKernelsFloat[SMALL_ORDER+1])(float *matrix, bool wide) = {
+    NULL, determinantFloat1, determinantFloat2, determinantFloat3, determinantFloat4,
+    determinantFloat5, determinantFloat6, determinantFloat7, determinantFloat8,
+    determinantFloat9, determinantFloat10, determinantFloat11, determinantFloat12,
+    determinantFloat13, determinantFloat14, determinantFloat15, determinantFloat16
+};
+
+/**
+ *  \brief
+ *  Single precision row update kernel without vector instructions
+ */
+static void updateRowFloatGeneric(float *restrict dst, const float *restrict l, const float *restrict u, int ld, int nb, int len){
+    for(int j=0;j<len;j++){
+        float acc = dst[j];
+        for(int i=0;i<nb;i++)
+            acc -= l[i]*u[i*ld+j];
+        dst[j] = acc;
+    }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+/**
+ *  \brief
+ *  Single precision row update kernel with AVX2 and FMA
+ *  32 terms of dst are kept in registers, twice as many as in double precision
+ */
+__attribute__((target("avx2,fma"))) static void updateRowFloatAVX2(float *restrict dst, const float *restrict l, const float *restrict u, int ld, int nb, int len){
+    int j = 0;
+    for(;j+32<=len;j+=32){
+        __m256 a0 = _mm256_loadu_ps(dst+j), a1 = _mm256_loadu_ps(dst+j+8);
+        __m256 a2 = _mm256_loadu_ps(dst+j+16), a3 = _mm256_loadu_ps(dst+j+24);
+        for(int i=0;i<nb;i++){
+            const float *ui = u+i*ld+j;
+            __m256 f = _mm256_broadcast_ss(l+i);
+            a0 = _mm256_fnmadd_ps(f, _mm256_loadu_ps(ui), a0);
+            a1 = _mm256_fnmadd_ps(f, _mm256_loadu_ps(ui+8), a1);
+            a2 = _mm256_fnmadd_ps(f, _mm256_loadu_ps(ui+16), a2);
+            a3 = _mm256_fnmadd_ps(f, _mm256_loadu_ps(ui+24), a3);
+        }
+        _mm256_storeu_ps(dst+j, a0); _mm256_storeu_ps(dst+j+8, a1);
+        _mm256_storeu_ps(dst+j+16, a2); _mm256_storeu_ps(dst+j+24, a3);
+    }
+    for(;j+8<=len;j+=8){
+        __m256 a = _mm256_loadu_ps(dst+j);
+        for(int i=0;i<nb;i++)
+            a = _mm256_fnmadd_ps(_mm256_broadcast_ss(l+i), _mm256_loadu_ps(u+i*ld+j), a);
+        _mm256_storeu_ps(dst+j, a);
+    }
+    updateRowFloatGeneric(dst+j, l, u+j, ld, nb, len-j);
+}
+
+/**
+ *  \brief
+ *  Single precision row update kernel with AVX-512
+ *  64 terms of dst are kept in registers
+ */
+__attribute__((target("avx512f"))) static void updateRowFloatAVX512(float *restrict dst, const float *restrict l, const float *restrict u, int ld, int nb, int len){
+    int j = 0;
+    for(;j+64<=len;j+=64){
+        __m512 a0 = _mm512_loadu_ps(dst+j), a1 = _mm512_loadu_ps(dst+j+16);
+        __m512 a2 = _mm512_loadu_ps(dst+j+32), a3 = _mm512_loadu_ps(dst+j+48);
+        for(int i=0;i<nb;i++){
+            const float *ui = u+i*ld+j;
+            __m512 f = _mm512_set1_ps(l[i]);
+            a0 = _mm512_fnmadd_ps(f, _mm512_loadu_ps(ui), a0);
+            a1 = _mm512_fnmadd_ps(f, _mm512_loadu_ps(ui+16), a1);
+            a2 = _mm512_fnmadd_ps(f, _mm512_loadu_ps(ui+32), a2);
+            a3 = _mm512_fnmadd_ps(f, _mm512_loadu_ps(ui+48), a3);
+        }
+        _mm512_storeu_ps(dst+j, a0); _mm512_storeu_ps(dst+j+16, a1);
+        _mm512_storeu_ps(dst+j+32, a2); _mm512_storeu_ps(dst+j+48, a3);
+    }
+    for(;j+16<=len;j+=16){
+        __m512 a = _mm512_loadu_ps(dst+j);
+        for(int i=0;i<nb;i++)
+            a = _mm512_fnmadd_ps(_mm512_set1_ps(l[i]), _mm512_loadu_ps(u+i*ld+j), a);
+        _mm512_storeu_ps(dst+j, a);
+    }
+    updateRowFloatGeneric(dst+j, l, u+j, ld, nb, len-j);
+}
+#endif
+
+/**
+ *  \brief
+ *  Chooses the widest single precision row update kernel the processor supports
+ *
+ *  \return the row update kernel
+ */
+static rowUpdateFloat selectRowUpdateFloat(void){
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_SIMD)
+    if(__builtin_cpu_supports("avx512f")) return updateRowFloatAVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return updateRowFloatAVX2;
+#endif
+    return updateRowFloatGeneric;
+}
+
+/** \brief trailing matrix update of a panel in single precision, as trailingUpdate */
+struct trailingUpdateFloat
+{
+    float *matrix;
+    int order;
+    int kb;             /* first column of the panel */
+    int je;             /* end of the panel, first row and column of the trailing matrix */
+    int nTasks;         /* number of ranges of rows */
+    rowUpdateFloat update;
+};
+
+/**
+ *  \brief
+ *  Updates a range of rows of the trailing matrix in single precision, as updateTrailingRows
+ *  \param arg the trailingUpdateFloat of the panel
+ *  \param task index of the range of rows
+ */
+static void updateTrailingRowsFloat(void *arg, int task){
+    struct trailingUpdateFloat *t = (struct trailingUpdateFloat *)arg;
+    float *matrix = t->matrix;
+    int order = t->order, kb = t->kb, je = t->je;
+    int first = je + (int)((long)(order-je)*task/t->nTasks);
+    int last = je + (int)((long)(order-je)*(task+1)/t->nTasks);
+    for(int jb=je;jb<order;jb+=COLUMN_BLOCK){
+        int len = (jb+COLUMN_BLOCK<order) ? COLUMN_BLOCK : order-jb;
+        for(int r=first;r<last;r++)
+            t->update(matrix+r*order+jb, matrix+r*order+kb, matrix+kb*order+jb, order, je-kb, len);
+    }
+}
+
+/**
+ *  \brief
+ *  Right-looking blocked LU factorization with partial pivoting in single precision, as factorizeBlocked
+ *  The pivots are multiplied in double when wide (mixed precision), in float otherwise
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \param wide the product of the pivots is accumulated in double
+ *  \param update row update kernel
+ *  \param nTasks largest number of ranges of rows of a trailing update
+ *  \param pfor runs the ranges of rows in parallel (or NULL)
+ *  \param ctx argument of pfor
+ *
+ *  \return the determinant of the matrix
+ */
+static double factorizeBlockedFloat(int order, float *matrix, bool wide, rowUpdateFloat update, int nTasks, parallelFor pfor, void *ctx){
     double det = 1;
-    for(int i=0; i<order; i++){
-        det *= (*((matrix+i*order) + i));
+    float detFloat = 1;
+    for(int kb=0;kb<order;kb+=PANEL){
+        int je = (kb+PANEL<order) ? kb+PANEL : order;                             /* end of the panel */
+        for(int i=kb;i<je;i++){
+            float *pivotRow = matrix+i*order;
+            //Partial Pivoting, the largest term (absolute value) of the column
+            int p = i;
+            float largest = fabsf(pivotRow[i]);
+            for(int k=i+1;k<order;k++){
+                if(fabsf(*((matrix+k*order) + i))>largest){
+                    largest = fabsf(*((matrix+k*order) + i));
+                    p = k;
+                }
+            }
+            if(largest == 0) return 0;
+            if(p != i){
+                //Swap the rows, the columns of the previous panels are no longer needed
+                for(int j=kb;j<order;j++){
+                    float temp=pivotRow[j];
+                    pivotRow[j]=*((matrix+p*order) + j);
+                    *((matrix+p*order) + j)=temp;
+                }
+                det = -det;
+                detFloat = -detFloat;
+            }
+            if(wide) det *= pivotRow[i];
+            else detFloat *= pivotRow[i];
+            //Gauss Elimination inside the panel, the multipliers are kept for the updates
+            for(int k=i+1;k<order;k++){
+                float *row = matrix+k*order;
+                float term = row[i] /= pivotRow[i];
+                for(int j=i+1;j<je;j++){
+                    row[j]-=term*pivotRow[j];
+                }
+            }
+        }
+        //rows of U on the right of the panel
+        for(int r=kb+1;r<je;r++)
+            update(matrix+r*order+je, matrix+r*order+kb, matrix+kb*order+je, order, r-kb, order-je);
+        //trailing matrix
+        struct trailingUpdateFloat t = {matrix, order, kb, je, 1, update};
+        if(pfor != NULL && (order-je)/TASK_ROWS > 1){
+            t.nTasks = ((order-je)/TASK_ROWS < nTasks) ? (order-je)/TASK_ROWS : nTasks;
+            pfor(ctx, t.nTasks, updateTrailingRowsFloat, &t);
+        }
+        else
+            updateTrailingRowsFloat(&t, 0);
     }
-	return pow(-1,swaps)*det;;
+    return wide ? det : detFloat;
+}
 
-             
+/**
+ *  \brief
+ *  Calculates the determinant of a matrix converted to single precision
+ *  The elimination is done in float, which halves the memory traffic and doubles the width of the
+ *  vector kernels; the product of the pivots is accumulated in double when wide (mixed precision),
+ *  so it neither overflows nor loses more than the rounding of the pivots themselves
+ *  The matrix is overwritten by its factorization
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \param wide the product of the pivots is accumulated in double
+ *
+ *  \return the determinant of the matrix
+ */
+double getDeterminantFloat(int order, float *matrix, bool wide){
+    if(order<1) return 1;
+    if(order<=SMALL_ORDER) return smallKernelsFloat[order](matrix, wide);
+    return factorizeBlockedFloat(order, matrix, wide, selectRowUpdateFloat(), 1, NULL, NULL);
 }
 
+/**
+ *  \brief
+ *  Calculates the determinant of a matrix converted to single precision, with the trailing updates
+ *  of its factorization split in ranges of rows that run in parallel, as getDeterminantParallel
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \param wide the product of the pivots is accumulated in double
+ *  \param nTasks largest number of ranges of rows of a trailing update
+ *  \param pfor runs the ranges of rows in parallel
+ *  \param ctx argument of pfor
+ *
+ *  \return the determinant of the matrix
+ */
+double getDeterminantFloatParallel(int order, float *matrix, bool wide, int nTasks, parallelFor pfor, void *ctx){
+    if(order<=SMALL_ORDER) return getDeterminantFloat(order, matrix, wide);
+    return factorizeBlockedFloat(order, matrix, wide, selectRowUpdateFloat(), nTasks, pfor, ctx);
+}
 
+/**
+ *  \brief
+ *  Calculates the logarithm of the absolute value of the determinant of a matrix
+ *  already factorized by getDeterminantFloat, summed in double when wide, in float otherwise
+ *  \param order order of the matrix
+ *  \param matrix the matrix factorized by getDeterminantFloat
+ *  \param wide the logarithms of the pivots are summed in double
+ *
+ *  \return log|det|, or -inf if the matrix is singular
+ */
+double getLogDeterminantFloat(int order, float *matrix, bool wide){
+    double logDet = 0;
+    float logDetFloat = 0;
+    for(int i=0;i<order;i++){
+        if(wide) logDet += log(fabs(*((matrix+i*order) + i)));
+        else logDetFloat += logf(fabsf(*((matrix+i*order) + i)));
+    }
+    return wide ? logDet : logDetFloat;
+}
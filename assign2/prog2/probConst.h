@@ -16,5 +16,39 @@
 /** \brief maximum number of files */
 #define  M           12
 
+/** \brief matrices are handed out in lock-step rounds */
+#define  SCHED_ROUNDS    0
+
+/** \brief matrices are handed out to the first worker that becomes free */
+#define  SCHED_DYNAMIC   1
+
+/** \brief every process reads and processes its own range of the matrices */
+#define  SCHED_SCATTER   2
+
+/** \brief the matrices are eliminated in double precision */
+#define  PRECISION_DOUBLE  0
+
+/** \brief the matrices are converted to float on load and eliminated in float, the pivots multiplied in float */
+#define  PRECISION_FLOAT   1
+
+/** \brief as PRECISION_FLOAT, but the pivots (or their logarithms) are accumulated in double */
+#define  PRECISION_MIXED   2
+
+/** \brief with scatter scheduling, files with fewer matrices than processes and at least this order
+    have each matrix factorized by all the processes together */
+#define  INTRA_ORDER 512
+
+/** \brief default number of messages in flight per worker (dynamic scheduling) */
+#define  DP          1
+
+/** \brief default number of matrices per message (dynamic scheduling) */
+#define  DB          1
+
+/** \brief kind of the records of a checkpoint (determinants of the matrices of each file done from its start) */
+#define  CHECKPOINT_KIND 2
+
+/** \brief seconds between two writes of the checkpoint */
+#define  CI          10
+
 
 #endif /* PROBCONST_H_ */
\ No newline at end of file
@@ -0,0 +1,153 @@
+/**
+ *  \file factorized.cu (implementation file)
+ *
+ *  \brief Kernels around the batched LU factorization of cuBLAS, shared by the CUDA matrix determinant programs.
+ */
+
+#include <math.h>
+#include "factorized.h"
+
+/**
+ *  \brief
+ *  Stores the address of each matrix of a batch, as the batched cuBLAS factorization expects.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param pointers array of the address of each matrix
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+__global__ void fillMatrixPointers(double *matrices, double **pointers, int numMatrices, int order)
+{
+  int matrixIndex = blockIdx.x * blockDim.x + threadIdx.x;
+  if (matrixIndex < numMatrices)
+    pointers[matrixIndex] = matrices + (size_t)matrixIndex * order * order;
+}
+
+/**
+ *  \brief
+ *  Calculates the determinant of each matrix factorized by cublasDgetrfBatched, one thread per matrix.
+ *
+ *  The determinant is the product of the diagonal of U, with a change of sign for every row that was
+ *  swapped (pivots[i] != i + 1). A positive status marks an exactly zero pivot, so a singular matrix.
+ *
+ *  \param factorized array of the LU factors of each matrix
+ *  \param pivots array of the pivots of each factorization (1-based)
+ *  \param info array of the status of each factorization
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+__global__ void calcDeterminantsFactorized(const double *factorized, const int *pivots, const int *info, double *determinants, double *logDeterminants, int numMatrices, int order)
+{
+  int matrixIndex = blockIdx.x * blockDim.x + threadIdx.x;
+  if (matrixIndex >= numMatrices)
+    return;
+
+  const double *matrix = factorized + (size_t)matrixIndex * order * order;
+  const int *pivot = pivots + (size_t)matrixIndex * order;
+  double det = 1, logDet = 0;
+  if (info[matrixIndex] > 0) // singular matrix
+  {
+    det = 0;
+    logDet = -INFINITY;
+  }
+  else
+  {
+    for (int i = 0; i < order; i++)
+    {
+      double term = matrix[(size_t)i * order + i];
+      det *= (pivot[i] != i + 1) ? -term : term;
+      logDet += log(fabs(term));
+    }
+  }
+
+  determinants[matrixIndex] = det;
+  if (logDeterminants != NULL)
+    logDeterminants[matrixIndex] = logDet;
+}
+
+/**
+ *  \brief
+ *  Converts a batch of matrices to single precision, on load of the float and mixed precision modes.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param converted array of their terms rounded to single precision
+ *  \param values number of terms of the batch
+ */
+__global__ void convertMatrices(const double *matrices, float *converted, size_t values)
+{
+  for (size_t e = blockIdx.x * blockDim.x + threadIdx.x; e < values; e += (size_t)gridDim.x * blockDim.x)
+    converted[e] = (float)matrices[e];
+}
+
+/**
+ *  \brief
+ *  Stores the address of each single precision matrix of a batch, as cublasSgetrfBatched expects.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param pointers array of the address of each matrix
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+__global__ void fillMatrixPointersFloat(float *matrices, float **pointers, int numMatrices, int order)
+{
+  int matrixIndex = blockIdx.x * blockDim.x + threadIdx.x;
+  if (matrixIndex < numMatrices)
+    pointers[matrixIndex] = matrices + (size_t)matrixIndex * order * order;
+}
+
+/**
+ *  \brief
+ *  Calculates the determinant of each matrix factorized by cublasSgetrfBatched, one thread per matrix.
+ *
+ *  As calcDeterminantsFactorized, but the diagonal of U is in single precision. When wide (mixed
+ *  precision) its product and the sum of its logarithms are accumulated in double, so the determinant
+ *  does not overflow a float; otherwise in float.
+ *
+ *  \param factorized array of the LU factors of each matrix
+ *  \param pivots array of the pivots of each factorization (1-based)
+ *  \param info array of the status of each factorization
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ *  \param wide the diagonal is accumulated in double
+ */
+__global__ void calcDeterminantsFactorizedFloat(const float *factorized, const int *pivots, const int *info, double *determinants, double *logDeterminants, int numMatrices, int order, bool wide)
+{
+  int matrixIndex = blockIdx.x * blockDim.x + threadIdx.x;
+  if (matrixIndex >= numMatrices)
+    return;
+
+  const float *matrix = factorized + (size_t)matrixIndex * order * order;
+  const int *pivot = pivots + (size_t)matrixIndex * order;
+  double det = 1, logDet = 0;
+  float detFloat = 1, logDetFloat = 0;
+  if (info[matrixIndex] > 0) // singular matrix
+  {
+    det = detFloat = 0;
+    logDet = logDetFloat = -INFINITY;
+  }
+  else
+  {
+    for (int i = 0; i < order; i++)
+    {
+      float term = matrix[(size_t)i * order + i];
+      if (wide)
+      {
+        det *= (pivot[i] != i + 1) ? -term : term;
+        logDet += log(fabs((double)term));
+      }
+      else
+      {
+        detFloat *= (pivot[i] != i + 1) ? -term : term;
+        logDetFloat += logf(fabsf(term));
+      }
+    }
+  }
+
+  determinants[matrixIndex] = wide ? det : detFloat;
+  if (logDeterminants != NULL)
+    logDeterminants[matrixIndex] = wide ? logDet : logDetFloat;
+}
@@ -0,0 +1,86 @@
+/**
+ *  \file factorized.h (interface file)
+ *
+ *  \brief Kernels around the batched LU factorization of cuBLAS, shared by the CUDA matrix determinant programs.
+ *
+ *  cublasDgetrfBatched factorizes the matrices of a batch in place, given the address of each one.
+ *  The determinant of a matrix is then the product of the diagonal of U, with a change of sign for
+ *  every row that was swapped. It is the same for a matrix stored by rows or by columns, as
+ *  det(A) = det(A^T), so both programs use these kernels. In the float and mixed precisions the
+ *  matrices are first converted on the device and factorized by cublasSgetrfBatched.
+ *
+ *  Methods:
+ *     \li fillMatrixPointers - address of each matrix of a batch.
+ *     \li calcDeterminantsFactorized - determinant of each factorized matrix, one thread per matrix.
+ *     \li convertMatrices - converts a batch of matrices to single precision.
+ *     \li fillMatrixPointersFloat - address of each single precision matrix of a batch.
+ *     \li calcDeterminantsFactorizedFloat - determinant of each factorized single precision matrix.
+ */
+#ifndef FACTORIZED_H
+#define FACTORIZED_H
+
+#include <stddef.h>
+
+/**
+ *  \brief
+ *  Stores the address of each matrix of a batch, as the batched cuBLAS factorization expects.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param pointers array of the address of each matrix
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+extern __global__ void fillMatrixPointers(double *matrices, double **pointers, int numMatrices, int order);
+
+/**
+ *  \brief
+ *  Calculates the determinant of each matrix factorized by cublasDgetrfBatched, one thread per matrix.
+ *
+ *  \param factorized array of the LU factors of each matrix
+ *  \param pivots array of the pivots of each factorization (1-based)
+ *  \param info array of the status of each factorization
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+extern __global__ void calcDeterminantsFactorized(const double *factorized, const int *pivots, const int *info, double *determinants, double *logDeterminants, int numMatrices, int order);
+
+/**
+ *  \brief
+ *  Converts a batch of matrices to single precision, on load of the float and mixed precision modes.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param converted array of their terms rounded to single precision
+ *  \param values number of terms of the batch
+ */
+extern __global__ void convertMatrices(const double *matrices, float *converted, size_t values);
+
+/**
+ *  \brief
+ *  Stores the address of each single precision matrix of a batch, as cublasSgetrfBatched expects.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param pointers array of the address of each matrix
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+extern __global__ void fillMatrixPointersFloat(float *matrices, float **pointers, int numMatrices, int order);
+
+/**
+ *  \brief
+ *  Calculates the determinant of each matrix factorized by cublasSgetrfBatched, one thread per matrix,
+ *  the diagonal accumulated in double when wide (mixed precision).
+ *
+ *  \param factorized array of the LU factors of each matrix
+ *  \param pivots array of the pivots of each factorization (1-based)
+ *  \param info array of the status of each factorization
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ *  \param wide the diagonal is accumulated in double
+ */
+extern __global__ void calcDeterminantsFactorizedFloat(const float *factorized, const int *pivots, const int *info, double *determinants, double *logDeterminants, int numMatrices, int order, bool wide);
+
+#endif /* FACTORIZED_H */
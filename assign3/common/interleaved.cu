@@ -0,0 +1,109 @@
+/**
+ *  \file interleaved.cu (implementation file)
+ *
+ *  \brief Interleaved thread-per-matrix determinant kernel of the CUDA matrix determinant programs.
+ *
+ *  The row program stores the matrices by rows and the column program by columns; the kernel pivots
+ *  on the rows of what it reads, so for the column program it works on the transpose, which has the
+ *  same determinant.
+ */
+
+#include <math.h>
+#include "interleaved.h"
+
+/**
+ *  \brief
+ *  Copies a batch of matrices to the interleaved layout.
+ *
+ *  The term (i, j) of matrix m is stored at (i * order + j) * numMatrices + m, so the threads of a warp,
+ *  one per matrix, access consecutive addresses when they all access the same term.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param interleaved array of the interleaved matrices
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+__global__ void interleaveMatrices(const double *matrices, double *interleaved, int numMatrices, int order)
+{
+  size_t terms = (size_t)order * order;
+  size_t values = terms * numMatrices;
+  for (size_t e = (size_t)blockIdx.x * blockDim.x + threadIdx.x; e < values; e += (size_t)gridDim.x * blockDim.x)
+    interleaved[(e % terms) * numMatrices + e / terms] = matrices[e];
+}
+
+/** \brief term (i, j) of the interleaved matrix of a thread */
+#define TERM(i, j) matrix[((size_t)(i) * order + (j)) * numMatrices]
+
+/**
+ *  \brief
+ *  Calculates the determinant of each interleaved matrix, one thread per matrix.
+ *
+ *  Each thread does the whole LU factorization of its matrix with partial pivoting:
+ *  1. The pivot is the largest term (absolute value) of the column on the pivot's row or below.
+ *  2. The pivot row is swapped, which changes the sign of the determinant.
+ *  3. The pivot multiplies the determinant and the Gaussian Elimination of the trailing matrix follows.
+ *
+ *  No synchronization is needed and, with the interleaved layout, every access of a warp is coalesced.
+ *
+ *  \param interleaved array of the interleaved matrices
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+__global__ void calcDeterminantsInterleaved(double *interleaved, double *determinants, double *logDeterminants, int numMatrices, int order)
+{
+  int matrixIndex = blockIdx.x * blockDim.x + threadIdx.x;
+  if (matrixIndex >= numMatrices)
+    return;
+
+  double *matrix = interleaved + matrixIndex;
+  double det = 1, logDet = 0;
+  for (int iteration = 0; iteration < order; iteration++)
+  {
+    // finding the pivot
+    int p = iteration;
+    double largest = fabs(TERM(iteration, iteration));
+    for (int k = iteration + 1; k < order; k++)
+    {
+      if (fabs(TERM(k, iteration)) > largest)
+      {
+        largest = fabs(TERM(k, iteration));
+        p = k;
+      }
+    }
+    if (largest == 0) // singular matrix
+    {
+      det = 0;
+      logDet = -INFINITY;
+      break;
+    }
+    if (p != iteration)
+    {
+      // Swap the two rows
+      for (int j = iteration; j < order; j++)
+      {
+        double temp = TERM(p, j);
+        TERM(p, j) = TERM(iteration, j);
+        TERM(iteration, j) = temp;
+      }
+      det = -det;
+    }
+
+    double pivot = TERM(iteration, iteration);
+    det *= pivot;
+    logDet += log(fabs(pivot));
+
+    // Gauss Elimination of the trailing matrix
+    for (int r = iteration + 1; r < order; r++)
+    {
+      double scale = TERM(r, iteration) / pivot;
+      for (int k = iteration + 1; k < order; k++)
+        TERM(r, k) -= scale * TERM(iteration, k);
+    }
+  }
+
+  determinants[matrixIndex] = det;
+  if (logDeterminants != NULL)
+    logDeterminants[matrixIndex] = logDet;
+}
@@ -0,0 +1,51 @@
+/**
+ *  \file interleaved.h (interface file)
+ *
+ *  \brief Interleaved thread-per-matrix determinant kernel of the CUDA matrix determinant programs.
+ *
+ *  The matrices of a batch are copied to an interleaved layout, term (i, j) of matrix m at
+ *  (i * order + j) * numMatrices + m, and each thread factorizes a whole matrix with partial
+ *  pivoting, so every access of a warp is coalesced and no synchronization is needed. It is one
+ *  of the kernels of each program (-k interleaved), chosen by auto for large batches of matrices
+ *  of order up to a warp; the thread, warp, tiled and cublas kernels are still used otherwise.
+ *
+ *  The kernel pivots on rows. A matrix stored by columns is read as its transpose, whose rows are
+ *  the columns of the matrix, and det(A) = det(A^T), so both programs compile this one file.
+ *
+ *  Methods:
+ *     \li interleaveMatrices - copies a batch of matrices to the interleaved layout.
+ *     \li calcDeterminantsInterleaved - determinant of each interleaved matrix, one thread per matrix.
+ */
+#ifndef INTERLEAVED_H
+#define INTERLEAVED_H
+
+/** \brief threads (one per matrix) of a block of the interleaved kernel */
+#define INTERLEAVED_THREADS 128
+
+/** \brief matrices of a launch above which small orders use the interleaved kernel */
+#define INTERLEAVED_MATRICES 2048
+
+/**
+ *  \brief
+ *  Copies a batch of matrices to the interleaved layout, term (i, j) of matrix m at (i * order + j) * numMatrices + m.
+ *
+ *  \param matrices array of matrices, one after the other
+ *  \param interleaved array of the interleaved matrices
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+extern __global__ void interleaveMatrices(const double *matrices, double *interleaved, int numMatrices, int order);
+
+/**
+ *  \brief
+ *  Calculates the determinant of each interleaved matrix, one thread per matrix, with partial pivoting.
+ *
+ *  \param interleaved array of the interleaved matrices
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+extern __global__ void calcDeterminantsInterleaved(double *interleaved, double *determinants, double *logDeterminants, int numMatrices, int order);
+
+#endif /* INTERLEAVED_H */
@@ -10,6 +10,21 @@
 #ifndef MATRIXUTILSROW_H
 # define MATRIXUTILSROW_H
 
+/** \brief number of threads of a warp */
+# define WARP_SIZE 32
+
+/** \brief mask of all the lanes of a warp */
+# define FULL_MASK 0xffffffff
+
+/** \brief matrices (one per warp) of a block of the warp kernel */
+# define WARPS_PER_BLOCK 4
+
+/** \brief threads of the tile of the tiled kernel along the columns */
+# define TILE_X 32
+
+/** \brief threads of the tile of the tiled kernel along the rows */
+# define TILE_Y 8
+
 /**
  *  \brief
  *  Calculates the determinant of a given matrix using row reduction.
@@ -20,6 +35,16 @@
  */
 extern double getDeterminant(int order, double *matrix);             
 
+/**
+ *  \brief
+ *  Calculates the logarithm of the absolute value of the determinant of a matrix factorized by getDeterminant.
+ *
+ *  \param order order of the matrix
+ *  \param matrix the matrix factorized by getDeterminant
+ *  \return log|det|, or -inf if the matrix is singular
+ */
+extern double getLogDeterminant(int order, double *matrix);
+
 
 /**
  *  \brief
@@ -34,7 +59,36 @@ extern double getDeterminant(int order, double *matrix);
  *
  *  \param matricesDevice array of matrices
  *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix, accumulated from the pivots (or NULL)
+ */
+extern __global__ void calcDeterminantsRows(double *matricesDevice, double *determinants, double *logDeterminants);
+
+/**
+ *  \brief
+ *  Calculates the determinants of small matrices, one warp per matrix staged in shared memory,
+ *  WARPS_PER_BLOCK matrices per block, each lane is responsible for a row.
+ *
+ *  The order must not exceed WARP_SIZE.
+ *
+ *  \param matricesDevice array of matrices
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+extern __global__ void calcDeterminantsRowsWarp(double *matricesDevice, double *determinants, double *logDeterminants, int numMatrices, int order);
+
+/**
+ *  \brief
+ *  Calculates the determinant of each matrix with a TILE_X x TILE_Y tile of threads per matrix.
+ *
+ *  Any order can be processed.
+ *
+ *  \param matricesDevice array of matrices
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param order order of the matrices
  */
-extern __global__ void calcDeterminantsRows(double *matricesDevice, double *determinants);
+extern __global__ void calcDeterminantsRowsTiled(double *matricesDevice, double *determinants, double *logDeterminants, int order);
 
 #endif
\ No newline at end of file
@@ -11,15 +11,264 @@
 
 #include "../common/common.h"
 #include <cuda_runtime.h>
+#include <cublas_v2.h>
 #include <stdio.h>
 #include <math.h>
 #include "matrix_utils_col.h"
+#include "../common/interleaved.h"
+#include "../common/factorized.h"
+#include "../../common/resultsink.h"
+#include "../../common/resultcache.h"
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/** \brief the kernel is chosen by the order of the matrices */
+#define KERNEL_AUTO 0
+
+/** \brief one thread per column, the order must not exceed the threads of a block */
+#define KERNEL_THREAD 1
+
+/** \brief one warp per matrix, the order must not exceed WARP_SIZE */
+#define KERNEL_WARP 2
+
+/** \brief a tile of threads per matrix */
+#define KERNEL_TILED 3
+
+/** \brief one thread per matrix, the matrices are interleaved */
+#define KERNEL_INTERLEAVED 4
+
+/** \brief batched LU factorization of cuBLAS */
+#define KERNEL_CUBLAS 5
+
+/** \brief the matrices are factorized in double precision */
+#define PRECISION_DOUBLE 0
+
+/** \brief the matrices are converted to float on the device and factorized in float, the pivots multiplied in float */
+#define PRECISION_FLOAT 1
+
+/** \brief as PRECISION_FLOAT, but the pivots (or their logarithms) are accumulated in double */
+#define PRECISION_MIXED 2
+
+/** \brief devices with a cuBLAS handle at most */
+#define MAX_DEVICES 16
+
+/** \brief checks the status of a cuBLAS call */
+#define CHECK_CUBLAS(call)                                              \
+  {                                                                     \
+    const cublasStatus_t status = call;                                 \
+    if (status != CUBLAS_STATUS_SUCCESS)                                \
+    {                                                                   \
+      printf("Error: %s:%d, cublas status %d\n", __FILE__, __LINE__, status); \
+      exit(EXIT_FAILURE);                                               \
+    }                                                                   \
+  }
+
+/** \brief cuBLAS handle of each device, created on its first use */
+static cublasHandle_t cublasHandles[MAX_DEVICES];
+
+#ifdef INSTRUMENT
+/** \brief operation of the device timed with a pair of events */
+struct instrEvent
+{
+  const char *name;             /* kernel or direction of the copy */
+  int device;                   /* device of the events */
+  size_t bytes;                 /* bytes of a copy, 0 for a kernel */
+  cudaEvent_t start, stop;
+};
+
+/** \brief totals of the operations of a name */
+struct instrTotal
+{
+  const char *name;
+  int count;
+  double ms;
+  double bytes;
+};
+
+/** \brief operations recorded and not resolved yet */
+static struct instrEvent *instrEvents = NULL;
+static int nInstrEvents = 0, instrCapacity = 0;
+
+/** \brief totals of every name */
+static struct instrTotal instrTotals[16];
+static int nInstrTotals = 0;
+
+/** \brief names of the kernels in the dump */
+static const char *instrKernelNames[] = {"kernel auto", "kernel thread", "kernel warp", "kernel tiled", "kernel interleaved", "kernel cublas"};
+
+/**
+ *  \brief Add the times of the operations of a device (of every device if -1) to the totals, and destroy their events.
+ *
+ *  \param device device, or -1
+ */
+static void instrResolve(int device)
+{
+  int kept = 0, current;
+  CHECK(cudaGetDevice(&current));
+  for (int e = 0; e < nInstrEvents; e++)
+  {
+    struct instrEvent *ev = &instrEvents[e];
+    if (device >= 0 && ev->device != device)
+    {
+      instrEvents[kept++] = *ev;
+      continue;
+    }
+    CHECK(cudaSetDevice(ev->device));
+    float ms;
+    CHECK(cudaEventSynchronize(ev->stop));
+    CHECK(cudaEventElapsedTime(&ms, ev->start, ev->stop));
+    CHECK(cudaEventDestroy(ev->start));
+    CHECK(cudaEventDestroy(ev->stop));
+
+    int t = 0;
+    while (t < nInstrTotals && strcmp(instrTotals[t].name, ev->name) != 0)
+      t++;
+    if (t == nInstrTotals)
+      instrTotals[nInstrTotals++] = (struct instrTotal){ev->name, 0, 0, 0};
+    instrTotals[t].count++;
+    instrTotals[t].ms += ms;
+    instrTotals[t].bytes += ev->bytes;
+  }
+  nInstrEvents = kept;
+  CHECK(cudaSetDevice(current));
+}
+
+/**
+ *  \brief Print the totals of every name to stderr, one JSON line each.
+ */
+static void instrDump(void)
+{
+  instrResolve(-1);
+  for (int t = 0; t < nInstrTotals; t++)
+    fprintf(stderr, "{\"program\": \"%s\", \"op\": \"%s\", \"count\": %d, \"ms\": %.3f, \"bytes\": %.0f, \"GBps\": %.3f}\n",
+            program_invocation_short_name, instrTotals[t].name, instrTotals[t].count, instrTotals[t].ms, instrTotals[t].bytes,
+            (instrTotals[t].ms > 0) ? instrTotals[t].bytes / instrTotals[t].ms / 1e6 : 0.0);
+}
+
+/**
+ *  \brief Record the start of an operation on a stream.
+ *
+ *  \param stream stream of the operation
+ *
+ *  \return index of the operation
+ */
+static int instrBegin(cudaStream_t stream)
+{
+  if (nInstrEvents == instrCapacity)
+  {
+    if (instrCapacity == 0)
+      atexit(instrDump);
+    instrCapacity = instrCapacity ? 2 * instrCapacity : 256;
+    instrEvents = (struct instrEvent *)realloc(instrEvents, instrCapacity * sizeof(struct instrEvent));
+  }
+  struct instrEvent *ev = &instrEvents[nInstrEvents];
+  CHECK(cudaGetDevice(&ev->device));
+  CHECK(cudaEventCreate(&ev->start));
+  CHECK(cudaEventCreate(&ev->stop));
+  CHECK(cudaEventRecord(ev->start, stream));
+  return nInstrEvents++;
+}
 
 /**
- *  \brief Print results of the matrix determinant calculations.
+ *  \brief Record the end of an operation on its stream.
+ *
+ *  \param e index of the operation
+ *  \param name kernel or direction of the copy
+ *  \param bytes bytes of a copy, 0 for a kernel
+ *  \param stream stream of the operation
  */
-void printResults(char *filename, int numMatrices, int order, double *determinants);
+static void instrEnd(int e, const char *name, size_t bytes, cudaStream_t stream)
+{
+  instrEvents[e].name = name;
+  instrEvents[e].bytes = bytes;
+  CHECK(cudaEventRecord(instrEvents[e].stop, stream));
+}
+
+/** \brief time an operation on a stream */
+#define INSTR_OP(name, bytes, stream, ...)                     \
+  do                                                           \
+  {                                                            \
+    int instrIndex = instrBegin(stream);                       \
+    __VA_ARGS__;                                               \
+    instrEnd(instrIndex, name, bytes, stream);                 \
+  } while (0)
+#else
+#define INSTR_OP(name, bytes, stream, ...) \
+  do                                       \
+  {                                        \
+    __VA_ARGS__;                           \
+  } while (0)
+#endif /* INSTRUMENT */
+
+/** \brief default number of streams of the streamed mode */
+#define DS 4
+
+/** \brief buffers of a batch of matrices cycled through a CUDA stream */
+struct streamSlot
+{
+  cudaStream_t stream;          /* stream of the batch */
+  double *matricesHost;         /* pinned host buffer of the matrices */
+  double *matricesDevice;       /* device buffer of the matrices */
+  double *scratchDevice;        /* device buffer of the interleaved matrices or of the LU pivots */
+  double *determinantsHost;     /* pinned host buffer of the determinants */
+  double *determinantsDevice;   /* device buffer of the determinants */
+  double *logDeterminantsHost;  /* pinned host buffer of log|det| (or NULL) */
+  double *logDeterminantsDevice; /* device buffer of log|det| (or NULL) */
+  int count;                    /* matrices of the batch in flight, 0 if the slot is free */
+  int first;                    /* index in its file of the first matrix of the batch */
+  int *index;                   /* index in its file of each matrix in flight (with -C, NULL otherwise) */
+  uint64_t *keys;               /* hash of the terms of each matrix in flight (with -C) */
+};
+
+/**
+ *  \brief Choose the kernel for an order, or -1 if the order is too large for it.
+ */
+static int chooseKernel(int kernel, int order, int numMatrices, int maxThreadsPerBlock);
+
+/**
+ *  \brief Launch the kernel that calculates the determinants of an array of matrices on a stream.
+ */
+static void launchDeterminants(int kernel, int order, int numMatrices, double *matricesDevice, double *scratchDevice, double *determinants, double *logDeterminants, cudaStream_t stream);
+
+/**
+ *  \brief Number of values of the scratch buffer a kernel needs per matrix.
+ */
+static size_t scratchPerMatrix(int kernel, int order);
+
+/**
+ *  \brief Reset the current device, destroying its cuBLAS handle.
+ */
+static void resetDevice(void);
+
+/**
+ *  \brief Calculate the determinants of the files in batches cycled through CUDA streams.
+ */
+static double processStreamed(char **filenames, int fnip, FILE *manifest, int kernel, bool logResults, int batch, int nStreams, int maxThreadsPerBlock);
+
+/** \brief output of the results, written while the next files are processed */
+static struct resultSink *sink;
+
+/** \brief determinants of the matrices already processed, keyed by the hash of their terms (NULL without -C) */
+static struct resultCache *cache = NULL;
+
+/** \brief precision of the factorization: PRECISION_DOUBLE, PRECISION_FLOAT or PRECISION_MIXED */
+static int precision = PRECISION_DOUBLE;
+
+/**
+ *  \brief Look up the determinants of an array of matrices in the cache, the matrices left are moved to its front.
+ */
+static int lookupMatrices(double *matrices, int numMatrices, int order, int first, double *determinants, double *logDeterminants, int *index, uint64_t *keys);
+
+/**
+ *  \brief Store the determinants calculated in the arrays of the file and in the cache.
+ */
+static void storeMatrices(int count, const double *calculated, const double *logCalculated, const int *index, const uint64_t *keys, double *determinants, double *logDeterminants);
+
+/**
+ *  \brief Next file to process: the names given with -f, then the lines of the manifest.
+ */
+static char *nextFileName(char **filenames, int fnip, int *next, FILE *manifest);
 
 /**
  *  \brief Print command usage.
@@ -43,10 +292,22 @@ static void printUsage(char *cmdName);
  *  6. Copy the matrices from the host to the GPU global memory.
  *  7. Process and calculate the matrices determinants.
  *  8. Retrieve the array of determinants from the GPU back to the host.
- *  9. Print results.
+ *  9. Hand the results to the result sink, which writes them while the next file is processed.
  *  10. For each matrix, calculate determinant using the CPU.
  *  11. Print total elapsed time for both CPU and GPU operations.
  *
+ *  Steps 2 to 10 are repeated for each file, the names given with -f first and then the lines of the
+ *  manifest (-F), read as they are needed, so only the file being processed is in memory.
+ *
+ *  With -C the determinants of the matrices found in the cache are not calculated: only the others
+ *  are copied to the device and checked by the CPU.
+ *
+ *  With -p float or mixed the matrices are converted to single precision on the device and factorized
+ *  by cublasSgetrfBatched, the pivots multiplied in float or in double; the CPU check stays in double.
+ *
+ *  With -b the files are streamed instead, in batches cycled through CUDA streams
+ *  (see processStreamed), and only the elapsed time of the pipeline is printed.
+ *
  *  \param argc number of words of the command line
  *  \param argv list of words of the command line
  *
@@ -54,22 +315,21 @@ static void printUsage(char *cmdName);
  */
 int main(int argc, char **argv)
 {
-  printf("%s Starting...\n", argv[0]);
-
-  // set up device
-  int dev = 0; /* Device set up */
-  cudaDeviceProp deviceProp;
-  CHECK(cudaGetDeviceProperties(&deviceProp, dev)); /* Show the current device's properties */
-  printf("Using Device %d: %s\n", dev, deviceProp.name);
-  CHECK(cudaSetDevice(dev));
-
-  char *filenames[16]; /* array of file's names  */ /* array of file's names  */
-  int fnip = 0;                                     /* filename insertion pointer */
+  char **filenames = (char **)malloc(sizeof(char *) * argc); /* names given with -f, at most one per word of the command line */
+  int fnip = 0;                                               /* filename insertion pointer */
+  FILE *manifest = NULL;                                      /* manifest read after those names */
   int opt;
+  bool logResults = false; /* log|det| is also calculated */
+  int outputFormat = SINK_TEXT; /* format of the results */
+  char *outputPath = NULL;      /* file of the results, NULL for the standard output */
+  char *cacheDir = NULL;        /* directory of the cache, NULL for none */
+  int kernel = KERNEL_AUTO; /* kernel that calculates the determinants */
+  int batch = 0;            /* matrices per batch of the streamed mode, 0 reads whole files */
+  int nStreams = DS;        /* streams of the streamed mode */
 
   do
   {
-    switch ((opt = getopt(argc, argv, "f:")))
+    switch ((opt = getopt(argc, argv, "f:F:lk:p:b:s:o:O:C:")))
     {
     case 'f': /* file name */
       if (optarg[0] == '-')
@@ -78,14 +338,93 @@ int main(int argc, char **argv)
         printUsage(basename(argv[0]));
         return EXIT_FAILURE;
       }
-      if (fnip >= 16) /* at most 16 files */
+      filenames[fnip++] = optarg;
+      break;
+
+    case 'F': /* manifest */
+      manifest = (strcmp(optarg, "-") == 0) ? stdin : fopen(optarg, "r");
+      if (manifest == NULL)
       {
-        fprintf(stderr, "%s: Too many files to unpack. At Most 16\n", basename(argv[0]));
+        fprintf(stderr, "%s: could not open manifest %s\n", basename(argv[0]), optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'l': /* log-domain results */
+      logResults = true;
+      break;
+
+    case 'k': /* kernel */
+      if (strcmp(optarg, "auto") == 0)
+        kernel = KERNEL_AUTO;
+      else if (strcmp(optarg, "thread") == 0)
+        kernel = KERNEL_THREAD;
+      else if (strcmp(optarg, "warp") == 0)
+        kernel = KERNEL_WARP;
+      else if (strcmp(optarg, "tiled") == 0)
+        kernel = KERNEL_TILED;
+      else if (strcmp(optarg, "interleaved") == 0)
+        kernel = KERNEL_INTERLEAVED;
+      else if (strcmp(optarg, "cublas") == 0)
+        kernel = KERNEL_CUBLAS;
+      else
+      {
+        fprintf(stderr, "%s: kernel must be auto, thread, warp, tiled, interleaved or cublas\n", basename(argv[0]));
         printUsage(basename(argv[0]));
         return EXIT_FAILURE;
       }
+      break;
 
-      filenames[fnip++] = optarg;
+    case 'p': /* precision of the factorization */
+      if (strcmp(optarg, "double") == 0)
+        precision = PRECISION_DOUBLE;
+      else if (strcmp(optarg, "float") == 0)
+        precision = PRECISION_FLOAT;
+      else if (strcmp(optarg, "mixed") == 0)
+        precision = PRECISION_MIXED;
+      else
+      {
+        fprintf(stderr, "%s: precision must be double, float or mixed\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'b': /* matrices per batch */
+      if (atoi(optarg) < 1)
+      {
+        fprintf(stderr, "%s: number of matrices per batch must be greater or equal than 1\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      batch = atoi(optarg);
+      break;
+
+    case 's': /* number of streams */
+      if (atoi(optarg) < 1)
+      {
+        fprintf(stderr, "%s: number of streams must be greater or equal than 1\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      nStreams = atoi(optarg);
+      break;
+
+    case 'o': /* output format */
+      if ((outputFormat = sinkFormat(optarg)) < 0)
+      {
+        fprintf(stderr, "%s: output format must be text, csv or binary\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'O': /* output file */
+      outputPath = optarg;
+      break;
+
+    case 'C': /* cache directory */
+      cacheDir = optarg;
       break;
 
     case 'h': /* help mode */
@@ -107,103 +446,602 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
+  if ((sink = sinkOpen(outputPath, outputFormat)) == NULL)
+  {
+    fprintf(stderr, "%s: could not open output file %s\n", basename(argv[0]), outputPath);
+    return EXIT_FAILURE;
+  }
+  FILE *info = sinkInfo(sink); /* stream of the other lines, apart from csv or binary results */
+  if (cacheDir != NULL && (cache = cacheOpen(cacheDir, "determinants", 2 * sizeof(double))) == NULL)
+  {
+    fprintf(stderr, "%s: could not create cache directory %s\n", basename(argv[0]), cacheDir);
+    return EXIT_FAILURE;
+  }
+  fprintf(info, "%s Starting...\n", argv[0]);
+
+  // set up device
+  int dev = 0; /* Device set up */
+  cudaDeviceProp deviceProp;
+  CHECK(cudaGetDeviceProperties(&deviceProp, dev)); /* Show the current device's properties */
+  fprintf(info, "Using Device %d: %s\n", dev, deviceProp.name);
+  CHECK(cudaSetDevice(dev));
+
+  if (batch > 0) /* streamed mode, the device is set up once for all the files */
+  {
+    double iElaps = processStreamed(filenames, fnip, manifest, kernel, logResults, batch, nStreams, deviceProp.maxThreadsPerBlock);
+    resetDevice(); /* reset device */
+    if (cache != NULL)
+      cacheClose(cache); /* the determinants of the new matrices are kept for the next runs */
+    sinkClose(sink); /* every result was written */
+    fprintf(info, "\nGPU Elapsed time = %.6f s\n", iElaps); /* Elapsed Time of the pipeline, reads included */
+    exit(EXIT_SUCCESS);
+  }
+
   double iElaps = 0;    /* total elapsed time using CUDA */
   double iElapsCpu = 0; /* total elapsed time using CPU */
-  for (int fileIndex = 0; fileIndex < fnip; fileIndex++)
-  { /* process each file in filenames array */
-    FILE *fp = fopen(filenames[fileIndex], "r");
+  int cpuMismatches = 0; /* determinants of the CPU that differ from the ones of the GPU */
+  char *filename; /* file being processed */
+  int nextName = 0; /* next of the names given with -f */
+  unsigned long seq = 0; /* position of the file in the list */
+  while ((filename = nextFileName(filenames, fnip, &nextName, manifest)) != NULL)
+  { /* process each file of the list, one at a time */
+    FILE *fp = fopen(filename, "r");
     if (fp == NULL)
     {
-      printf("Error: could not open file %s\n", filenames[fileIndex]);
+      printf("Error: could not open file %s\n", filename);
       return EXIT_FAILURE;
     }
     int numMatrices;
     if (fread(&numMatrices, sizeof(int), 1, fp) == 0) /* Get the number of matrices in file */
     {
-      printf("Error: could not read from file %s\n", filenames[fileIndex]);
+      printf("Error: could not read from file %s\n", filename);
       return EXIT_FAILURE;
     }
 
     int order;
     if (!fread(&order, sizeof(int), 1, fp)) /* Get the order of the matrices in file */
     {
-      printf("Error: could not read from file %s\n", filenames[fileIndex]);
+      printf("Error: could not read from file %s\n", filename);
       return EXIT_FAILURE;
     }
 
     // malloc host memory
     double *matricesHost = (double *)malloc(sizeof(double) * numMatrices * order * order); /* allocate host memory for the matrices */
     double *determinantsHost = (double *)malloc(sizeof(double) * numMatrices);             /* allocate host memory for the determinants */
+    double *logDeterminantsHost = NULL;                                                    /* and for their log|det| */
+    if (logResults)
+      logDeterminantsHost = (double *)malloc(sizeof(double) * numMatrices);
 
     // malloc device global memory all the matrices and the results array
     double *determinants;
     double *matricesDevice;
+    double *logDeterminants = NULL;
     CHECK(cudaMalloc((void **)&determinants, sizeof(double) * numMatrices));                   /* Device memory allocation for determinants array */
+    if (logResults)
+      CHECK(cudaMalloc((void **)&logDeterminants, sizeof(double) * numMatrices));              /* Device memory allocation for log|det| array */
     CHECK(cudaMalloc((void **)&matricesDevice, sizeof(double) * numMatrices * order * order)); /* Device memory allocation for matrices */
 
     if (!fread(matricesHost, sizeof(double), numMatrices * order * order, fp)) /* Read all matrices to host array */
     {
-      printf("Error: could not read from file %s\n", filenames[fileIndex]);
+      printf("Error: could not read from file %s\n", filename);
       return EXIT_FAILURE;
     }
+    fclose(fp);
+
+    int numMisses = numMatrices;                      /* matrices calculated, at the front of matricesHost */
+    double *gpuDeterminants = determinantsHost;       /* their determinants */
+    double *gpuLogDeterminants = logDeterminantsHost; /* and their log|det| */
+    int *missIndex = NULL;                            /* index in the file of each of them (with -C) */
+    uint64_t *missKeys = NULL;                        /* and the hash of its terms */
+    if (cache != NULL) /* the determinants found in the cache go straight to the arrays of the file */
+    {
+      missIndex = (int *)malloc(sizeof(int) * numMatrices);
+      missKeys = (uint64_t *)malloc(sizeof(uint64_t) * numMatrices);
+      numMisses = lookupMatrices(matricesHost, numMatrices, order, 0, determinantsHost, logDeterminantsHost, missIndex, missKeys);
+      gpuDeterminants = (double *)malloc(sizeof(double) * numMisses);
+      gpuLogDeterminants = logResults ? (double *)malloc(sizeof(double) * numMisses) : NULL;
+    }
 
     // transfer data from host to device
-    CHECK(cudaMemcpy(matricesDevice, matricesHost, sizeof(double) * numMatrices * order * order, cudaMemcpyHostToDevice)); /* Set number of matrices at device's memory */
+    INSTR_OP("copy in", sizeof(double) * numMisses * order * order, 0, CHECK(cudaMemcpy(matricesDevice, matricesHost, sizeof(double) * numMisses * order * order, cudaMemcpyHostToDevice))); /* Set number of matrices at device's memory */
 
-    // invoke kernel at host side
-    dim3 grid(numMatrices, 1); /* Create a grid of one block per matrix */
-    dim3 block(order, 1);      /* Create a thread per column for each block */
+    // choose the kernel at host side
+    int fileKernel = chooseKernel(kernel, order, numMisses, deviceProp.maxThreadsPerBlock);
+    if (fileKernel < 0)
+    {
+      printf("Error: the order of the matrices of file %s is too large for the kernel\n", filename);
+      return EXIT_FAILURE;
+    }
+    double *scratchDevice = NULL;
+    if (scratchPerMatrix(fileKernel, order) > 0)
+      CHECK(cudaMalloc((void **)&scratchDevice, sizeof(double) * numMisses * scratchPerMatrix(fileKernel, order))); /* Device memory allocation for the interleaved matrices or the pivots */
 
     double iStart = seconds();
 
-    calcDeterminantsCols<<<grid, block>>>(matricesDevice, determinants); /* Calculate pivots for each column */
+    // invoke kernel at host side
+    launchDeterminants(fileKernel, order, numMisses, matricesDevice, scratchDevice, determinants, logDeterminants, 0);
     CHECK(cudaDeviceSynchronize());
 
     iElaps += seconds() - iStart; /* sum processing time with CUDA Kernel */
 
     CHECK(cudaGetLastError()); /* check for a kernel error */
 
-    CHECK(cudaMemcpy(determinantsHost, determinants, sizeof(double) * numMatrices, cudaMemcpyDeviceToHost)); /* copy kernel result back to host */
-
-    // check device results
-    printResults(filenames[fileIndex], numMatrices, order, determinantsHost); /* print determinant calculation results */
+    INSTR_OP("copy out", sizeof(double) * numMisses, 0, CHECK(cudaMemcpy(gpuDeterminants, determinants, sizeof(double) * numMisses, cudaMemcpyDeviceToHost))); /* copy kernel result back to host */
+    if (logResults)
+      INSTR_OP("copy out", sizeof(double) * numMisses, 0, CHECK(cudaMemcpy(gpuLogDeterminants, logDeterminants, sizeof(double) * numMisses, cudaMemcpyDeviceToHost)));
 
     /* free device global memory */
     CHECK(cudaFree(determinants));
+    if (logResults)
+      CHECK(cudaFree(logDeterminants));
     CHECK(cudaFree(matricesDevice));
+    CHECK(cudaFree(scratchDevice));
 
     double iStartCpu = seconds();
-    for (int matrixPointer = 0; matrixPointer < numMatrices; matrixPointer++)
+    for (int matrixPointer = 0; matrixPointer < numMisses; matrixPointer++)
     {                                                                  /* Calculate determinants using CPU */
       double *matrix = (matricesHost + order * order * matrixPointer); /* get matrix to process */
       double cpuDeterminant = getDeterminant(order, matrix);           /* calculate determinant  */
+      double gpuDeterminant = gpuDeterminants[matrixPointer];
+      double tolerance = (precision == PRECISION_DOUBLE) ? 1e-6 : 1e-3; /* relative, single precision rounds far more */
+      if (fabs(cpuDeterminant - gpuDeterminant) > tolerance * fmax(fabs(cpuDeterminant), fabs(gpuDeterminant)))
+        cpuMismatches++; /* beyond the rounding of the two orders of operations */
     }
     iElapsCpu += seconds() - iStartCpu; /* sum processing time with CPU */
 
-    free(matricesHost);     /* free the array of matrices at the host */
-    free(determinantsHost); /* free the array of determinants at the host */
+    if (cache != NULL) /* the determinants calculated take their place in the file, and in the cache */
+    {
+      storeMatrices(numMisses, gpuDeterminants, gpuLogDeterminants, missIndex, missKeys, determinantsHost, logDeterminantsHost);
+      free(gpuDeterminants);
+      free(gpuLogDeterminants);
+      free(missIndex);
+      free(missKeys);
+    }
+
+    sinkDeterminants(sink, seq++, filename, numMatrices, order, determinantsHost, logDeterminantsHost); /* the sink frees the determinants once written */
+    free(matricesHost); /* free the array of matrices at the host */
+    free(filename);
 
     // reset device
-    CHECK(cudaDeviceReset()); /* reset device */
+    resetDevice(); /* reset device */
   }
-  printf("\nGPU Elapsed time = %.6f s\n", iElaps);    /* Elapsed Time Using the Cuda Kernel */
-  printf("\nCPU Elapsed time = %.6f s\n", iElapsCpu); /* Elapsed Time Using the CPU */
+  if (cache != NULL)
+    cacheClose(cache); /* the determinants of the new matrices are kept for the next runs */
+  sinkClose(sink); /* every result was written */
+  fprintf(info, "\nGPU Elapsed time = %.6f s\n", iElaps);    /* Elapsed Time Using the Cuda Kernel */
+  fprintf(info, "\nCPU Elapsed time = %.6f s\n", iElapsCpu); /* Elapsed Time Using the CPU */
+  fprintf(info, "\nDeterminants differing between the CPU and the GPU = %d\n", cpuMismatches);
   exit(EXIT_SUCCESS);
 }
 
 /**
- *  \brief Print results of the matrix detemrinant calculations
+ *  \brief Choose the kernel for an order.
+ *
+ *  The automatic choice gives a thread to each small matrix when there are enough of them to fill the device,
+ *  a warp to each small matrix otherwise, and a tile of threads to the larger ones.
+ *  In the float and mixed precisions the batched factorization of cuBLAS is the only kernel.
+ *
+ *  \param kernel requested kernel
+ *  \param order order of the matrices
+ *  \param numMatrices number of matrices of a launch
+ *  \param maxThreadsPerBlock threads of a block of the device
+ *
+ *  \return the kernel, or -1 if the order is too large for the requested kernel
+ */
+static int chooseKernel(int kernel, int order, int numMatrices, int maxThreadsPerBlock)
+{
+  if (precision != PRECISION_DOUBLE)
+    return KERNEL_CUBLAS; /* cublasSgetrfBatched */
+  if (kernel == KERNEL_AUTO && order <= WARP_SIZE)
+    return (numMatrices >= INTERLEAVED_MATRICES) ? KERNEL_INTERLEAVED : KERNEL_WARP; /* small matrices share a block */
+  if (kernel == KERNEL_AUTO)
+    return KERNEL_TILED;
+  if ((kernel == KERNEL_THREAD && order > maxThreadsPerBlock) || (kernel == KERNEL_WARP && order > WARP_SIZE))
+    return -1;
+  return kernel;
+}
+
+/**
+ *  \brief Launch the kernel that calculates the determinants of an array of matrices on a stream.
+ *
+ *  \param kernel kernel chosen for the order
+ *  \param order order of the matrices
+ *  \param numMatrices number of matrices
+ *  \param matricesDevice array of matrices
+ *  \param scratchDevice array of scratchPerMatrix values per matrix (interleaved and cublas kernels only)
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param stream stream of the launch
+ */
+static void launchDeterminants(int kernel, int order, int numMatrices, double *matricesDevice, double *scratchDevice, double *determinants, double *logDeterminants, cudaStream_t stream)
+{
+  if (numMatrices == 0)
+    return;
+#ifdef INSTRUMENT
+  int instrIndex = instrBegin(stream); /* the kernels of the determinants, prologues included */
+#endif
+  if (kernel == KERNEL_THREAD)
+  {
+    dim3 grid(numMatrices, 1); /* Create a grid of one block per matrix */
+    dim3 block(order, 1);      /* Create a thread per column for each block */
+    calcDeterminantsCols<<<grid, block, 0, stream>>>(matricesDevice, determinants, logDeterminants); /* Calculate pivots for each column */
+  }
+  else if (kernel == KERNEL_WARP)
+  {
+    dim3 grid((numMatrices + WARPS_PER_BLOCK - 1) / WARPS_PER_BLOCK, 1); /* Create a grid of WARPS_PER_BLOCK matrices per block */
+    dim3 block(WARPS_PER_BLOCK * WARP_SIZE, 1);                         /* Create a warp per matrix */
+    size_t sharedBytes = sizeof(double) * WARPS_PER_BLOCK * order * (order | 1); /* padded matrices in shared memory */
+    calcDeterminantsColsWarp<<<grid, block, sharedBytes, stream>>>(matricesDevice, determinants, logDeterminants, numMatrices, order);
+  }
+  else if (kernel == KERNEL_INTERLEAVED)
+  {
+    size_t values = (size_t)numMatrices * order * order;
+    dim3 copyGrid((values + INTERLEAVED_THREADS - 1) / INTERLEAVED_THREADS < 4096 ? (values + INTERLEAVED_THREADS - 1) / INTERLEAVED_THREADS : 4096, 1);
+    dim3 copyBlock(INTERLEAVED_THREADS, 1);
+    interleaveMatrices<<<copyGrid, copyBlock, 0, stream>>>(matricesDevice, scratchDevice, numMatrices, order); /* coalesced layout */
+    dim3 grid((numMatrices + INTERLEAVED_THREADS - 1) / INTERLEAVED_THREADS, 1); /* Create a grid of INTERLEAVED_THREADS matrices per block */
+    dim3 block(INTERLEAVED_THREADS, 1);                                          /* Create a thread per matrix */
+    calcDeterminantsInterleaved<<<grid, block, 0, stream>>>(scratchDevice, determinants, logDeterminants, numMatrices, order);
+  }
+  else if (kernel == KERNEL_CUBLAS)
+  {
+    int dev;
+    CHECK(cudaGetDevice(&dev));
+    if (cublasHandles[dev] == NULL)
+      CHECK_CUBLAS(cublasCreate(&cublasHandles[dev]));
+    CHECK_CUBLAS(cublasSetStream(cublasHandles[dev], stream));
+
+    double **pointers = (double **)scratchDevice;        /* matrix of each factorization */
+    int *pivots = (int *)(scratchDevice + numMatrices);  /* pivots of each factorization */
+    int *info = pivots + (size_t)numMatrices * order;    /* and its status */
+    dim3 grid((numMatrices + INTERLEAVED_THREADS - 1) / INTERLEAVED_THREADS, 1); /* Create a thread per matrix */
+    dim3 block(INTERLEAVED_THREADS, 1);
+    if (precision != PRECISION_DOUBLE) /* converted on the device, factorized in single precision */
+    {
+      float **pointersFloat = (float **)scratchDevice;                                         /* matrix of each factorization */
+      float *converted = (float *)(scratchDevice + (size_t)numMatrices * (1 + (order + 2) / 2)); /* after the pivots and the status */
+      size_t values = (size_t)numMatrices * order * order;
+      dim3 copyGrid((values + INTERLEAVED_THREADS - 1) / INTERLEAVED_THREADS < 4096 ? (values + INTERLEAVED_THREADS - 1) / INTERLEAVED_THREADS : 4096, 1);
+      convertMatrices<<<copyGrid, block, 0, stream>>>(matricesDevice, converted, values);
+      fillMatrixPointersFloat<<<grid, block, 0, stream>>>(converted, pointersFloat, numMatrices, order);
+      CHECK_CUBLAS(cublasSgetrfBatched(cublasHandles[dev], order, pointersFloat, order, pivots, info, numMatrices));
+      calcDeterminantsFactorizedFloat<<<grid, block, 0, stream>>>(converted, pivots, info, determinants, logDeterminants, numMatrices, order, precision == PRECISION_MIXED);
+#ifdef INSTRUMENT
+      instrEnd(instrIndex, "kernel cublas float", 0, stream);
+#endif
+      return;
+    }
+    fillMatrixPointers<<<grid, block, 0, stream>>>(matricesDevice, pointers, numMatrices, order);
+    /* the matrices are read as column-major, so their transposes are factorized, with the same determinant */
+    CHECK_CUBLAS(cublasDgetrfBatched(cublasHandles[dev], order, pointers, order, pivots, info, numMatrices));
+    calcDeterminantsFactorized<<<grid, block, 0, stream>>>(matricesDevice, pivots, info, determinants, logDeterminants, numMatrices, order);
+  }
+  else
+  {
+    dim3 grid(numMatrices, 1);  /* Create a grid of one block per matrix */
+    dim3 block(TILE_X, TILE_Y); /* Create a tile of threads for each block */
+    calcDeterminantsColsTiled<<<grid, block, 0, stream>>>(matricesDevice, determinants, logDeterminants, order);
+  }
+#ifdef INSTRUMENT
+  instrEnd(instrIndex, instrKernelNames[kernel], 0, stream);
+#endif
+}
+
+/**
+ *  \brief Number of values of the scratch buffer a kernel needs per matrix.
+ *
+ *  The interleaved kernel copies the matrices, the cublas kernel needs a pointer to each matrix,
+ *  its pivots and the status of its factorization, and in the float and mixed precisions the
+ *  matrix converted to single precision.
+ *
+ *  \param kernel kernel chosen for the order
+ *  \param order order of the matrices
+ *
+ *  \return values (doubles) per matrix
+ */
+static size_t scratchPerMatrix(int kernel, int order)
+{
+  if (kernel == KERNEL_INTERLEAVED)
+    return (size_t)order * order;
+  if (kernel == KERNEL_CUBLAS && precision != PRECISION_DOUBLE)
+    return 1 + (order + 2) / 2 + ((size_t)order * order + 1) / 2; /* and the terms in single precision */
+  if (kernel == KERNEL_CUBLAS)
+    return 1 + (order + 2) / 2; /* a pointer, order pivots and the status */
+  return 0;
+}
+
+/**
+ *  \brief Reset the current device, destroying its cuBLAS handle.
+ */
+static void resetDevice(void)
+{
+  int dev;
+  CHECK(cudaGetDevice(&dev));
+#ifdef INSTRUMENT
+  instrResolve(dev); /* the events of the device are destroyed by the reset */
+#endif
+  if (cublasHandles[dev] != NULL)
+  {
+    CHECK_CUBLAS(cublasDestroy(cublasHandles[dev]));
+    cublasHandles[dev] = NULL;
+  }
+  CHECK(cudaDeviceReset());
+}
+
+/**
+ *  \brief Look up the determinants of an array of matrices in the cache.
+ *
+ *  The determinants found are stored in the arrays of the file, and the matrices left to calculate
+ *  are moved to the front of the array, in order, so they are copied to the device as one block.
+ *
+ *  \param matrices array of matrices
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ *  \param first index in the file of the first matrix of the array
+ *  \param determinants determinants of the file
+ *  \param logDeterminants log|det| of the file (or NULL), a determinant cached without it is calculated again
+ *  \param index index in the file of each matrix left
+ *  \param keys hash of the terms of each matrix left
+ *
+ *  \return number of matrices left
+ */
+static int lookupMatrices(double *matrices, int numMatrices, int order, int first, double *determinants, double *logDeterminants, int *index, uint64_t *keys)
+{
+  size_t terms = (size_t)order * order;
+  int left = 0;
+  for (int m = 0; m < numMatrices; m++)
+  {
+    double value[2]; /* determinant and log|det| */
+    uint64_t key = cacheHash(matrices + m * terms, sizeof(double) * terms, order + ((uint64_t)precision << 32)); /* each precision has its own results */
+    if (cacheGet(cache, key, value) && (logDeterminants == NULL || !isnan(value[1])))
+    {
+      determinants[first + m] = value[0];
+      if (logDeterminants != NULL)
+        logDeterminants[first + m] = value[1];
+      continue;
+    }
+    if (left != m)
+      memcpy(matrices + left * terms, matrices + m * terms, sizeof(double) * terms);
+    index[left] = first + m;
+    keys[left++] = key;
+  }
+  return left;
+}
+
+/**
+ *  \brief Store the determinants calculated in the arrays of the file and in the cache.
+ *
+ *  \param count number of matrices calculated
+ *  \param calculated determinants of the matrices calculated
+ *  \param logCalculated their log|det| (or NULL)
+ *  \param index index in the file of each matrix calculated
+ *  \param keys hash of the terms of each matrix calculated
+ *  \param determinants determinants of the file
+ *  \param logDeterminants log|det| of the file (or NULL)
+ */
+static void storeMatrices(int count, const double *calculated, const double *logCalculated, const int *index, const uint64_t *keys, double *determinants, double *logDeterminants)
+{
+  for (int m = 0; m < count; m++)
+  {
+    double value[2] = {calculated[m], (logCalculated != NULL) ? logCalculated[m] : NAN}; /* NAN: log|det| was not calculated */
+    determinants[index[m]] = value[0];
+    if (logDeterminants != NULL)
+      logDeterminants[index[m]] = value[1];
+    cachePut(cache, keys[m], value);
+  }
+}
+
+/**
+ *  \brief Wait for the batch of a slot and save its determinants (and store them in the cache).
+ *
+ *  \param slot slot of the batch
+ *  \param determinants determinants of the file of the batch
+ *  \param logDeterminants log|det| of the file of the batch (or NULL)
+ */
+static void retireBatch(struct streamSlot *slot, double *determinants, double *logDeterminants)
+{
+  if (slot->count == 0)
+    return;
+  CHECK(cudaStreamSynchronize(slot->stream)); /* the buffers of the slot can be reused */
+  if (slot->index != NULL) /* only the matrices not found in the cache were calculated */
+    storeMatrices(slot->count, slot->determinantsHost, slot->logDeterminantsHost, slot->index, slot->keys, determinants, logDeterminants);
+  else
+  {
+    memcpy(determinants + slot->first, slot->determinantsHost, sizeof(double) * slot->count);
+    if (logDeterminants != NULL)
+      memcpy(logDeterminants + slot->first, slot->logDeterminantsHost, sizeof(double) * slot->count);
+  }
+  slot->count = 0;
+}
+
+/**
+ *  \brief Calculate the determinants of the files in batches cycled through CUDA streams.
+ *
+ *  Every stream has pinned host buffers and device buffers for a batch of matrices.
+ *  The batches of a file are handed to the streams in turn: before a slot is refilled its
+ *  previous batch is waited for, then the next batch is read into its pinned buffer and the copy
+ *  to the device, the kernel and the copy of the determinants back are queued on its stream,
+ *  so the file is read while the batches of the other streams are being copied and processed.
+ *  Only a batch per stream is in memory, the device is set up once for all the files and the
+ *  buffers only grow when a file has larger matrices.
+ *
+ *  \param filenames names of the files given with -f
+ *  \param fnip number of those names
+ *  \param manifest manifest with the names of the next files, or NULL
+ *  \param kernel requested kernel
+ *  \param logResults log|det| is also calculated
+ *  \param batch matrices per batch
+ *  \param nStreams number of streams
+ *  \param maxThreadsPerBlock threads of a block of the device
+ *
+ *  \return elapsed time
+ */
+static double processStreamed(char **filenames, int fnip, FILE *manifest, int kernel, bool logResults, int batch, int nStreams, int maxThreadsPerBlock)
+{
+  double iStart = seconds();
+  struct streamSlot *slots = (struct streamSlot *)malloc(sizeof(struct streamSlot) * nStreams);
+  size_t capacity = 0;            /* matrix values the buffers of a slot can hold */
+  size_t scratchCapacity = 0; /* and its interleaved buffer */
+
+  for (int s = 0; s < nStreams; s++)
+  {
+    struct streamSlot *slot = slots + s;
+    CHECK(cudaStreamCreate(&slot->stream));
+    slot->matricesHost = slot->matricesDevice = slot->scratchDevice = NULL;
+    CHECK(cudaMallocHost((void **)&slot->determinantsHost, sizeof(double) * batch)); /* pinned, so the copies are asynchronous */
+    CHECK(cudaMalloc((void **)&slot->determinantsDevice, sizeof(double) * batch));
+    slot->logDeterminantsHost = slot->logDeterminantsDevice = NULL;
+    if (logResults)
+    {
+      CHECK(cudaMallocHost((void **)&slot->logDeterminantsHost, sizeof(double) * batch));
+      CHECK(cudaMalloc((void **)&slot->logDeterminantsDevice, sizeof(double) * batch));
+    }
+    slot->count = 0;
+    slot->index = NULL;
+    slot->keys = NULL;
+    if (cache != NULL)
+    {
+      slot->index = (int *)malloc(sizeof(int) * batch);
+      slot->keys = (uint64_t *)malloc(sizeof(uint64_t) * batch);
+    }
+  }
+
+  char *filename; /* file being processed */
+  int nextName = 0; /* next of the names given with -f */
+  unsigned long seq = 0; /* position of the file in the list */
+  while ((filename = nextFileName(filenames, fnip, &nextName, manifest)) != NULL)
+  { /* process each file of the list, one at a time */
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+      printf("Error: could not open file %s\n", filename);
+      exit(EXIT_FAILURE);
+    }
+    int header[2]; /* number and order of the matrices */
+    if (fread(header, sizeof(int), 2, fp) != 2)
+    {
+      printf("Error: could not read from file %s\n", filename);
+      exit(EXIT_FAILURE);
+    }
+    int numMatrices = header[0];
+    int order = header[1];
+    int fileKernel = chooseKernel(kernel, order, batch, maxThreadsPerBlock);
+    if (fileKernel < 0)
+    {
+      printf("Error: the order of the matrices of file %s is too large for the kernel\n", filename);
+      exit(EXIT_FAILURE);
+    }
+
+    double *determinants = (double *)malloc(sizeof(double) * numMatrices); /* determinants of the file */
+    double *logDeterminants = logResults ? (double *)malloc(sizeof(double) * numMatrices) : NULL;
+
+    size_t values = (size_t)batch * order * order;
+    if (values > capacity) /* the slots are free between files */
+    {
+      for (int s = 0; s < nStreams; s++)
+      {
+        CHECK(cudaFreeHost(slots[s].matricesHost));
+        CHECK(cudaFree(slots[s].matricesDevice));
+        CHECK(cudaMallocHost((void **)&slots[s].matricesHost, sizeof(double) * values));
+        CHECK(cudaMalloc((void **)&slots[s].matricesDevice, sizeof(double) * values));
+      }
+      capacity = values;
+    }
+    size_t scratchValues = (size_t)batch * scratchPerMatrix(fileKernel, order);
+    if (scratchValues > scratchCapacity)
+    {
+      for (int s = 0; s < nStreams; s++)
+      {
+        CHECK(cudaFree(slots[s].scratchDevice));
+        CHECK(cudaMalloc((void **)&slots[s].scratchDevice, sizeof(double) * scratchValues));
+      }
+      scratchCapacity = scratchValues;
+    }
+
+    for (int first = 0, b = 0; first < numMatrices; b++)
+    {
+      struct streamSlot *slot = slots + b % nStreams;
+      retireBatch(slot, determinants, logDeterminants); /* wait for the previous batch of the slot */
+
+      int count = (numMatrices - first < batch) ? numMatrices - first : batch;
+      size_t batchValues = (size_t)count * order * order;
+      if (fread(slot->matricesHost, sizeof(double), batchValues, fp) != batchValues) /* read the batch while the other streams work */
+      {
+        printf("Error: could not read from file %s\n", filename);
+        exit(EXIT_FAILURE);
+      }
+      slot->first = first;
+      first += count;
+      if (cache != NULL && (count = lookupMatrices(slot->matricesHost, count, order, slot->first, determinants, logDeterminants, slot->index, slot->keys)) == 0)
+        continue; /* every determinant of the batch was found in the cache */
+      batchValues = (size_t)count * order * order; /* only the matrices left are copied */
+      INSTR_OP("copy in", sizeof(double) * batchValues, slot->stream, CHECK(cudaMemcpyAsync(slot->matricesDevice, slot->matricesHost, sizeof(double) * batchValues, cudaMemcpyHostToDevice, slot->stream)));
+      launchDeterminants(fileKernel, order, count, slot->matricesDevice, slot->scratchDevice, slot->determinantsDevice, slot->logDeterminantsDevice, slot->stream);
+      INSTR_OP("copy out", sizeof(double) * count, slot->stream, CHECK(cudaMemcpyAsync(slot->determinantsHost, slot->determinantsDevice, sizeof(double) * count, cudaMemcpyDeviceToHost, slot->stream)));
+      if (logResults)
+        INSTR_OP("copy out", sizeof(double) * count, slot->stream, CHECK(cudaMemcpyAsync(slot->logDeterminantsHost, slot->logDeterminantsDevice, sizeof(double) * count, cudaMemcpyDeviceToHost, slot->stream)));
+      slot->count = count;
+    }
+    for (int s = 0; s < nStreams; s++)
+      retireBatch(slots + s, determinants, logDeterminants); /* drain the streams */
+    CHECK(cudaGetLastError()); /* check for a kernel error */
+    fclose(fp);
+
+    sinkDeterminants(sink, seq++, filename, numMatrices, order, determinants, logDeterminants); /* written while the next file streams */
+    free(filename);
+  }
+
+  for (int s = 0; s < nStreams; s++)
+  {
+    struct streamSlot *slot = slots + s;
+    CHECK(cudaStreamDestroy(slot->stream));
+    CHECK(cudaFreeHost(slot->matricesHost));
+    CHECK(cudaFree(slot->matricesDevice));
+    CHECK(cudaFree(slot->scratchDevice));
+    CHECK(cudaFreeHost(slot->determinantsHost));
+    CHECK(cudaFree(slot->determinantsDevice));
+    CHECK(cudaFreeHost(slot->logDeterminantsHost));
+    CHECK(cudaFree(slot->logDeterminantsDevice));
+    free(slot->index);
+    free(slot->keys);
+  }
+  free(slots);
+  return seconds() - iStart;
+}
+
+/**
+ *  \brief Next file to process: the names given with -f, then the lines of the manifest.
+ *
+ *  The manifest is read a line at a time, so the list can be of any length and a list piped
+ *  on the standard input is processed while it is being produced.
+ *  Empty lines and lines starting with '#' are skipped.
+ *
+ *  \param filenames names given with -f
+ *  \param fnip number of those names
+ *  \param next next of those names, updated
+ *  \param manifest manifest read after those names, or NULL
+ *
+ *  \return name of the file, allocated with malloc, or NULL once the list is exhausted
  */
-void printResults(char *filename, int numMatrices, int order, double *determinants)
+static char *nextFileName(char **filenames, int fnip, int *next, FILE *manifest)
 {
-  printf("\nMatrix File  %s\n", filename);
-  printf("Number of Matrices  %d\n", numMatrices);
-  printf("Order of the matrices  %d\n", order);
+  if (*next < fnip)
+    return strdup(filenames[(*next)++]);
+  if (manifest == NULL)
+    return NULL;
 
-  for (int i = 0; i < numMatrices; i++)
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &size, manifest)) != -1)
   {
-    printf("\tMatrix %d Result: Determinant = %.3e \n", i + 1, determinants[i]);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = '\0';
+    if (len > 0 && line[0] != '#')
+      return line;
   }
+  free(line);
+  return NULL;
 }
 
 /**
@@ -215,9 +1053,18 @@ void printResults(char *filename, int numMatrices, int order, double *determinan
  */
 static void printUsage(char *cmdName)
 {
-  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename]\n"
+  fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / manifest / log-domain results / kernel / precision / matrices per batch / streams / output format / output file / cache directory]\n"
                   "  OPTIONS:\n"
                   "  -h      --- print this help\n"
-                  "  -f      --- filename to process\n",
+                  "  -f      --- filename to process\n"
+                  "  -F      --- manifest with a filename per line, - for the standard input\n"
+                  "  -l      --- also calculate log|det|, the determinants are printed from it\n"
+                  "  -k      --- kernel: auto (default), thread, warp, tiled, interleaved or cublas\n"
+                  "  -p      --- precision: double (default), float or mixed (float, pivots multiplied in double), both with the cublas kernel\n"
+                  "  -b      --- matrices per batch, streams the files in batches through the device\n"
+                  "  -s      --- number of streams of the batches (default 4)\n"
+                  "  -o      --- output format: text (default), csv or binary\n"
+                  "  -O      --- file of the results (default the standard output)\n"
+                  "  -C      --- directory of the cache of the results, matrices already processed are not calculated again\n",
           cmdName);
 }
\ No newline at end of file
@@ -13,58 +13,206 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
-
 #include <time.h>
+
+#include "matrix_utils_col.h"
+
+/** \brief largest order with a specialized kernel */
+#define SMALL_ORDER 16
+
+/** \brief number of columns of a panel of the blocked factorization */
+#define PANEL 32
+
+/** \brief number of columns of the trailing matrix updated at a time */
+#define COLUMN_BLOCK 256
+
 /**
  *  \brief
- *  Calculates the determinant of a given matrix using column reduction.
- * 
+ *  Eliminates the matrix below the diagonal, column by column.
+ *
+ *  Inlined in the kernels of each small order, so the loops have constant bounds.
+ *
+ *  \param order order of the matrix
  *  \param matrix the matrix to be processed
- *  \param argv order of the matrix
  *  \return the determinant of the matrix
  */
-double getDeterminant(int order, double *matrix)
+static __forceinline__ double eliminate(int order, double *matrix)
 {
-  int i, j, k; 
-  int swaps = 0;
-  for (i = 0; i < order - 1; i++)
+  double det = 1;
+  for (int i = 0; i < order; i++)
   {
-    for (k = i + 1; k < order; k++)
+    double *pivotRow = matrix + i * order;
+    // Partial Pivoting, the largest term (absolute value) of the column
+    int p = i;
+    double largest = fabs(pivotRow[i]);
+    for (int k = i + 1; k < order; k++)
     {
-    // If diagonal element(absolute vallue) is smaller than any of the terms to the right of it
-    if (fabs(*((matrix + i * order) + i)) < fabs(*((matrix + i * order) + k)))
+      if (fabs(*((matrix + k * order) + i)) > largest)
       {
-        // Swap the cols
-        swaps++;
-        for (j = 0; j < order; j++)
-        {
-          double temp;
-          temp = *((matrix + j * order) + i);
-          *((matrix + j * order) + i) = *((matrix + j * order) + k);
-          *((matrix + j * order) + k) = temp;
-        }
+        largest = fabs(*((matrix + k * order) + i));
+        p = k;
       }
     }
-
-    // Begin Gauss Elimination
-    for (k = i + 1; k < order; k++)
+    if (largest == 0)
+      return 0;
+    if (p != i)
+    {
+      // Swap the rows, the columns on the left are no longer needed
+      for (int j = i; j < order; j++)
+      {
+        double temp = pivotRow[j];
+        pivotRow[j] = *((matrix + p * order) + j);
+        *((matrix + p * order) + j) = temp;
+      }
+      det = -det;
+    }
+    det *= pivotRow[i];
+    // Gauss Elimination of the terms on the right of the pivot
+    for (int k = i + 1; k < order; k++)
     {
-      double term = *((matrix + i * order) + k) / *((matrix + i * order) + i);
-      for (j = i + 1; j < order; j++)
+      double *row = matrix + k * order;
+      double term = row[i] / pivotRow[i];
+      for (int j = i + 1; j < order; j++)
       {
-        *((matrix + j * order) + k) -= term * (*((matrix + j * order) + i));
+        row[j] -= term * pivotRow[j];
       }
     }
   }
-  
- 
+  return det;
+}
+
+/** \brief defines the kernel of a small order */
+#define SMALL_KERNEL(N) \
+  static double determinant##N(double *matrix) { return eliminate(N, matrix); }
+
+SMALL_KERNEL(1) SMALL_KERNEL(2) SMALL_KERNEL(3) SMALL_KERNEL(4)
+SMALL_KERNEL(5) SMALL_KERNEL(6) SMALL_KERNEL(7) SMALL_KERNEL(8)
+SMALL_KERNEL(9) SMALL_KERNEL(10) SMALL_KERNEL(11) SMALL_KERNEL(12)
+SMALL_KERNEL(13) SMALL_KERNEL(14) SMALL_KERNEL(15) SMALL_KERNEL(16)
+
+/** \brief kernels of the small orders, indexed by order */
+static double (*const smallKernels[SMALL_ORDER + 1])(double *matrix) = {
+    NULL, determinant1, determinant2, determinant3, determinant4,
+    determinant5, determinant6, determinant7, determinant8,
+    determinant9, determinant10, determinant11, determinant12,
+    determinant13, determinant14, determinant15, determinant16};
+
+/**
+ *  \brief
+ *  Subtracts from a row the combination of nb rows (ld values apart) with the given factors.
+ *
+ *  dst[j] -= l[0] * u[j] + l[1] * u[ld + j] + ... for j < len
+ *
+ *  \param dst row to update
+ *  \param l factors of the rows
+ *  \param u first of the rows
+ *  \param ld distance between the rows
+ *  \param nb number of rows
+ *  \param len number of terms to update
+ */
+static void updateRow(double *__restrict__ dst, const double *__restrict__ l, const double *__restrict__ u, int ld, int nb, int len)
+{
+  for (int j = 0; j < len; j++)
+  {
+    double acc = dst[j];
+    for (int i = 0; i < nb; i++)
+      acc -= l[i] * u[i * ld + j];
+    dst[j] = acc;
+  }
+}
+
+/**
+ *  \brief
+ *  Right-looking blocked LU factorization with partial pivoting.
+ *
+ *  For each panel of PANEL columns:
+ *  1. The panel is factorized column by column, the multipliers are stored below the diagonal.
+ *  2. The rows of U on the right of the panel are obtained by forward substitution.
+ *  3. The trailing matrix is updated with the panel, COLUMN_BLOCK columns at a time.
+ *
+ *  \param order order of the matrix
+ *  \param matrix the matrix to be processed
+ *  \return the determinant of the matrix
+ */
+static double factorizeBlocked(int order, double *matrix)
+{
   double det = 1;
-  for (int i = 0; i < order; i++)
+  for (int kb = 0; kb < order; kb += PANEL)
   {
-    det *= (*((matrix + i * order) + i));
+    int je = (kb + PANEL < order) ? kb + PANEL : order; /* end of the panel */
+    for (int i = kb; i < je; i++)
+    {
+      double *pivotRow = matrix + i * order;
+      // Partial Pivoting, the largest term (absolute value) of the column
+      int p = i;
+      double largest = fabs(pivotRow[i]);
+      for (int k = i + 1; k < order; k++)
+      {
+        if (fabs(*((matrix + k * order) + i)) > largest)
+        {
+          largest = fabs(*((matrix + k * order) + i));
+          p = k;
+        }
+      }
+      if (largest == 0)
+        return 0;
+      if (p != i)
+      {
+        // Swap the rows, the columns of the previous panels are no longer needed
+        for (int j = kb; j < order; j++)
+        {
+          double temp = pivotRow[j];
+          pivotRow[j] = *((matrix + p * order) + j);
+          *((matrix + p * order) + j) = temp;
+        }
+        det = -det;
+      }
+      det *= pivotRow[i];
+      // Gauss Elimination inside the panel, the multipliers are kept for the updates
+      for (int k = i + 1; k < order; k++)
+      {
+        double *row = matrix + k * order;
+        double term = row[i] /= pivotRow[i];
+        for (int j = i + 1; j < je; j++)
+        {
+          row[j] -= term * pivotRow[j];
+        }
+      }
+    }
+    // rows of U on the right of the panel
+    for (int r = kb + 1; r < je; r++)
+      updateRow(matrix + r * order + je, matrix + r * order + kb, matrix + kb * order + je, order, r - kb, order - je);
+    // trailing matrix
+    for (int jb = je; jb < order; jb += COLUMN_BLOCK)
+    {
+      int len = (jb + COLUMN_BLOCK < order) ? COLUMN_BLOCK : order - jb;
+      for (int r = je; r < order; r++)
+        updateRow(matrix + r * order + jb, matrix + r * order + kb, matrix + kb * order + jb, order, je - kb, len);
+    }
   }
+  return det;
+}
 
-  return pow(-1, swaps) * det;
+/**
+ *  \brief
+ *  Calculates the determinant of a given matrix.
+ *
+ *  The rows are reduced by LU factorization with partial pivoting, which gives the same
+ *  determinant as the column reduction of the GPU (the determinant of the transpose).
+ *  The matrix is overwritten by its factorization.
+ *  Small orders have kernels specialized at compile time, larger ones are factorized by panels.
+ *
+ *  \param matrix the matrix to be processed
+ *  \param argv order of the matrix
+ *  \return the determinant of the matrix
+ */
+double getDeterminant(int order, double *matrix)
+{
+  if (order < 1)
+    return 1;
+  if (order <= SMALL_ORDER)
+    return smallKernels[order](matrix);
+  return factorizeBlocked(order, matrix);
 }
 
 /**
@@ -81,8 +229,9 @@ double getDeterminant(int order, double *matrix)
  *
  *  \param matricesDevice array of matrices
  *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix, accumulated from the pivots (or NULL)
  */
-__global__ void calcDeterminantsCols(double *matricesDevice, double *determinants)
+__global__ void calcDeterminantsCols(double *matricesDevice, double *determinants, double *logDeterminants)
 {
   int order = blockDim.x;
   double *matrix = matricesDevice + blockIdx.x * order * order;
@@ -92,7 +241,8 @@ __global__ void calcDeterminantsCols(double *matricesDevice, double *determinant
   double *pivotCol;
   double scale;
 
-  int iteration, k, j, temp;
+  int iteration, k, j;
+  double temp;
   for (iteration = 0; iteration < order; iteration++)
   {
     if (threadIdx.x == iteration)
@@ -105,9 +255,9 @@ __global__ void calcDeterminantsCols(double *matricesDevice, double *determinant
       {
         for (k = iteration + 1; k < order; k++)
         {
-          if ((matrix + k * order + iteration) != 0)
+          if (*(matrix + iteration * order + k) != 0)
           {
-            // Swap the two rows
+            // Swap the two columns
             for (j = 0; j < order; j++)
             {
               temp = *(matrix + j * order + k);
@@ -128,6 +278,9 @@ __global__ void calcDeterminantsCols(double *matricesDevice, double *determinant
       else
         determinants[blockIdx.x] *= pivot;
 
+      if (logDeterminants != NULL) // does not overflow for large orders
+        logDeterminants[blockIdx.x] = (iteration == 0 ? 0 : logDeterminants[blockIdx.x]) + log(fabs(pivot));
+
       if (switchedCols)
         determinants[blockIdx.x] *= -1;
     }
@@ -155,4 +308,199 @@ __global__ void calcDeterminantsCols(double *matricesDevice, double *determinant
     if (threadIdx.x < iteration)
       return;
   }
-}
\ No newline at end of file
+}
+/**
+ *  \brief
+ *  Calculates the determinants of small matrices, one warp per matrix and several matrices per block.
+ *
+ *  1. The warp copies its matrix to shared memory, rows padded to an odd length to avoid bank conflicts.
+ *  2. Each lane is responsible for a column, the pivot is the largest term (absolute value) of the row,
+ *  found with warp shuffles.
+ *  3. The lanes swap the pivot column, then each lane on the right of the pivot's column does the
+ *  Gaussian Elimination on its column.
+ *
+ *  Only warp synchronization is needed, the order must not exceed WARP_SIZE.
+ *
+ *  \param matricesDevice array of matrices
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param numMatrices number of matrices
+ *  \param order order of the matrices
+ */
+__global__ void calcDeterminantsColsWarp(double *matricesDevice, double *determinants, double *logDeterminants, int numMatrices, int order)
+{
+  extern __shared__ double sharedMatrices[];
+  int warp = threadIdx.x / WARP_SIZE;
+  int lane = threadIdx.x % WARP_SIZE;
+  int matrixIndex = blockIdx.x * (blockDim.x / WARP_SIZE) + warp;
+  if (matrixIndex >= numMatrices) // the whole warp has no matrix
+    return;
+
+  int ld = order | 1; // odd length of the rows in shared memory
+  double *matrix = sharedMatrices + warp * order * ld;
+  double *source = matricesDevice + (size_t)matrixIndex * order * order;
+  for (int e = lane; e < order * order; e += WARP_SIZE)
+    matrix[(e / order) * ld + e % order] = source[e];
+  __syncwarp();
+
+  double det = 1, logDet = 0;
+  for (int iteration = 0; iteration < order; iteration++)
+  {
+    // finding the pivot, the largest term of the row on the pivot's column or on its right
+    double largest = (lane >= iteration && lane < order) ? fabs(matrix[iteration * ld + lane]) : -1;
+    int p = lane;
+    for (int offset = WARP_SIZE / 2; offset > 0; offset /= 2)
+    {
+      double other = __shfl_down_sync(FULL_MASK, largest, offset);
+      int otherCol = __shfl_down_sync(FULL_MASK, p, offset);
+      if (other > largest)
+      {
+        largest = other;
+        p = otherCol;
+      }
+    }
+    largest = __shfl_sync(FULL_MASK, largest, 0);
+    p = __shfl_sync(FULL_MASK, p, 0);
+    if (largest == 0) // singular matrix
+    {
+      det = 0;
+      logDet = -INFINITY;
+      break;
+    }
+
+    if (p != iteration)
+    {
+      // Swap the two columns, the rows above are no longer needed
+      for (int j = iteration + lane; j < order; j += WARP_SIZE)
+      {
+        double temp = matrix[j * ld + p];
+        matrix[j * ld + p] = matrix[j * ld + iteration];
+        matrix[j * ld + iteration] = temp;
+      }
+      det = -det;
+    }
+    __syncwarp();
+
+    double pivot = matrix[iteration * ld + iteration];
+    det *= pivot;
+    logDet += log(fabs(pivot));
+
+    // if the lane's column is to the right of the current pivot's column
+    if (lane > iteration && lane < order)
+    {
+      double scale = matrix[iteration * ld + lane] / pivot;
+      for (int k = iteration + 1; k < order; k++)
+        matrix[k * ld + lane] -= scale * matrix[k * ld + iteration];
+    }
+    __syncwarp();
+  }
+
+  if (lane == 0)
+  {
+    determinants[matrixIndex] = det;
+    if (logDeterminants != NULL)
+      logDeterminants[matrixIndex] = logDet;
+  }
+}
+
+/**
+ *  \brief
+ *  Calculates the determinant of each matrix with a 2D tile of threads per matrix.
+ *
+ *  1. The threads of the block find the pivot of the row with a reduction in shared memory,
+ *  and swap the pivot column.
+ *  2. Threads Synchronize.
+ *  3. The trailing matrix is updated by the tile, threadIdx.y strides over the rows and
+ *  threadIdx.x over the columns, so consecutive threads access consecutive terms.
+ *  4. Threads Synchronize.
+ *
+ *  Any order can be processed, the matrix is eliminated in place in global memory.
+ *
+ *  \param matricesDevice array of matrices
+ *  \param determinants array of determinants for each matrix
+ *  \param logDeterminants array of log|det| for each matrix (or NULL)
+ *  \param order order of the matrices
+ */
+__global__ void calcDeterminantsColsTiled(double *matricesDevice, double *determinants, double *logDeterminants, int order)
+{
+  __shared__ double largestTerms[TILE_X * TILE_Y];
+  __shared__ int pivotCols[TILE_X * TILE_Y];
+  int tid = threadIdx.y * blockDim.x + threadIdx.x;
+  int threads = blockDim.x * blockDim.y;
+  double *matrix = matricesDevice + (size_t)blockIdx.x * order * order;
+  double det = 1, logDet = 0; // only kept by the first thread
+
+  for (int iteration = 0; iteration < order; iteration++)
+  {
+    double *pivotRow = matrix + (size_t)iteration * order;
+    // finding the pivot, the largest term of the row on the pivot's column or on its right
+    double largest = -1;
+    int p = iteration;
+    for (int k = iteration + tid; k < order; k += threads)
+    {
+      if (fabs(pivotRow[k]) > largest)
+      {
+        largest = fabs(pivotRow[k]);
+        p = k;
+      }
+    }
+    largestTerms[tid] = largest;
+    pivotCols[tid] = p;
+    __syncthreads();
+    for (int s = threads / 2; s > 0; s /= 2)
+    {
+      if (tid < s && largestTerms[tid + s] > largestTerms[tid])
+      {
+        largestTerms[tid] = largestTerms[tid + s];
+        pivotCols[tid] = pivotCols[tid + s];
+      }
+      __syncthreads();
+    }
+    largest = largestTerms[0];
+    p = pivotCols[0];
+    if (largest == 0) // singular matrix
+    {
+      det = 0;
+      logDet = -INFINITY;
+      break;
+    }
+
+    if (p != iteration)
+    {
+      // Swap the two columns, the rows above are no longer needed
+      for (int j = iteration + tid; j < order; j += threads)
+      {
+        double temp = matrix[(size_t)j * order + p];
+        matrix[(size_t)j * order + p] = matrix[(size_t)j * order + iteration];
+        matrix[(size_t)j * order + iteration] = temp;
+      }
+    }
+    __syncthreads();
+
+    double pivot = pivotRow[iteration];
+    if (tid == 0)
+    {
+      det *= (p != iteration) ? -pivot : pivot;
+      logDet += log(fabs(pivot));
+    }
+
+    // Gauss Elimination of the trailing matrix
+    for (int r = iteration + 1 + threadIdx.y; r < order; r += blockDim.y)
+    {
+      double *row = matrix + (size_t)r * order;
+      double term = row[iteration] / pivot;
+      for (int k = iteration + 1 + threadIdx.x; k < order; k += blockDim.x)
+        row[k] -= term * pivotRow[k];
+    }
+
+    // synchronize threads
+    __syncthreads();
+  }
+
+  if (tid == 0)
+  {
+    determinants[blockIdx.x] = det;
+    if (logDeterminants != NULL)
+      logDeterminants[blockIdx.x] = logDet;
+  }
+}
@@ -0,0 +1,166 @@
+#!/bin/bash
+#
+# Benchmark of the text processing and matrix determinant programs.
+#
+# Builds every program, generates the inputs, runs each program over a sweep of its settings
+# and writes, in $OUT:
+#   raw.csv      - one line per run
+#   summary.csv  - per setting: runs, mean, standard deviation, min and max of the elapsed time,
+#                  throughput, and speedup and efficiency against the fewest threads / processes
+#   summary.json - the same as summary.csv
+#   counters.jsonl - with CFLAGS=-DINSTRUMENT, the counters printed by every run
+#
+# The elapsed time is the one printed by the program ("Elapsed time", or "GPU Elapsed time").
+# Every setting below can be overridden from the environment, e.g.
+#   THREADS="1 2 4 8 16" ORDERS="128 1024" REPS=10 ./bench.sh
+#
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(dirname "$HERE")
+
+OUT=${OUT:-$HERE/results}
+REPS=${REPS:-5}                                     # runs of each setting
+ENGINES=${ENGINES:-"a1p1 a2p1 a1p2 a2p2 a3p1 a3p2"} # programs to run, the CUDA ones need nvcc
+
+THREADS=${THREADS:-"1 2 4"}                         # -n of the pthreads programs
+RANKS=${RANKS:-"2 3 4"}                             # processes of the MPI programs
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIFLAGS=${MPIFLAGS:-}                              # e.g. --oversubscribe
+
+TEXT_BYTES=${TEXT_BYTES:-16777216}                  # size of the text corpus
+TEXT_FILES=${TEXT_FILES:-4}                         # corpus split in this many files
+CHUNKS=${CHUNKS:-"4096 65536"}                      # -m of the text programs
+TEXT_DISPATCH=${TEXT_DISPATCH:-"monitor atomic pool"}  # -d of the pthreads text program
+
+ORDERS=${ORDERS:-"32 128 512"}                      # orders of the matrix files
+MATRIX_BYTES=${MATRIX_BYTES:-67108864}              # each matrix file holds about this many bytes
+SLOTS=${SLOTS:-"4 16"}                              # -k of the pthreads determinant program
+DET_DISPATCH=${DET_DISPATCH:-"ring pool"}           # -d of the pthreads determinant program
+SCHEDULING=${SCHEDULING:-"rounds dynamic scatter"}  # -s of the MPI determinant program
+KERNELS=${KERNELS:-"auto"}                          # -k of the CUDA programs
+CFLAGS=${CFLAGS:-}                                  # extra build flags, e.g. -DINSTRUMENT
+
+BIN=$OUT/bin
+DATA=$OUT/data
+mkdir -p "$BIN" "$DATA"
+
+has() { case " $ENGINES " in *" $1 "*) return 0;; *) return 1;; esac; }
+
+# build
+
+gcc -Wall -O3 -o "$BIN/gendata" "$HERE/gendata.c"
+cd "$ROOT/assign1/prog1" && has a1p1 && gcc -Wall -O3 $CFLAGS -o "$BIN/a1p1" main.c sharedRegion.c textProcUtils.c ../common/workpool.c ../../common/filelist.c ../common/instrument.c ../../common/resultsink.c ../../common/resultcache.c -pthread -lm
+cd "$ROOT/assign2/prog1" && has a2p1 && mpicc -Wall -O3 $CFLAGS -o "$BIN/a2p1" main.c textProcUtils.c ../../common/filelist.c ../common/instrument.c ../../common/resultsink.c ../../common/resultcache.c ../common/checkpoint.c -pthread -lm
+cd "$ROOT/assign1/prog2" && has a1p2 && gcc -Wall -O3 $CFLAGS -o "$BIN/a1p2" main.c matrixutils.c sharedregion.c ../common/workpool.c ../../common/filelist.c ../common/instrument.c ../../common/resultsink.c ../../common/resultcache.c -pthread -lm
+cd "$ROOT/assign2/prog2" && has a2p2 && mpicc -Wall -O3 $CFLAGS -o "$BIN/a2p2" main.c matrixutils.c ../../common/filelist.c ../common/instrument.c ../../common/resultsink.c ../../common/resultcache.c ../common/checkpoint.c -pthread -lm
+if command -v nvcc >/dev/null; then
+  cd "$ROOT/assign3/prog1" && has a3p1 && nvcc -O2 $CFLAGS -Wno-deprecated-gpu-targets -o "$BIN/a3p1" matrixDeterminantsRows.cu matrix_utils_row.cu ../common/interleaved.cu ../common/factorized.cu ../../common/resultsink.c ../../common/resultcache.c -lcublas -lpthread
+  cd "$ROOT/assign3/prog2" && has a3p2 && nvcc -O2 $CFLAGS -Wno-deprecated-gpu-targets -o "$BIN/a3p2" matrixDeterminantCols.cu matrix_utils_col.cu ../common/interleaved.cu ../common/factorized.cu ../../common/resultsink.c ../../common/resultcache.c -lcublas -lpthread
+else
+  ENGINES=$(echo " $ENGINES " | sed -e 's/ a3p1 / /' -e 's/ a3p2 / /')
+  echo "nvcc not found, the CUDA programs are skipped"
+fi
+cd "$OUT"
+
+# inputs, generated once for a given size
+
+TEXTS=""
+for i in $(seq 1 "$TEXT_FILES"); do
+  t=$DATA/text_${TEXT_BYTES}_$i.txt
+  [ -f "$t" ] || "$BIN/gendata" -t text -o "$t" -z $((TEXT_BYTES / TEXT_FILES)) -s "$i"
+  TEXTS="$TEXTS -f $t"
+done
+
+matrixFile() { echo "$DATA/mat_${MATRIX_BYTES}_$1.bin"; }
+matrixCount() { local c=$((MATRIX_BYTES / ($1 * $1 * 8))); [ $c -ge 1 ] && echo $c || echo 1; }
+for o in $ORDERS; do
+  m=$(matrixFile "$o")
+  [ -f "$m" ] || "$BIN/gendata" -t matrix -o "$m" -n "$(matrixCount "$o")" -r "$o" -s "$o"
+done
+
+# runs
+
+RAW=$OUT/raw.csv
+echo "engine,input,setting,workers,run,seconds,items,bytes" > "$RAW"
+
+# the counters of an instrumented build (one JSON line per thread, process or GPU operation) are kept
+# in counters.jsonl, each preceded by a line naming its run
+COUNTERS=/dev/null
+case " $CFLAGS " in *" -DINSTRUMENT "*) COUNTERS=$OUT/counters.jsonl; : > "$COUNTERS";; esac
+
+# run <engine> <input> <setting> <workers> <items> <bytes> <command...>
+run() {
+  local engine=$1 input=$2 setting=$3 workers=$4 items=$5 bytes=$6
+  shift 6
+  for r in $(seq 1 "$REPS"); do
+    local s
+    [ "$COUNTERS" = /dev/null ] || echo "{\"run\": \"$engine $input $setting $workers $r\"}" >> "$COUNTERS"
+    s=$("$@" 2>>"$COUNTERS" | awk '/^Elapsed time|^GPU Elapsed time/ { t = $(NF-1) } END { print t }')
+    if [ -z "$s" ]; then
+      echo "failed: $*" >&2
+      continue
+    fi
+    echo "$engine,$input,$setting,$workers,$r,$s,$items,$bytes" >> "$RAW"
+  done
+  echo "$engine $input $setting $workers"
+}
+
+words=$(cat $(echo "$TEXTS" | sed 's/-f//g') | wc -w)
+has a1p1 && for d in $TEXT_DISPATCH; do for m in $CHUNKS; do for n in $THREADS; do
+  run a1p1 text "d=$d m=$m" "$n" "$words" "$TEXT_BYTES" "$BIN/a1p1" $TEXTS -n "$n" -m "$m" -d "$d"
+done; done; done
+has a2p1 && for m in $CHUNKS; do for p in $RANKS; do
+  run a2p1 text "m=$m" "$p" "$words" "$TEXT_BYTES" $MPIEXEC $MPIFLAGS -n "$p" "$BIN/a2p1" $TEXTS -m "$m"
+done; done
+
+for o in $ORDERS; do
+  m=$(matrixFile "$o")
+  c=$(matrixCount "$o")
+  b=$(stat -c %s "$m")
+  has a1p2 && for d in $DET_DISPATCH; do for k in $SLOTS; do for n in $THREADS; do
+    run a1p2 "order$o" "d=$d k=$k" "$n" "$c" "$b" "$BIN/a1p2" -f "$m" -n "$n" -k "$k" -d "$d"
+  done; done; done
+  has a2p2 && for s in $SCHEDULING; do for p in $RANKS; do
+    run a2p2 "order$o" "s=$s" "$p" "$c" "$b" $MPIEXEC $MPIFLAGS -n "$p" "$BIN/a2p2" -f "$m" -s "$s"
+  done; done
+  for e in a3p1 a3p2; do
+    has $e && for k in $KERNELS; do
+      run $e "order$o" "k=$k" 1 "$c" "$b" "$BIN/$e" -f "$m" -k "$k"
+    done
+  done
+done
+
+# summary: statistics of each setting, speedup and efficiency against the fewest workers of the setting
+
+awk -F, -v csv="$OUT/summary.csv" -v json="$OUT/summary.json" '
+NR > 1 {
+  key = $1 FS $2 FS $3 FS $4
+  if (!(key in n)) { order[++nKeys] = key; series = $1 FS $2 FS $3
+                     if (!(series in base) || $4 + 0 < baseWorkers[series]) { base[series] = key; baseWorkers[series] = $4 + 0 } }
+  n[key]++; sum[key] += $6; sq[key] += $6 * $6
+  if (!(key in lo) || $6 < lo[key]) lo[key] = $6
+  if (!(key in hi) || $6 > hi[key]) hi[key] = $6
+  items[key] = $7; bytes[key] = $8
+}
+END {
+  print "engine,input,setting,workers,runs,mean_s,stddev_s,min_s,max_s,items_per_s,mb_per_s,speedup,efficiency" > csv
+  print "[" > json
+  for (i = 1; i <= nKeys; i++) {
+    key = order[i]; split(key, f, FS); series = f[1] FS f[2] FS f[3]
+    mean = sum[key] / n[key]
+    var = (n[key] > 1) ? (sq[key] - n[key] * mean * mean) / (n[key] - 1) : 0
+    sd = (var > 0) ? sqrt(var) : 0
+    b = base[series]; baseMean = sum[b] / n[b]
+    speedup = (mean > 0) ? baseMean / mean : 0
+    eff = speedup * baseWorkers[series] / f[4]
+    ips = (mean > 0) ? items[key] / mean : 0
+    mbs = (mean > 0) ? bytes[key] / mean / 1e6 : 0
+    printf "%s,%s,%s,%s,%d,%.6f,%.6f,%.6f,%.6f,%.1f,%.2f,%.3f,%.3f\n", f[1], f[2], f[3], f[4], n[key], mean, sd, lo[key], hi[key], ips, mbs, speedup, eff > csv
+    printf "  {\"engine\": \"%s\", \"input\": \"%s\", \"setting\": \"%s\", \"workers\": %s, \"runs\": %d, \"mean_s\": %.6f, \"stddev_s\": %.6f, \"min_s\": %.6f, \"max_s\": %.6f, \"items_per_s\": %.1f, \"mb_per_s\": %.2f, \"speedup\": %.3f, \"efficiency\": %.3f}%s\n", f[1], f[2], f[3], f[4], n[key], mean, sd, lo[key], hi[key], ips, mbs, speedup, eff, (i < nKeys) ? "," : "" > json
+  }
+  print "]" > json
+}' "$RAW"
+
+column -s, -t "$OUT/summary.csv" 2>/dev/null || cat "$OUT/summary.csv"
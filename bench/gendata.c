@@ -0,0 +1,175 @@
+/**
+ *  \file gendata.c
+ *
+ *  \brief Input generator of the benchmarks.
+ *
+ *  Generates the inputs of the programs, reproducibly from a seed:
+ *    \li matrix files: number of matrices and order (two ints), then the terms of each matrix
+ *        (doubles, row by row), as read by the matrix determinant programs;
+ *    \li text corpora: UTF-8 Portuguese-like text, with accented letters, punctuation, quotes and
+ *        apostrophes, as read by the text processing programs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <libgen.h>
+
+/** \brief words of the corpora, with every special character the text programs handle */
+static const char *words[] = {
+  "a", "o", "e", "é", "um", "uma", "de", "do", "da", "em", "que", "não", "com", "para", "por",
+  "casa", "cidade", "coração", "ação", "informação", "água", "árvore", "órgão", "ótimo", "última",
+  "então", "também", "você", "português", "três", "pé", "avô", "avó", "irmã", "mãe", "pão", "põe",
+  "lições", "câmara", "ênfase", "ícone", "úmido", "qualquer", "sempre", "escola", "estrada",
+  "livro", "luz", "mar", "sol", "rapaz", "feliz", "dizer", "fazer", "olhar", "ver", "ler", "uns",
+  "cão", "caçador", "açúcar", "ouvir", "ideia", "obra", "ilha", "homem", "hoje", "d'água",
+  "pôr-do-sol", "guarda-chuva", "1999", "12", "Lisboa", "Porto", "Aveiro", "Ângela", "Óscar",
+};
+
+/** \brief separators between words, one of them is picked after each word */
+static const char *separators[] = {
+  " ", " ", " ", " ", " ", " ", " ", " ", ", ", ". ", "; ", ": ", "! ", "? ", "\n", " - ", " – ",
+  " “", "” ", " «", "» ", " (", ") ", " [", "] ", "… ",
+};
+
+/** \brief state of the generator */
+static uint64_t state;
+
+/** \brief next pseudo-random number (xorshift64*) */
+static uint64_t nextRandom(void)
+{
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 2685821657736338717ULL;
+}
+
+/** \brief print the usage of the program */
+static void printUsage(char *cmdName);
+
+/**
+ *  \brief Main function.
+ *
+ *  \param argc number of words of the command line
+ *  \param argv list of words of the command line
+ *
+ *  \return status of operation
+ */
+int main(int argc, char *argv[])
+{
+  char *type = NULL;           /* matrix or text */
+  char *output = NULL;         /* name of the file generated */
+  int count = 1;               /* number of matrices */
+  int order = 32;              /* order of the matrices */
+  long size = 1 << 20;         /* bytes of the corpus */
+  uint64_t seed = 1;
+  int opt;
+
+  opterr = 0;
+  while ((opt = getopt(argc, argv, "t:o:n:r:z:s:h")) != -1)
+    switch (opt)
+    {
+    case 't': /* type of input */
+      type = optarg;
+      break;
+    case 'o': /* output file */
+      output = optarg;
+      break;
+    case 'n': /* number of matrices */
+      count = atoi(optarg);
+      break;
+    case 'r': /* order of the matrices */
+      order = atoi(optarg);
+      break;
+    case 'z': /* bytes of the corpus */
+      size = atol(optarg);
+      break;
+    case 's': /* seed */
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'h': /* help mode */
+      printUsage(basename(argv[0]));
+      return EXIT_SUCCESS;
+    default:
+      fprintf(stderr, "%s: invalid option\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+  if (type == NULL || output == NULL || count < 0 || order < 1 || size < 0)
+  {
+    fprintf(stderr, "%s: invalid format\n", basename(argv[0]));
+    printUsage(basename(argv[0]));
+    return EXIT_FAILURE;
+  }
+
+  FILE *f = fopen(output, "wb");
+  if (f == NULL)
+  {
+    perror("error on opening the output file");
+    return EXIT_FAILURE;
+  }
+  state = seed * 0x9E3779B97F4A7C15ULL + 1; /* never 0 */
+
+  if (strcmp(type, "matrix") == 0)
+  {
+    int header[2] = {count, order};
+    double *matrix = (double *)malloc((size_t)order * order * sizeof(double));
+    fwrite(header, sizeof(int), 2, f);
+    for (int m = 0; m < count; m++)
+    {
+      for (size_t t = 0; t < (size_t)order * order; t++) /* uniform in [-2, 2) */
+        matrix[t] = (double)(nextRandom() >> 11) / 9007199254740992.0 * 4.0 - 2.0;
+      fwrite(matrix, sizeof(double), (size_t)order * order, f);
+    }
+    free(matrix);
+  }
+  else if (strcmp(type, "text") == 0)
+  {
+    int nWords = sizeof(words) / sizeof(words[0]);
+    int nSeparators = sizeof(separators) / sizeof(separators[0]);
+    long written = 0;
+    while (written < size)
+    {
+      const char *w = words[nextRandom() % nWords];
+      const char *s = separators[nextRandom() % nSeparators];
+      written += fprintf(f, "%s%s", w, s);
+    }
+    fputc('\n', f);
+  }
+  else
+  {
+    fprintf(stderr, "%s: type must be matrix or text\n", basename(argv[0]));
+    fclose(f);
+    return EXIT_FAILURE;
+  }
+
+  if (fclose(f) != 0)
+  {
+    perror("error on writing the output file");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ *  \brief Print command usage.
+ *
+ *  \param cmdName string with the name of the command
+ */
+static void printUsage(char *cmdName)
+{
+  fprintf(stderr, "\nSynopsis: %s OPTIONS [type / output / number of matrices / order / bytes / seed]\n"
+                  "  OPTIONS:\n"
+                  "  -h      --- print this help\n"
+                  "  -t      --- type of input: matrix or text\n"
+                  "  -o      --- file to generate\n"
+                  "  -n      --- number of matrices (default 1)\n"
+                  "  -r      --- order of the matrices (default 32)\n"
+                  "  -z      --- bytes of the text (default 1 MiB)\n"
+                  "  -s      --- seed (default 1)\n",
+          cmdName);
+}
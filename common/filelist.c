@@ -0,0 +1,128 @@
+/**
+ *  \file filelist.c (implementation file)
+ *
+ *  \brief Unbounded list of input files shared by the text processing and matrix determinant programs of every assignment.
+ *
+ *  Only the names of the command line are kept; the manifest is read a line at a time when a
+ *  window is taken, so a list piped on the standard input is processed while it is being produced.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filelist.h"
+
+/**
+ *  \brief Initialize an empty list.
+ *
+ *  \param list list
+ */
+void fileListInit(struct fileList *list)
+{
+  list->names = NULL;
+  list->nNames = 0;
+  list->capacity = 0;
+  list->next = 0;
+  list->manifest = NULL;
+}
+
+/**
+ *  \brief Add a name given on the command line.
+ *
+ *  \param list list
+ *  \param name name of the file
+ */
+void fileListAdd(struct fileList *list, const char *name)
+{
+  if (list->nNames == list->capacity)
+  {
+    list->capacity = (list->capacity == 0) ? 16 : 2 * list->capacity;
+    if ((list->names = realloc(list->names, list->capacity * sizeof(char *))) == NULL)
+    {
+      perror("error on allocating the list of files");
+      exit(EXIT_FAILURE);
+    }
+  }
+  list->names[list->nNames++] = strdup(name);
+}
+
+/**
+ *  \brief Set the manifest read after the names given on the command line.
+ *
+ *  \param list list
+ *  \param path path of the manifest, "-" for the standard input
+ *
+ *  \return 0 on success, -1 if the manifest can not be opened
+ */
+int fileListManifest(struct fileList *list, const char *path)
+{
+  if (list->manifest != NULL && list->manifest != stdin)
+    fclose(list->manifest);
+  list->manifest = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+  return (list->manifest == NULL) ? -1 : 0;
+}
+
+/**
+ *  \brief Read the next name of the manifest.
+ *
+ *  \param manifest manifest
+ *
+ *  \return name allocated with malloc, or NULL at the end of the manifest
+ */
+static char *readManifest(FILE *manifest)
+{
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+
+  while ((len = getline(&line, &size, manifest)) != -1)
+  {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = '\0';
+    if (len > 0 && line[0] != '#')
+      return line;
+  }
+  free(line);
+  return NULL;
+}
+
+/**
+ *  \brief Take the next names of the list.
+ *
+ *  \param list list
+ *  \param names array filled with the names, each allocated with malloc and freed by the caller
+ *  \param max most names taken
+ *
+ *  \return number of names taken, 0 once the list is exhausted
+ */
+int fileListWindow(struct fileList *list, char **names, int max)
+{
+  int n = 0;
+
+  while (n < max && list->next < list->nNames)
+  {
+    names[n++] = list->names[list->next];
+    list->names[list->next++] = NULL;
+  }
+  while (n < max && list->manifest != NULL && (names[n] = readManifest(list->manifest)) != NULL)
+    n++;
+  return n;
+}
+
+/**
+ *  \brief Close the manifest and free the list.
+ *
+ *  \param list list
+ */
+void fileListClose(struct fileList *list)
+{
+  for (int i = list->next; i < list->nNames; i++)
+    free(list->names[i]);
+  free(list->names);
+  if (list->manifest != NULL && list->manifest != stdin)
+    fclose(list->manifest);
+  fileListInit(list);
+}
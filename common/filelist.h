@@ -0,0 +1,81 @@
+/**
+ *  \file filelist.h (interface file)
+ *
+ *  \brief Unbounded list of input files shared by the text processing and matrix determinant programs of every assignment.
+ *
+ *  The names given on the command line (-f) come first, then the lines of a manifest (-F), a file
+ *  with a name per line, read as they are needed so that the list can be of any length; "-" reads
+ *  the manifest from the standard input. Empty lines and lines starting with '#' are skipped.
+ *
+ *  The programs take the names in windows of a bounded number of files, process a window and print
+ *  its results, then free its state before the next one, so their memory does not grow with the list.
+ *
+ *  Methods:
+ *     \li fileListInit - initializes an empty list.
+ *     \li fileListAdd - adds a name given on the command line.
+ *     \li fileListManifest - sets the manifest read after those names.
+ *     \li fileListWindow - takes the next names of the list.
+ *     \li fileListClose - closes the manifest and frees the list.
+ */
+#ifndef FILELIST_H
+#define FILELIST_H
+
+#include <stdio.h>
+
+/** \brief default number of files of a window */
+#define DW 64
+
+/** \brief list of input files */
+struct fileList
+{
+  char **names;   /* names given on the command line */
+  int nNames;     /* number of those names */
+  int capacity;   /* names allocated */
+  int next;       /* next of those names to be taken */
+  FILE *manifest; /* manifest read after those names, or NULL */
+};
+
+/**
+ *  \brief Initialize an empty list.
+ *
+ *  \param list list
+ */
+extern void fileListInit(struct fileList *list);
+
+/**
+ *  \brief Add a name given on the command line.
+ *
+ *  \param list list
+ *  \param name name of the file
+ */
+extern void fileListAdd(struct fileList *list, const char *name);
+
+/**
+ *  \brief Set the manifest read after the names given on the command line.
+ *
+ *  \param list list
+ *  \param path path of the manifest, "-" for the standard input
+ *
+ *  \return 0 on success, -1 if the manifest can not be opened
+ */
+extern int fileListManifest(struct fileList *list, const char *path);
+
+/**
+ *  \brief Take the next names of the list.
+ *
+ *  \param list list
+ *  \param names array filled with the names, each allocated with malloc and freed by the caller
+ *  \param max most names taken
+ *
+ *  \return number of names taken, 0 once the list is exhausted
+ */
+extern int fileListWindow(struct fileList *list, char **names, int max);
+
+/**
+ *  \brief Close the manifest and free the list.
+ *
+ *  \param list list
+ */
+extern void fileListClose(struct fileList *list);
+
+#endif /* FILELIST_H */
@@ -0,0 +1,409 @@
+/**
+ *  \file resultcache.c (implementation file)
+ *
+ *  \brief On-disk cache of results keyed by the hash of their input, shared by the text processing and matrix determinant programs of every assignment.
+ *
+ *  The records of the file are loaded into an open addressing hash table (linear probing) that is not
+ *  changed until the cache is closed, so the lookups of the threads take no lock. The values stored
+ *  during the run wait in a list guarded by a mutex, and are added to the table and appended to the
+ *  file by cacheClose.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "resultcache.h"
+
+/** \brief first bytes of a cache file */
+#define CACHE_MAGIC "RCACHE1\n"
+
+/** \brief primes of XXH64 */
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+/** \brief header of a cache file */
+struct cacheHeader
+{
+  char magic[8];
+  uint32_t valueSize;
+  uint32_t reserved;
+};
+
+/** \brief structure of the cache */
+struct resultCache
+{
+  char *path;             /* file of the cache */
+  size_t valueSize;
+  size_t recordSize;      /* key and value */
+  bool writable;          /* the header of the file matches, or there is no file yet */
+  size_t capacity;        /* slots of the table, a power of two */
+  size_t count;           /* keys in the table */
+  uint64_t *keys;         /* key of each slot, 0 for an empty slot */
+  unsigned char *values;  /* value of each slot */
+  pthread_mutex_t lock;   /* guards the values stored during the run */
+  unsigned char *pending; /* records stored during the run */
+  size_t nPending;
+  size_t pendingCapacity;
+};
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline uint64_t xxhMerge(uint64_t acc, uint64_t val)
+{
+  acc ^= xxhRound(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+/**
+ *  \brief XXH64 hash of a block of memory.
+ *
+ *  Four lanes consume stripes of 32 bytes, then the tail is mixed 8, 4 and 1 bytes at a time.
+ *  The bytes are read in the order of the machine (little endian on the targets of the programs).
+ *
+ *  \param data first byte of the block
+ *  \param size number of bytes of the block
+ *  \param seed seed of the hash
+ *
+ *  \return hash
+ */
+uint64_t cacheHash(const void *data, size_t size, uint64_t seed)
+{
+  const unsigned char *p = (const unsigned char *)data;
+  const unsigned char *end = p + size;
+  uint64_t h;
+
+  if (size >= 32)
+  {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+
+    for (; p + 32 <= end; p += 32)
+    {
+      v1 = xxhRound(v1, read64(p));
+      v2 = xxhRound(v2, read64(p + 8));
+      v3 = xxhRound(v3, read64(p + 16));
+      v4 = xxhRound(v4, read64(p + 24));
+    }
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = xxhMerge(h, v1);
+    h = xxhMerge(h, v2);
+    h = xxhMerge(h, v3);
+    h = xxhMerge(h, v4);
+  }
+  else
+    h = seed + PRIME64_5;
+
+  h += (uint64_t)size;
+  for (; p + 8 <= end; p += 8)
+  {
+    h ^= xxhRound(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (p + 4 <= end)
+  {
+    h ^= (uint64_t)read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++)
+  {
+    h ^= (*p) * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33; /* avalanche */
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+/**
+ *  \brief XXH64 hash, with seed 0, of the contents of a file.
+ *
+ *  \param path name of the file
+ *  \param hash hash of the contents
+ *
+ *  \return 0, or -1 if the file can not be read
+ */
+int cacheHashFile(const char *path, uint64_t *hash)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+
+  if (fd == -1)
+    return -1;
+  if (fstat(fd, &st) == -1)
+  {
+    close(fd);
+    return -1;
+  }
+  if (st.st_size == 0) /* an empty file can not be mapped */
+  {
+    close(fd);
+    *hash = cacheHash(NULL, 0, 0);
+    return 0;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  *hash = cacheHash(map, st.st_size, 0);
+  munmap(map, st.st_size);
+  return 0;
+}
+
+/**
+ *  \brief Slot of a key in the table: the one holding it, or the empty slot where it would go.
+ *
+ *  \param cache cache
+ *  \param key key (not 0)
+ *
+ *  \return index of the slot
+ */
+static size_t findSlot(struct resultCache *cache, uint64_t key)
+{
+  size_t mask = cache->capacity - 1;
+  size_t slot = (size_t)(key ^ (key >> 29)) & mask;
+
+  while (cache->keys[slot] != 0 && cache->keys[slot] != key)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+/**
+ *  \brief Add a key to the table, doubling it when it is half full, or replace its value.
+ *
+ *  \param cache cache
+ *  \param key key (not 0)
+ *  \param value value
+ *
+ *  \return false if the key was already in the table with the same value
+ */
+static bool insertKey(struct resultCache *cache, uint64_t key, const unsigned char *value)
+{
+  if (2 * (cache->count + 1) > cache->capacity)
+  {
+    uint64_t *keys = cache->keys;
+    unsigned char *values = cache->values;
+    size_t capacity = cache->capacity;
+
+    cache->capacity = 2 * capacity;
+    cache->keys = (uint64_t *)calloc(cache->capacity, sizeof(uint64_t));
+    cache->values = (unsigned char *)malloc(cache->capacity * cache->valueSize);
+    for (size_t s = 0; s < capacity; s++)
+      if (keys[s] != 0)
+      {
+        size_t slot = findSlot(cache, keys[s]);
+        cache->keys[slot] = keys[s];
+        memcpy(cache->values + slot * cache->valueSize, values + s * cache->valueSize, cache->valueSize);
+      }
+    free(keys);
+    free(values);
+  }
+
+  size_t slot = findSlot(cache, key);
+  if (cache->keys[slot] == key)
+  {
+    if (memcmp(cache->values + slot * cache->valueSize, value, cache->valueSize) == 0)
+      return false;
+  }
+  else
+  {
+    cache->keys[slot] = key;
+    cache->count++;
+  }
+  memcpy(cache->values + slot * cache->valueSize, value, cache->valueSize);
+  return true;
+}
+
+/**
+ *  \brief Load a cache of the cache directory, created if it does not exist yet.
+ *
+ *  \param dir cache directory
+ *  \param name name of the cache, the file is dir/name.cache
+ *  \param valueSize number of bytes of a value
+ *
+ *  \return cache, or NULL if the directory can not be created
+ */
+struct resultCache *cacheOpen(const char *dir, const char *name, size_t valueSize)
+{
+  if (mkdir(dir, 0777) == -1 && errno != EEXIST)
+    return NULL;
+
+  struct resultCache *cache = (struct resultCache *)calloc(1, sizeof(struct resultCache));
+  cache->path = (char *)malloc(strlen(dir) + strlen(name) + 8);
+  sprintf(cache->path, "%s/%s.cache", dir, name);
+  cache->valueSize = valueSize;
+  cache->recordSize = sizeof(uint64_t) + valueSize;
+  cache->writable = true;
+  pthread_mutex_init(&cache->lock, NULL);
+  cache->capacity = 1024;
+  cache->keys = (uint64_t *)calloc(cache->capacity, sizeof(uint64_t)); /* key 0 marks the empty slots, it is stored as 1 */
+  cache->values = (unsigned char *)malloc(cache->capacity * valueSize);
+
+  FILE *fp = fopen(cache->path, "rb");
+  if (fp == NULL)
+    return cache; /* nothing cached yet */
+
+  struct cacheHeader header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, CACHE_MAGIC, 8) != 0 || header.valueSize != valueSize)
+  {
+    fprintf(stderr, "cache %s does not match, it is not used\n", cache->path);
+    cache->writable = false;
+    fclose(fp);
+    return cache;
+  }
+
+  unsigned char *record = (unsigned char *)malloc(cache->recordSize);
+  size_t nRecords = 0;
+  while (fread(record, cache->recordSize, 1, fp) == 1) /* a later record of a key replaces the value */
+  {
+    insertKey(cache, read64(record), record + sizeof(uint64_t));
+    nRecords++;
+  }
+  free(record);
+
+  /* a record cut by an interrupted run is removed, so the records of this run are appended after the last complete one */
+  off_t end = sizeof(header) + (off_t)(nRecords * cache->recordSize);
+  if (fseeko(fp, 0, SEEK_END) == 0 && ftello(fp) > end && truncate(cache->path, end) == -1)
+  {
+    fprintf(stderr, "cache %s could not be repaired, it is not written\n", cache->path);
+    cache->writable = false;
+  }
+  fclose(fp);
+  return cache;
+}
+
+/**
+ *  \brief Look up the value of a key loaded from the file.
+ *
+ *  \param cache cache
+ *  \param key key
+ *  \param value the value, if the key was found
+ *
+ *  \return true if the key was found
+ */
+bool cacheGet(struct resultCache *cache, uint64_t key, void *value)
+{
+  if (key == 0)
+    key = 1;
+
+  size_t slot = findSlot(cache, key);
+  if (cache->keys[slot] != key)
+    return false;
+  memcpy(value, cache->values + slot * cache->valueSize, cache->valueSize);
+  return true;
+}
+
+/**
+ *  \brief Store the value of a key, appended to the file when the cache is closed.
+ *
+ *  \param cache cache
+ *  \param key key
+ *  \param value value, copied
+ */
+void cachePut(struct resultCache *cache, uint64_t key, const void *value)
+{
+  if (key == 0)
+    key = 1;
+  if (!cache->writable) /* the table does not change until the cache is closed */
+    return;
+  size_t slot = findSlot(cache, key);
+  if (cache->keys[slot] == key && memcmp(cache->values + slot * cache->valueSize, value, cache->valueSize) == 0)
+    return;
+
+  pthread_mutex_lock(&cache->lock);
+  if (cache->nPending == cache->pendingCapacity)
+  {
+    cache->pendingCapacity = (cache->pendingCapacity == 0) ? 256 : 2 * cache->pendingCapacity;
+    cache->pending = (unsigned char *)realloc(cache->pending, cache->pendingCapacity * cache->recordSize);
+  }
+  unsigned char *record = cache->pending + cache->nPending++ * cache->recordSize;
+  memcpy(record, &key, sizeof(uint64_t));
+  memcpy(record + sizeof(uint64_t), value, cache->valueSize);
+  pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ *  \brief Append the values stored during the run, close the file and free the cache.
+ *
+ *  The records are appended with a single buffered stream, so a file shared by runs that end
+ *  at the same time may get the same key twice, which is harmless.
+ *
+ *  \param cache cache
+ */
+void cacheClose(struct resultCache *cache)
+{
+  if (cache->nPending > 0)
+  {
+    FILE *fp = fopen(cache->path, "ab");
+    if (fp == NULL)
+      fprintf(stderr, "cache %s could not be written\n", cache->path);
+    else
+    {
+      fseeko(fp, 0, SEEK_END);
+      if (ftello(fp) == 0) /* new file */
+      {
+        struct cacheHeader header;
+        memcpy(header.magic, CACHE_MAGIC, 8);
+        header.valueSize = cache->valueSize;
+        header.reserved = 0;
+        fwrite(&header, sizeof(header), 1, fp);
+      }
+      for (size_t r = 0; r < cache->nPending; r++)
+      {
+        unsigned char *record = cache->pending + r * cache->recordSize;
+        if (insertKey(cache, read64(record), record + sizeof(uint64_t))) /* not for the same input twice in the run */
+          fwrite(record, cache->recordSize, 1, fp);
+      }
+      fclose(fp);
+    }
+  }
+
+  pthread_mutex_destroy(&cache->lock);
+  free(cache->pending);
+  free(cache->keys);
+  free(cache->values);
+  free(cache->path);
+  free(cache);
+}
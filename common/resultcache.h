@@ -0,0 +1,110 @@
+/**
+ *  \file resultcache.h (interface file)
+ *
+ *  \brief On-disk cache of results keyed by the hash of their input, shared by the text processing and matrix determinant programs of every assignment.
+ *
+ *  The key is the XXH64 hash of the contents of a file (word counts) or of the terms of a matrix
+ *  (determinants), so a file or a matrix already seen by a previous run is not processed again,
+ *  whatever its name or its place in the list.
+ *
+ *  A cache is a file of the cache directory: a header (magic, size of a value), then records of a
+ *  64 bit key followed by the value, the last record of a key holding its value. It is loaded into
+ *  a hash table when opened, the lookups of a run only read that table (no lock), and the results
+ *  stored during the run are appended to the file when it is closed. Different values with the same hash are not told apart: with 64 bits the
+ *  chance is negligible for any realistic number of inputs.
+ *
+ *  Methods:
+ *     \li cacheHash - XXH64 hash of a block of memory.
+ *     \li cacheHashFile - XXH64 hash of the contents of a file.
+ *     \li cacheOpen - loads a cache of the cache directory (created if needed).
+ *     \li cacheGet - looks up the value of a key loaded from the file.
+ *     \li cachePut - stores the value of a key, appended to the file when the cache is closed.
+ *     \li cacheClose - appends the values stored, closes the file and frees the cache.
+ */
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief opaque structure of the cache */
+struct resultCache;
+
+/**
+ *  \brief XXH64 hash of a block of memory.
+ *
+ *  \param data first byte of the block
+ *  \param size number of bytes of the block
+ *  \param seed seed of the hash (the order of the matrices, so equal terms of other orders do not collide)
+ *
+ *  \return hash
+ */
+extern uint64_t cacheHash(const void *data, size_t size, uint64_t seed);
+
+/**
+ *  \brief XXH64 hash, with seed 0, of the contents of a file.
+ *
+ *  The file is mapped in memory, so it is read only once.
+ *
+ *  \param path name of the file
+ *  \param hash hash of the contents
+ *
+ *  \return 0, or -1 if the file can not be read
+ */
+extern int cacheHashFile(const char *path, uint64_t *hash);
+
+/**
+ *  \brief Load a cache of the cache directory, created if it does not exist yet.
+ *
+ *  A file whose header does not match (another size of values) is not used, and not written.
+ *
+ *  \param dir cache directory
+ *  \param name name of the cache, the file is dir/name.cache
+ *  \param valueSize number of bytes of a value
+ *
+ *  \return cache, or NULL if the directory can not be created
+ */
+extern struct resultCache *cacheOpen(const char *dir, const char *name, size_t valueSize);
+
+/**
+ *  \brief Look up the value of a key loaded from the file.
+ *
+ *  May be called by any thread, without lock. The values stored during the run are not seen.
+ *
+ *  \param cache cache
+ *  \param key key
+ *  \param value the value, if the key was found
+ *
+ *  \return true if the key was found
+ */
+extern bool cacheGet(struct resultCache *cache, uint64_t key, void *value);
+
+/**
+ *  \brief Store the value of a key, appended to the file when the cache is closed.
+ *
+ *  May be called by any thread. A key that is already in the cache with the same value is not stored
+ *  again, with another value (a result calculated with more options) it is replaced.
+ *
+ *  \param cache cache
+ *  \param key key
+ *  \param value value, copied
+ */
+extern void cachePut(struct resultCache *cache, uint64_t key, const void *value);
+
+/**
+ *  \brief Append the values stored during the run, close the file and free the cache.
+ *
+ *  \param cache cache
+ */
+extern void cacheClose(struct resultCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESULTCACHE_H */
@@ -0,0 +1,394 @@
+/**
+ *  \file resultsink.c (implementation file)
+ *
+ *  \brief Streamed output of the results, shared by the text processing and matrix determinant programs of every assignment.
+ *
+ *  The files handed to the sink wait in a list guarded by a mutex, the writer thread sleeps on a
+ *  condition variable until the file with the next sequence number is in the list, then formats
+ *  and writes it outside the lock, so the threads that hand the files over never wait for the output.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "resultsink.h"
+
+/** \brief size of the buffer of an output file */
+#define SINK_BUFFER 1048576
+
+/** \brief kind of a record of the binary format */
+#define RECORD_WORDS 1
+#define RECORD_DETERMINANTS 2
+
+/** \brief results of a file waiting to be written */
+struct sinkRecord
+{
+  unsigned long seq;       /* position of the file in the list */
+  int kind;                /* RECORD_WORDS or RECORD_DETERMINANTS */
+  char *fileName;
+  int counts[3];           /* nWords, nWordsBV and nWordsEC */
+  int nMatrix;
+  int order;
+  double *determinants;
+  double *logDeterminants; /* or NULL */
+  struct sinkRecord *next;
+};
+
+/** \brief structure of the sink */
+struct resultSink
+{
+  FILE *out;
+  int format;
+  char *buffer;              /* buffer of an output file, NULL for the standard output */
+  bool header;               /* the header of the csv format was written */
+  pthread_t thread;          /* writer thread */
+  pthread_mutex_t lock;      /* guards the fields below */
+  pthread_cond_t ready;      /* a record was added, or the sink is closing */
+  struct sinkRecord *records; /* records not written yet, in any order */
+  unsigned long next;        /* sequence number of the next record written */
+  bool closing;              /* no more records will be added */
+};
+
+/**
+ *  \brief Parse the name of a format.
+ *
+ *  \param name text, csv or binary
+ *
+ *  \return the format, or -1 if the name is not known
+ */
+int sinkFormat(const char *name)
+{
+  if (strcmp(name, "text") == 0)
+    return SINK_TEXT;
+  if (strcmp(name, "csv") == 0)
+    return SINK_CSV;
+  if (strcmp(name, "binary") == 0)
+    return SINK_BINARY;
+  return -1;
+}
+
+/**
+ *  \brief Write a field of the csv format, quoted if it has a comma, a quote or a line break.
+ *
+ *  \param out output
+ *  \param field field
+ */
+static void writeCsvField(FILE *out, const char *field)
+{
+  if (strpbrk(field, ",\"\r\n") == NULL)
+  {
+    fputs(field, out);
+    return;
+  }
+  putc('"', out);
+  for (const char *c = field; *c != '\0'; c++)
+  {
+    if (*c == '"')
+      putc('"', out);
+    putc(*c, out);
+  }
+  putc('"', out);
+}
+
+/**
+ *  \brief Write a determinant from its value and the logarithm of its absolute value.
+ *
+ *  The sign is the one of the value, it is kept when the value overflows or underflows,
+ *  and the digits come from the logarithm.
+ *
+ *  \param out output
+ *  \param determinant value of the determinant
+ *  \param logDeterminant log|det|
+ */
+static void writeLogDeterminant(FILE *out, double determinant, double logDeterminant)
+{
+  if (isinf(logDeterminant) && logDeterminant < 0) /* singular matrix */
+  {
+    fprintf(out, "%.3e (log|det| = -inf)", 0.0);
+    return;
+  }
+  double exponent = floor(logDeterminant / M_LN10);
+  double mantissa = pow(10, logDeterminant / M_LN10 - exponent);
+  if (mantissa >= 9.9995) /* rounds up to the next power */
+  {
+    mantissa /= 10;
+    exponent++;
+  }
+  fprintf(out, "%s%.3fe%+03.0f (log|det| = %.6f)", signbit(determinant) ? "-" : "", mantissa, exponent, logDeterminant);
+}
+
+/**
+ *  \brief Write a record in the format of the sink.
+ *
+ *  Operation carried out by the writer thread.
+ *
+ *  \param sink sink
+ *  \param r record
+ */
+static void writeRecord(struct resultSink *sink, struct sinkRecord *r)
+{
+  FILE *out = sink->out;
+
+  flockfile(out); /* the lines of a file are not mixed with the other lines of the program */
+  if (sink->format == SINK_BINARY)
+  {
+    int head[2] = {r->kind, (int)strlen(r->fileName)};
+    fwrite(head, sizeof(int), 2, out);
+    fwrite(r->fileName, 1, head[1], out);
+    if (r->kind == RECORD_WORDS)
+      fwrite(r->counts, sizeof(int), 3, out);
+    else
+    {
+      int shape[3] = {r->nMatrix, r->order, r->logDeterminants != NULL};
+      fwrite(shape, sizeof(int), 3, out);
+      fwrite(r->determinants, sizeof(double), r->nMatrix, out);
+      if (r->logDeterminants != NULL)
+        fwrite(r->logDeterminants, sizeof(double), r->nMatrix, out);
+    }
+  }
+  else if (sink->format == SINK_CSV)
+  {
+    if (!sink->header)
+    {
+      if (r->kind == RECORD_WORDS)
+        fputs("file,words,words_beginning_with_vowel,words_ending_with_consonant\n", out);
+      else
+        fputs(r->logDeterminants != NULL ? "file,matrix,order,determinant,log_abs_determinant\n" : "file,matrix,order,determinant\n", out);
+      sink->header = true;
+    }
+    if (r->kind == RECORD_WORDS)
+    {
+      writeCsvField(out, r->fileName);
+      fprintf(out, ",%d,%d,%d\n", r->counts[0], r->counts[1], r->counts[2]);
+    }
+    else
+      for (int i = 0; i < r->nMatrix; i++)
+      {
+        writeCsvField(out, r->fileName);
+        fprintf(out, ",%d,%d,%.17g", i + 1, r->order, r->determinants[i]);
+        if (r->logDeterminants != NULL)
+          fprintf(out, ",%.17g", r->logDeterminants[i]);
+        putc('\n', out);
+      }
+  }
+  else if (r->kind == RECORD_WORDS)
+  {
+    fprintf(out, "\nFile name: %s\n", r->fileName);
+    fprintf(out, "Total number of words = %d\n", r->counts[0]);
+    fprintf(out, "N. of words beginning with a vowel = %d\n", r->counts[1]);
+    fprintf(out, "N. of words ending with a consonant = %d\n", r->counts[2]);
+  }
+  else
+  {
+    fprintf(out, "\nMatrix File  %s\n", r->fileName);
+    fprintf(out, "Number of Matrices  %d\n", r->nMatrix);
+    fprintf(out, "Order of the matrices  %d\n", r->order);
+    for (int i = 0; i < r->nMatrix; i++)
+    {
+      if (r->logDeterminants != NULL) /* value printed from its logarithm */
+      {
+        fprintf(out, "\tMatrix %d Result: Determinant = ", i + 1);
+        writeLogDeterminant(out, r->determinants[i], r->logDeterminants[i]);
+        fprintf(out, " \n");
+      }
+      else
+        fprintf(out, "\tMatrix %d Result: Determinant = %.3e \n", i + 1, r->determinants[i]);
+    }
+  }
+  funlockfile(out);
+}
+
+/**
+ *  \brief Writer thread.
+ *
+ *  Writes the records in the order of their sequence numbers, waiting for the next one when it is
+ *  not there yet. Once the sink is closing, a missing number is skipped.
+ *
+ *  \param arg sink
+ */
+static void *writer(void *arg)
+{
+  struct resultSink *sink = (struct resultSink *)arg;
+
+  pthread_mutex_lock(&sink->lock);
+  while (true)
+  {
+    struct sinkRecord **link = &sink->records, **lowest = NULL;
+    while (*link != NULL && (*link)->seq != sink->next)
+    {
+      if (lowest == NULL || (*link)->seq < (*lowest)->seq)
+        lowest = link;
+      link = &(*link)->next;
+    }
+
+    if (*link == NULL && sink->closing)
+    {
+      if (lowest == NULL) /* every record was written */
+        break;
+      link = lowest;
+    }
+    if (*link == NULL)
+    {
+      pthread_cond_wait(&sink->ready, &sink->lock);
+      continue;
+    }
+
+    struct sinkRecord *r = *link;
+    *link = r->next;
+    sink->next = r->seq + 1;
+    pthread_mutex_unlock(&sink->lock);
+
+    writeRecord(sink, r);
+    free(r->fileName);
+    free(r->determinants);
+    free(r->logDeterminants);
+    free(r);
+
+    pthread_mutex_lock(&sink->lock);
+  }
+  pthread_mutex_unlock(&sink->lock);
+  return NULL;
+}
+
+/**
+ *  \brief Open the output and start the writer thread.
+ *
+ *  \param path file written, or NULL for the standard output
+ *  \param format SINK_TEXT, SINK_CSV or SINK_BINARY
+ *
+ *  \return sink, or NULL if the file can not be opened
+ */
+struct resultSink *sinkOpen(const char *path, int format)
+{
+  struct resultSink *sink = (struct resultSink *)calloc(1, sizeof(struct resultSink));
+
+  sink->format = format;
+  sink->out = stdout;
+  if (path != NULL)
+  {
+    if ((sink->out = fopen(path, (format == SINK_BINARY) ? "wb" : "w")) == NULL)
+    {
+      free(sink);
+      return NULL;
+    }
+    sink->buffer = (char *)malloc(SINK_BUFFER);
+    setvbuf(sink->out, sink->buffer, _IOFBF, SINK_BUFFER); /* a write per megabyte */
+  }
+  pthread_mutex_init(&sink->lock, NULL);
+  pthread_cond_init(&sink->ready, NULL);
+
+  if (pthread_create(&sink->thread, NULL, writer, sink) != 0)
+  {
+    perror("error on creating the writer thread");
+    exit(EXIT_FAILURE);
+  }
+  return sink;
+}
+
+/**
+ *  \brief Add a record to the list and wake up the writer.
+ *
+ *  \param sink sink
+ *  \param r record
+ */
+static void putRecord(struct resultSink *sink, struct sinkRecord *r)
+{
+  pthread_mutex_lock(&sink->lock);
+  r->next = sink->records;
+  sink->records = r;
+  if (r->seq == sink->next)
+    pthread_cond_signal(&sink->ready);
+  pthread_mutex_unlock(&sink->lock);
+}
+
+/**
+ *  \brief Hand the word counts of a file to the writer.
+ *
+ *  \param sink sink
+ *  \param seq position of the file in the list (0 for the first one)
+ *  \param fileName name of the file, copied
+ *  \param nWords number of words
+ *  \param nWordsBV number of words beginning with a vowel
+ *  \param nWordsEC number of words ending with a consonant
+ */
+void sinkWords(struct resultSink *sink, unsigned long seq, const char *fileName, int nWords, int nWordsBV, int nWordsEC)
+{
+  struct sinkRecord *r = (struct sinkRecord *)calloc(1, sizeof(struct sinkRecord));
+
+  r->seq = seq;
+  r->kind = RECORD_WORDS;
+  r->fileName = strdup(fileName);
+  r->counts[0] = nWords;
+  r->counts[1] = nWordsBV;
+  r->counts[2] = nWordsEC;
+  putRecord(sink, r);
+}
+
+/**
+ *  \brief Hand the determinants of a file to the writer.
+ *
+ *  The arrays now belong to the sink, which frees them once written.
+ *
+ *  \param sink sink
+ *  \param seq position of the file in the list (0 for the first one)
+ *  \param fileName name of the file, copied
+ *  \param nMatrix number of matrices
+ *  \param order order of the matrices
+ *  \param determinants determinant of each matrix, allocated with malloc
+ *  \param logDeterminants log|det| of each matrix, allocated with malloc (or NULL)
+ */
+void sinkDeterminants(struct resultSink *sink, unsigned long seq, const char *fileName, int nMatrix, int order,
+                      double *determinants, double *logDeterminants)
+{
+  struct sinkRecord *r = (struct sinkRecord *)calloc(1, sizeof(struct sinkRecord));
+
+  r->seq = seq;
+  r->kind = RECORD_DETERMINANTS;
+  r->fileName = strdup(fileName);
+  r->nMatrix = nMatrix;
+  r->order = order;
+  r->determinants = determinants;
+  r->logDeterminants = logDeterminants;
+  putRecord(sink, r);
+}
+
+/**
+ *  \brief Stream of the other lines of the programs.
+ *
+ *  \param sink sink
+ *
+ *  \return the standard output with the text format, the standard error otherwise
+ */
+FILE *sinkInfo(struct resultSink *sink)
+{
+  return (sink->format == SINK_TEXT) ? stdout : stderr;
+}
+
+/**
+ *  \brief Write the files left, stop the writer thread, close the output and free the sink.
+ *
+ *  \param sink sink
+ */
+void sinkClose(struct resultSink *sink)
+{
+  pthread_mutex_lock(&sink->lock);
+  sink->closing = true;
+  pthread_cond_signal(&sink->ready);
+  pthread_mutex_unlock(&sink->lock);
+  pthread_join(sink->thread, NULL);
+
+  if (sink->out != stdout)
+    fclose(sink->out);
+  else
+    fflush(stdout);
+  free(sink->buffer);
+  pthread_mutex_destroy(&sink->lock);
+  pthread_cond_destroy(&sink->ready);
+  free(sink);
+}
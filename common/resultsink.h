@@ -0,0 +1,118 @@
+/**
+ *  \file resultsink.h (interface file)
+ *
+ *  \brief Streamed output of the results, shared by the text processing and matrix determinant programs of every assignment.
+ *
+ *  The results of a file are handed to the sink as soon as the file is done (its last chunk or matrix),
+ *  and a writer thread formats and writes them while the programs keep computing the next files.
+ *  Every file has a sequence number, its position in the list of files: the writer holds the files
+ *  that are done early and writes them in order, so the output does not depend on the scheduling.
+ *
+ *  Formats:
+ *     \li text - the lines printed so far by the programs.
+ *     \li csv - a header, then a line per file (word counts) or per matrix (determinants),
+ *         with the determinants printed with all their digits.
+ *     \li binary - a record per file, in the byte order of the machine:
+ *         int kind (1 words, 2 determinants), int length of the name, the name (no terminator), then
+ *         for words: int nWords, int nWordsBV, int nWordsEC;
+ *         for determinants: int nMatrix, int order, int hasLog, nMatrix doubles (and nMatrix doubles of log|det| if hasLog).
+ *
+ *  Methods:
+ *     \li sinkFormat - parses the name of a format.
+ *     \li sinkOpen - opens the output and starts the writer thread.
+ *     \li sinkWords - hands the word counts of a file to the writer.
+ *     \li sinkDeterminants - hands the determinants of a file to the writer.
+ *     \li sinkInfo - stream of the other lines of the programs (elapsed time, ...).
+ *     \li sinkClose - writes the files left, stops the writer and closes the output.
+ */
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief the lines printed so far by the programs */
+#define SINK_TEXT 0
+
+/** \brief comma separated values */
+#define SINK_CSV 1
+
+/** \brief records of ints and doubles */
+#define SINK_BINARY 2
+
+/** \brief opaque structure of the sink */
+struct resultSink;
+
+/**
+ *  \brief Parse the name of a format.
+ *
+ *  \param name text, csv or binary
+ *
+ *  \return the format, or -1 if the name is not known
+ */
+extern int sinkFormat(const char *name);
+
+/**
+ *  \brief Open the output and start the writer thread.
+ *
+ *  \param path file written, or NULL for the standard output
+ *  \param format SINK_TEXT, SINK_CSV or SINK_BINARY
+ *
+ *  \return sink, or NULL if the file can not be opened
+ */
+extern struct resultSink *sinkOpen(const char *path, int format);
+
+/**
+ *  \brief Hand the word counts of a file to the writer.
+ *
+ *  May be called by any thread.
+ *
+ *  \param sink sink
+ *  \param seq position of the file in the list (0 for the first one)
+ *  \param fileName name of the file, copied
+ *  \param nWords number of words
+ *  \param nWordsBV number of words beginning with a vowel
+ *  \param nWordsEC number of words ending with a consonant
+ */
+extern void sinkWords(struct resultSink *sink, unsigned long seq, const char *fileName, int nWords, int nWordsBV, int nWordsEC);
+
+/**
+ *  \brief Hand the determinants of a file to the writer.
+ *
+ *  May be called by any thread. The arrays now belong to the sink, which frees them once written.
+ *
+ *  \param sink sink
+ *  \param seq position of the file in the list (0 for the first one)
+ *  \param fileName name of the file, copied
+ *  \param nMatrix number of matrices
+ *  \param order order of the matrices
+ *  \param determinants determinant of each matrix, allocated with malloc
+ *  \param logDeterminants log|det| of each matrix, allocated with malloc (or NULL)
+ */
+extern void sinkDeterminants(struct resultSink *sink, unsigned long seq, const char *fileName, int nMatrix, int order,
+                             double *determinants, double *logDeterminants);
+
+/**
+ *  \brief Stream of the other lines of the programs.
+ *
+ *  \param sink sink
+ *
+ *  \return the standard output with the text format, the standard error otherwise, so the results stay parseable
+ */
+extern FILE *sinkInfo(struct resultSink *sink);
+
+/**
+ *  \brief Write the files left, stop the writer thread, close the output and free the sink.
+ *
+ *  \param sink sink
+ */
+extern void sinkClose(struct resultSink *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESULTSINK_H */
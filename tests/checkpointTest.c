@@ -0,0 +1,114 @@
+/**
+ *  \file checkpointTest.c
+ *
+ *  \brief Regression test of the checkpoint of the MPI programs (../assign2/common/checkpoint.c).
+ *
+ *  A checkpoint keeps a single record per file, replaced as the part of the file done grows, so
+ *  its size does not grow with the number of writes; it is written to a temporary file renamed
+ *  over the previous one, so no temporary file is left and the records of a reopened checkpoint
+ *  are the last ones written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../assign2/common/checkpoint.h"
+
+/** \brief kind of the records of the test */
+#define KIND 7
+
+/** \brief checks that failed */
+static int failed = 0;
+
+/**
+ *  \brief Report a check that failed.
+ *
+ *  \param ok result of the check
+ *  \param what description of the check
+ */
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failed++;
+  }
+}
+
+/**
+ *  \brief Size of a file.
+ *
+ *  \param path file
+ *
+ *  \return bytes of the file, or -1 if it does not exist
+ */
+static long sizeOf(const char *path)
+{
+  struct stat st;
+
+  return (stat(path, &st) == 0) ? (long)st.st_size : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *dir = (argc > 1) ? argv[1] : ".";
+  char path[4096], tmpPath[4200];
+  snprintf(path, sizeof(path), "%s/test.ckpt", dir);
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+  remove(path);
+
+  struct checkpoint *cp = checkpointOpen(path, KIND, 0);
+  check(cp != NULL, "a missing checkpoint opens empty");
+  check(checkpointFind(cp, "a.txt") == NULL, "an empty checkpoint has no record");
+
+  /* the record of a file is replaced at every write, so the file keeps its size */
+  int values[3];
+  long firstSize = -1;
+  for (int w = 1; w <= 1000; w++)
+  {
+    values[0] = w;
+    values[1] = 2 * w;
+    values[2] = 3 * w;
+    checkpointSet(cp, "a.txt", 100 * w, values, sizeof(values));
+    checkpointSet(cp, "b.txt", w, values, sizeof(values));
+    checkpointFlush(cp);
+    if (w == 1)
+      firstSize = sizeOf(path);
+  }
+  check(firstSize > 0, "the checkpoint is written");
+  check(sizeOf(path) == firstSize, "the checkpoint does not grow with the writes");
+  check(sizeOf(tmpPath) == -1, "no temporary file is left");
+  checkpointClose(cp, false);
+
+  /* the records read back are the last ones */
+  cp = checkpointOpen(path, KIND, 0);
+  check(cp != NULL, "the checkpoint opens again");
+  const struct checkpointRecord *record = checkpointFind(cp, "a.txt");
+  check(record != NULL && record->position == 100000 && record->size == sizeof(values),
+        "the record of a file is the last one written");
+  if (record != NULL && record->size == sizeof(values))
+  {
+    memcpy(values, record->values, sizeof(values));
+    check(values[0] == 1000 && values[1] == 2000 && values[2] == 3000, "the values of a record are the last ones");
+  }
+  checkpointClose(cp, false);
+
+  /* a checkpoint of another kind is not used */
+  check(checkpointOpen(path, KIND + 1, 0) == NULL, "a checkpoint of another kind is not used");
+
+  /* a cut checkpoint keeps its complete records */
+  check(truncate(path, sizeOf(path) - 5) == 0, "the checkpoint is cut");
+  cp = checkpointOpen(path, KIND, 0);
+  check(cp != NULL, "a cut checkpoint opens");
+  check((checkpointFind(cp, "a.txt") != NULL) + (checkpointFind(cp, "b.txt") != NULL) == 1,
+        "only the cut record of a cut checkpoint is dropped");
+  checkpointClose(cp, true);
+  check(sizeOf(path) == -1, "a finished checkpoint is removed");
+
+  if (failed == 0)
+    printf("checkpoint: passed\n");
+  return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
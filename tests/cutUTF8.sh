@@ -0,0 +1,66 @@
+#!/bin/bash
+#
+# Regression test of the UTF-8 decoding at the end of a chunk, in the text processing programs.
+#
+# A character is never decoded past the bytes of its chunk:
+#   - ../assign1/prog1/texts/cutUTF8.txt ends with a lone lead byte, and every dispatch mode and
+#     input backend counts 1365 words;
+#   - a text of two and three byte characters counted in chunks of odd sizes, so that most chunks
+#     end inside a character, gets the counts of the chunks of the default size.
+#
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+BIN=${BIN:-$HERE/bin}
+WORK=${WORK:-$HERE/work}
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIFLAGS=${MPIFLAGS:---oversubscribe}
+mkdir -p "$WORK"
+
+failed=0
+
+# expect <counts> <command...>: the counts printed by the command must be the given ones
+expect() {
+  local want=$1 got
+  shift
+  got=$("$@" 2>/dev/null | awk -F' = ' '/^Total number of words|^N. of words/ { printf "%s ", $2 }')
+  if [ "$got" != "$want" ]; then
+    echo "FAILED: $* gave '$got', expected '$want'" >&2
+    failed=1
+  fi
+}
+
+# lone lead byte at the end of the file
+CUT=$HERE/../assign1/prog1/texts/cutUTF8.txt
+for d in monitor atomic summary pool; do
+  for i in read mmap; do
+    expect "1365 1365 1365 " "$BIN/a1p1" -f "$CUT" -n 2 -d "$d" -i "$i"
+  done
+done
+for i in read mmap; do
+  expect "1365 1365 1365 " $MPIEXEC $MPIFLAGS -n 2 "$BIN/a2p1" -f "$CUT" -i "$i"
+  expect "1365 1365 1365 " $MPIEXEC $MPIFLAGS -n 3 "$BIN/a2p1" -f "$CUT" -i "$i" -p 4
+done
+expect "1365 1365 1365 " $MPIEXEC $MPIFLAGS -n 3 "$BIN/a2p1" -f "$CUT" -s scatter -m 64
+
+# characters of two and three bytes cut by the end of the chunks
+MB=$WORK/multibyte.txt
+: > "$MB"
+for r in $(seq 1 300); do
+  printf 'a\xc3\xa7\xc3\xa3o p\xc3\xb5e \xc3\xa9 \xe2\x82\xacuro, \xc3\xbanico; \xc3\xa1rvore ma\xc3\xa7\xc3\xa3 %d.\n' "$r" >> "$MB"
+done
+want=$("$BIN/a1p1" -f "$MB" -n 1 | awk -F' = ' '/^Total number of words|^N. of words/ { printf "%s ", $2 }')
+for m in 11 12 13 17 31; do
+  for d in monitor atomic summary pool; do
+    for i in read mmap; do
+      expect "$want" "$BIN/a1p1" -f "$MB" -n 3 -m "$m" -d "$d" -i "$i"
+    done
+  done
+  for i in read mmap; do
+    expect "$want" $MPIEXEC $MPIFLAGS -n 3 "$BIN/a2p1" -f "$MB" -m "$m" -i "$i"
+  done
+done
+
+[ $failed -eq 0 ] && echo "cutUTF8: passed"
+exit $failed
@@ -0,0 +1,123 @@
+/**
+ *  \file resultCacheTest.c
+ *
+ *  \brief Regression test of the result cache of every program (../common/resultcache.c).
+ *
+ *  A cache file cut inside a record, as an interrupted run leaves it, keeps its complete records,
+ *  and the records of the next run are appended after the last of them, so they are all found
+ *  when the cache is opened again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../common/resultcache.h"
+
+/** \brief keys stored by each run */
+#define KEYS 10
+
+/** \brief header of a cache file: magic and size of a value */
+#define HEADER_BYTES 16
+
+/** \brief checks that failed */
+static int failed = 0;
+
+/**
+ *  \brief Report a check that failed.
+ *
+ *  \param ok result of the check
+ *  \param what description of the check
+ */
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failed++;
+  }
+}
+
+/**
+ *  \brief Size of a file.
+ *
+ *  \param path file
+ *
+ *  \return bytes of the file, or -1 if it does not exist
+ */
+static long sizeOf(const char *path)
+{
+  struct stat st;
+
+  return (stat(path, &st) == 0) ? (long)st.st_size : -1;
+}
+
+/**
+ *  \brief Tells whether a key of the cache has the value the test stores for it.
+ *
+ *  \param cache cache
+ *  \param key key
+ *
+ *  \return true if the key is found with its value
+ */
+static bool found(struct resultCache *cache, uint64_t key)
+{
+  double value[2];
+
+  return cacheGet(cache, key, value) && value[0] == (double)key && value[1] == -(double)key;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *dir = (argc > 1) ? argv[1] : ".";
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/test.cache", dir);
+  remove(path);
+
+  size_t recordBytes = sizeof(uint64_t) + 2 * sizeof(double);
+  double value[2];
+
+  /* first run */
+  struct resultCache *cache = cacheOpen(dir, "test", sizeof(value));
+  check(cache != NULL, "the cache opens");
+  for (uint64_t key = 1; key <= KEYS; key++)
+  {
+    value[0] = key;
+    value[1] = -(double)key;
+    cachePut(cache, key, value);
+  }
+  cacheClose(cache);
+  check(sizeOf(path) == (long)(HEADER_BYTES + KEYS * recordBytes), "the records of the first run are written");
+
+  /* an interrupted run leaves a record cut */
+  FILE *fp = fopen(path, "ab");
+  fwrite("XXXXX", 1, 5, fp);
+  fclose(fp);
+
+  /* second run, after the cut record */
+  cache = cacheOpen(dir, "test", sizeof(value));
+  for (uint64_t key = 1; key <= KEYS; key++)
+    check(found(cache, key), "a key of the first run is found in the cut cache");
+  for (uint64_t key = KEYS + 1; key <= 2 * KEYS; key++)
+  {
+    value[0] = key;
+    value[1] = -(double)key;
+    cachePut(cache, key, value);
+  }
+  cacheClose(cache);
+  check(sizeOf(path) == (long)(HEADER_BYTES + 2 * KEYS * recordBytes), "the cut record is removed before the records are appended");
+
+  /* third run, every record is found */
+  cache = cacheOpen(dir, "test", sizeof(value));
+  bool all = true;
+  for (uint64_t key = 1; key <= 2 * KEYS; key++)
+    all = found(cache, key) && all;
+  check(all, "the keys of both runs are found");
+  cacheClose(cache);
+  remove(path);
+
+  if (failed == 0)
+    printf("resultCache: passed\n");
+  return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,51 @@
+#!/bin/bash
+#
+# Regression test of the scatter scheduling of the MPI text processing program.
+#
+# Every process reads its range of each file in windows of -m bytes and carries the state of the
+# word it is in from a window to the next, so the counts do not depend on the size of the windows
+# nor on the number of processes (one process included), and are those of the dispatcher. The
+# options scatter has no use for are refused.
+#
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+BIN=${BIN:-$HERE/bin}
+WORK=${WORK:-$HERE/work}
+MPIEXEC=${MPIEXEC:-mpiexec}
+MPIFLAGS=${MPIFLAGS:---oversubscribe}
+mkdir -p "$WORK"
+
+failed=0
+
+counts() { "$@" 2>/dev/null | awk -F' = ' '/^Total number of words|^N. of words/ { printf "%s ", $2 }'; }
+
+# long words of two and three byte characters, so the windows often end inside a word and a character
+TEXT=$WORK/scatter.txt
+: > "$TEXT"
+for r in $(seq 1 400); do
+  printf 'Constitucionalmente \xc3\xa0s extraordin\xc3\xa1rias a\xc3\xa7\xc3\xb5es, \xe2\x82\xacuros; inconstitucional%d pr\xc3\xa9-hist\xc3\xb3ria.\n' "$r" >> "$TEXT"
+done
+cp "$HERE/../assign2/prog1/texts/text1.txt" "$WORK/scatter1.txt"
+
+want=$(counts $MPIEXEC $MPIFLAGS -n 2 "$BIN/a2p1" -f "$TEXT" -f "$WORK/scatter1.txt")
+for n in 1 2 3 4; do
+  for m in 11 13 64 4096; do
+    got=$(counts $MPIEXEC $MPIFLAGS -n "$n" "$BIN/a2p1" -f "$TEXT" -f "$WORK/scatter1.txt" -s scatter -m "$m")
+    if [ "$got" != "$want" ]; then
+      echo "FAILED: scatter with $n processes and windows of $m bytes gave '$got', expected '$want'" >&2
+      failed=1
+    fi
+  done
+done
+
+for option in "-i mmap" "-a" "-R $WORK/scatter.ckpt" "-T 5"; do
+  if $MPIEXEC $MPIFLAGS -n 2 "$BIN/a2p1" -f "$TEXT" -s scatter $option > /dev/null 2>&1; then
+    echo "FAILED: scatter accepted $option" >&2
+    failed=1
+  fi
+done
+
+[ $failed -eq 0 ] && echo "scatterWindows: passed"
+exit $failed